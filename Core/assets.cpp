@@ -0,0 +1,123 @@
+#include <assets.h>
+
+// The cache holds one reference to every asset, so assets stay resident between frames
+// even when the caller only borrows them for a draw. asset_collect() frees the unused ones.
+std::map<std::string, ModelHandle>   asset_models;
+std::map<std::string, TextureHandle> asset_textures;
+asset_cache_stats_t                  asset_stats = {};
+
+///////////////////////////////////////////
+
+ModelHandle asset_load_model(const std::string& objPath, const std::string& texturePath) {
+	// A mesh can be paired with different textures, so both paths make up the key
+	std::string key = objPath + "|" + texturePath;
+
+	auto it = asset_models.find(key);
+	if (it != asset_models.end()) {
+		asset_stats.hits++;
+		return it->second;
+	}
+	asset_stats.misses++;
+
+	Model model;
+	model.loadModel(objPath, texturePath);
+
+	// Free the GPU buffers when the last handle goes away
+	ModelHandle handle(new Model(model), [](Model* m) {
+		asset_stats.resident_bytes -= m->bufferBytes;
+		asset_stats.resident_models--;
+		m->cleanupModel();
+		delete m;
+	});
+
+	asset_stats.resident_bytes += handle->bufferBytes;
+	asset_stats.resident_models++;
+	asset_models[key] = handle;
+	return handle;
+}
+
+TextureHandle asset_load_texture(const std::string& path) {
+	auto it = asset_textures.find(path);
+	if (it != asset_textures.end()) {
+		asset_stats.hits++;
+		return it->second;
+	}
+	asset_stats.misses++;
+
+	Texture texture;
+	if (app_config_texture_streaming) {
+		texture = stream_texture_load(path);
+	}
+	else {
+		texture = loadTextureFile(path);
+		texture_pages_add(texture);
+	}
+	TextureHandle handle(new Texture(texture), [](Texture* t) {
+		asset_stats.resident_bytes -= t->bytes;
+		asset_stats.resident_textures--;
+		texture_pages_remove(*t);
+		stream_texture_release(t->id);
+		glDeleteTextures(1, &t->id);
+		delete t;
+	});
+
+	asset_stats.resident_bytes += handle->bytes;
+	asset_stats.resident_textures++;
+	asset_textures[path] = handle;
+	return handle;
+}
+
+///////////////////////////////////////////
+
+size_t asset_collect() {
+	size_t freed = 0;
+
+	// Models first, since releasing a model can leave its texture unused
+	for (auto it = asset_models.begin(); it != asset_models.end();) {
+		if (it->second.use_count() == 1) {
+			it = asset_models.erase(it);
+			freed++;
+		}
+		else {
+			++it;
+		}
+	}
+	for (auto it = asset_textures.begin(); it != asset_textures.end();) {
+		if (it->second.use_count() == 1) {
+			it = asset_textures.erase(it);
+			freed++;
+		}
+		else {
+			++it;
+		}
+	}
+	return freed;
+}
+
+bool asset_release_model(Model* model) {
+	for (auto it = asset_models.begin(); it != asset_models.end(); ++it) {
+		if (it->second.get() != model)
+			continue;
+
+		// Someone else still draws it, and it must stay loaded for them
+		if (it->second.use_count() > 1)
+			return false;
+
+		// Drop it from the cache as well, so a later load imports it again instead of getting the freed model
+		asset_models.erase(it);
+		return true;
+	}
+
+	// Not from the cache, the caller owns it
+	model->cleanupModel();
+	return true;
+}
+
+void asset_shutdown() {
+	asset_models.clear();
+	asset_textures.clear();
+}
+
+asset_cache_stats_t asset_cache_stats() {
+	return asset_stats;
+}
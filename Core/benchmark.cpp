@@ -0,0 +1,1863 @@
+#include <benchmark.h>
+
+const int benchmark_frames = 20;   // Frames timed per measurement
+const int benchmark_size   = 512;  // Offscreen target size, kept small so we measure submission and not fill
+const int benchmark_edge_pixels = benchmark_size * benchmark_size / 1000; // Allowed to differ where the GPU rounds transforms differently
+
+benchmark_scene_t benchmark_scene_create() {
+	benchmark_scene_t scene = {};
+
+	// Render target
+	glGenTextures(1, &scene.color);
+	glBindTexture(GL_TEXTURE_2D, scene.color);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, benchmark_size, benchmark_size);
+	glGenRenderbuffers(1, &scene.depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, scene.depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, benchmark_size, benchmark_size);
+	glGenFramebuffers(1, &scene.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, scene.fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scene.color, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, scene.depth);
+
+	// Cube in the same vertex layout Model::loadModel produces: position, normal, tex coords
+	std::vector<float> vertices;
+	for (int i = 0; i < 8; i++) {
+		float x = (i & 1) ? 0.5f : -0.5f, y = (i & 2) ? 0.5f : -0.5f, z = (i & 4) ? 0.5f : -0.5f;
+		vertices.insert(vertices.end(), { x, y, z, x, y, z, x + 0.5f, y + 0.5f });
+	}
+	std::vector<uint32_t> indices = {
+		0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+		2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5 };
+	scene.index_count = (GLsizei)indices.size();
+	scene.bounds = { glm::vec3(-0.5f), glm::vec3(0.5f), glm::vec3(0.0f), sqrtf(0.75f) };
+
+	glGenVertexArrays(1, &scene.vao);
+	glGenBuffers(1, &scene.vbo);
+	glGenBuffers(1, &scene.ebo);
+	glBindVertexArray(scene.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, scene.vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+	glBindVertexArray(0);
+
+	// 1x1 white texture
+	uint32_t white = 0xFFFFFFFF;
+	glGenTextures(1, &scene.texture);
+	glBindTexture(GL_TEXTURE_2D, scene.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	Shaders shaders("Shaders/default.vert", "Shaders/default.frag");
+	scene.program = gl_create_program(shaders.vertexShader, shaders.fragmentShader);
+	glUniformBlockBinding(scene.program, glGetUniformBlockIndex(scene.program, "TransformBuffer"), 0);
+
+	glViewport(0, 0, benchmark_size, benchmark_size);
+	glEnable(GL_DEPTH_TEST);
+	return scene;
+}
+
+void benchmark_scene_destroy(benchmark_scene_t& scene) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &scene.fbo);
+	glDeleteTextures(1, &scene.color);
+	glDeleteRenderbuffers(1, &scene.depth);
+	glDeleteVertexArrays(1, &scene.vao);
+	glDeleteBuffers(1, &scene.vbo);
+	glDeleteBuffers(1, &scene.ebo);
+	glDeleteTextures(1, &scene.texture);
+	glDeleteProgram(scene.program);
+}
+
+// A grid of objects in front of the camera
+std::vector<glm::mat4> benchmark_transforms(int count) {
+	std::vector<glm::mat4> worlds(count);
+	int side = (int)ceil(sqrt((double)count));
+	for (int i = 0; i < count; i++) {
+		glm::vec3 pos((i % side) - side * 0.5f, (i / side) - side * 0.5f, -side * 1.0f);
+		worlds[i] = glm::translate(glm::mat4(1.0f), pos) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+	}
+	return worlds;
+}
+
+double benchmark_elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+///////////////////////////////////////////
+
+// What the benchmarks below share, so each one is only its scenario and its checks: time a frame, draw
+// one through a render queue, read the image back to compare and print a row of results.
+
+// ms per frame over frames timed frames, GPU work included. draw_frame runs frames + 1 times, the first
+// untimed to warm up, which also grows the ring and anything else sized by the first frame.
+double benchmark_time_frames(int frames, const std::function<void()>& draw_frame) {
+	draw_frame();
+	glFinish();
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int f = 0; f < frames; f++) {
+		draw_frame();
+	}
+	glFinish();
+	return benchmark_elapsed_ms(start) / frames;
+}
+
+// A frame into the offscreen target through the queue, looking down -z from the origin. push fills the
+// queue, which is culled against the view first when cull is set.
+void benchmark_queue_frame(benchmark_scene_t& scene, render_queue_t& queue, bool cull, const std::function<void()>& push) {
+	glBindFramebuffer(GL_FRAMEBUFFER, scene.fbo);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	gl_ring_begin_frame(app_uniform_ring);
+	render_queue_begin(queue, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+	if (cull)
+		render_queue_set_frustum(queue, cull_frustum_from_matrix(app_view.viewproj[0]));
+	push();
+	render_queue_flush(queue);
+	gl_ring_end_frame(app_uniform_ring);
+}
+
+std::vector<uint8_t> benchmark_read_image() {
+	std::vector<uint8_t> image(benchmark_size * benchmark_size * 4);
+	glReadPixels(0, 0, benchmark_size, benchmark_size, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+	return image;
+}
+
+uint32_t benchmark_pixels_differ(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+	uint32_t differ = 0;
+	for (size_t p = 0; p < a.size(); p += 4) {
+		differ += memcmp(&a[p], &b[p], 4) != 0;
+	}
+	return differ;
+}
+
+void benchmark_table_header(const benchmark_table_t& table) {
+	printf("  %-*s", table.label_width, table.label);
+	for (const benchmark_column_t& column : table.columns) {
+		printf("  %*s", column.width, column.name);
+	}
+	printf("\n");
+}
+
+// One number per column, NAN leaves a cell blank and note goes after the last value given
+void benchmark_table_row(const benchmark_table_t& table, const char* label, std::initializer_list<double> values, const char* note = "") {
+	printf("  %-*s", table.label_width, label);
+	const benchmark_column_t* column = table.columns.data();
+	for (double value : values) {
+		if (std::isnan(value))
+			printf("  %*s", column->width, "");
+		else
+			printf("  %*.*f", column->width, column->precision, value);
+		column++;
+	}
+	printf("%s\n", note);
+}
+
+///////////////////////////////////////////
+
+// The submission path from before the render queue and uniform ring: every draw rebinds all of its
+// state and does a synchronous glBufferSubData into one shared uniform buffer
+double benchmark_draws_buffer_subdata(benchmark_scene_t& scene, const std::vector<glm::mat4>& worlds) {
+	GLuint ubo;
+	glGenBuffers(1, &ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(app_transform_buffer_t), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, ubo);
+
+	auto draw_frame = [&]() {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		for (const glm::mat4& world : worlds) {
+			glUseProgram(scene.program);
+
+			app_transform_buffer_t uniforms;
+			uniforms.world = world;
+			uniforms.mvp[0] = app_view.viewproj[0] * world;
+			uniforms.material = glm::uvec4(texture_no_layer, 0, 0, 0);
+			glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(app_transform_buffer_t), &uniforms);
+
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, scene.texture);
+			glUniform1i(glGetUniformLocation(scene.program, "texture_diffuse"), 0);
+
+			glBindVertexArray(scene.vao);
+			glDrawElements(GL_TRIANGLES, scene.index_count, GL_UNSIGNED_INT, 0);
+			glBindVertexArray(0);
+
+			glUseProgram(0);
+		}
+	};
+
+	double ms = benchmark_time_frames(benchmark_frames, draw_frame);
+	glDeleteBuffers(1, &ubo);
+	return worlds.size() / ms;
+}
+
+// The current path: queued, sorted, MVP built on the CPU and written into the persistently mapped ring
+double benchmark_draws_uniform_ring(benchmark_scene_t& scene, const std::vector<glm::mat4>& worlds) {
+	render_queue_t queue;
+	draw_mesh_t mesh = { scene.program, scene.texture, scene.vao, scene.index_count, 0, GL_UNSIGNED_INT, false, glm::vec3(0.0f), glm::vec3(1.0f) };
+
+	double ms = benchmark_time_frames(benchmark_frames, [&]() {
+		benchmark_queue_frame(scene, queue, false, [&]() {
+			for (const glm::mat4& world : worlds) {
+				render_queue_push(queue, mesh, world, scene.bounds);
+			}
+		});
+	});
+	return worlds.size() / ms;
+}
+
+void benchmark_uniform_upload(benchmark_scene_t& scene) {
+	printf("\nPer draw uniform upload (draws/ms, higher is better, %s ring)\n", app_uniform_ring.persistent ? "persistent mapped" : "staged");
+	benchmark_table_t table = { "objects", 8, { { "glBufferSubData", 16, 1 }, { "uniform ring", 16, 1 } } };
+	benchmark_table_header(table);
+
+	const int counts[] = { 1000, 10000 };
+	for (int count : counts) {
+		std::vector<glm::mat4> worlds = benchmark_transforms(count);
+		double before = benchmark_draws_buffer_subdata(scene, worlds);
+		double after = benchmark_draws_uniform_ring(scene, worlds);
+		char speedup[32];
+		snprintf(speedup, sizeof(speedup), "  (%.2fx)", after / before);
+		benchmark_table_row(table, std::to_string(count).c_str(), { before, after }, speedup);
+	}
+}
+
+///////////////////////////////////////////
+
+// Objects spread all around the viewer, like an outdoor scene where most of it is behind you
+std::vector<glm::mat4> benchmark_transforms_surround(int count, float radius = 60.0f) {
+	std::vector<glm::mat4> worlds(count);
+	for (int i = 0; i < count; i++) {
+		float angle = (float)i * 2.39996f; // Golden angle, an even spread without any randomness
+		float dist = 2.0f + radius * (float)(i % 97) / 97.0f;
+		glm::vec3 pos(cosf(angle) * dist, (float)(i % 7) - 3.0f, sinf(angle) * dist);
+		worlds[i] = glm::translate(glm::mat4(1.0f), pos) * glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0, 1, 0));
+	}
+	return worlds;
+}
+
+// Same test as cull_frustum_test(), one box and one plane at a time
+uint32_t benchmark_cull_scalar(const frustum_t& frustum, const cull_list_t& list) {
+	uint32_t visible = 0;
+	for (uint32_t i = 0; i < list.count; i++) {
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++) {
+			const glm::vec4& plane = frustum.planes[p];
+			float dist = plane.x * list.center_x[i] + plane.y * list.center_y[i] + plane.z * list.center_z[i] + plane.w;
+			float radius = fabsf(plane.x) * list.extent_x[i] + fabsf(plane.y) * list.extent_y[i] + fabsf(plane.z) * list.extent_z[i];
+			inside = dist + radius >= 0.0f;
+		}
+		visible += inside ? 1 : 0;
+	}
+	return visible;
+}
+
+void benchmark_culling(benchmark_scene_t& scene) {
+	printf("\nFrustum culling (microseconds per frame, lower is better)\n");
+	benchmark_table_t table = { "objects", 8, { { "visible", 8, 0 }, { "scalar", 10, 1 }, { "sse", 10, 1 } } };
+	benchmark_table_header(table);
+
+	// A headset-like stereo pair: about 100 degrees per eye, wider on the outside, 64mm apart, looking down -z
+	XrView views[2] = { { XR_TYPE_VIEW }, { XR_TYPE_VIEW } };
+	views[0].pose = views[1].pose = xr_pose_identity;
+	views[0].pose.position.x = -0.032f;
+	views[1].pose.position.x = 0.032f;
+	views[0].fov = { -0.96f, 0.78f, 0.85f, -0.85f };
+	views[1].fov = { -0.78f, 0.96f, 0.85f, -0.85f };
+	frustum_t frustum = cull_frustum_stereo(views, 2, 0.05f, 100.0f);
+
+	const int counts[] = { 1000, 20000 };
+	for (int count : counts) {
+		std::vector<glm::mat4> worlds = benchmark_transforms_surround(count);
+		cull_list_t list = {};
+		for (const glm::mat4& world : worlds) {
+			cull_list_add(list, scene.bounds, world);
+		}
+
+		// Culling is cheap, so time many more frames than the draw benchmarks to get a stable number.
+		// The far plane moves a tiny bit each frame, so the compiler can't hoist the scalar loop out.
+		const int frames = benchmark_frames * 10;
+		volatile uint32_t visible_scalar = benchmark_cull_scalar(frustum, list);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int f = 0; f < frames; f++) {
+			frustum.planes[5].w += 1e-6f;
+			visible_scalar = benchmark_cull_scalar(frustum, list);
+		}
+		double scalar_us = benchmark_elapsed_ms(start) * 1000.0 / frames;
+
+		cull_stats_t stats = cull_frustum_test(frustum, list); // warm up, sizes visible[]
+		start = std::chrono::high_resolution_clock::now();
+		for (int f = 0; f < frames; f++) {
+			stats = cull_frustum_test(frustum, list);
+		}
+		double sse_us = benchmark_elapsed_ms(start) * 1000.0 / frames;
+
+		benchmark_table_row(table, std::to_string(count).c_str(), { (double)stats.visible, scalar_us, sse_us },
+			visible_scalar == stats.visible ? "" : "  (MISMATCH with scalar)");
+	}
+}
+
+// Flat SSE culling against the static scene BVH, on scenes of growing size. The BVH cost should grow
+// with what's visible, not with the object count.
+void benchmark_bvh(benchmark_scene_t& scene) {
+	printf("\nStatic scene BVH (microseconds per frame, lower is better)\n");
+	benchmark_table_t table = { "objects", 8, { { "visible", 8, 0 }, { "build ms", 10, 1 }, { "flat sse", 10, 1 }, { "bvh", 10, 1 }, { "nodes", 8, 0 } } };
+	benchmark_table_header(table);
+
+	// The level grows with the object count at the same density, so what's in view stays about the same
+	frustum_t frustum = cull_frustum_from_matrix(glm::perspective(glm::radians(60.0f), 1.0f, 0.05f, 30.0f));
+
+	const int counts[] = { 1000, 20000, 100000 };
+	for (int count : counts) {
+		std::vector<glm::mat4> worlds = benchmark_transforms_surround(count, 60.0f * sqrtf(count / 1000.0f));
+		cull_list_t list = {};
+		std::vector<aabb_t> boxes;
+		for (const glm::mat4& world : worlds) {
+			cull_list_add(list, scene.bounds, world);
+			boxes.push_back(cull_world_box(scene.bounds, world));
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		bvh_t bvh;
+		bvh_build(bvh, boxes);
+		double build_ms = benchmark_elapsed_ms(start);
+
+		const int frames = benchmark_frames * 10;
+		cull_stats_t flat = cull_frustum_test(frustum, list);
+		start = std::chrono::high_resolution_clock::now();
+		for (int f = 0; f < frames; f++) {
+			flat = cull_frustum_test(frustum, list);
+		}
+		double flat_us = benchmark_elapsed_ms(start) * 1000.0 / frames;
+
+		std::vector<uint32_t> visible;
+		bvh_stats_t stats = {};
+		start = std::chrono::high_resolution_clock::now();
+		for (int f = 0; f < frames; f++) {
+			visible.clear();
+			bvh_cull(bvh, boxes, frustum, visible, stats);
+		}
+		double bvh_us = benchmark_elapsed_ms(start) * 1000.0 / frames;
+
+		benchmark_table_row(table, std::to_string(count).c_str(), { (double)stats.objects_visible, build_ms, flat_us, bvh_us, (double)stats.nodes_visited },
+			flat.visible == stats.objects_visible ? "" : "  (MISMATCH with flat)");
+	}
+}
+
+// Whether a wall of benchmark_occlusion blocks the line from an eye to a point, walls are rectangles facing +z
+bool benchmark_occlusion_blocked(const glm::vec3& eye, const glm::vec3& point) {
+	for (int w = -6; w <= 6; w++) {
+		float depth = 6.0f + (float)((w + 6) % 4) * 2.0f + 1.0f; // The quad sits at z = -1 before it's placed
+		if (point.z > -depth)
+			continue;
+		glm::vec3 hit = eye + (point - eye) * ((-depth - eye.z) / (point.z - eye.z));
+		if (hit.x >= w * 5.0f - 2.0f && hit.x <= w * 5.0f + 2.0f && hit.y >= -4.0f && hit.y <= 8.0f)
+			return true;
+	}
+	return false;
+}
+
+// Walls in front of a field of objects, rasterized and tested on the CPU only. The buffer is drawn from
+// between two eyes 64 mm apart, and every box it hides must have all its corners hidden from both eyes.
+// Boxes that reach the edge of the view are left out of that check, an eye sees a little past it.
+void benchmark_occlusion(benchmark_scene_t& scene) {
+	printf("\nOcclusion culling (%ux%u buffer, %u threads)\n", occlusion_width, occlusion_height, jobs_thread_count());
+	benchmark_table_t table = { "objects", 8, { { "in view", 8, 0 }, { "walls", 8, 0 }, { "occluded", 8, 0 }, { "raster us", 10, 1 }, { "test us", 10, 1 }, { "us/object", 10, 3 } } };
+	benchmark_table_header(table);
+
+	const glm::vec3 wall_positions[] = { glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, -1.0f), glm::vec3(1.0f, 1.0f, -1.0f), glm::vec3(0.0f, 1.0f, -1.0f) };
+	const uint32_t  wall_indices[] = { 0, 1, 2, 0, 2, 3 };
+	glm::mat4 viewproj = glm::perspective(glm::radians(90.0f), (float)occlusion_width / occlusion_height, 0.05f, 100.0f);
+	frustum_t frustum = cull_frustum_from_matrix(viewproj);
+
+	const int counts[] = { 1000, 20000 };
+	for (int count : counts) {
+		// Occlusion only ever sees what survived frustum culling
+		std::vector<aabb_t> boxes;
+		for (const glm::mat4& world : benchmark_transforms_surround(count)) {
+			aabb_t box = cull_world_box(scene.bounds, world);
+			uint32_t plane_mask = 0x3F;
+			if (bvh_test_planes(frustum, box.min, box.max, plane_mask))
+				boxes.push_back(box);
+		}
+
+		const int frames = benchmark_frames * 10;
+		double raster_us = 0.0, test_us = 0.0;
+		uint32_t occluded = 0, walls = 0, wrong = 0;
+		for (int f = 0; f < frames; f++) {
+			occlusion_begin(app_occlusion, viewproj, 0.032f);
+
+			// A row of buildings 6 to 12 meters out, 4 meters wide with gaps between them
+			walls = 0;
+			for (int w = -6; w <= 6; w++) {
+				float depth = 6.0f + (float)((w + 6) % 4) * 2.0f;
+				glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3(w * 5.0f - 2.0f, -4.0f, -depth)) * glm::scale(glm::mat4(1.0f), glm::vec3(4.0f, 12.0f, 1.0f));
+				occlusion_add_occluder(app_occlusion, wall_positions, wall_indices, 6, world);
+				walls++;
+			}
+			occlusion_rasterize(app_occlusion);
+			raster_us += app_occlusion.stats.raster_us;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			occluded = 0;
+			wrong = 0;
+			for (const aabb_t& box : boxes) {
+				if (!occlusion_test_box(app_occlusion, box)) {
+					occluded++;
+					bool hidden = true;
+					for (int c = 0; c < 16 && hidden; c++) {
+						glm::vec3 eye((c & 8) ? 0.032f : -0.032f, 0.0f, 0.0f);
+						glm::vec3 corner((c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y, (c & 4) ? box.max.z : box.min.z);
+						glm::vec4 clip = viewproj * glm::vec4(corner, 1.0f);
+						if (fabsf(clip.x) > clip.w * 0.95f || fabsf(clip.y) > clip.w * 0.95f)
+							break;
+						hidden = benchmark_occlusion_blocked(eye, corner);
+					}
+					wrong += hidden ? 0 : 1;
+				}
+			}
+			test_us += benchmark_elapsed_ms(start) * 1000.0;
+		}
+
+		benchmark_table_row(table, std::to_string(count).c_str(), { (double)boxes.size(), (double)walls, (double)occluded, raster_us / frames, test_us / frames, test_us / frames / boxes.size() },
+			wrong == 0 ? "" : "  (ERROR: objects an eye can see were occluded)");
+	}
+}
+
+// Bumpy UV sphere in the loadModel vertex layout, with the duplicated seam and pole vertices a real export has
+void benchmark_sphere_mesh(uint32_t rings, uint32_t segments, std::vector<float>& vertices, std::vector<uint32_t>& indices) {
+	for (uint32_t r = 0; r <= rings; r++) {
+		for (uint32_t s = 0; s <= segments; s++) {
+			float u = (float)s / segments, v = (float)r / rings;
+			float theta = u * glm::two_pi<float>(), phi = v * glm::pi<float>();
+			glm::vec3 normal(sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta));
+			float height = 1.0f + 0.03f * sinf(theta * 7.0f) * sinf(phi * 5.0f);
+			glm::vec3 position = normal * height * 0.5f;
+			vertices.insert(vertices.end(), { position.x, position.y, position.z, normal.x, normal.y, normal.z, u, v });
+		}
+	}
+	for (uint32_t r = 0; r < rings; r++) {
+		for (uint32_t s = 0; s < segments; s++) {
+			uint32_t a = r * (segments + 1) + s, b = a + segments + 1;
+			indices.insert(indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+		}
+	}
+}
+
+// Simplification cost at import, then drawing a field of spheres with and without LOD selection
+void benchmark_lod(benchmark_scene_t& scene) {
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	benchmark_sphere_mesh(64, 128, vertices, indices);
+
+	std::vector<uint32_t> lod_indices;
+	std::vector<lod_range_t> lods;
+	auto start = std::chrono::high_resolution_clock::now();
+	lod_build(vertices.data(), 8, (uint32_t)(vertices.size() / 8), indices, 0.5f, lod_indices, lods);
+	double build_ms = benchmark_elapsed_ms(start);
+
+	printf("\nLOD generation (%zu triangles, %.1f ms)\n", indices.size() / 3, build_ms);
+	benchmark_table_t levels = { "level", 8, { { "triangles", 10, 0 }, { "error", 10, 5 } } };
+	benchmark_table_header(levels);
+	for (size_t i = 0; i < lods.size(); i++) {
+		benchmark_table_row(levels, std::to_string(i).c_str(), { (double)(lods[i].index_count / 3), lods[i].error });
+	}
+
+	// The same sphere with a vertex per triangle corner, the way an unwelded OBJ import comes in, has to
+	// simplify just as far, only real UV and normal seams may hold it back
+	std::vector<float> corners;
+	std::vector<uint32_t> corner_indices, corner_lod_indices;
+	std::vector<lod_range_t> corner_lods;
+	for (uint32_t index : indices) {
+		corner_indices.push_back((uint32_t)corner_indices.size());
+		corners.insert(corners.end(), vertices.begin() + index * 8, vertices.begin() + index * 8 + 8);
+	}
+	lod_build(corners.data(), 8, (uint32_t)(corners.size() / 8), corner_indices, 0.5f, corner_lod_indices, corner_lods);
+	printf("  unwelded: %zu levels, coarsest %u triangles%s\n", corner_lods.size(), corner_lods.back().index_count / 3,
+		corner_lods.size() == lods.size() ? "" : "  (ERROR: fewer levels than the welded mesh)");
+
+	GLuint vao, vbo, ebo;
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, lod_indices.size() * sizeof(uint32_t), lod_indices.data(), GL_STATIC_DRAW);
+	vertex_attributes_float();
+	glBindVertexArray(0);
+
+	// Spheres spread from 2 to 40 meters in front of the camera
+	std::vector<glm::mat4> worlds;
+	for (int i = 0; i < 200; i++) {
+		float distance = 2.0f + 38.0f * (float)i / 200;
+		float angle = (float)i * 2.39996f;
+		glm::vec3 position(cosf(angle) * distance * 0.4f, sinf(angle) * distance * 0.4f, -distance);
+		worlds.push_back(glm::translate(glm::mat4(1.0f), position));
+	}
+
+	app_view.lod_position = glm::vec3(0.0f);
+	app_view.lod_scale = 0.5f; // 90 degree vertical FOV
+	benchmark_table_t table = { "mode", 8, { { "triangles", 10, 0 }, { "ms/frame", 10, 2 } } };
+	benchmark_table_header(table);
+	const int frames = benchmark_frames / 4; // These frames are GPU bound, and slow on software rasterizers
+	for (int use_lod = 0; use_lod < 2; use_lod++) {
+		uint64_t triangles = 0;
+		double ms = benchmark_time_frames(frames, [&]() {
+			triangles = 0;
+			benchmark_queue_frame(scene, app_render_queue, false, [&]() {
+				for (const glm::mat4& world : worlds) {
+					uint32_t level = use_lod ? lod_select((uint32_t)lods.size(), glm::vec3(world[3]), 0.5f) : 0;
+					draw_mesh_t mesh = { scene.program, scene.texture, vao, (GLsizei)lods[level].index_count, lods[level].first_index, GL_UNSIGNED_INT, false, glm::vec3(0.0f), glm::vec3(1.0f) };
+					render_queue_push(app_render_queue, mesh, world, scene.bounds);
+					triangles += lods[level].index_count / 3;
+				}
+			});
+		});
+		benchmark_table_row(table, use_lod ? "lod" : "full", { (double)triangles, ms });
+	}
+	app_view.lod_scale = 0.0f;
+
+	glDeleteBuffers(1, &vbo);
+	glDeleteBuffers(1, &ebo);
+	glDeleteVertexArrays(1, &vao);
+}
+
+// Quantization error measured on the CPU, then the same field of spheres drawn from each vertex layout
+void benchmark_vertex_format(benchmark_scene_t& scene) {
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	benchmark_sphere_mesh(64, 128, vertices, indices);
+	uint32_t vertex_count = (uint32_t)(vertices.size() / vertex_float_stride);
+	glm::vec3 box_min(-0.52f), box_max(0.52f);
+
+	std::vector<vertex_quantized_t> packed;
+	vertex_quantize(vertices.data(), vertex_count, box_min, box_max, packed);
+
+	// Decode the way the vertex fetch and default.vert do
+	float position_error = 0.0f, normal_error = 0.0f, uv_error = 0.0f;
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		const float* v = &vertices[i * vertex_float_stride];
+		const vertex_quantized_t& q = packed[i];
+		glm::vec3 position = box_min + glm::vec3(q.position[0], q.position[1], q.position[2]) / 65535.0f * (box_max - box_min);
+		glm::vec2 e = glm::max(glm::vec2(q.normal[0], q.normal[1]) / 32767.0f, -1.0f);
+		glm::vec3 n(e, 1.0f - fabsf(e.x) - fabsf(e.y));
+		float t = glm::max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		glm::vec2 uv(glm::unpackHalf1x16(q.uv[0]), glm::unpackHalf1x16(q.uv[1]));
+		position_error = glm::max(position_error, glm::distance(position, glm::vec3(v[0], v[1], v[2])));
+		normal_error = glm::max(normal_error, glm::degrees(acosf(glm::clamp(glm::dot(glm::normalize(n), glm::vec3(v[3], v[4], v[5])), -1.0f, 1.0f))));
+		uv_error = glm::max(uv_error, glm::distance(uv, glm::vec2(v[6], v[7])));
+	}
+	printf("\nVertex format (%u vertices, %zu triangles)\n", vertex_count, indices.size() / 3);
+	printf("  max error: position %.6f (of a 1.04 box), normal %.4f degrees, uv %.6f\n", position_error, normal_error, uv_error);
+
+	Shaders shaders("Shaders/default.vert", "Shaders/default.frag");
+	GLuint quantized_program = gl_create_program(shaders.vertexShader, shaders.fragmentShader, "#define QUANTIZED\n");
+	glUniformBlockBinding(quantized_program, glGetUniformBlockIndex(quantized_program, "TransformBuffer"), 0);
+
+	GLuint vao[2], vbo[2], ebo;
+	glGenVertexArrays(2, vao);
+	glGenBuffers(2, vbo);
+	glGenBuffers(1, &ebo);
+	for (int quantized = 0; quantized < 2; quantized++) {
+		glBindVertexArray(vao[quantized]);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo[quantized]);
+		if (quantized)
+			glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(vertex_quantized_t), packed.data(), GL_STATIC_DRAW);
+		else
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		if (!quantized)
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+		if (quantized)
+			vertex_attributes_quantized();
+		else
+			vertex_attributes_float();
+	}
+	glBindVertexArray(0);
+
+	std::vector<glm::mat4> worlds;
+	for (int i = 0; i < 100; i++) {
+		glm::vec3 position((float)(i % 10) - 4.5f, (float)(i / 10) - 4.5f, -8.0f);
+		worlds.push_back(glm::translate(glm::mat4(1.0f), position));
+	}
+
+	benchmark_table_t table = { "layout", 10, { { "bytes/vertex", 12, 0 }, { "ms/frame", 10, 2 } } };
+	benchmark_table_header(table);
+	std::vector<uint8_t> images[2];
+	for (int quantized = 0; quantized < 2; quantized++) {
+		draw_mesh_t mesh = { quantized ? quantized_program : scene.program, scene.texture, vao[quantized], (GLsizei)indices.size(), 0, GL_UNSIGNED_INT, quantized != 0, box_min, box_max - box_min };
+		double ms = benchmark_time_frames(benchmark_frames / 4, [&]() {
+			benchmark_queue_frame(scene, app_render_queue, false, [&]() {
+				for (const glm::mat4& world : worlds) {
+					render_queue_push(app_render_queue, mesh, world, scene.bounds);
+				}
+			});
+		});
+		benchmark_table_row(table, quantized ? "quantized" : "float", { (double)(quantized ? sizeof(vertex_quantized_t) : vertex_float_stride * sizeof(float)), ms });
+		images[quantized] = benchmark_read_image();
+	}
+
+	// Both layouts should cover the same pixels, give or take edges the position rounding moved
+	printf("  %u of %d pixels differ between the layouts\n", benchmark_pixels_differ(images[0], images[1]), benchmark_size * benchmark_size);
+
+	glDeleteProgram(quantized_program);
+	glDeleteBuffers(2, vbo);
+	glDeleteBuffers(1, &ebo);
+	glDeleteVertexArrays(2, vao);
+}
+
+// The import pipeline on a sphere that arrives the way Assimp hands over an OBJ: a separate vertex per face
+// corner, triangles in no useful order
+void benchmark_mesh_optimization(benchmark_scene_t& scene) {
+	std::vector<float> sphere_vertices;
+	std::vector<uint32_t> sphere_indices;
+	benchmark_sphere_mesh(64, 128, sphere_vertices, sphere_indices);
+
+	// Stepping by a prime visits every triangle once, scattered without any randomness
+	uint32_t triangle_count = (uint32_t)(sphere_indices.size() / 3);
+	std::vector<uint32_t> shuffled(triangle_count);
+	for (uint32_t t = 0; t < triangle_count; t++) {
+		shuffled[t] = (uint32_t)((t * 7919ull) % triangle_count);
+	}
+
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	for (uint32_t t : shuffled) {
+		for (int c = 0; c < 3; c++) {
+			const float* v = &sphere_vertices[sphere_indices[t * 3 + c] * vertex_float_stride];
+			indices.push_back((uint32_t)(vertices.size() / vertex_float_stride));
+			vertices.insert(vertices.end(), v, v + vertex_float_stride);
+		}
+	}
+	std::vector<float> raw_vertices = vertices;
+	std::vector<uint32_t> raw_indices = indices;
+	uint32_t raw_count = (uint32_t)(vertices.size() / vertex_float_stride);
+
+	printf("\nMesh optimization (%u triangles, %u-entry FIFO cache)\n", triangle_count, mesh_cache_size);
+	benchmark_table_t stages = { "stage", 14, { { "vertices", 8, 0 }, { "ACMR", 8, 3 }, { "ATVR", 8, 3 }, { "ms", 8, 2 } } };
+	benchmark_table_header(stages);
+	mesh_cache_stats_t stats = mesh_cache_stats(indices.data(), indices.size(), raw_count);
+	benchmark_table_row(stages, "imported", { (double)raw_count, stats.acmr, stats.atvr });
+
+	auto start = std::chrono::high_resolution_clock::now();
+	uint32_t vertex_count = mesh_weld(vertices, vertex_float_stride, indices);
+	double ms = benchmark_elapsed_ms(start);
+	stats = mesh_cache_stats(indices.data(), indices.size(), vertex_count);
+	benchmark_table_row(stages, "weld", { (double)vertex_count, stats.acmr, stats.atvr, ms });
+
+	start = std::chrono::high_resolution_clock::now();
+	mesh_optimize_vertex_cache(indices.data(), indices.size(), vertex_count);
+	ms = benchmark_elapsed_ms(start);
+	stats = mesh_cache_stats(indices.data(), indices.size(), vertex_count);
+	benchmark_table_row(stages, "vertex cache", { (double)vertex_count, stats.acmr, stats.atvr, ms });
+
+	start = std::chrono::high_resolution_clock::now();
+	uint32_t clusters = mesh_optimize_overdraw(indices.data(), indices.size(), vertices.data(), vertex_float_stride);
+	ms = benchmark_elapsed_ms(start);
+	stats = mesh_cache_stats(indices.data(), indices.size(), vertex_count);
+	char note[32];
+	snprintf(note, sizeof(note), "  (%u clusters)", clusters);
+	benchmark_table_row(stages, "overdraw", { (double)vertex_count, stats.acmr, stats.atvr, ms }, note);
+
+	start = std::chrono::high_resolution_clock::now();
+	mesh_optimize_vertex_fetch(vertices, vertex_float_stride, indices);
+	ms = benchmark_elapsed_ms(start);
+	stats = mesh_cache_stats(indices.data(), indices.size(), vertex_count);
+	benchmark_table_row(stages, "vertex fetch", { (double)vertex_count, stats.acmr, stats.atvr, ms });
+
+	// Draw both versions, the optimized one with 16 bit indices
+	std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+	GLuint vao[2], vbo[2], ebo[2];
+	glGenVertexArrays(2, vao);
+	glGenBuffers(2, vbo);
+	glGenBuffers(2, ebo);
+	for (int optimized = 0; optimized < 2; optimized++) {
+		const std::vector<float>& source = optimized ? vertices : raw_vertices;
+		glBindVertexArray(vao[optimized]);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo[optimized]);
+		glBufferData(GL_ARRAY_BUFFER, source.size() * sizeof(float), source.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo[optimized]);
+		if (optimized)
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, short_indices.size() * sizeof(uint16_t), short_indices.data(), GL_STATIC_DRAW);
+		else
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, raw_indices.size() * sizeof(uint32_t), raw_indices.data(), GL_STATIC_DRAW);
+		vertex_attributes_float();
+	}
+	glBindVertexArray(0);
+
+	std::vector<glm::mat4> worlds;
+	for (int i = 0; i < 100; i++) {
+		worlds.push_back(glm::translate(glm::mat4(1.0f), glm::vec3((float)(i % 10) - 4.5f, (float)(i / 10) - 4.5f, -8.0f)));
+	}
+
+	benchmark_table_t table = { "draw", 14, { { "bytes", 8, 0 }, { "ms/frame", 10, 2 } } };
+	benchmark_table_header(table);
+	for (int optimized = 0; optimized < 2; optimized++) {
+		draw_mesh_t mesh = { scene.program, scene.texture, vao[optimized], (GLsizei)indices.size(), 0, optimized ? (GLenum)GL_UNSIGNED_SHORT : (GLenum)GL_UNSIGNED_INT, false, glm::vec3(0.0f), glm::vec3(1.0f) };
+		ms = benchmark_time_frames(benchmark_frames / 4, [&]() {
+			benchmark_queue_frame(scene, app_render_queue, false, [&]() {
+				for (const glm::mat4& world : worlds) {
+					render_queue_push(app_render_queue, mesh, world, scene.bounds);
+				}
+			});
+		});
+		size_t bytes = optimized ?
+			vertices.size() * sizeof(float) + short_indices.size() * sizeof(uint16_t) :
+			raw_vertices.size() * sizeof(float) + raw_indices.size() * sizeof(uint32_t);
+		benchmark_table_row(table, optimized ? "optimized" : "imported", { (double)bytes, ms });
+	}
+
+	glDeleteBuffers(2, vbo);
+	glDeleteBuffers(2, ebo);
+	glDeleteVertexArrays(2, vao);
+}
+
+// Baking cost, size and quality for each block format on a generated image, against uploading RGBA8 and
+// letting the driver build the mips. Quality is measured on what the GPU decodes, read back from level 0.
+void benchmark_texture_compression() {
+	const uint32_t size = 1024;
+	texture_image_t image = { size, size };
+	image.pixels.resize((size_t)size * size * 4);
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			// Smooth gradients with a band of fine stripes and a soft alpha disc, roughly what photos and UI mix
+			float u = x / (float)size, v = y / (float)size;
+			float stripes = (y / 64) % 4 == 0 ? 40.0f * sinf(x * 0.8f) : 0.0f;
+			float disc = glm::clamp(1.5f - 3.0f * glm::length(glm::vec2(u, v) - glm::vec2(0.5f)), 0.0f, 1.0f);
+			uint8_t* p = &image.pixels[((size_t)y * size + x) * 4];
+			p[0] = (uint8_t)glm::clamp(255.0f * u + stripes, 0.0f, 255.0f);
+			p[1] = (uint8_t)glm::clamp(255.0f * v, 0.0f, 255.0f);
+			p[2] = (uint8_t)glm::clamp(128.0f + 127.0f * sinf(u * 6.0f + v * 4.0f), 0.0f, 255.0f);
+			p[3] = (uint8_t)(255.0f * disc);
+		}
+	}
+
+	printf("\nTexture compression (%ux%u RGBA, full mip chain, %u threads)\n", size, size, jobs_thread_count());
+	benchmark_table_t table = { "format", 6, { { "bytes", 10, 0 }, { "bake ms", 9, 1 }, { "upload ms", 9, 2 }, { "PSNR rgb", 8, 2 }, { "PSNR a", 8, 2 } } };
+	benchmark_table_header(table);
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	auto start = std::chrono::high_resolution_clock::now();
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glFinish();
+	double upload_ms = benchmark_elapsed_ms(start);
+	glDeleteTextures(1, &texture);
+	benchmark_table_row(table, "RGBA8", { (double)(image.pixels.size() * 4 / 3), NAN, upload_ms });
+
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<texture_image_t> mips;
+	texture_build_mips(image, true, mips);
+	double mips_ms = benchmark_elapsed_ms(start);
+
+	const texture_format_t formats[] = { TEXTURE_FORMAT_BC1, TEXTURE_FORMAT_BC3, TEXTURE_FORMAT_BC7 };
+	for (texture_format_t format : formats) {
+		ktx_texture_t baked = { format, false };
+		baked.levels.resize(mips.size());
+		start = std::chrono::high_resolution_clock::now();
+		size_t bytes = 0;
+		for (size_t i = 0; i < mips.size(); i++) {
+			texture_compress(mips[i], format, baked.levels[i]);
+			bytes += baked.levels[i].blocks.size();
+		}
+		double bake_ms = benchmark_elapsed_ms(start) + mips_ms;
+
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		start = std::chrono::high_resolution_clock::now();
+		size_t uploaded = ktx_upload(baked, GL_TEXTURE_2D, false);
+		glFinish();
+		upload_ms = benchmark_elapsed_ms(start);
+		if (uploaded == 0) {
+			benchmark_table_row(table, texture_format_name(format), { (double)bytes, bake_ms }, "  (not supported by this GL)");
+			glDeleteTextures(1, &texture);
+			continue;
+		}
+
+		std::vector<uint8_t> decoded(image.pixels.size());
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, decoded.data());
+		glDeleteTextures(1, &texture);
+
+		double error_rgb = 0.0, error_alpha = 0.0;
+		for (size_t i = 0; i < decoded.size(); i += 4) {
+			for (int c = 0; c < 3; c++) {
+				double d = (double)decoded[i + c] - image.pixels[i + c];
+				error_rgb += d * d;
+			}
+			double d = (double)decoded[i + 3] - image.pixels[i + 3];
+			error_alpha += d * d;
+		}
+		double texels = (double)size * size;
+		double psnr_rgb = 10.0 * log10(255.0 * 255.0 / glm::max(error_rgb / (texels * 3), 1e-10));
+		double psnr_alpha = 10.0 * log10(255.0 * 255.0 / glm::max(error_alpha / texels, 1e-10));
+		if (format == TEXTURE_FORMAT_BC1)
+			benchmark_table_row(table, texture_format_name(format), { (double)bytes, bake_ms, upload_ms, psnr_rgb }, "    opaque");
+		else
+			benchmark_table_row(table, texture_format_name(format), { (double)bytes, bake_ms, upload_ms, psnr_rgb, psnr_alpha });
+
+		// The container has to give back exactly what went in
+		const char* path = "benchmark_texture.ktx2";
+		ktx_texture_t loaded;
+		bool round_trip = ktx_write(path, baked) && ktx_read(path, loaded) && loaded.format == format && loaded.levels.size() == baked.levels.size();
+		for (size_t i = 0; round_trip && i < loaded.levels.size(); i++) {
+			round_trip = loaded.levels[i].width == baked.levels[i].width && loaded.levels[i].height == baked.levels[i].height &&
+				loaded.levels[i].blocks == baked.levels[i].blocks;
+		}
+		remove(path);
+		if (!round_trip)
+			printf("  %-6s  KTX2 round trip FAILED\n", texture_format_name(format));
+	}
+}
+
+// Mip generation for 2K and 4K textures: glGenerateMipmap against building the chain on the worker threads
+// and uploading each level. The image is a fine diagonal wave, even linear light around 0.5, that's above
+// Nyquist from level 1 down, so a perfect filter leaves flat sRGB 188. What's left of it at level 2 is the
+// shimmer, and a mean below 188 is the darkening from averaging sRGB values.
+void benchmark_mip_generation() {
+	printf("\nMip generation (level 2 of a wave above Nyquist, ideal is flat 188)\n");
+	benchmark_table_t table = { "size    method", 26, { { "ms", 9, 1 }, { "mean", 7, 1 }, { "ripple", 7, 2 } } };
+	benchmark_table_header(table);
+
+	const uint32_t sizes[] = { 2048, 4096 };
+	for (uint32_t size : sizes) {
+		texture_image_t image = { size, size };
+		image.pixels.resize((size_t)size * size * 4);
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				float linear = 0.5f + 0.5f * sinf(x * 2.9f + y * 2.3f);
+				uint8_t encoded = (uint8_t)(255.0f * (linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f) + 0.5f);
+				uint8_t* p = &image.pixels[((size_t)y * size + x) * 4];
+				p[0] = p[1] = p[2] = encoded;
+				p[3] = 255;
+			}
+		}
+
+		// 0 is glGenerateMipmap, then the CPU filters
+		for (int method = 0; method < 4; method++) {
+			const char* names[] = { "glGenerateMipmap", "CPU box", "CPU Lanczos-3", "CPU Kaiser" };
+			GLuint texture;
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glFinish();
+
+			std::vector<texture_image_t> levels;
+			auto start = std::chrono::high_resolution_clock::now();
+			if (method == 0) {
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+				glGenerateMipmap(GL_TEXTURE_2D);
+			} else {
+				texture_mip_filter_t filter = app_config_mip_filter;
+				app_config_mip_filter = (texture_mip_filter_t)(method - 1);
+				texture_build_mips(image, true, levels);
+				app_config_mip_filter = filter;
+				for (size_t i = 0; i < levels.size(); i++) {
+					glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA8, levels[i].width, levels[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[i].pixels.data());
+				}
+			}
+			glFinish();
+			double ms = benchmark_elapsed_ms(start);
+
+			uint32_t level_size = size >> 2;
+			std::vector<uint8_t> level((size_t)level_size * level_size * 4);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glGetTexImage(GL_TEXTURE_2D, 2, GL_RGBA, GL_UNSIGNED_BYTE, level.data());
+			glDeleteTextures(1, &texture);
+
+			double sum = 0.0, sum_squared = 0.0;
+			for (size_t i = 0; i < level.size(); i += 4) {
+				sum += level[i];
+				sum_squared += (double)level[i] * level[i];
+			}
+			double texels = (double)level_size * level_size;
+			double mean = sum / texels;
+			double ripple = sqrt(glm::max(sum_squared / texels - mean * mean, 0.0));
+			char label[32];
+			snprintf(label, sizeof(label), "%-6u  %s", size, names[method]);
+			benchmark_table_row(table, label, { ms, mean, ripple });
+		}
+	}
+}
+
+// Time to first frame for a scene's worth of textures: loading every level up front, against streaming them
+// with half the memory they'd need fully resident. Images are written out as PPM, which decodes about as fast
+// as a file can, so the up front numbers here are the mips and uploads and real JPEGs only widen the gap.
+void benchmark_texture_streaming() {
+	const uint32_t count = 6, size = 2048;
+	std::vector<std::string> paths;
+	for (uint32_t i = 0; i < count; i++) {
+		paths.push_back("benchmark_stream_" + std::to_string(i) + ".ppm");
+		FILE* fp = fopen(paths.back().c_str(), "wb");
+		if (!fp)
+			return;
+		fprintf(fp, "P6\n%u %u\n255\n", size, size);
+		std::vector<uint8_t> row(size * 3);
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				row[x * 3 + 0] = (uint8_t)(x * (i + 1));
+				row[x * 3 + 1] = (uint8_t)(y ^ x);
+				row[x * 3 + 2] = (uint8_t)(y * (i + 1));
+			}
+			fwrite(row.data(), 1, row.size(), fp);
+		}
+		fclose(fp);
+	}
+	size_t full_bytes = (size_t)size * size * 4 * 4 / 3 * count;
+
+	printf("\nTexture streaming (%u textures of %ux%u)\n", count, size, size);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<GLuint> ids;
+	for (const std::string& path : paths) {
+		ids.push_back(loadTextureFile(path).id);
+	}
+	glFinish();
+	printf("  up front:  %8.1f ms until the first frame, %zu MB resident\n", benchmark_elapsed_ms(start), full_bytes >> 20);
+	glDeleteTextures((GLsizei)ids.size(), ids.data());
+	ids.clear();
+
+	size_t budget = app_config_texture_budget;
+	app_config_texture_budget = full_bytes / 2;
+	start = std::chrono::high_resolution_clock::now();
+	for (const std::string& path : paths) {
+		ids.push_back(stream_texture_load(path).id);
+	}
+	double first_frame_ms = benchmark_elapsed_ms(start);
+
+	// Every texture drawn at full size each frame, until nothing is left to decode or upload
+	double usable_ms = 0.0, worst_frame_ms = 0.0;
+	uint32_t frames = 0, usable_frames = 0;
+	for (; frames < 10000; frames++) {
+		auto frame_start = std::chrono::high_resolution_clock::now();
+		for (GLuint id : ids) {
+			stream_touch(id, (float)size);
+		}
+		stream_update();
+		upload_update();
+		glFinish();
+		worst_frame_ms = glm::max(worst_frame_ms, benchmark_elapsed_ms(frame_start));
+
+		const stream_stats_t& stats = app_stream.stats;
+		if (stats.decoding == 0 && usable_frames == 0) {
+			usable_frames = frames + 1;
+			usable_ms = benchmark_elapsed_ms(start);
+		}
+		if (stats.decoding == 0 && stats.uploading == 0 && stats.uploaded_levels == 0 && stats.evicted_levels == 0)
+			break;
+		if (stats.decoding > 0 || stats.uploading > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	printf("  streaming: %8.1f ms until the first frame, %.1f ms (%u frames) until every texture is usable\n", first_frame_ms, usable_ms, usable_frames);
+	printf("             settled after %u frames at %zu MB resident of a %zu MB budget, worst frame %.1f ms\n",
+		frames, app_stream.stats.resident_bytes >> 20, app_config_texture_budget >> 20, worst_frame_ms);
+
+	// Their resident levels went into a page as well, drawn from there whenever nothing finer is up
+	uint32_t paged = 0;
+	for (GLuint id : ids) {
+		paged += app_stream.textures[id].paged ? 1 : 0;
+	}
+	printf("             %u of %u textures paged at their resident levels, %zu KB of pages\n", paged, count, app_texture_pages.bytes >> 10);
+
+	for (GLuint id : ids) {
+		stream_texture_release(id);
+	}
+	glDeleteTextures((GLsizei)ids.size(), ids.data());
+	app_config_texture_budget = budget;
+	for (const std::string& path : paths) {
+		remove(path.c_str());
+	}
+}
+
+// Worst frame while a batch of textures and mesh buffers goes up: all of it synchronously in one frame, the
+// way loads used to block, against staging it from a worker and issuing it through the ring within the
+// per frame budget. Each frame ends in glFinish so the GPU side of the copies is counted too.
+void benchmark_uploads() {
+	const uint32_t texture_count = 4, size = 2048;
+	const size_t buffer_bytes = 32u << 20;
+	std::vector<uint8_t> pixels((size_t)size * size * 4);
+	for (size_t i = 0; i < pixels.size(); i++) {
+		pixels[i] = (uint8_t)(i * 7 + (i >> 12));
+	}
+	std::vector<uint8_t> vertices(buffer_bytes, 0x3F);
+	size_t total_bytes = pixels.size() * texture_count + buffer_bytes;
+
+	printf("\nUploads (%u textures of %ux%u and a %zu MB buffer, %zu MB total)\n", texture_count, size, size, buffer_bytes >> 20, total_bytes >> 20);
+
+	std::vector<GLuint> textures(texture_count);
+	GLuint buffer;
+	glGenTextures(texture_count, textures.data());
+	glGenBuffers(1, &buffer);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (GLuint texture : textures) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, buffer_bytes, vertices.data(), GL_STATIC_DRAW);
+	glFinish();
+	printf("  synchronous: worst frame %7.2f ms, 1 frame\n", benchmark_elapsed_ms(start));
+
+	glDeleteTextures(texture_count, textures.data());
+	glDeleteBuffers(1, &buffer);
+	glGenTextures(texture_count, textures.data());
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, buffer_bytes, nullptr, GL_STATIC_DRAW);
+
+	start = std::chrono::high_resolution_clock::now();
+	job_handle_t handle = std::make_shared<job_counter_t>();
+	handle->pending = 0;
+	for (GLuint texture : textures) {
+		jobs_submit([&pixels, texture, handle]() { upload_texture(texture, 0, size, size, GL_RGBA8, pixels.data(), handle); }, handle);
+	}
+	jobs_submit([&vertices, buffer, handle]() { upload_buffer(buffer, 0, vertices.data(), vertices.size(), handle); }, handle);
+
+	double worst_frame_ms = 0.0, issue_ms = 0.0;
+	uint32_t frames = 0;
+	while (!jobs_done(handle) && frames < 10000) {
+		auto frame_start = std::chrono::high_resolution_clock::now();
+		upload_update();
+		glFinish();
+		worst_frame_ms = glm::max(worst_frame_ms, benchmark_elapsed_ms(frame_start));
+		issue_ms = glm::max(issue_ms, (double)app_upload.stats.ms);
+		frames++;
+	}
+	printf("  ring:        worst frame %7.2f ms (%.2f ms issuing), %u frames, %.1f ms in all\n", worst_frame_ms, issue_ms, frames, benchmark_elapsed_ms(start));
+
+	std::vector<uint8_t> readback(pixels.size());
+	glBindTexture(GL_TEXTURE_2D, textures[texture_count - 1]);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, readback.data());
+	printf("  contents %s\n", readback == pixels ? "match" : "DIFFER");
+
+	glDeleteTextures(texture_count, textures.data());
+	glDeleteBuffers(1, &buffer);
+}
+
+// The same grid drawn with a different texture on every object, from separate 2D textures and then from
+// those textures moved into one array page. Sorting already groups draws by texture, so what's left to
+// save here is binds; the bigger win is that paged draws can share a batch. Returns whether the images match.
+bool benchmark_texture_arrays(benchmark_scene_t& scene) {
+	const uint32_t texture_count = 64, size = 128;
+	std::vector<uint32_t> pixels(size * size);
+	std::vector<Texture> textures(texture_count);
+	for (uint32_t i = 0; i < texture_count; i++) {
+		for (uint32_t p = 0; p < pixels.size(); p++) {
+			pixels[p] = 0xFF000000 | (i * 0x040404) | (p & 0xFF);
+		}
+		textures[i] = { 0, "texture_diffuse", "", (int)size, (int)size, 0 };
+		glGenTextures(1, &textures[i].id);
+		glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // Same sampling as the page
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+
+	printf("\nTexture arrays (%u textures of %ux%u, one per object)\n", texture_count, size, size);
+	benchmark_table_t table = { "", 14, { { "draws/ms", 9, 1 }, { "texture binds", 13, 0 }, { "draw calls", 10, 0 } } };
+	benchmark_table_header(table);
+
+	std::vector<glm::mat4> worlds = benchmark_transforms(4096);
+	std::vector<uint8_t> images[2];
+	render_queue_t queue;
+	for (int paged = 0; paged < 2; paged++) {
+		if (paged) {
+			for (Texture& texture : textures) {
+				texture_pages_add(texture);
+			}
+		}
+
+		double ms = benchmark_time_frames(benchmark_frames, [&]() {
+			benchmark_queue_frame(scene, queue, false, [&]() {
+				for (size_t i = 0; i < worlds.size(); i++) {
+					const Texture& texture = textures[i % texture_count];
+					draw_mesh_t mesh = { scene.program, texture.id, scene.vao, scene.index_count, 0, GL_UNSIGNED_INT, false, glm::vec3(0.0f), glm::vec3(1.0f) };
+					if (texture.paged) {
+						mesh.texture = texture_pages_array(texture);
+						mesh.paged = true;
+						mesh.layer = texture.layer;
+					}
+					render_queue_push(queue, mesh, worlds[i], scene.bounds);
+				}
+			});
+		});
+		benchmark_table_row(table, paged ? "array page" : "2D textures", { worlds.size() / ms, (double)queue.stats.texture_binds, (double)queue.stats.draws });
+		images[paged] = benchmark_read_image();
+	}
+	bool match = images[0] == images[1];
+	printf("  %zu pages, %zu KB, images %s\n", app_texture_pages.pages.size(), app_texture_pages.bytes >> 10, match ? "match" : "DIFFER");
+
+	for (Texture& texture : textures) {
+		texture_pages_remove(texture);
+		glDeleteTextures(1, &texture.id);
+	}
+	texture_pages_shutdown();
+	return match;
+}
+
+// Spheres of increasing detail, each in its own VAO and also in the float mesh pool
+std::vector<benchmark_pooled_mesh_t> benchmark_pooled_meshes(uint32_t count, uint32_t detail) {
+	std::vector<benchmark_pooled_mesh_t> meshes(count);
+	for (uint32_t m = 0; m < count; m++) {
+		std::vector<float> vertices;
+		std::vector<uint32_t> indices;
+		benchmark_sphere_mesh(detail + m * detail / 2, detail * 2 + m * detail, vertices, indices);
+		benchmark_pooled_mesh_t& mesh = meshes[m];
+		mesh.index_count = (GLsizei)indices.size();
+		uint32_t vertex_count = (uint32_t)(vertices.size() / vertex_float_stride);
+
+		glGenVertexArrays(1, &mesh.vao);
+		glGenBuffers(1, &mesh.vbo);
+		glGenBuffers(1, &mesh.ebo);
+		glBindVertexArray(mesh.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+		vertex_attributes_float();
+		glBindVertexArray(0);
+
+		mesh_pool_alloc(MESH_POOL_FLOAT, vertex_count, (uint32_t)indices.size(), mesh.pool);
+		const mesh_pool_t& pool = app_mesh_pools.pools[MESH_POOL_FLOAT];
+		glBindBuffer(GL_ARRAY_BUFFER, pool.vbo);
+		glBufferSubData(GL_ARRAY_BUFFER, (size_t)mesh.pool.vertices.first * pool.vertex_stride, vertices.size() * sizeof(float), vertices.data());
+		glBindBuffer(GL_COPY_WRITE_BUFFER, pool.ebo);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)mesh.pool.indices.first * sizeof(uint32_t), indices.size() * sizeof(uint32_t), indices.data());
+	}
+	return meshes;
+}
+
+void benchmark_pooled_meshes_destroy(std::vector<benchmark_pooled_mesh_t>& meshes) {
+	for (benchmark_pooled_mesh_t& mesh : meshes) {
+		mesh_pool_free(mesh.pool);
+		glDeleteVertexArrays(1, &mesh.vao);
+		glDeleteBuffers(1, &mesh.vbo);
+		glDeleteBuffers(1, &mesh.ebo);
+	}
+	mesh_pool_shutdown();
+}
+
+// The mesh as a pooled draw, through the multi draw indirect shader
+draw_mesh_t benchmark_pooled_draw(const benchmark_pooled_mesh_t& source, GLuint program, GLuint texture) {
+	draw_mesh_t mesh = { program, texture, app_mesh_pools.pools[MESH_POOL_FLOAT].vao, source.index_count, source.pool.indices.first, GL_UNSIGNED_INT, false, glm::vec3(0.0f), glm::vec3(1.0f) };
+	mesh.base_vertex = (GLint)source.pool.vertices.first;
+	mesh.pooled = true;
+	return mesh;
+}
+
+// A field of objects over a handful of different meshes, first with a VAO and draw call per object and
+// then with the meshes in a pool, where each program/texture run is one glMultiDrawElementsIndirect.
+// Returns whether the images match, give or take edges.
+bool benchmark_multi_draw(benchmark_scene_t& scene) {
+	const uint32_t mesh_count = 8;
+	Shaders shaders("Shaders/default.vert", "Shaders/default.frag");
+	GLuint program = gl_create_program(shaders.vertexShader, shaders.fragmentShader, "#define INDIRECT\n");
+	glUniformBlockBinding(program, glGetUniformBlockIndex(program, "ViewBuffer"), 1);
+
+	std::vector<benchmark_pooled_mesh_t> meshes = benchmark_pooled_meshes(mesh_count, 4);
+
+	printf("\nMulti draw indirect (%u meshes, one VAO each vs one pool)\n", mesh_count);
+	benchmark_table_t table = { "", 14, { { "draws/ms", 9, 1 }, { "draw calls", 10, 0 }, { "VAO binds", 9, 0 }, { "objects", 10, 0 } } };
+	benchmark_table_header(table);
+
+	std::vector<glm::mat4> worlds = benchmark_transforms(4096);
+	std::vector<uint8_t> images[2];
+	render_queue_t queue;
+	for (int pooled = 0; pooled < 2; pooled++) {
+		double ms = benchmark_time_frames(benchmark_frames, [&]() {
+			benchmark_queue_frame(scene, queue, false, [&]() {
+				for (size_t i = 0; i < worlds.size(); i++) {
+					const benchmark_pooled_mesh_t& source = meshes[i % mesh_count];
+					draw_mesh_t mesh = { scene.program, scene.texture, source.vao, source.index_count, 0, GL_UNSIGNED_INT, false, glm::vec3(0.0f), glm::vec3(1.0f) };
+					if (pooled)
+						mesh = benchmark_pooled_draw(source, program, scene.texture);
+					render_queue_push(queue, mesh, worlds[i], scene.bounds);
+				}
+			});
+		});
+		benchmark_table_row(table, pooled ? "indirect" : "per draw", { worlds.size() / ms, (double)queue.stats.draws, (double)queue.stats.vao_binds, (double)(pooled ? queue.stats.commands : queue.stats.draws) });
+		images[pooled] = benchmark_read_image();
+	}
+
+	// The indirect shader multiplies world and viewproj on the GPU rather than the CPU, so edges can round differently
+	uint32_t differ = benchmark_pixels_differ(images[0], images[1]);
+	printf("  %u of %d pixels differ\n", differ, benchmark_size * benchmark_size);
+
+	benchmark_pooled_meshes_destroy(meshes);
+	glDeleteProgram(program);
+	return differ <= benchmark_edge_pixels;
+}
+
+// Game style submission, one plain draw per object over a handful of meshes, with and without the queue
+// folding repeated draws into instanced ones. Nothing about the pushes changes between the two, so the
+// images have to match, give or take edges. Returns whether they do.
+bool benchmark_auto_instancing(benchmark_scene_t& scene) {
+	const uint32_t mesh_count = 8;
+	Shaders shaders("Shaders/default.vert", "Shaders/default.frag");
+	GLuint instanced_program = gl_create_program(shaders.vertexShader, shaders.fragmentShader, "#define INSTANCED\n");
+	glUniformBlockBinding(instanced_program, glGetUniformBlockIndex(instanced_program, "ViewBuffer"), 1);
+	std::vector<benchmark_pooled_mesh_t> meshes = benchmark_pooled_meshes(mesh_count, 4);
+
+	printf("\nAutomatic instancing (%u meshes, one drawModel per object)\n", mesh_count);
+	benchmark_table_t table = { "", 10, { { "draws/ms", 9, 1 }, { "packets", 8, 0 }, { "draw calls", 10, 0 }, { "merged", 8, 0 } } };
+	benchmark_table_header(table);
+
+	std::vector<glm::mat4> worlds = benchmark_transforms(4096);
+	std::vector<uint8_t> images[2];
+	render_queue_t queue;
+	for (int merge = 0; merge < 2; merge++) {
+		app_config_auto_instancing = merge != 0;
+		double ms = benchmark_time_frames(benchmark_frames, [&]() {
+			benchmark_queue_frame(scene, queue, true, [&]() {
+				for (size_t i = 0; i < worlds.size(); i++) {
+					const benchmark_pooled_mesh_t& source = meshes[i % mesh_count];
+					draw_mesh_t mesh = { scene.program, scene.texture, source.vao, source.index_count, 0, GL_UNSIGNED_INT, false, glm::vec3(0.0f), glm::vec3(1.0f) };
+					mesh.instanced_program = instanced_program;
+					render_queue_push(queue, mesh, worlds[i], scene.bounds);
+				}
+			});
+		});
+		benchmark_table_row(table, merge ? "merged" : "separate", { worlds.size() / ms, (double)queue.stats.packets, (double)queue.stats.draws, (double)queue.stats.merged });
+		images[merge] = benchmark_read_image();
+	}
+	app_config_auto_instancing = true;
+
+	// The instanced shader multiplies by viewproj on the GPU, edges can round differently
+	uint32_t differ = benchmark_pixels_differ(images[0], images[1]);
+	printf("  %u of %d pixels differ\n", differ, benchmark_size * benchmark_size);
+
+	benchmark_pooled_meshes_destroy(meshes);
+	glDeleteProgram(instanced_program);
+	return differ <= benchmark_edge_pixels;
+}
+
+// A game style render function, building a Transform per object and drawing it, run for each of two
+// eyes the way app_draw used to, and then recorded once and replayed into both eyes' queues. Returns
+// whether both ways drew the same image.
+bool benchmark_draw_list(benchmark_scene_t& scene) {
+	const int object_count = 4096, eyes = 2;
+	std::vector<glm::mat4> worlds = benchmark_transforms(object_count);
+	draw_mesh_t mesh = { scene.program, scene.texture, scene.vao, scene.index_count, 0, GL_UNSIGNED_INT, false, glm::vec3(0.0f), glm::vec3(1.0f) };
+	glm::mat4 projection = app_view.viewproj[0];
+	float time = 0.0f;
+	auto game_render = [&](draw_list_t* list, render_queue_t& queue) {
+		for (int i = 0; i < object_count; i++) {
+			Transform transform = { glm::vec3(worlds[i][3]), glm::angleAxis(time + i * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.5f) };
+			glm::mat4 world = transformToMat4(transform);
+			if (list)
+				draw_list_push(*list, mesh, world, scene.bounds);
+			else
+				render_queue_push(queue, mesh, world, scene.bounds);
+		}
+	};
+
+	printf("\nFrame draw list (%d objects, %d eyes)\n", object_count, eyes);
+	benchmark_table_t table = { "", 16, { { "frame ms", 8, 2 }, { "game renders", 12, 1 } } };
+	benchmark_table_header(table);
+
+	std::vector<uint8_t> images[2];
+	render_queue_t queue;
+	draw_list_t list;
+	for (int record = 0; record < 2; record++) {
+		uint32_t renders = 0;
+		double ms = benchmark_time_frames(benchmark_frames, [&]() {
+			renders = 0;
+			draw_list_clear(list);
+			for (int eye = 0; eye < eyes; eye++) {
+				app_view.viewproj[0] = glm::translate(projection, glm::vec3(eye * 0.064f - 0.032f, 0.0f, 0.0f));
+				benchmark_queue_frame(scene, queue, true, [&]() {
+					if (!record) {
+						game_render(nullptr, queue);
+						renders++;
+						return;
+					}
+					if (!list.recorded) {
+						game_render(&list, queue);
+						list.recorded = true;
+						renders++;
+					}
+					draw_list_replay(list, queue);
+				});
+			}
+		});
+		benchmark_table_row(table, record ? "record + replay" : "render per eye", { ms, (double)renders });
+		images[record] = benchmark_read_image();
+	}
+	bool match = images[0] == images[1];
+	printf("  images %s\n", match ? "match" : "DIFFER");
+	app_view.viewproj[0] = projection;
+	return match;
+}
+
+// Recording a frame's worth of objects the immediate way, a drawModel() per object that rebuilds its world
+// matrix every time, against a retained Scene where a few percent of the entities move each frame. Only
+// the recording is timed, drawing is the same either way. Afterwards every entity's matrix has to match its
+// transform, and a handle from before clear() has to stay dead once its slot is reused. Returns whether
+// both hold.
+bool benchmark_scene_registry() {
+	const uint32_t model_count = 8, entity_count = 16384, moved = entity_count / 50;
+	std::vector<ModelHandle> models(model_count);
+	for (uint32_t m = 0; m < model_count; m++) {
+		std::vector<float> vertices;
+		std::vector<uint32_t> indices;
+		benchmark_sphere_mesh(6 + m, 12 + m * 2, vertices, indices);
+		models[m] = std::make_shared<Model>();
+		models[m]->loadMesh("benchmark sphere " + std::to_string(m), vertices, indices, nullptr);
+		upload_wait(models[m]->upload);
+	}
+
+	std::vector<glm::mat4> worlds = benchmark_transforms(entity_count);
+	std::vector<Transform> transforms(entity_count);
+	Scene scene;
+	std::vector<Entity> entities(entity_count);
+	for (uint32_t i = 0; i < entity_count; i++) {
+		transforms[i] = mat4ToTransform(worlds[i]);
+		entities[i] = scene.add(models[i % model_count], transforms[i]);
+	}
+
+	printf("\nScene registry (%u entities over %u models, %u moved per frame)\n", entity_count, model_count, moved);
+	benchmark_table_t table = { "", 10, { { "record ms", 9, 3 }, { "recorded", 8, 0 }, { "rebuilt", 8, 0 } } };
+	benchmark_table_header(table);
+
+	draw_list_t list;
+	for (int retained = 0; retained < 2; retained++) {
+		uint32_t rebuilt = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int f = 0; f < benchmark_frames; f++) {
+			draw_list_clear(list);
+			for (uint32_t n = 0; n < moved; n++) {
+				uint32_t i = (f * moved + n) % entity_count;
+				transforms[i].position.y += 0.01f;
+				if (retained)
+					scene.setTransform(entities[i], transforms[i]);
+			}
+			if (retained) {
+				scene.update();
+				scene.draw(list);
+				rebuilt += scene.stats.updated;
+				continue;
+			}
+			for (uint32_t i = 0; i < entity_count; i++) {
+				const Model& model = *models[i % model_count];
+				glm::mat4 world = transformToMat4(transforms[i]);
+				draw_list_push(list, model.drawMesh(model.selectLod(world), false), world, model.bounds);
+				rebuilt++;
+			}
+		}
+		double ms = benchmark_elapsed_ms(start) / benchmark_frames;
+		benchmark_table_row(table, retained ? "retained" : "immediate", { ms, (double)list.entries.size(), (double)(rebuilt / benchmark_frames) });
+	}
+
+	bool match = true;
+	for (uint32_t i = 0; i < entity_count; i++) {
+		match = match && *(const glm::mat4*)ecs_get(scene.world, entities[i], scene.matrix) == transformToMat4(transforms[i]);
+	}
+	scene.clear();
+	Entity reused = scene.add(models[0], transforms[0]);
+	bool stale = reused.index == entities[0].index && !scene.valid(entities[0]);
+	printf("  matrices %s, handles from before clear() %s\n", match ? "match" : "DIFFER", stale ? "stay dead" : "CAME BACK");
+
+	scene.clear();
+	for (ModelHandle& model : models) {
+		model->cleanupModel();
+	}
+	mesh_pool_shutdown();
+	return match && stale;
+}
+
+// The same objects as an array of structs, the way game objects usually look, and as ECS chunks. "move"
+// nudges every position, which only needs the position array, "rebuild" turns every transform into a world
+// matrix. The ECS runs once on this thread and once spread over the workers, a job per chunk. Returns
+// whether the array of structs and the ECS end up with the same matrix.
+struct benchmark_object_t {
+	ModelHandle model;
+	Transform   transform;
+	glm::mat4   world;
+	uint32_t    generation;
+	bool        alive;
+	bool        visible;
+};
+
+bool benchmark_ecs() {
+	const uint32_t object_count = 65536;
+	std::vector<glm::mat4> worlds = benchmark_transforms(object_count);
+	std::vector<benchmark_object_t> objects(object_count);
+	ecs_world_t world;
+	ecs_component_t position = ecs_register<glm::vec3>(world, "position");
+	ecs_component_t rotation = ecs_register<glm::quat>(world, "rotation");
+	ecs_component_t scale    = ecs_register<glm::vec3>(world, "scale");
+	ecs_component_t matrix   = ecs_register<glm::mat4>(world, "world");
+	ecs_component_t renderable = ecs_register<scene_renderable_t>(world, "renderable"); // Rows as wide as the Scene's
+	ecs_component_t dirty    = ecs_register<uint8_t>(world, "dirty");
+	ecs_mask_t mask = ecs_mask(position) | ecs_mask(rotation) | ecs_mask(scale) | ecs_mask(matrix) | ecs_mask(renderable) | ecs_mask(dirty);
+	for (uint32_t i = 0; i < object_count; i++) {
+		Transform transform = mat4ToTransform(worlds[i]);
+		objects[i] = { nullptr, transform, worlds[i], 0, true, true };
+		Entity entity = ecs_create(world, mask);
+		*(glm::vec3*)ecs_write(world, entity, position) = transform.position;
+		*(glm::quat*)ecs_write(world, entity, rotation) = transform.rotation;
+		*(glm::vec3*)ecs_write(world, entity, scale) = transform.scale;
+	}
+	ecs_query_t query = { mask, 0, 0, 0 };
+
+	printf("\nECS storage (%u objects, %u chunks, ms per frame)\n", object_count, (uint32_t)world.archetypes[0].chunks.size());
+	benchmark_table_t table = { "", 16, { { "move", 8, 3 }, { "rebuild", 8, 3 } } };
+	benchmark_table_header(table);
+
+	std::function<void(ecs_view_t& view)> move = [position](ecs_view_t& view) {
+		glm::vec3* positions = view.write<glm::vec3>(position);
+		for (uint32_t i = 0; i < view.count; i++) {
+			positions[i].y += 0.01f;
+		}
+	};
+	std::function<void(ecs_view_t& view)> rebuild = [position, rotation, scale, matrix](ecs_view_t& view) {
+		const glm::vec3* positions = view.read<glm::vec3>(position);
+		const glm::quat* rotations = view.read<glm::quat>(rotation);
+		const glm::vec3* scales    = view.read<glm::vec3>(scale);
+		glm::mat4*       matrices  = view.write<glm::mat4>(matrix);
+		for (uint32_t i = 0; i < view.count; i++) {
+			matrices[i] = transformToMat4({ positions[i], rotations[i], scales[i] });
+		}
+	};
+
+	glm::mat4 check[2];
+	for (int mode = 0; mode < 3; mode++) {
+		double ms[2];
+		for (int pass = 0; pass < 2; pass++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int f = 0; f < benchmark_frames; f++) {
+				if (mode == 0) {
+					for (benchmark_object_t& object : objects) {
+						if (pass == 0)
+							object.transform.position.y += 0.01f;
+						else
+							object.world = transformToMat4(object.transform);
+					}
+				}
+				else if (mode == 1) {
+					ecs_for_each(world, query, pass == 0 ? move : rebuild);
+				}
+				else {
+					ecs_for_each_parallel(world, query, pass == 0 ? move : rebuild);
+				}
+			}
+			ms[pass] = benchmark_elapsed_ms(start) / benchmark_frames;
+		}
+		if (mode < 2) // Both have moved every object the same distance by now
+			check[mode] = mode == 0 ? objects.back().world : *(const glm::mat4*)ecs_get(world, { object_count - 1, 0 }, matrix);
+		const char* names[] = { "array of structs", "ECS", "ECS parallel" };
+		benchmark_table_row(table, names[mode], { ms[0], ms[1] });
+	}
+	ecs_clear(world);
+	bool match = check[0] == check[1];
+	printf("  results %s\n", match ? "match" : "DIFFER");
+	return match;
+}
+
+// A forest of small trees where a few roots move each frame, like hands carrying things. Walking every node
+// up to its root is what app_draw used to do for the controllers, a full pass rebuilds every node in depth
+// order, and the hierarchy rebuilds only the subtrees under moved roots. Afterwards a subtree is moved to
+// another parent and a root removed before the next update, and every cached matrix is checked against a
+// fresh walk to the root, the moved subtree's against its new parent. Returns whether they all matched.
+bool benchmark_hierarchy() {
+	const uint32_t root_count = 256, branching = 4, levels = 3, moved = 4;
+	transform_hierarchy_t hierarchy;
+	std::vector<hierarchy_node_t> nodes;
+	Transform offset = { glm::vec3(0.0f, 0.2f, 0.0f), glm::angleAxis(0.3f, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.9f) };
+	std::vector<glm::mat4> worlds = benchmark_transforms(root_count);
+	for (uint32_t r = 0; r < root_count; r++) {
+		size_t first = nodes.size();
+		nodes.push_back(hierarchy_add(hierarchy, mat4ToTransform(worlds[r])));
+		for (size_t n = first, level_end = nodes.size(), level = 0; level < levels; level++, level_end = nodes.size()) {
+			for (; n < level_end; n++) {
+				for (uint32_t b = 0; b < branching; b++) {
+					nodes.push_back(hierarchy_add(hierarchy, offset, nodes[n]));
+				}
+			}
+		}
+	}
+	hierarchy_update(hierarchy);
+	uint32_t tree_size = (uint32_t)(nodes.size() / root_count);
+
+	// Every node's world matrix from scratch, the way it's done without a hierarchy
+	auto walk = [&hierarchy](hierarchy_node_t node) {
+		glm::mat4 world(1.0f);
+		for (uint32_t p = hierarchy.slots[node.index].position; p != UINT32_MAX; p = hierarchy.parents[p]) {
+			world = transformToMat4(hierarchy.locals[p]) * world;
+		}
+		return world;
+	};
+
+	printf("\nTransform hierarchy (%zu nodes, %u roots moved per frame)\n", nodes.size(), moved);
+	benchmark_table_t table = { "", 14, { { "ms", 8, 3 }, { "rebuilt", 8, 0 } } };
+	benchmark_table_header(table);
+	std::vector<glm::mat4> walked(nodes.size());
+	for (int mode = 0; mode < 3; mode++) {
+		uint32_t rebuilt = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int f = 0; f < benchmark_frames; f++) {
+			for (uint32_t m = 0; m < moved; m++) {
+				hierarchy_node_t root = nodes[((f * moved + m) % root_count) * tree_size];
+				Transform local = hierarchy_get_local(hierarchy, root);
+				local.position.y += 0.01f;
+				hierarchy_set_local(hierarchy, root, local);
+			}
+			if (mode == 0) {
+				for (size_t n = 0; n < nodes.size(); n++) {
+					walked[n] = walk(nodes[n]);
+				}
+				rebuilt += (uint32_t)nodes.size();
+			}
+			else {
+				if (mode == 1) {
+					for (uint8_t& dirty : hierarchy.dirty) {
+						dirty = 1;
+					}
+					hierarchy.pending = (uint32_t)hierarchy.dirty.size();
+				}
+				hierarchy_update(hierarchy);
+				rebuilt += hierarchy.stats.updated;
+			}
+		}
+		double ms = benchmark_elapsed_ms(start) / benchmark_frames;
+		const char* names[] = { "walk to root", "full pass", "dirty subtrees" };
+		benchmark_table_row(table, names[mode], { ms, (double)(rebuilt / benchmark_frames) });
+	}
+
+	// Restructure, then check everything that's left. The remove runs while the order is stale from the move.
+	hierarchy_node_t moved_node = nodes[1], new_parent = nodes[nodes.size() - 1];
+	hierarchy_set_parent(hierarchy, moved_node, new_parent);
+	hierarchy_remove(hierarchy, nodes[root_count / 2 * tree_size]);
+	hierarchy_update(hierarchy);
+	glm::mat4 expected = hierarchy_world(hierarchy, new_parent) * transformToMat4(hierarchy_get_local(hierarchy, moved_node));
+	bool match = true;
+	for (int c = 0; c < 4; c++) {
+		match = match && glm::all(glm::epsilonEqual(expected[c], hierarchy_world(hierarchy, moved_node)[c], 0.0001f));
+	}
+	uint32_t checked = 0;
+	for (hierarchy_node_t node : nodes) {
+		if (!hierarchy_valid(hierarchy, node))
+			continue;
+		glm::mat4 expected = walk(node), cached = hierarchy_world(hierarchy, node);
+		for (int c = 0; c < 4; c++) {
+			match = match && glm::all(glm::epsilonEqual(expected[c], cached[c], 0.0001f));
+		}
+		checked++;
+	}
+	printf("  %u nodes after restructuring, results %s\n", checked, match ? "match" : "DIFFER");
+	return match;
+}
+
+// Objects Hi-Z rejected that the finished frame doesn't prove hidden. Nothing moves, so the depth buffer
+// is what every frame draws: an object is hidden when each pixel centre inside its screen rect already
+// holds something nearer than the nearest corner of its box. Boxes crossing the near plane never are.
+uint32_t benchmark_gpu_culling_hiz_errors(const render_queue_t& queue) {
+	std::vector<uint32_t> results;
+	gpu_cull_read_results(queue.gpu_object_count, results);
+	std::vector<float> depth(benchmark_size * benchmark_size);
+	glReadPixels(0, 0, benchmark_size, benchmark_size, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+
+	const cull_list_t& list = queue.gpu_bounds;
+	uint32_t errors = 0;
+	for (uint32_t k = 0; k < queue.gpu_object_count; k++) {
+		if (results[k] != GPU_CULL_OCCLUDED)
+			continue;
+		uint32_t b = queue.gpu_object_bounds[k];
+		if (b == render_queue_no_bounds) {
+			errors++;
+			continue;
+		}
+		glm::vec3 center(list.center_x[b], list.center_y[b], list.center_z[b]), extent(list.extent_x[b], list.extent_y[b], list.extent_z[b]);
+		glm::vec2 rect_min(FLT_MAX), rect_max(-FLT_MAX);
+		float nearest = FLT_MAX;
+		bool crosses_near = false;
+		for (int c = 0; c < 8; c++) {
+			glm::vec3 corner = center + extent * glm::vec3((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f);
+			glm::vec4 clip = app_view.viewproj[0] * glm::vec4(corner, 1.0f);
+			if (clip.w <= 0.0f) {
+				crosses_near = true;
+				break;
+			}
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			rect_min = glm::min(rect_min, glm::vec2(ndc));
+			rect_max = glm::max(rect_max, glm::vec2(ndc));
+			nearest = glm::min(nearest, ndc.z * 0.5f + 0.5f);
+		}
+		if (crosses_near) {
+			errors++;
+			continue;
+		}
+
+		int x0 = glm::max((int)ceilf((rect_min.x * 0.5f + 0.5f) * benchmark_size - 0.5f), 0);
+		int y0 = glm::max((int)ceilf((rect_min.y * 0.5f + 0.5f) * benchmark_size - 0.5f), 0);
+		int x1 = glm::min((int)floorf((rect_max.x * 0.5f + 0.5f) * benchmark_size - 0.5f), benchmark_size - 1);
+		int y1 = glm::min((int)floorf((rect_max.y * 0.5f + 0.5f) * benchmark_size - 0.5f), benchmark_size - 1);
+		bool hidden = true;
+		for (int y = y0; y <= y1 && hidden; y++) {
+			for (int x = x0; x <= x1 && hidden; x++) {
+				hidden = depth[y * benchmark_size + x] < nearest;
+			}
+		}
+		errors += hidden ? 0 : 1;
+	}
+	return errors;
+}
+
+// 100k pooled objects on a plane around the camera with a wall in front of it, culled on the CPU and then
+// by cull.comp, first against the frustum only and then with Hi-Z from the frame before. Each frame
+// captures its depth the way openxr_render_layer does. The GPU results are read back once per mode and
+// checked against the CPU frustum test, whatever Hi-Z rejected has to be hidden in the finished frame, and
+// all three images have to match. Returns whether every check passed.
+bool benchmark_gpu_culling(benchmark_scene_t& scene) {
+	const uint32_t mesh_count = 8, side = 320, frames = 5;
+	gpu_cull_init();
+	Shaders shaders("Shaders/default.vert", "Shaders/default.frag");
+	GLuint program = gl_create_program(shaders.vertexShader, shaders.fragmentShader, "#define INDIRECT\n");
+	glUniformBlockBinding(program, glGetUniformBlockIndex(program, "ViewBuffer"), 1);
+	std::vector<benchmark_pooled_mesh_t> meshes = benchmark_pooled_meshes(mesh_count, 2);
+
+	std::vector<glm::mat4> worlds(side * side);
+	for (uint32_t i = 0; i < side * side; i++) {
+		glm::vec3 pos(((i % side) - side * 0.5f) * 1.5f, -2.0f, ((i / side) - side * 0.5f) * 1.5f);
+		worlds[i] = glm::translate(glm::mat4(1.0f), pos) * glm::scale(glm::mat4(1.0f), glm::vec3(0.8f));
+	}
+	glm::mat4 wall = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -6.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(10.0f, 8.0f, 0.5f));
+	draw_mesh_t wall_mesh = { scene.program, scene.texture, scene.vao, scene.index_count, 0, GL_UNSIGNED_INT, false, glm::vec3(0.0f), glm::vec3(1.0f) };
+
+	printf("\nGPU culling (%u objects over %u pooled meshes, behind a wall)\n", side * side, mesh_count);
+	benchmark_table_t table = { "", 16, { { "frame ms", 8, 2 }, { "visible", 8, 0 }, { "occluded", 10, 0 }, { "mismatches", 10, 0 } } };
+	benchmark_table_header(table);
+
+	const char* names[3] = { "CPU frustum", "GPU frustum", "GPU frustum+Hi-Z" };
+	std::vector<uint8_t> images[3];
+	render_queue_t queue;
+	uint32_t total_mismatches = 0, hiz_errors = 0;
+	for (int mode = 0; mode < 3; mode++) {
+		app_config_gpu_culling = mode > 0;
+		app_config_gpu_cull_occlusion = mode > 1;
+		app_gpu_cull.valid[0] = app_gpu_cull.valid[1] = false;
+		app_occlusion.ready = false; // No CPU occluders, the CPU row is the frustum alone
+
+		// The warm up frame also leaves the first depth to test against
+		auto draw_frame = [&]() {
+			benchmark_queue_frame(scene, queue, true, [&]() {
+				render_queue_push(queue, wall_mesh, wall, scene.bounds);
+				for (size_t i = 0; i < worlds.size(); i++) {
+					render_queue_push(queue, benchmark_pooled_draw(meshes[i % mesh_count], program, scene.texture), worlds[i], scene.bounds);
+				}
+			});
+			gpu_cull_capture(scene.fbo, 0, benchmark_size, benchmark_size, app_view.viewproj[0]);
+		};
+		double frame_ms = benchmark_time_frames(frames, draw_frame);
+
+		// One more frame, reading the GPU's decisions back to check them
+		uint32_t visible = queue.stats.visible - 1, occluded = 0, mismatches = 0;
+		if (mode > 0) {
+			app_config_gpu_cull_validate = true;
+			draw_frame();
+			app_config_gpu_cull_validate = false;
+			visible = app_gpu_cull.stats.visible;
+			occluded = app_gpu_cull.stats.occluded;
+			mismatches = app_gpu_cull.stats.mismatches;
+			total_mismatches += mismatches;
+			if (mode > 1)
+				hiz_errors = benchmark_gpu_culling_hiz_errors(queue);
+		}
+		benchmark_table_row(table, names[mode], { frame_ms, (double)visible, (double)occluded, (double)mismatches });
+		images[mode] = benchmark_read_image();
+	}
+	bool images_match = images[0] == images[1] && images[1] == images[2];
+	printf("  images %s, %u objects Hi-Z rejected aren't hidden\n", images_match ? "match" : "DIFFER", hiz_errors);
+
+	app_config_gpu_culling = true;
+	app_config_gpu_cull_occlusion = true;
+	benchmark_pooled_meshes_destroy(meshes);
+	glDeleteProgram(program);
+	gpu_cull_shutdown();
+	return total_mismatches == 0 && hiz_errors == 0 && images_match;
+}
+
+///////////////////////////////////////////
+
+// A field of props over a few sphere models, marked static. First every placement is its own static scene
+// object, then they're merged into chunks. Both go through the BVH and the render queue the way the level
+// is drawn, and the images have to match up to the rounding pre-transformed vertices add. Returns whether
+// they do.
+bool benchmark_static_batching(benchmark_scene_t& scene) {
+	const uint32_t model_count = 8, placement_count = 4096;
+	Shaders shaders("Shaders/default.vert", "Shaders/default.frag");
+	app_shader_program_indirect = gl_create_program(shaders.vertexShader, shaders.fragmentShader, "#define INDIRECT\n");
+	app_shader_program_indirect_quantized = gl_create_program(shaders.vertexShader, shaders.fragmentShader, "#define INDIRECT\n#define QUANTIZED\n");
+	glUniformBlockBinding(app_shader_program_indirect, glGetUniformBlockIndex(app_shader_program_indirect, "ViewBuffer"), 1);
+	glUniformBlockBinding(app_shader_program_indirect_quantized, glGetUniformBlockIndex(app_shader_program_indirect_quantized, "ViewBuffer"), 1);
+
+	std::vector<Model> models(model_count);
+	for (uint32_t m = 0; m < model_count; m++) {
+		std::vector<float> vertices;
+		std::vector<uint32_t> indices;
+		benchmark_sphere_mesh(6 + m, 12 + m * 2, vertices, indices);
+		models[m].loadMesh("benchmark sphere " + std::to_string(m), vertices, indices, nullptr);
+		models[m].textureID = scene.texture;
+		upload_wait(models[m].upload);
+	}
+
+	std::vector<glm::mat4> worlds = benchmark_transforms(placement_count);
+	printf("\nStatic batching (%u placements of %u models)\n", placement_count, model_count);
+	benchmark_table_t table = { "", 10, { { "build ms", 8, 1 }, { "objects", 8, 0 }, { "frame ms", 8, 2 }, { "draw calls", 10, 0 }, { "commands", 9, 0 } } };
+	benchmark_table_header(table);
+
+	bool occlusion = app_config_occlusion;
+	app_config_occlusion = false; // Culling alone, the CPU occluders would be different meshes in each mode
+	std::vector<uint8_t> images[2];
+	render_queue_t queue;
+	for (int batched = 0; batched < 2; batched++) {
+		for (uint32_t i = 0; i < placement_count; i++) {
+			models[i % model_count].markStatic(mat4ToTransform(worlds[i]));
+		}
+		app_config_static_batching = batched != 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		static_batch_build(app_static_batch, app_static_scene);
+		double build_ms = benchmark_elapsed_ms(start);
+		for (const ModelHandle& chunk : app_static_batch.chunks) {
+			upload_wait(chunk->upload);
+		}
+		static_scene_update(app_static_scene);
+		jobs_wait(app_static_scene.build_job);
+		static_scene_update(app_static_scene);
+
+		double frame_ms = benchmark_time_frames(benchmark_frames, [&]() {
+			benchmark_queue_frame(scene, queue, true, [&]() {
+				static_scene_draw(app_static_scene, queue, cull_frustum_from_matrix(app_view.viewproj[0]));
+			});
+		});
+		char note[48];
+		snprintf(note, sizeof(note), "  (BVH %zu nodes in %.1f ms)", app_static_scene.bvh.nodes.size(), app_static_scene.build_ms);
+		benchmark_table_row(table, batched ? "batched" : "per object", { build_ms, (double)app_static_scene.objects.size(), frame_ms, (double)queue.stats.draws, (double)queue.stats.commands }, note);
+		images[batched] = benchmark_read_image();
+		static_scene_clear(app_static_scene);
+	}
+
+	uint32_t differ = benchmark_pixels_differ(images[0], images[1]);
+	printf("  %u of %d pixels differ, sources %s after the build\n", differ, benchmark_size * benchmark_size, models[0].uploaded() ? "kept" : "freed");
+
+	app_config_occlusion = occlusion;
+	app_config_static_batching = true;
+	static_batch_clear(app_static_batch);
+	for (Model& model : models) {
+		if (model.uploaded())
+			model.cleanupModel();
+	}
+	mesh_pool_shutdown();
+	glDeleteProgram(app_shader_program_indirect);
+	glDeleteProgram(app_shader_program_indirect_quantized);
+	app_shader_program_indirect = app_shader_program_indirect_quantized = 0;
+	return differ <= benchmark_edge_pixels;
+}
+
+///////////////////////////////////////////
+
+// The uniform ring, one view looking down -z from the origin and the offscreen scene
+benchmark_scene_t benchmark_begin() {
+	if (app_uniform_ring.buffer == 0) {
+		gl_ring_create(app_uniform_ring, 1024 * 1024, gl_ring_alignment());
+	}
+	app_view.view_count = 1;
+	app_view.viewproj[0] = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, 1000.0f);
+	return benchmark_scene_create();
+}
+
+void benchmark_end(benchmark_scene_t& scene) {
+	benchmark_scene_destroy(scene);
+	gl_ring_destroy(app_uniform_ring);
+}
+
+void benchmark_run() {
+	printf("Chisel Engine benchmarks\nGPU: %s\nOpenGL: %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+	benchmark_scene_t scene = benchmark_begin();
+	benchmark_uniform_upload(scene);
+	benchmark_culling(scene);
+	benchmark_bvh(scene);
+	benchmark_occlusion(scene);
+	benchmark_lod(scene);
+	benchmark_vertex_format(scene);
+	benchmark_mesh_optimization(scene);
+	benchmark_texture_compression();
+	benchmark_mip_generation();
+	benchmark_texture_streaming();
+	benchmark_uploads();
+	benchmark_texture_arrays(scene);
+	benchmark_multi_draw(scene);
+	benchmark_auto_instancing(scene);
+	benchmark_draw_list(scene);
+	benchmark_scene_registry();
+	benchmark_ecs();
+	benchmark_hierarchy();
+	benchmark_gpu_culling(scene);
+	benchmark_static_batching(scene);
+	benchmark_end(scene);
+
+	printf("\n");
+	mesh_optimize_report(app_mesh_optimize_stats); // Every mesh the benchmarks loaded
+}
+
+int benchmark_test() {
+	printf("Chisel Engine tests\nGPU: %s\nOpenGL: %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+	benchmark_scene_t scene = benchmark_begin();
+	int failures = 0;
+	if (!benchmark_texture_arrays(scene)) {
+		printf("FAILED: drawing from array pages changed the image\n");
+		failures++;
+	}
+	if (!benchmark_multi_draw(scene)) {
+		printf("FAILED: multi draw indirect changed the image\n");
+		failures++;
+	}
+	if (!benchmark_auto_instancing(scene)) {
+		printf("FAILED: automatic instancing changed the image\n");
+		failures++;
+	}
+	if (!benchmark_draw_list(scene)) {
+		printf("FAILED: replaying the recorded draw list changed the image\n");
+		failures++;
+	}
+	if (!benchmark_scene_registry()) {
+		printf("FAILED: scene matrices are stale, or a handle came back after clear()\n");
+		failures++;
+	}
+	if (!benchmark_ecs()) {
+		printf("FAILED: ECS chunks and plain structs disagree\n");
+		failures++;
+	}
+	if (!benchmark_hierarchy()) {
+		printf("FAILED: hierarchy world matrices are wrong after a reparent and a remove\n");
+		failures++;
+	}
+	if (!benchmark_gpu_culling(scene)) {
+		printf("FAILED: GPU culling disagrees with the CPU frustum test, or Hi-Z rejected something visible\n");
+		failures++;
+	}
+	if (!benchmark_static_batching(scene)) {
+		printf("FAILED: static batching changed the image\n");
+		failures++;
+	}
+	benchmark_end(scene);
+
+	printf("%d failed\n", failures);
+	return failures;
+}
@@ -0,0 +1,290 @@
+#include <bvh.h>
+
+const uint32_t bvh_max_leaf_size = 4;
+const uint32_t bvh_bins = 12;     // Binned SAH, close to a full sweep at a fraction of the cost
+const float    bvh_traversal_cost = 1.0f; // Relative to testing one object
+
+float bvh_area(const glm::vec3& min, const glm::vec3& max) {
+	glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+void bvh_grow(glm::vec3& min, glm::vec3& max, const aabb_t& box) {
+	min = glm::min(min, box.min);
+	max = glm::max(max, box.max);
+}
+
+// Node bounds from its leaf objects
+void bvh_fit_leaf(bvh_node_t& node, const bvh_t& bvh, const std::vector<aabb_t>& boxes) {
+	node.min = glm::vec3(FLT_MAX);
+	node.max = glm::vec3(-FLT_MAX);
+	for (uint32_t i = 0; i < node.count; i++) {
+		bvh_grow(node.min, node.max, boxes[bvh.indices[node.first + i]]);
+	}
+}
+
+///////////////////////////////////////////
+
+// Top down build with a binned surface area heuristic. Nodes are split with an explicit stack, and each
+// split reserves both children side by side at the end of the array, which keeps siblings together and
+// every child after its parent.
+void bvh_build(bvh_t& bvh, const std::vector<aabb_t>& boxes) {
+	uint32_t count = (uint32_t)boxes.size();
+	bvh.nodes.clear();
+	bvh.indices.resize(count);
+	if (count == 0)
+		return;
+
+	std::vector<glm::vec3> centroids(count);
+	for (uint32_t i = 0; i < count; i++) {
+		bvh.indices[i] = i;
+		centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+	}
+
+	bvh.nodes.reserve(count * 2 / bvh_max_leaf_size + 1);
+	bvh.nodes.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), count });
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty()) {
+		uint32_t node_index = stack.back();
+		stack.pop_back();
+
+		bvh_fit_leaf(bvh.nodes[node_index], bvh, boxes);
+		bvh_node_t node = bvh.nodes[node_index];
+		if (node.count <= bvh_max_leaf_size)
+			continue;
+
+		// Split along whichever axis and bin boundary gives the lowest SAH cost
+		glm::vec3 centroid_min(FLT_MAX), centroid_max(-FLT_MAX);
+		for (uint32_t i = 0; i < node.count; i++) {
+			const glm::vec3& c = centroids[bvh.indices[node.first + i]];
+			centroid_min = glm::min(centroid_min, c);
+			centroid_max = glm::max(centroid_max, c);
+		}
+
+		float    best_cost = FLT_MAX;
+		int      best_axis = -1;
+		uint32_t best_split = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			float extent = centroid_max[axis] - centroid_min[axis];
+			if (extent <= 0.0f)
+				continue;
+			float scale = bvh_bins / extent;
+
+			glm::vec3 bin_min[bvh_bins], bin_max[bvh_bins];
+			uint32_t  bin_count[bvh_bins] = {};
+			for (uint32_t b = 0; b < bvh_bins; b++) {
+				bin_min[b] = glm::vec3(FLT_MAX);
+				bin_max[b] = glm::vec3(-FLT_MAX);
+			}
+			for (uint32_t i = 0; i < node.count; i++) {
+				uint32_t object = bvh.indices[node.first + i];
+				uint32_t b = std::min((uint32_t)((centroids[object][axis] - centroid_min[axis]) * scale), bvh_bins - 1);
+				bin_count[b]++;
+				bvh_grow(bin_min[b], bin_max[b], boxes[object]);
+			}
+
+			// Sweep from the right to get the cost of every right hand side, then from the left
+			float     right_area[bvh_bins];
+			uint32_t  right_count[bvh_bins];
+			glm::vec3 sweep_min(FLT_MAX), sweep_max(-FLT_MAX);
+			uint32_t  sweep_count = 0;
+			for (uint32_t b = bvh_bins - 1; b > 0; b--) {
+				sweep_count += bin_count[b];
+				if (bin_count[b] > 0)
+					bvh_grow(sweep_min, sweep_max, { bin_min[b], bin_max[b] });
+				right_area[b] = bvh_area(sweep_min, sweep_max);
+				right_count[b] = sweep_count;
+			}
+			sweep_min = glm::vec3(FLT_MAX);
+			sweep_max = glm::vec3(-FLT_MAX);
+			sweep_count = 0;
+			for (uint32_t b = 0; b < bvh_bins - 1; b++) {
+				sweep_count += bin_count[b];
+				if (bin_count[b] > 0)
+					bvh_grow(sweep_min, sweep_max, { bin_min[b], bin_max[b] });
+				if (sweep_count == 0 || right_count[b + 1] == 0)
+					continue;
+				float cost = bvh_area(sweep_min, sweep_max) * sweep_count + right_area[b + 1] * right_count[b + 1];
+				if (cost < best_cost) {
+					best_cost = cost;
+					best_axis = axis;
+					best_split = b + 1;
+				}
+			}
+		}
+
+		// Compare against not splitting at all, both costs are relative to this node's area
+		float leaf_cost = bvh_area(node.min, node.max) * node.count;
+		float split_cost = bvh_traversal_cost * bvh_area(node.min, node.max) + best_cost;
+		if (best_axis < 0 || (split_cost >= leaf_cost && node.count <= bvh_max_leaf_size * 4))
+			continue;
+
+		// Partition the node's objects in place around the chosen bin boundary
+		float scale = bvh_bins / (centroid_max[best_axis] - centroid_min[best_axis]);
+		uint32_t* begin = &bvh.indices[node.first];
+		uint32_t* middle = std::partition(begin, begin + node.count, [&](uint32_t object) {
+			uint32_t b = std::min((uint32_t)((centroids[object][best_axis] - centroid_min[best_axis]) * scale), bvh_bins - 1);
+			return b < best_split;
+		});
+		uint32_t left_count = (uint32_t)(middle - begin);
+		if (left_count == 0 || left_count == node.count)
+			continue;
+
+		uint32_t left = (uint32_t)bvh.nodes.size();
+		bvh.nodes.push_back({ glm::vec3(0.0f), node.first, glm::vec3(0.0f), left_count });
+		bvh.nodes.push_back({ glm::vec3(0.0f), node.first + left_count, glm::vec3(0.0f), node.count - left_count });
+		bvh.nodes[node_index].first = left;
+		bvh.nodes[node_index].count = 0;
+		stack.push_back(left + 1);
+		stack.push_back(left);
+	}
+}
+
+// Recompute node bounds after objects moved, keeping the tree shape. Children always come after their
+// parent, so walking the array backwards visits both children before the node that contains them.
+// Quality drops as objects drift from where they were at build time, fine for things that rarely move.
+void bvh_refit(bvh_t& bvh, const std::vector<aabb_t>& boxes) {
+	for (size_t i = bvh.nodes.size(); i-- > 0; ) {
+		bvh_node_t& node = bvh.nodes[i];
+		if (node.count > 0) {
+			bvh_fit_leaf(node, bvh, boxes);
+			continue;
+		}
+		const bvh_node_t& left = bvh.nodes[node.first];
+		const bvh_node_t& right = bvh.nodes[node.first + 1];
+		node.min = glm::min(left.min, right.min);
+		node.max = glm::max(left.max, right.max);
+	}
+}
+
+///////////////////////////////////////////
+
+// Tests a box against the planes still set in plane_mask. Returns false when it's fully outside one of
+// them, and clears the bits of planes it's fully inside of, so children skip those.
+bool bvh_test_planes(const frustum_t& frustum, const glm::vec3& min, const glm::vec3& max, uint32_t& plane_mask) {
+	glm::vec3 center = (min + max) * 0.5f;
+	glm::vec3 extent = (max - min) * 0.5f;
+	for (uint32_t p = 0; p < 6; p++) {
+		if (!(plane_mask & (1 << p)))
+			continue;
+		const glm::vec4& plane = frustum.planes[p];
+		float dist = glm::dot(glm::vec3(plane), center) + plane.w;
+		float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+		if (dist + radius < 0.0f)
+			return false;
+		if (dist - radius >= 0.0f)
+			plane_mask &= ~(1 << p);
+	}
+	return true;
+}
+
+// Appends every object whose box touches the frustum. Whole subtrees that are fully outside are skipped
+// with one test, and ones fully inside are taken without testing anything below them, which is what makes
+// this scale with what's visible rather than with the size of the scene.
+void bvh_cull(const bvh_t& bvh, const std::vector<aabb_t>& boxes, const frustum_t& frustum, std::vector<uint32_t>& out_visible, bvh_stats_t& stats) {
+	stats = {};
+	if (bvh.nodes.empty())
+		return;
+
+	// Depth is bounded by the build for any sane scene, but a degenerate one can go deeper, so the stack grows
+	struct entry_t { uint32_t node; uint32_t plane_mask; };
+	std::vector<entry_t> stack;
+	stack.reserve(64);
+	stack.push_back({ 0, 0x3F });
+
+	while (!stack.empty()) {
+		entry_t entry = stack.back();
+		stack.pop_back();
+		const bvh_node_t& node = bvh.nodes[entry.node];
+		stats.nodes_visited++;
+
+		uint32_t plane_mask = entry.plane_mask;
+		if (plane_mask != 0 && !bvh_test_planes(frustum, node.min, node.max, plane_mask))
+			continue;
+
+		if (node.count > 0) {
+			for (uint32_t i = 0; i < node.count; i++) {
+				uint32_t object = bvh.indices[node.first + i];
+				uint32_t object_mask = plane_mask;
+				if (object_mask != 0) {
+					stats.objects_tested++;
+					if (!bvh_test_planes(frustum, boxes[object].min, boxes[object].max, object_mask))
+						continue;
+				}
+				out_visible.push_back(object);
+			}
+			continue;
+		}
+
+		stack.push_back({ node.first + 1, plane_mask });
+		stack.push_back({ node.first, plane_mask });
+	}
+	stats.objects_visible = (uint32_t)out_visible.size();
+}
+
+///////////////////////////////////////////
+
+// Slab test, returns the entry distance or FLT_MAX on a miss
+float bvh_ray_box(const glm::vec3& origin, const glm::vec3& inv_direction, const glm::vec3& min, const glm::vec3& max, float max_distance) {
+	glm::vec3 t0 = (min - origin) * inv_direction;
+	glm::vec3 t1 = (max - origin) * inv_direction;
+	glm::vec3 t_near = glm::min(t0, t1);
+	glm::vec3 t_far = glm::max(t0, t1);
+	float enter = glm::max(glm::max(t_near.x, t_near.y), glm::max(t_near.z, 0.0f));
+	float exit = glm::min(glm::min(t_far.x, t_far.y), glm::min(t_far.z, max_distance));
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+// Closest object box hit along a ray. Children are visited nearest first, and anything farther than the
+// best hit so far is skipped.
+bool bvh_raycast(const bvh_t& bvh, const std::vector<aabb_t>& boxes, const glm::vec3& origin, const glm::vec3& direction, float max_distance, uint32_t& out_index, float& out_distance) {
+	if (bvh.nodes.empty())
+		return false;
+
+	glm::vec3 inv_direction = 1.0f / direction; // Infinities for axis aligned rays are what the slab test wants
+	float    best = max_distance;
+	bool     hit = false;
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (!stack.empty()) {
+		const bvh_node_t& node = bvh.nodes[stack.back()];
+		stack.pop_back();
+		if (bvh_ray_box(origin, inv_direction, node.min, node.max, best) == FLT_MAX)
+			continue;
+
+		if (node.count > 0) {
+			for (uint32_t i = 0; i < node.count; i++) {
+				uint32_t object = bvh.indices[node.first + i];
+				float t = bvh_ray_box(origin, inv_direction, boxes[object].min, boxes[object].max, best);
+				if (t < best) {
+					best = t;
+					out_index = object;
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		const bvh_node_t& left = bvh.nodes[node.first];
+		const bvh_node_t& right = bvh.nodes[node.first + 1];
+		float t_left = bvh_ray_box(origin, inv_direction, left.min, left.max, best);
+		float t_right = bvh_ray_box(origin, inv_direction, right.min, right.max, best);
+
+		// Push the far child first so the near one pops next
+		if (t_left <= t_right) {
+			if (t_right != FLT_MAX) stack.push_back(node.first + 1);
+			if (t_left != FLT_MAX) stack.push_back(node.first);
+		}
+		else {
+			if (t_left != FLT_MAX) stack.push_back(node.first);
+			if (t_right != FLT_MAX) stack.push_back(node.first + 1);
+		}
+	}
+
+	if (hit)
+		out_distance = best;
+	return hit;
+}
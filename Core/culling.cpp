@@ -0,0 +1,197 @@
+#include <culling.h>
+
+glm::vec4 cull_plane_normalize(const glm::vec4& plane) {
+	return plane / glm::length(glm::vec3(plane));
+}
+
+glm::quat cull_xr_quat(const XrQuaternionf& q) {
+	return glm::quat(q.w, q.x, q.y, q.z);
+}
+
+///////////////////////////////////////////
+
+// Frustum for a single view, straight from the OpenXR field of view angles
+frustum_t cull_frustum_from_fov(const XrPosef& pose, const XrFovf& fov, float near_z, float far_z) {
+	XrView view = { XR_TYPE_VIEW };
+	view.pose = pose;
+	view.fov = fov;
+	return cull_frustum_stereo(&view, 1, near_z, far_z);
+}
+
+// Shared head frame of a set of views, halfway between the eye orientations, and the widest tangents
+// (left, right, down, up) of any eye's corner rays in it, looking down -z. Canted displays work too, each
+// eye's corner rays are taken into the head frame before measuring.
+void cull_stereo_extents(const XrView* views, uint32_t view_count, glm::quat& out_head, glm::vec4& out_tangents) {
+	glm::quat head = cull_xr_quat(views[0].pose.orientation);
+	if (view_count > 1)
+		head = glm::slerp(head, cull_xr_quat(views[1].pose.orientation), 0.5f);
+	glm::quat head_inv = glm::inverse(head);
+
+	glm::vec4 tangents(-FLT_MAX);
+	for (uint32_t v = 0; v < view_count; v++) {
+		const XrFovf& fov = views[v].fov;
+		glm::quat to_head = head_inv * cull_xr_quat(views[v].pose.orientation);
+		float tx[2] = { tanf(fov.angleLeft), tanf(fov.angleRight) };
+		float ty[2] = { tanf(fov.angleDown), tanf(fov.angleUp) };
+		for (int c = 0; c < 4; c++) {
+			glm::vec3 ray = to_head * glm::vec3(tx[c & 1], ty[c >> 1], -1.0f);
+			float forward = glm::max(-ray.z, 1e-4f);
+			tangents = glm::max(tangents, glm::vec4(-ray.x, ray.x, -ray.y, ray.y) / forward);
+		}
+	}
+	out_head = head;
+	out_tangents = tangents;
+}
+
+// One frustum that encloses every view, so both eyes get culled with a single test. Side planes use the
+// widest angle of any eye, measured in the shared head frame, and are pushed out until every eye position
+// is behind them. For a typical headset that moves the apex slightly back from between the eyes.
+frustum_t cull_frustum_stereo(const XrView* views, uint32_t view_count, float near_z, float far_z) {
+	glm::quat head;
+	glm::vec4 tangents;
+	cull_stereo_extents(views, view_count, head, tangents);
+	float tan_left = tangents.x, tan_right = tangents.y, tan_down = tangents.z, tan_up = tangents.w;
+
+	// Inward normals in head space, then world space
+	glm::vec3 normals[6] = {
+		glm::vec3( 1.0f,  0.0f, -tan_left),
+		glm::vec3(-1.0f,  0.0f, -tan_right),
+		glm::vec3( 0.0f,  1.0f, -tan_down),
+		glm::vec3( 0.0f, -1.0f, -tan_up),
+		glm::vec3( 0.0f,  0.0f, -1.0f),
+		glm::vec3( 0.0f,  0.0f,  1.0f),
+	};
+
+	frustum_t frustum;
+	for (int p = 0; p < 6; p++) {
+		glm::vec3 normal = glm::normalize(head * normals[p]);
+
+		// Through whichever eye is farthest outside, so all of them stay inside
+		float min_distance = FLT_MAX;
+		for (uint32_t v = 0; v < view_count; v++) {
+			const XrVector3f& pos = views[v].pose.position;
+			min_distance = glm::min(min_distance, glm::dot(normal, glm::vec3(pos.x, pos.y, pos.z)));
+		}
+		frustum.planes[p] = glm::vec4(normal, -min_distance);
+	}
+	frustum.planes[4].w -= near_z;
+	frustum.planes[5].w += far_z;
+	return frustum;
+}
+
+// Projection from the midpoint between the eyes covering the same angles as cull_frustum_stereo(), for
+// anything that needs the combined view as an image rather than as planes (occlusion culling)
+glm::mat4 cull_stereo_viewproj(const XrView* views, uint32_t view_count, float near_z, float far_z) {
+	glm::quat head;
+	glm::vec4 tangents;
+	cull_stereo_extents(views, view_count, head, tangents);
+
+	glm::vec3 center(0.0f);
+	for (uint32_t v = 0; v < view_count; v++) {
+		const XrVector3f& pos = views[v].pose.position;
+		center += glm::vec3(pos.x, pos.y, pos.z) / (float)view_count;
+	}
+
+	glm::mat4 view = glm::inverse(glm::translate(glm::mat4(1.0f), center) * glm::mat4_cast(head));
+	glm::mat4 projection = glm::frustum(-tangents.x * near_z, tangents.y * near_z, -tangents.z * near_z, tangents.w * near_z, near_z, far_z);
+	return projection * view;
+}
+
+// Gribb/Hartmann plane extraction, for views that only exist as a matrix (benchmarks, debug cameras)
+frustum_t cull_frustum_from_matrix(const glm::mat4& viewproj) {
+	glm::mat4 m = glm::transpose(viewproj);
+	frustum_t frustum;
+	frustum.planes[0] = cull_plane_normalize(m[3] + m[0]);
+	frustum.planes[1] = cull_plane_normalize(m[3] - m[0]);
+	frustum.planes[2] = cull_plane_normalize(m[3] + m[1]);
+	frustum.planes[3] = cull_plane_normalize(m[3] - m[1]);
+	frustum.planes[4] = cull_plane_normalize(m[3] + m[2]);
+	frustum.planes[5] = cull_plane_normalize(m[3] - m[2]);
+	return frustum;
+}
+
+///////////////////////////////////////////
+
+void cull_list_clear(cull_list_t& list) {
+	list.center_x.clear(); list.center_y.clear(); list.center_z.clear();
+	list.extent_x.clear(); list.extent_y.clear(); list.extent_z.clear();
+	list.count = 0;
+}
+
+// Box around an object space box after transforming it, through the absolute rotation/scale (Arvo's method)
+aabb_t cull_world_box(const Bounds& bounds, const glm::mat4& world) {
+	glm::vec3 center = glm::vec3(world * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+	glm::vec3 half = (bounds.max - bounds.min) * 0.5f;
+	glm::vec3 extent =
+		glm::abs(glm::vec3(world[0])) * half.x +
+		glm::abs(glm::vec3(world[1])) * half.y +
+		glm::abs(glm::vec3(world[2])) * half.z;
+	return { center - extent, center + extent };
+}
+
+// Adds the world space box around an object space box, returns its index for reading visible[] later
+uint32_t cull_list_add(cull_list_t& list, const Bounds& bounds, const glm::mat4& world) {
+	aabb_t box = cull_world_box(bounds, world);
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	glm::vec3 extent = (box.max - box.min) * 0.5f;
+
+	uint32_t index = list.count++;
+	list.center_x.push_back(center.x); list.center_y.push_back(center.y); list.center_z.push_back(center.z);
+	list.extent_x.push_back(extent.x); list.extent_y.push_back(extent.y); list.extent_z.push_back(extent.z);
+	return index;
+}
+
+// Box against six planes, four boxes per iteration. A box is outside when it is entirely behind any
+// plane: dot(n, center) + d + dot(|n|, extent) < 0. Conservative near the frustum corners, which only
+// ever keeps a few extra objects, never drops a visible one.
+cull_stats_t cull_frustum_test(const frustum_t& frustum, cull_list_t& list) {
+	// Pad to a multiple of four with empty boxes, so the loop below has no scalar tail
+	size_t padded = (list.count + 3) & ~3u;
+	list.center_x.resize(padded, 0.0f); list.center_y.resize(padded, 0.0f); list.center_z.resize(padded, 0.0f);
+	list.extent_x.resize(padded, 0.0f); list.extent_y.resize(padded, 0.0f); list.extent_z.resize(padded, 0.0f);
+	list.visible.resize(padded);
+
+	__m128 nx[6], ny[6], nz[6], nd[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; p++) {
+		const glm::vec4& plane = frustum.planes[p];
+		nx[p] = _mm_set1_ps(plane.x);
+		ny[p] = _mm_set1_ps(plane.y);
+		nz[p] = _mm_set1_ps(plane.z);
+		nd[p] = _mm_set1_ps(plane.w);
+		ax[p] = _mm_set1_ps(fabsf(plane.x));
+		ay[p] = _mm_set1_ps(fabsf(plane.y));
+		az[p] = _mm_set1_ps(fabsf(plane.z));
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	uint32_t visible = 0;
+	for (size_t i = 0; i < padded; i += 4) {
+		__m128 cx = _mm_loadu_ps(&list.center_x[i]);
+		__m128 cy = _mm_loadu_ps(&list.center_y[i]);
+		__m128 cz = _mm_loadu_ps(&list.center_z[i]);
+		__m128 ex = _mm_loadu_ps(&list.extent_x[i]);
+		__m128 ey = _mm_loadu_ps(&list.extent_y[i]);
+		__m128 ez = _mm_loadu_ps(&list.extent_z[i]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++) {
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)), _mm_add_ps(_mm_mul_ps(nz[p], cz), nd[p]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; lane++) {
+			list.visible[i + lane] = (mask & (1 << lane)) ? 0 : 1;
+		}
+	}
+	for (uint32_t i = 0; i < list.count; i++) {
+		visible += list.visible[i];
+	}
+
+	// Drop the padding again, so cull_list_add() keeps appending right after the real entries
+	list.center_x.resize(list.count); list.center_y.resize(list.count); list.center_z.resize(list.count);
+	list.extent_x.resize(list.count); list.extent_y.resize(list.count); list.extent_z.resize(list.count);
+
+	return { list.count, visible };
+}
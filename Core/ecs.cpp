@@ -0,0 +1,262 @@
+#include <ecs.h>
+
+ecs_component_t ecs_register(ecs_world_t& world, const char* name, size_t size) {
+	if (world.components.size() >= ecs_max_components) {
+		printf("ECS: no room to register %s, %u components at most\n", name, ecs_max_components);
+		return ecs_max_components - 1;
+	}
+	world.components.push_back({ name, size });
+	return (ecs_component_t)world.components.size() - 1;
+}
+
+// Rows are sized so the entity ids and every array fit in one chunk, each array starting aligned
+uint32_t ecs_archetype_get(ecs_world_t& world, ecs_mask_t mask) {
+	auto found = world.archetype_lookup.find(mask);
+	if (found != world.archetype_lookup.end())
+		return found->second;
+
+	ecs_archetype_t archetype = {};
+	archetype.mask = mask;
+	size_t row_bytes = sizeof(Entity);
+	uint32_t arrays = 1;
+	for (ecs_component_t c = 0; c < world.components.size(); c++) {
+		if (mask & ecs_mask(c)) {
+			row_bytes += world.components[c].size;
+			arrays++;
+		}
+	}
+	archetype.capacity = (uint32_t)glm::max((ecs_chunk_bytes - arrays * ecs_array_align) / row_bytes, (size_t)1);
+
+	size_t offset = 0;
+	auto align = [](size_t value) { return (value + ecs_array_align - 1) / ecs_array_align * ecs_array_align; };
+	offset = align(sizeof(Entity) * archetype.capacity);
+	for (ecs_component_t c = 0; c < world.components.size(); c++) {
+		if (!(mask & ecs_mask(c)))
+			continue;
+		archetype.offsets[c] = offset;
+		offset = align(offset + world.components[c].size * archetype.capacity);
+	}
+
+	uint32_t index = (uint32_t)world.archetypes.size();
+	world.archetypes.push_back(std::move(archetype));
+	world.archetype_lookup[mask] = index;
+	return index;
+}
+
+// A free row at the end of the archetype, a new chunk when the last one is full
+void ecs_row_alloc(ecs_world_t& world, uint32_t archetype_index, uint32_t& out_chunk, uint32_t& out_row) {
+	ecs_archetype_t& archetype = world.archetypes[archetype_index];
+	if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity) {
+		archetype.chunks.emplace_back();
+		ecs_chunk_t& chunk = archetype.chunks.back();
+		chunk.data.resize(ecs_chunk_bytes);
+		chunk.count = 0;
+		for (uint32_t c = 0; c < ecs_max_components; c++) {
+			chunk.versions[c] = world.version; // A new chunk counts as changed
+		}
+	}
+	out_chunk = (uint32_t)archetype.chunks.size() - 1;
+	out_row = archetype.chunks.back().count++;
+}
+
+// Fill a hole by moving the archetype's very last row into it, so chunks stay packed
+void ecs_row_free(ecs_world_t& world, uint32_t archetype_index, uint32_t chunk_index, uint32_t row) {
+	ecs_archetype_t& archetype = world.archetypes[archetype_index];
+	ecs_chunk_t& chunk = archetype.chunks[chunk_index];
+	ecs_chunk_t& last = archetype.chunks.back();
+	uint32_t last_row = last.count - 1;
+
+	if (&last != &chunk || last_row != row) {
+		Entity* entities = (Entity*)chunk.data.data();
+		Entity moved = ((Entity*)last.data.data())[last_row];
+		entities[row] = moved;
+		for (ecs_component_t c = 0; c < world.components.size(); c++) {
+			if (!(archetype.mask & ecs_mask(c)))
+				continue;
+			size_t size = world.components[c].size;
+			memcpy(chunk.data.data() + archetype.offsets[c] + row * size, last.data.data() + archetype.offsets[c] + last_row * size, size);
+			chunk.versions[c] = world.version;
+		}
+		world.records[moved.index].chunk = chunk_index;
+		world.records[moved.index].row = row;
+	}
+
+	last.count--;
+	if (last.count == 0)
+		archetype.chunks.pop_back();
+}
+
+///////////////////////////////////////////
+
+Entity ecs_create(ecs_world_t& world, ecs_mask_t components) {
+	uint32_t index;
+	if (!world.free_records.empty()) {
+		index = world.free_records.back();
+		world.free_records.pop_back();
+	}
+	else {
+		index = (uint32_t)world.records.size();
+		world.records.push_back({});
+	}
+
+	ecs_record_t& record = world.records[index];
+	record.archetype = ecs_archetype_get(world, components);
+	ecs_row_alloc(world, record.archetype, record.chunk, record.row);
+	record.alive = true;
+	Entity entity = { index, record.generation };
+
+	ecs_archetype_t& archetype = world.archetypes[record.archetype];
+	ecs_chunk_t& chunk = archetype.chunks[record.chunk];
+	((Entity*)chunk.data.data())[record.row] = entity;
+	for (ecs_component_t c = 0; c < world.components.size(); c++) {
+		if (components & ecs_mask(c)) {
+			size_t size = world.components[c].size;
+			memset(chunk.data.data() + archetype.offsets[c] + record.row * size, 0, size);
+			chunk.versions[c] = world.version;
+		}
+	}
+	world.count++;
+	return entity;
+}
+
+void ecs_destroy(ecs_world_t& world, Entity entity) {
+	if (!ecs_alive(world, entity))
+		return;
+	ecs_record_t& record = world.records[entity.index];
+	ecs_row_free(world, record.archetype, record.chunk, record.row);
+	record.alive = false;
+	record.generation++;
+	world.free_records.push_back(entity.index);
+	world.count--;
+}
+
+bool ecs_alive(const ecs_world_t& world, Entity entity) {
+	return entity.index < world.records.size() && world.records[entity.index].alive && world.records[entity.index].generation == entity.generation;
+}
+
+// Copy what the two archetypes share into a row of the new one, new components start zeroed
+void ecs_move(ecs_world_t& world, Entity entity, ecs_mask_t mask) {
+	ecs_record_t& record = world.records[entity.index];
+	uint32_t target_index = ecs_archetype_get(world, mask);
+	if (target_index == record.archetype)
+		return;
+
+	uint32_t chunk_index, row;
+	ecs_row_alloc(world, target_index, chunk_index, row);
+	const ecs_archetype_t& source = world.archetypes[record.archetype];
+	ecs_archetype_t& target = world.archetypes[target_index];
+	const ecs_chunk_t& from = source.chunks[record.chunk];
+	ecs_chunk_t& to = target.chunks[chunk_index];
+	((Entity*)to.data.data())[row] = entity;
+	for (ecs_component_t c = 0; c < world.components.size(); c++) {
+		if (!(mask & ecs_mask(c)))
+			continue;
+		size_t size = world.components[c].size;
+		uint8_t* dst = to.data.data() + target.offsets[c] + row * size;
+		if (source.mask & ecs_mask(c))
+			memcpy(dst, from.data.data() + source.offsets[c] + record.row * size, size);
+		else
+			memset(dst, 0, size);
+		to.versions[c] = world.version;
+	}
+
+	ecs_row_free(world, record.archetype, record.chunk, record.row);
+	record.archetype = target_index;
+	record.chunk = chunk_index;
+	record.row = row;
+}
+
+void ecs_add(ecs_world_t& world, Entity entity, ecs_component_t component) {
+	if (ecs_alive(world, entity))
+		ecs_move(world, entity, world.archetypes[world.records[entity.index].archetype].mask | ecs_mask(component));
+}
+
+void ecs_remove(ecs_world_t& world, Entity entity, ecs_component_t component) {
+	if (ecs_alive(world, entity))
+		ecs_move(world, entity, world.archetypes[world.records[entity.index].archetype].mask & ~ecs_mask(component));
+}
+
+bool ecs_has(const ecs_world_t& world, Entity entity, ecs_component_t component) {
+	return ecs_alive(world, entity) && (world.archetypes[world.records[entity.index].archetype].mask & ecs_mask(component)) != 0;
+}
+
+const void* ecs_get(const ecs_world_t& world, Entity entity, ecs_component_t component) {
+	if (!ecs_has(world, entity, component))
+		return nullptr;
+	const ecs_record_t& record = world.records[entity.index];
+	const ecs_archetype_t& archetype = world.archetypes[record.archetype];
+	return archetype.chunks[record.chunk].data.data() + archetype.offsets[component] + record.row * world.components[component].size;
+}
+
+void* ecs_write(ecs_world_t& world, Entity entity, ecs_component_t component) {
+	if (!ecs_has(world, entity, component))
+		return nullptr;
+	const ecs_record_t& record = world.records[entity.index];
+	ecs_archetype_t& archetype = world.archetypes[record.archetype];
+	ecs_chunk_t& chunk = archetype.chunks[record.chunk];
+	chunk.versions[component] = world.version;
+	return chunk.data.data() + archetype.offsets[component] + record.row * world.components[component].size;
+}
+
+void ecs_tick(ecs_world_t& world) {
+	world.version++;
+}
+
+// The records stay, each live one dead with its generation bumped like ecs_destroy() does, so an Entity
+// from before the clear can't come back to life when its slot is reused
+void ecs_clear(ecs_world_t& world) {
+	world.archetypes.clear();
+	world.archetype_lookup.clear();
+	world.free_records.clear();
+	for (uint32_t i = (uint32_t)world.records.size(); i-- > 0;) {
+		ecs_record_t& record = world.records[i];
+		if (record.alive) {
+			record.alive = false;
+			record.generation++;
+		}
+		world.free_records.push_back(i);
+	}
+	world.count = 0;
+}
+
+///////////////////////////////////////////
+
+bool ecs_query_match(const ecs_query_t& query, const ecs_archetype_t& archetype) {
+	return (archetype.mask & query.all) == query.all && (archetype.mask & query.none) == 0;
+}
+
+bool ecs_query_chunk(const ecs_query_t& query, const ecs_chunk_t& chunk) {
+	return chunk.count > 0 && (query.changed_since == 0 || chunk.versions[query.changed] > query.changed_since);
+}
+
+// Don't create, destroy, add or remove components from inside fn, rows would move under the view
+void ecs_for_each(ecs_world_t& world, const ecs_query_t& query, const std::function<void(ecs_view_t& view)>& fn) {
+	for (ecs_archetype_t& archetype : world.archetypes) {
+		if (!ecs_query_match(query, archetype))
+			continue;
+		for (ecs_chunk_t& chunk : archetype.chunks) {
+			if (!ecs_query_chunk(query, chunk))
+				continue;
+			ecs_view_t view = { &world, &archetype, &chunk, chunk.count };
+			fn(view);
+		}
+	}
+}
+
+// Chunks are gathered first, then shared out a few batches per thread. A chunk is only ever seen by one job.
+void ecs_for_each_parallel(ecs_world_t& world, const ecs_query_t& query, const std::function<void(ecs_view_t& view)>& fn) {
+	std::vector<ecs_view_t> views;
+	ecs_for_each(world, query, [&views](ecs_view_t& view) { views.push_back(view); });
+	uint32_t batch = std::max((uint32_t)views.size() / (jobs_thread_count() * 4), 1u);
+	jobs_parallel_for((uint32_t)views.size(), batch, [&views, &fn](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) {
+			fn(views[i]);
+		}
+	});
+}
+
+uint32_t ecs_query_count(ecs_world_t& world, const ecs_query_t& query) {
+	uint32_t count = 0;
+	ecs_for_each(world, query, [&count](ecs_view_t& view) { count += view.count; });
+	return count;
+}
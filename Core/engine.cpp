@@ -1,8 +1,51 @@
 #include "core/gameobject.cpp"
+#include "core/lod.cpp"
+#include "core/vertexformat.cpp"
+#include "core/meshopt.cpp"
+#include "core/texcompress.cpp"
+#include "core/ktx.cpp"
+#include "core/streaming.cpp"
+#include "core/assets.cpp"
+#include "core/ringbuffer.cpp"
+#include "core/jobs.cpp"
+#include "core/upload.cpp"
+#include "core/texturepages.cpp"
+#include "core/meshpool.cpp"
+#include "core/culling.cpp"
+#include "core/bvh.cpp"
+#include "core/occlusion.cpp"
+#include "core/gpuculling.cpp"
+#include "core/renderqueue.cpp"
+#include "core/staticscene.cpp"
+#include "core/staticbatch.cpp"
+#include "core/ecs.cpp"
+#include "core/hierarchy.cpp"
+#include "core/scene.cpp"
+#include "core/benchmark.cpp"
 #include "core/audio.cpp"
 #include "core/shaders.cpp"
 
-int main() {
+int main(int argc, char** argv) {
+	// Offline texture baking: --bake [bc1|bc3|bc7|auto] images... writes a .ktx2 next to each image, no window needed
+	if (argc > 1 && strcmp(argv[1], "--bake") == 0) {
+		texture_format_t format = TEXTURE_FORMAT_AUTO;
+		int first = 2;
+		const texture_format_t formats[] = { TEXTURE_FORMAT_BC1, TEXTURE_FORMAT_BC3, TEXTURE_FORMAT_BC7, TEXTURE_FORMAT_AUTO };
+		for (texture_format_t candidate : formats) {
+			if (argc > 2 && _stricmp(argv[2], texture_format_name(candidate)) == 0) {
+				format = candidate;
+				first = 3;
+			}
+		}
+		jobs_init();
+		int failed = 0;
+		for (int i = first; i < argc; i++) {
+			failed += ktx_bake_file(argv[i], format) ? 0 : 1;
+		}
+		jobs_shutdown();
+		return failed > 0 ? 1 : 0;
+	}
+
 	// Initialize GLFW (creates the window and OpenGL context)
 	if (!glfwInit()) {
 		MessageBox(nullptr, _T("GLFW initialization failed\n"), _T("Error"), MB_OK);
@@ -22,6 +65,9 @@ int main() {
 	}
 	glfwMakeContextCurrent(window);
 
+	// The desktop window is only a mirror, xrWaitFrame paces the loop, so never wait on the monitor's vsync
+	glfwSwapInterval(0);
+
 	// Now that we have a context, we can load OpenGL functions with glad
 	if (!gladLoadGL()) {
 		MessageBox(nullptr, _T("Failed to load OpenGL functions\n"), _T("Error"), MB_OK);
@@ -30,6 +76,27 @@ int main() {
 		return 1;
 	}
 
+	// Optional GL extensions decide how the swapchains get created, so load them before OpenXR
+	gl_load_extensions();
+
+	// Worker threads for CPU side work like BVH builds
+	jobs_init();
+
+	// Staging ring that buffer and texture data goes up through, a few MB per frame
+	upload_init();
+
+	// Benchmarks only need the GL context, so they run without a headset
+	if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+		benchmark_run();
+		opengl_shutdown();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--test") == 0) {
+		int failures = benchmark_test();
+		opengl_shutdown();
+		return failures == 0 ? 0 : 1;
+	}
+
 	// Check if openxr_init() fails
 	if (!openxr_init("Single file OpenXR", OPENGL_SWAPCHAIN_FORMAT)) {
 		MessageBox(nullptr, _T("OpenXR initialization failed\n"), _T("Error"), MB_OK);
@@ -47,6 +114,10 @@ int main() {
 	openxr_make_actions();
 	app_init();
 	game.start();
+	mesh_optimize_report(app_mesh_optimize_stats);
+
+	// Whatever the level marked static gets merged now, before the first frame
+	static_batch_build(app_static_batch, app_static_scene);
 
 	// Enable depth 
 	glEnable(GL_DEPTH_TEST);
@@ -73,8 +144,8 @@ int main() {
 			// Render the VR frame into the XR swapchains
 			openxr_render_frame();
 
-			// Swap the GLFW buffers
-			glfwSwapBuffers(window);
+			// Swap the GLFW buffers, if the mirror got a new image this frame
+			gl_mirror_present();
 
 			// If the XR session is not visible or focused, sleep a bit to reduce CPU usage
 			if (xr_session_state != XR_SESSION_STATE_VISIBLE &&
@@ -225,12 +296,27 @@ bool openxr_init(const char* app_name, int64_t swapchain_format) {
 	xr_views.resize(view_count, { XR_TYPE_VIEW });
 	xrEnumerateViewConfigurationViews(xr_instance, xr_system_id, app_config_view, view_count, &view_count, xr_config_views.data());
 
-	// Create OpenGL swapchains for each view
-	for (uint32_t i = 0; i < view_count; i++) {
+	// Multiview renders every view into one layered swapchain, which needs matching view sizes
+	if (gl_multiview) {
+		for (uint32_t i = 1; i < view_count; i++) {
+			if (xr_config_views[i].recommendedImageRectWidth != xr_config_views[0].recommendedImageRectWidth ||
+				xr_config_views[i].recommendedImageRectHeight != xr_config_views[0].recommendedImageRectHeight) {
+				gl_multiview = false;
+			}
+		}
+		if (view_count != 2)
+			gl_multiview = false;
+		printf("Stereo rendering: %s\n", gl_multiview ? "single pass (GL_OVR_multiview)" : "one pass per eye");
+	}
+	uint32_t swapchain_count = gl_multiview ? 1 : view_count;
+	uint32_t swapchain_layers = gl_multiview ? view_count : 1;
+
+	// Create OpenGL swapchains for each view, or a single layered one for multiview
+	for (uint32_t i = 0; i < swapchain_count; i++) {
 		XrViewConfigurationView& view = xr_config_views[i];
 		XrSwapchainCreateInfo swapchain_info = { XR_TYPE_SWAPCHAIN_CREATE_INFO };
 		XrSwapchain handle;
-		swapchain_info.arraySize = 1;
+		swapchain_info.arraySize = swapchain_layers;
 		swapchain_info.mipCount = 1;
 		swapchain_info.faceCount = 1;
 		swapchain_info.format = swapchain_format;
@@ -251,13 +337,16 @@ bool openxr_init(const char* app_name, int64_t swapchain_format) {
 		swapchain_t swapchain = {};
 		swapchain.width = swapchain_info.width;
 		swapchain.height = swapchain_info.height;
+		swapchain.array_size = swapchain_layers;
 		swapchain.handle = handle;
 		swapchain.surface_images.resize(surface_count, { XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR });
 		swapchain.surface_data.resize(surface_count);
 
 		xrEnumerateSwapchainImages(swapchain.handle, surface_count, &surface_count, (XrSwapchainImageBaseHeader*)swapchain.surface_images.data());
 		for (uint32_t img_i = 0; img_i < surface_count; img_i++) {
-			swapchain.surface_data[img_i] = gl_make_surface_data((XrBaseInStructure&)swapchain.surface_images[img_i], swapchain.width, swapchain.height);
+			swapchain.surface_data[img_i] = gl_multiview
+				? gl_make_surface_data_multiview((XrBaseInStructure&)swapchain.surface_images[img_i], swapchain.width, swapchain.height, swapchain_layers)
+				: gl_make_surface_data((XrBaseInStructure&)swapchain.surface_images[img_i], swapchain.width, swapchain.height);
 		}
 		xr_swapchains.push_back(swapchain);
 	}
@@ -358,6 +447,22 @@ void openxr_shutdown() {
 
 void opengl_shutdown() {
 	// Cleanup the OpenGL resources we've created
+	static_scene_clear(app_static_scene);
+	static_batch_clear(app_static_batch);
+	app_scene.clear();
+	hierarchy_clear(app_hierarchy);
+	app_hand_nodes[0] = app_hand_nodes[1] = hierarchy_none;
+	upload_drain();
+	jobs_shutdown();
+	app_controller_model = nullptr;
+	asset_shutdown();
+	stream_shutdown();
+	texture_pages_shutdown();
+	mesh_pool_shutdown();
+	gpu_cull_shutdown();
+	upload_shutdown();
+	gl_ring_destroy(app_uniform_ring);
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
 }
@@ -476,6 +581,15 @@ void openxr_render_frame() {
 	// xrEndFrame right away.
 	xrBeginFrame(xr_session, nullptr);
 
+	// Per draw uniforms for this frame go into the next section of the ring
+	gl_ring_begin_frame(app_uniform_ring);
+
+	// New views this frame, so the occlusion buffer needs drawing again
+	app_occlusion.ready = false;
+
+	// And the game records its draws again, once for all of them
+	draw_list_clear(app_frame_draws);
+
 	// Execute any code that's dependant on the predicted time, such as updating the location of
 	// controller models.
 	openxr_poll_predicted(frame_state.predictedDisplayTime);
@@ -490,6 +604,9 @@ void openxr_render_frame() {
 		layer = (XrCompositionLayerBaseHeader*)&layer_proj;
 	}
 
+	// Fence this frame's uniforms, the section gets reused once the GPU is past it
+	gl_ring_end_frame(app_uniform_ring);
+
 	// We're finished with rendering our layer, so send it off for display!
 	XrFrameEndInfo end_info{ XR_TYPE_FRAME_END_INFO };
 	end_info.displayTime = frame_state.predictedDisplayTime;
@@ -513,6 +630,51 @@ bool openxr_render_layer(XrTime predictedTime, std::vector<XrCompositionLayerPro
 	xrLocateViews(xr_session, &locate_info, &view_state, (uint32_t)xr_views.size(), &view_count, xr_views.data());
 	views.resize(view_count);
 
+	// Only every Nth frame gets copied to the desktop window
+	uint32_t divisor = app_config_mirror_divisor > 0 ? app_config_mirror_divisor : 1;
+	mirror_this_frame = app_config_mirror != MIRROR_NONE && (mirror_frame_counter++ % divisor) == 0;
+
+	// With multiview there's a single layered swapchain, and every view gets drawn in one pass
+	if (gl_multiview) {
+		swapchain_t& swapchain = xr_swapchains[0];
+
+		uint32_t                    img_id;
+		XrSwapchainImageAcquireInfo acquire_info = { XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
+		xrAcquireSwapchainImage(swapchain.handle, &acquire_info, &img_id);
+
+		XrSwapchainImageWaitInfo wait_info = { XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
+		wait_info.timeout = XR_INFINITE_DURATION;
+		xrWaitSwapchainImage(swapchain.handle, &wait_info);
+
+		// Each view points at its own layer of the shared image
+		for (uint32_t i = 0; i < view_count; i++) {
+			views[i] = { XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW };
+			views[i].pose = xr_views[i].pose;
+			views[i].fov = xr_views[i].fov;
+			views[i].subImage.swapchain = swapchain.handle;
+			views[i].subImage.imageRect.offset = { 0, 0 };
+			views[i].subImage.imageRect.extent = { swapchain.width, swapchain.height };
+			views[i].subImage.imageArrayIndex = i;
+		}
+
+		gl_render_layer(views.data(), view_count, swapchain.surface_data[img_id]);
+
+		// Copy to the desktop window before handing the image back to the runtime, and keep the depth for
+		// next frame's GPU occlusion culling
+		for (uint32_t i = 0; i < view_count; i++) {
+			gl_mirror_view(swapchain.surface_data[img_id].layerfbo[i], i, swapchain.width, swapchain.height);
+			gpu_cull_capture(swapchain.surface_data[img_id].layerfbo[i], i, swapchain.width, swapchain.height, app_view.viewproj[i]);
+		}
+
+		XrSwapchainImageReleaseInfo release_info = { XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
+		xrReleaseSwapchainImage(swapchain.handle, &release_info);
+
+		layer.space = xr_app_space;
+		layer.viewCount = (uint32_t)views.size();
+		layer.views = views.data();
+		return true;
+	}
+
 	// And now we'll iterate through each viewpoint, and render it!
 	for (uint32_t i = 0; i < view_count; i++) {
 
@@ -537,7 +699,11 @@ bool openxr_render_layer(XrTime predictedTime, std::vector<XrCompositionLayerPro
 		views[i].subImage.imageRect.extent = { xr_swapchains[i].width, xr_swapchains[i].height };
 
 		// Call the rendering callback with our view and swapchain info
-		gl_render_layer(views[i], xr_swapchains[i].surface_data[img_id], window);
+		gl_render_layer(&views[i], 1, xr_swapchains[i].surface_data[img_id]);
+
+		// Copy to the desktop window before handing the image back to the runtime
+		gl_mirror_view(xr_swapchains[i].surface_data[img_id].fbo, i, xr_swapchains[i].width, xr_swapchains[i].height);
+		gpu_cull_capture(xr_swapchains[i].surface_data[img_id].fbo, i, xr_swapchains[i].width, xr_swapchains[i].height, app_view.viewproj[0]);
 
 		// And tell OpenXR we're done with rendering to this one!
 		XrSwapchainImageReleaseInfo release_info = { XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
@@ -554,6 +720,27 @@ bool openxr_render_layer(XrTime predictedTime, std::vector<XrCompositionLayerPro
 // OpenGL code                          //
 ///////////////////////////////////////////
 
+// Look for the optional extensions we can make use of and load their entry points
+void gl_load_extensions() {
+	if (glfwExtensionSupported("GL_ARB_buffer_storage")) {
+		ext_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+	}
+	if (app_config_multiview && glfwExtensionSupported("GL_OVR_multiview")) {
+		ext_glFramebufferTextureMultiviewOVR = (PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC)glfwGetProcAddress("glFramebufferTextureMultiviewOVR");
+		gl_multiview = ext_glFramebufferTextureMultiviewOVR != nullptr;
+	}
+	gl_texture_s3tc = glfwExtensionSupported("GL_EXT_texture_compression_s3tc") != 0;
+}
+
+// Insert #define lines right after the #version directive, so one shader file can build several variants
+std::string gl_shader_variant(const char* source, const char* defines) {
+	std::string result = source;
+	size_t version = result.find("#version");
+	size_t line_end = version == std::string::npos ? 0 : result.find('\n', version) + 1;
+	result.insert(line_end, defines);
+	return result;
+}
+
 // Compile a GLSL shader and return its ID
 GLuint gl_compile_shader(GLenum type, const char* source) {
 	GLuint shader = glCreateShader(type);
@@ -570,10 +757,10 @@ GLuint gl_compile_shader(GLenum type, const char* source) {
 	return shader;
 }
 
-// Link vertex and fragment shader into a program
-GLuint gl_create_program(const char* vs_src, const char* fs_src) {
-	GLuint vs = gl_compile_shader(GL_VERTEX_SHADER, vs_src);
-	GLuint fs = gl_compile_shader(GL_FRAGMENT_SHADER, fs_src);
+// Link vertex and fragment shader into a program, optionally with extra #defines for both stages
+GLuint gl_create_program(const char* vs_src, const char* fs_src, const char* defines) {
+	GLuint vs = gl_compile_shader(GL_VERTEX_SHADER, gl_shader_variant(vs_src, defines).c_str());
+	GLuint fs = gl_compile_shader(GL_FRAGMENT_SHADER, gl_shader_variant(fs_src, defines).c_str());
 
 	GLuint prog = glCreateProgram();
 	glAttachShader(prog, vs);
@@ -594,6 +781,25 @@ GLuint gl_create_program(const char* vs_src, const char* fs_src) {
 	return prog;
 }
 
+GLuint gl_create_compute_program(const char* cs_src, const char* defines) {
+	GLuint cs = gl_compile_shader(GL_COMPUTE_SHADER, gl_shader_variant(cs_src, defines).c_str());
+
+	GLuint prog = glCreateProgram();
+	glAttachShader(prog, cs);
+	glLinkProgram(prog);
+	glDeleteShader(cs);
+
+	GLint success = 0;
+	glGetProgramiv(prog, GL_LINK_STATUS, &success);
+	if (!success) {
+		char log[512];
+		glGetProgramInfoLog(prog, 512, NULL, log);
+		printf("Program link error: %s\n", log);
+	}
+
+	return prog;
+}
+
 // Convert from XrFovf to a projection matrix using glm
 glm::mat4 gl_xr_projection(XrFovf fov, float clip_near, float clip_far) {
 	float left = clip_near * tanf(fov.angleLeft);
@@ -631,34 +837,106 @@ swapchain_surfdata_t gl_make_surface_data(XrBaseInStructure& swapchain_img, int3
 	return result;
 }
 
-// Swaping between the headset and desktop window framebuffers
-void gl_render_layer(XrCompositionLayerProjectionView& view, swapchain_surfdata_t& surface, GLFWwindow* window) {
-	// Render to the headset's framebuffer
+// Same as above, but for a layered swapchain image that all views render into at once
+swapchain_surfdata_t gl_make_surface_data_multiview(XrBaseInStructure& swapchain_img, int32_t width, int32_t height, uint32_t layers) {
+	swapchain_surfdata_t result = {};
+
+	XrSwapchainImageOpenGLKHR& gl_swapchain_img = (XrSwapchainImageOpenGLKHR&)swapchain_img;
+	GLuint colorTexture = gl_swapchain_img.image;
+
+	glGenFramebuffers(1, &result.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, result.fbo);
+
+	// Multiview needs a layered depth attachment, so use a texture array instead of a renderbuffer
+	glGenTextures(1, &result.depthtexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, result.depthtexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, width, height, layers);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	ext_glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, result.depthtexture, 0, 0, layers);
+	ext_glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0, 0, layers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Failed to create multiview framebuffer for swapchain image\n");
+	}
+
+	// Blits can't read from a layered framebuffer, so keep a framebuffer per layer at hand for the desktop mirror
+	for (uint32_t i = 0; i < layers && i < 2; i++) {
+		glGenFramebuffers(1, &result.layerfbo[i]);
+		glBindFramebuffer(GL_FRAMEBUFFER, result.layerfbo[i]);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0, i);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, result.depthtexture, 0, i); // GPU culling blits depth out of here
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return result;
+}
+
+// Render the headset's view(s) into the swapchain framebuffer
+void gl_render_layer(XrCompositionLayerProjectionView* views, uint32_t view_count, swapchain_surfdata_t& surface) {
+	XrCompositionLayerProjectionView& view = views[0];
+
 	glBindFramebuffer(GL_FRAMEBUFFER, surface.fbo);
 	glViewport(view.subImage.imageRect.offset.x, view.subImage.imageRect.offset.y,
 		view.subImage.imageRect.extent.width, view.subImage.imageRect.extent.height); // set the viewport to headset
 	glClearColor(0, 0, 0, 1);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	extern void app_draw(XrCompositionLayerProjectionView & view);
-	app_draw(view); // first draw for the headset
+	app_draw(views, view_count);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Copy a finished eye image to the desktop window, a blit costs a fraction of drawing the scene again
+void gl_mirror_view(GLuint read_fbo, uint32_t eye, int32_t width, int32_t height) {
+	if (!mirror_this_frame || read_fbo == 0 || eye > 1)
+		return;
+	if (app_config_mirror == MIRROR_LEFT_EYE && eye != 0)
+		return;
 
-	// Render to the desktop window's default framebuffer
-	glfwMakeContextCurrent(window); // make the desktop window current context
 	int windowWidth, windowHeight;
 	glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+	if (windowWidth <= 0 || windowHeight <= 0)
+		return; // minimized
+
+	// Each mirrored eye gets the whole window, or half of it when showing both
+	int slots = app_config_mirror == MIRROR_BOTH_EYES ? 2 : 1;
+	int slotWidth = windowWidth / slots;
+
+	// Fit the eye image in its slot without stretching it
+	float scale = std::min((float)slotWidth / width, (float)windowHeight / height);
+	int dstWidth = (int)(width * scale);
+	int dstHeight = (int)(height * scale);
+	int dstX = slotWidth * (slots == 2 ? eye : 0) + (slotWidth - dstWidth) / 2;
+	int dstY = (windowHeight - dstHeight) / 2;
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	if (eye == 0) {
+		// Clear the letterbox bars once per mirrored frame
+		glViewport(0, 0, windowWidth, windowHeight);
+		glClearColor(0, 0, 0, 1);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, read_fbo);
+	glBlitFramebuffer(0, 0, width, height, dstX, dstY, dstX + dstWidth, dstY + dstHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
-	glViewport(0, 0, windowWidth, windowHeight);
-	glClearColor(0, 0, 0, 1);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	app_draw(view); // second draw for the desktop window
+	mirror_pending = true;
+}
+
+// Show whatever got mirrored this frame, swap interval 0 keeps this from blocking the XR loop
+void gl_mirror_present() {
+	if (!mirror_pending)
+		return;
+	glfwSwapBuffers(window);
+	mirror_pending = false;
 }
 
 
 void gl_swapchain_destroy(swapchain_t& swapchain) {
 	for (auto& surf : swapchain.surface_data) {
 		glDeleteRenderbuffers(1, &surf.depthbuffer);
+		glDeleteTextures(1, &surf.depthtexture);
 		glDeleteFramebuffers(1, &surf.fbo);
+		glDeleteFramebuffers(2, surf.layerfbo);
 	}
 }
 
@@ -668,25 +946,48 @@ void gl_swapchain_destroy(swapchain_t& swapchain) {
 
 void app_init() {
 
+	// Shader variant defines, multiview draws every eye in one pass
+	const char* shader_defines = gl_multiview ? "#define MULTIVIEW\n" : "";
+
 	// Main app shader setup
 	Shaders defaultShaders("Shaders/default.vert", "Shaders/default.frag");
-	app_shader_program = gl_create_program(defaultShaders.vertexShader, defaultShaders.fragmentShader);
-
-	// Create a UBO for transform data
-	glGenBuffers(1, &app_uniform_buffer);
-	glBindBuffer(GL_UNIFORM_BUFFER, app_uniform_buffer);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(app_transform_buffer_t), nullptr, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	app_shader_program = gl_create_program(defaultShaders.vertexShader, defaultShaders.fragmentShader, shader_defines);
+
+	// Instanced variant, the instance buffer is at storage binding 0 and per view data at uniform binding 1
+	std::string instanced_defines = std::string(shader_defines) + "#define INSTANCED\n";
+	app_shader_program_instanced = gl_create_program(defaultShaders.vertexShader, defaultShaders.fragmentShader, instanced_defines.c_str());
+	glUniformBlockBinding(app_shader_program_instanced, glGetUniformBlockIndex(app_shader_program_instanced, "ViewBuffer"), 1);
+
+	// Same pair again for models with quantized vertices
+	std::string quantized_defines = std::string(shader_defines) + "#define QUANTIZED\n";
+	app_shader_program_quantized = gl_create_program(defaultShaders.vertexShader, defaultShaders.fragmentShader, quantized_defines.c_str());
+	quantized_defines += "#define INSTANCED\n";
+	app_shader_program_instanced_quantized = gl_create_program(defaultShaders.vertexShader, defaultShaders.fragmentShader, quantized_defines.c_str());
+	glUniformBlockBinding(app_shader_program_instanced_quantized, glGetUniformBlockIndex(app_shader_program_instanced_quantized, "ViewBuffer"), 1);
+
+	// Pooled models, every draw record (world matrix and texture layer) in the storage buffer at binding 0
+	std::string indirect_defines = std::string(shader_defines) + "#define INDIRECT\n";
+	app_shader_program_indirect = gl_create_program(defaultShaders.vertexShader, defaultShaders.fragmentShader, indirect_defines.c_str());
+	glUniformBlockBinding(app_shader_program_indirect, glGetUniformBlockIndex(app_shader_program_indirect, "ViewBuffer"), 1);
+	indirect_defines += "#define QUANTIZED\n";
+	app_shader_program_indirect_quantized = gl_create_program(defaultShaders.vertexShader, defaultShaders.fragmentShader, indirect_defines.c_str());
+	glUniformBlockBinding(app_shader_program_indirect_quantized, glGetUniformBlockIndex(app_shader_program_indirect_quantized, "ViewBuffer"), 1);
+
+	// Ring buffer for per draw transform data, each draw binds its own slice at binding point 0
+	gl_ring_create(app_uniform_ring, 1024 * 1024, gl_ring_alignment());
+
+	// Compute shaders that cull pooled meshes and build the Hi-Z pyramid they test against
+	gpu_cull_init();
 
 	// The binding point 0 matches layout(binding = 0) in the shader if used,
 	// or you can use glGetUniformBlockIndex/glUniformBlockBinding to link them.
 	GLuint blockIndex = glGetUniformBlockIndex(app_shader_program, "TransformBuffer");
 	glUniformBlockBinding(app_shader_program, blockIndex, 0);
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, app_uniform_buffer);
+	glUniformBlockBinding(app_shader_program_quantized, glGetUniformBlockIndex(app_shader_program_quantized, "TransformBuffer"), 0);
 
 	// Skybox/Cubemap setup
 	Shaders skyboxShaders("Shaders/cubemap.vert", "Shaders/cubemap.frag");
-	skyboxShaderProgram = gl_create_program(skyboxShaders.vertexShader, skyboxShaders.fragmentShader);
+	skyboxShaderProgram = gl_create_program(skyboxShaders.vertexShader, skyboxShaders.fragmentShader, shader_defines);
 
 	// Create skybox VAO/VBO/EBO
 	glGenVertexArrays(1, &skyboxVAO);
@@ -716,27 +1017,78 @@ void app_init() {
 	cubemapTexture = loadCubemap(faces);
 
 	glBindVertexArray(0);
+
+	// Load the controller model once, app_draw runs several times per frame
+	app_controller_model = asset_load_model("Resources/VRController.obj", "Resources/htc_vive_controller.jpeg"); // replace with own controller function (setController())
+
+	// Each hand is a node that follows the controller, and the controller model hangs off it at a small scale
+	Transform identity = { glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f) };
+	Transform controller = { glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.05f) };
+	for (uint32_t i = 0; i < 2; i++) {
+		app_hand_nodes[i] = hierarchy_add(app_hierarchy, identity);
+		app_scene.setParent(app_scene.add(app_controller_model, controller), app_hand_nodes[i]);
+	}
 }
 
-void app_draw(XrCompositionLayerProjectionView& view) {
-	// Compute view and projection matrices
-	glm::mat4 mat_projection = gl_xr_projection(view.fov, 0.05f, 100.0f);
-	glm::quat orientation(view.pose.orientation.w, view.pose.orientation.x, view.pose.orientation.y, view.pose.orientation.z);
-	glm::vec3 position(view.pose.position.x, view.pose.position.y, view.pose.position.z);
+void app_draw(XrCompositionLayerProjectionView* views, uint32_t view_count) {
+	// Compute view and projection matrices, for every view we draw at once (both eyes with multiview)
+	glm::mat4 mat_projection[2];
+	glm::mat4 mat_view_skybox[2];
+	glm::vec3 eye_position(0.0f);
+	glm::vec3 eye_forward(0.0f);
+	app_view.view_count = view_count;
+	for (uint32_t i = 0; i < view_count; i++) {
+		XrCompositionLayerProjectionView& view = views[i];
+		mat_projection[i] = gl_xr_projection(view.fov, 0.05f, 100.0f);
+		glm::quat orientation(view.pose.orientation.w, view.pose.orientation.x, view.pose.orientation.y, view.pose.orientation.z);
+		glm::vec3 position(view.pose.position.x, view.pose.position.y, view.pose.position.z);
+
+		glm::mat4 mat_view = glm::inverse(glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(orientation));
+
+		// Remove translation from view matrix for skybox
+		mat_view_skybox[i] = glm::mat4(glm::mat3(mat_view));
 
-	glm::mat4 mat_view = glm::inverse(glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(orientation));
+		app_view.viewproj[i] = mat_projection[i] * mat_view;
+
+		// The render queue sorts from between the eyes when there's more than one
+		eye_position += position / (float)view_count;
+		eye_forward += orientation * glm::vec3(0.0f, 0.0f, -1.0f);
+	}
+	render_queue_begin(app_render_queue, eye_position, glm::normalize(eye_forward));
+
+	// Cull with one frustum around both eyes, even when this call only draws one of them
+	frustum_t frustum = cull_frustum_stereo(xr_views.data(), (uint32_t)xr_views.size(), 0.05f, 100.0f);
+	render_queue_set_frustum(app_render_queue, frustum);
+
+	// LODs are picked from between the eyes too, so an object never shows a different level in each eye
+	app_view.lod_position = glm::vec3(0.0f);
+	app_view.lod_scale = 0.0f;
+	for (const XrView& view : xr_views) {
+		app_view.lod_position += glm::vec3(view.pose.position.x, view.pose.position.y, view.pose.position.z) / (float)xr_views.size();
+		app_view.lod_scale = glm::max(app_view.lod_scale, 1.0f / (tanf(view.fov.angleUp) - tanf(view.fov.angleDown)));
+	}
+	app_view.pixel_height = (uint32_t)views[0].subImage.imageRect.extent.height;
+
+	// The occlusion buffer is drawn once per frame from between the eyes, and tests account for how far
+	// each eye can see around an occluder from there
+	if (app_config_occlusion && !app_occlusion.ready) {
+		float eye_offset = 0.0f;
+		if (xr_views.size() > 1) {
+			const XrVector3f& a = xr_views[0].pose.position;
+			const XrVector3f& b = xr_views[1].pose.position;
+			eye_offset = glm::distance(glm::vec3(a.x, a.y, a.z), glm::vec3(b.x, b.y, b.z)) * 0.5f;
+		}
+		occlusion_begin(app_occlusion, cull_stereo_viewproj(xr_views.data(), (uint32_t)xr_views.size(), 0.05f, 100.0f), eye_offset);
+	}
 
 	// Draw SKYBOX
 	glDepthFunc(GL_LEQUAL); // Ensure skybox passes depth test
 	glUseProgram(skyboxShaderProgram);
 
-	// Remove translation from view matrix for skybox
-	glm::mat4 mat_view_skybox = glm::mat4(glm::mat3(mat_view));
-
 	GLuint uProjLoc = glGetUniformLocation(skyboxShaderProgram, "uProjection");
 	GLuint uViewLoc = glGetUniformLocation(skyboxShaderProgram, "uView");
-	glUniformMatrix4fv(uProjLoc, 1, GL_FALSE, &mat_projection[0][0]);
-	glUniformMatrix4fv(uViewLoc, 1, GL_FALSE, &mat_view_skybox[0][0]);
+	glUniformMatrix4fv(uProjLoc, view_count, GL_FALSE, &mat_projection[0][0][0]);
+	glUniformMatrix4fv(uViewLoc, view_count, GL_FALSE, &mat_view_skybox[0][0][0]);
 	glBindVertexArray(skyboxVAO);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
@@ -746,45 +1098,46 @@ void app_draw(XrCompositionLayerProjectionView& view) {
 
 	glDepthFunc(GL_LESS); // Reset to default depth func
 
-	// Update the uniform buffer with viewproj and world
-	// We'll draw each cube individually, updating the world matrix each time.
-
-	transform_buffer.viewproj = mat_projection * mat_view;
-	
-	glBindBuffer(GL_UNIFORM_BUFFER, app_uniform_buffer);
-
-	glBindVertexArray(app_vao);
-
-	Model controllerModel; // Controller Model - Default are Vive Controllers
-	controllerModel.loadModel("Resources/VRController.obj", "Resources/htc_vive_controller.jpeg"); // replace with own controller function (setController())
-
-	// for each of the two controllers
-	for (size_t i = 0; i < 2; i++) {
-		glm::quat controller_orientation(app_controllers[i].orientation.w, app_controllers[i].orientation.x,
-			app_controllers[i].orientation.y, app_controllers[i].orientation.z);
-		glm::vec3 controller_pos(app_controllers[i].position.x, app_controllers[i].position.y, app_controllers[i].position.z);
-
-		glm::mat4 mat_model = glm::translate(glm::mat4(1.0f), controller_pos) * glm::mat4_cast(controller_orientation) * glm::scale(glm::mat4(1.0f), glm::vec3(0.05f));
-		transform_buffer.world = mat_model;
-
-		controllerModel.drawModel(mat4ToTransform(mat_model)); // draw the controller model at the controller's location and orientation
+	// Models are recorded by drawModel() once per frame, on the first view drawn, and every view replays
+	// that list into its own queue, which sorts and submits it all together
+	if (!app_frame_draws.recorded) {
+		// Set a default transform
+		defaultTransform = mat4ToTransform(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(1.0f)));
+
+		// Render models in the game logic, then everything the game added to the scene, controllers included,
+		// once the hierarchy has carried this frame's hand poses down to whatever hangs off them
+		game.render();
+		hierarchy_update(app_hierarchy);
+		app_scene.update();
+		app_scene.draw(app_frame_draws);
+		app_frame_draws.recorded = true;
 	}
-	
-	glUseProgram(app_shader_program);
+	draw_list_replay(app_frame_draws, app_render_queue);
 
-	// Set a default transform
-	defaultTransform = mat4ToTransform(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(1.0f)));
+	// Level geometry registered with static_scene_add, culled through its BVH
+	static_scene_draw(app_static_scene, app_render_queue, frustum);
 
-	// Render models in the game logic
-	game.render();
-
-	glBindVertexArray(0);
-	glUseProgram(0);
+	// Sort and submit everything that was queued for this view
+	render_queue_flush(app_render_queue);
 }
 
 ///////////////////////////////////////////
 
 void app_update() {
+	// Pick up a finished BVH build, or refit it if static objects moved last frame
+	static_scene_update(app_static_scene);
+
+	// Finish texture decodes and stream mip levels in or out, from what was on screen last frame
+	stream_update();
+
+	// Issue this frame's share of staged buffer and texture uploads
+	upload_update();
+
+	// What each controller points at, for the game to use this frame
+	for (uint32_t i = 0; i < 2; i++) {
+		app_hand_hits[i] = xr_input.renderHand[i] ? static_scene_raycast_pose(app_static_scene, xr_input.handPose[i], 100.0f) : static_hit_t{};
+	}
+
 	// run update logic for the game class
 	game.update();
 }
@@ -808,6 +1161,11 @@ void app_update_predicted() {
 		app_controllers.resize(2, xr_pose_identity);
 	for (uint32_t i = 0; i < 2; i++) {
 		app_controllers[i] = xr_input.renderHand[i] ? xr_input.handPose[i] : xr_pose_identity;
+		const XrPosef& pose = app_controllers[i];
+		hierarchy_set_local(app_hierarchy, app_hand_nodes[i], {
+			glm::vec3(pose.position.x, pose.position.y, pose.position.z),
+			glm::quat(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z),
+			glm::vec3(1.0f) });
 	}
 }
 
@@ -842,20 +1200,40 @@ GLuint loadCubemap(std::vector<std::string> faces)
 
 	stbi_set_flip_vertically_on_load(false); // Typically not flipping for cube maps
 	int width, height, nrChannels;
-	for (GLuint i = 0; i < faces.size(); i++)
+
+	// A cube is only complete when its faces agree on format and size, so the baked faces are used when all
+	// six are there and match the first one, otherwise every face is decoded from its source image
+	std::vector<ktx_texture_t> baked(faces.size());
+	bool useBaked = app_config_prefer_ktx2;
+	for (size_t i = 0; useBaked && i < faces.size(); i++)
 	{
-		unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-		if (data)
-		{
-			// JPG = GL_RGB and PNG = GL_RGBA
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-				0, GL_SRGB_ALPHA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			stbi_image_free(data);
-		}
-		else
+		useBaked = ktx_read(ktx_sibling_path(faces[i]).c_str(), baked[i]) && !baked[i].levels.empty() &&
+			baked[i].format == baked[0].format && baked[i].levels.size() == baked[0].levels.size() &&
+			baked[i].levels[0].width == baked[0].levels[0].width && baked[i].levels[0].height == baked[0].levels[0].height;
+	}
+	if (useBaked)
+	{
+		// Baked faces skip decoding, the sky is sRGB either way
+		for (GLuint i = 0; i < faces.size(); i++)
+			ktx_upload(baked[i], GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, true);
+	}
+	else
+	{
+		for (GLuint i = 0; i < faces.size(); i++)
 		{
-			MessageBox(nullptr, _T("Cubemap texture failed to load"), _T("Error"), MB_OK);
-			stbi_image_free(data);
+			unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+			if (data)
+			{
+				// JPG = GL_RGB and PNG = GL_RGBA
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+					0, GL_SRGB_ALPHA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+				stbi_image_free(data);
+			}
+			else
+			{
+				MessageBox(nullptr, _T("Cubemap texture failed to load"), _T("Error"), MB_OK);
+				stbi_image_free(data);
+			}
 		}
 	}
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
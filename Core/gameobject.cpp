@@ -1,4 +1,7 @@
 #include <gameobject.h>
+#include <assets.h>
+#include <renderqueue.h>
+#include <staticbatch.h>
 
 void Model::loadModel(const std::string& objPath, const std::string& texturePath = "") {
 	Assimp::Importer importer;
@@ -28,73 +31,253 @@ void Model::loadModel(const std::string& objPath, const std::string& texturePath
 			});
 	}
 
-	// Extract indices
+	// Extract indices, triangles only (Triangulate leaves point and line primitives alone)
 	for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
 		aiFace face = mesh->mFaces[i];
-		for (unsigned int j = 0; j < face.mNumIndices; ++j) {
-			indices.push_back(face.mIndices[j]);
-		}
+		if (face.mNumIndices != 3)
+			continue;
+		indices.insert(indices.end(), face.mIndices, face.mIndices + 3);
 	}
 
-	// Load texture if provided
-	GLuint textureID = !texturePath.empty() ? loadTexture(texturePath) : 0;
+	// Load texture if provided - shared through the asset cache so models using the same image reuse it
+	TextureHandle texture = !texturePath.empty() ? asset_load_texture(texturePath) : nullptr;
+	loadMesh(objPath, vertices, indices, texture);
+}
 
-	// Generate VAO, VBO, and EBO
-	GLuint vao, vbo, ebo;
-	glGenVertexArrays(1, &vao);
-	glGenBuffers(1, &vbo);
-	glGenBuffers(1, &ebo);
+void Model::loadMesh(const std::string& name, std::vector<float>& vertices, std::vector<uint32_t>& indices, TextureHandle texture) {
+	uint32_t sourceVertexCount = (uint32_t)(vertices.size() / vertex_float_stride);
+	Bounds bounds = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX), glm::vec3(0.0f), 0.0f };
+	for (uint32_t i = 0; i < sourceVertexCount; ++i) {
+		const float* v = &vertices[i * vertex_float_stride];
+		glm::vec3 pos(v[0], v[1], v[2]);
+		bounds.min = glm::min(bounds.min, pos);
+		bounds.max = glm::max(bounds.max, pos);
+	}
 
-	// Bind VAO
-	glBindVertexArray(vao);
+	// Sphere around the box center, sized to the farthest vertex rather than the box corner so it stays tight
+	if (sourceVertexCount == 0)
+		bounds.min = bounds.max = glm::vec3(0.0f);
+	bounds.center = (bounds.min + bounds.max) * 0.5f;
+	for (uint32_t i = 0; i < sourceVertexCount; ++i) {
+		const float* v = &vertices[i * vertex_float_stride];
+		bounds.radius = glm::max(bounds.radius, glm::distance(bounds.center, glm::vec3(v[0], v[1], v[2])));
+	}
 
-	// Bind and fill VBO
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	// Merge the per face corner copies Assimp makes, before simplification so it sees the real topology
+	uint32_t vertexCount = sourceVertexCount;
+	mesh_cache_stats_t statsBefore = mesh_cache_stats(indices.data(), indices.size(), vertexCount);
+	if (app_config_optimize_meshes) {
+		vertexCount = mesh_weld(vertices, vertex_float_stride, indices);
+	}
 
-	// Bind and fill EBO
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	// Simplified levels go after the full mesh in the same index buffer, they all share the vertices
+	std::vector<uint32_t> lodIndices;
+	std::vector<lod_range_t> lods;
+	lod_build(vertices.data(), vertex_float_stride, vertexCount, indices, bounds.radius, lodIndices, lods);
+
+	// Every level gets its own triangle order, then the vertices are renumbered for the whole buffer
+	if (app_config_optimize_meshes) {
+		uint32_t clusters = 0;
+		for (const lod_range_t& lod : lods) {
+			mesh_optimize_vertex_cache(&lodIndices[lod.first_index], lod.index_count, vertexCount);
+			clusters += mesh_optimize_overdraw(&lodIndices[lod.first_index], lod.index_count, vertices.data(), vertex_float_stride);
+		}
+		mesh_optimize_vertex_fetch(vertices, vertex_float_stride, lodIndices);
+
+		mesh_cache_stats_t statsAfter = mesh_cache_stats(lodIndices.data(), lods[0].index_count, vertexCount);
+		uint32_t triangles = lods[0].index_count / 3;
+		app_mesh_optimize_stats.meshes++;
+		app_mesh_optimize_stats.triangles          += triangles;
+		app_mesh_optimize_stats.vertices_before    += sourceVertexCount;
+		app_mesh_optimize_stats.vertices_after     += vertexCount;
+		app_mesh_optimize_stats.transformed_before += (uint64_t)((double)statsBefore.acmr * triangles + 0.5);
+		app_mesh_optimize_stats.transformed_after  += (uint64_t)((double)statsAfter.acmr * triangles + 0.5);
+		app_mesh_optimize_stats.clusters           += clusters;
+	}
 
-	// Configure vertex attributes
-	glEnableVertexAttribArray(0); // Position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	// 16 bit indices whenever every vertex is reachable with them, halving the index buffer
+	GLenum indexType = vertexCount <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
-	glEnableVertexAttribArray(1); // Normal attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	GLuint textureID = texture ? texture->id : 0;
 
-	glEnableVertexAttribArray(2); // Texture coordinate attribute
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+	// Vertex data, half the size when quantized. It goes up through the staging ring, from a worker, and
+	// the model isn't drawn until it has landed.
+	bool quantized = app_config_quantize_vertices && vertex_can_quantize(vertices.data(), vertexCount);
+	auto vertexData = std::make_shared<std::vector<uint8_t>>();
+	if (quantized) {
+		std::vector<vertex_quantized_t> packed;
+		vertex_quantize(vertices.data(), vertexCount, bounds.min, bounds.max, packed);
+		vertexData->assign((const uint8_t*)packed.data(), (const uint8_t*)(packed.data() + packed.size()));
+	}
+	else {
+		vertexData->assign((const uint8_t*)vertices.data(), (const uint8_t*)(vertices.data() + vertices.size()));
+	}
 
-	// Unbind VAO (optional, to avoid accidental changes)
-	glBindVertexArray(0);
+	// Pooled meshes share their layout's buffers and VAO, so they can be drawn together. Multi draw takes
+	// one index type, so they always use 32 bit indices.
+	mesh_pool_alloc_t pool = {};
+	bool pooled = app_config_mesh_pool && mesh_pool_alloc(quantized ? MESH_POOL_QUANTIZED : MESH_POOL_FLOAT, vertexCount, (uint32_t)lodIndices.size(), pool);
+	if (pooled)
+		indexType = GL_UNSIGNED_INT;
+
+	auto indexData = std::make_shared<std::vector<uint8_t>>();
+	if (indexType == GL_UNSIGNED_SHORT) {
+		std::vector<uint16_t> shortIndices(lodIndices.begin(), lodIndices.end());
+		indexData->assign((const uint8_t*)shortIndices.data(), (const uint8_t*)(shortIndices.data() + shortIndices.size()));
+	}
+	else {
+		indexData->assign((const uint8_t*)lodIndices.data(), (const uint8_t*)(lodIndices.data() + lodIndices.size()));
+	}
+	size_t vertexBytes = vertexData->size();
+	size_t indexBytes = indexData->size();
+
+	GLuint vao = 0, vbo = 0, ebo = 0;
+	GLuint vertexTarget, indexTarget;
+	size_t vertexOffset = 0, indexOffset = 0;
+	if (pooled) {
+		const mesh_pool_t& target = app_mesh_pools.pools[pool.format];
+		vao = target.vao;
+		vertexTarget = target.vbo;
+		indexTarget = target.ebo;
+		vertexOffset = (size_t)pool.vertices.first * target.vertex_stride;
+		indexOffset = (size_t)pool.indices.first * sizeof(uint32_t);
+	}
+	else {
+		// Generate VAO, VBO, and EBO
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vbo);
+		glGenBuffers(1, &ebo);
+
+		// Bind VAO, then size the VBO and EBO
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+
+		// Configure vertex attributes
+		if (quantized)
+			vertex_attributes_quantized();
+		else
+			vertex_attributes_float();
+
+		// Unbind VAO (optional, to avoid accidental changes)
+		glBindVertexArray(0);
+		vertexTarget = vbo;
+		indexTarget = ebo;
+	}
+
+	job_handle_t upload = std::make_shared<job_counter_t>();
+	upload->pending = 0;
+	jobs_submit([vertexTarget, vertexOffset, indexTarget, indexOffset, vertexData, indexData, upload]() {
+		upload_buffer(vertexTarget, vertexOffset, vertexData->data(), vertexData->size(), upload);
+		upload_buffer(indexTarget, indexOffset, indexData->data(), indexData->size(), upload);
+	}, upload);
 
 	// Store the model data in the Model object instance that called this function
-	*this = { vao, vbo, ebo, indices.size(), textureID };
+	size_t bufferBytes = vertexBytes + indexBytes;
+	*this = { vao, vbo, ebo, indices.size(), textureID, texture, bufferBytes, bounds, quantized, indexType };
+	this->lods = lods;
+	this->upload = upload;
+	this->pooled = pooled;
+	this->pool = pool;
+
+	// Simple enough meshes double as their own occluder, using the coarsest level that fits the budget.
+	// Anything heavier needs loadOccluder().
+	const lod_range_t& coarsest = lods.back();
+	if (coarsest.index_count / 3 <= app_config_occluder_triangles) {
+		for (uint32_t i = 0; i < vertexCount; ++i) {
+			occluderVertices.push_back(glm::vec3(vertices[i * vertex_float_stride], vertices[i * vertex_float_stride + 1], vertices[i * vertex_float_stride + 2]));
+		}
+		occluderIndices.assign(lodIndices.begin() + coarsest.first_index, lodIndices.begin() + coarsest.first_index + coarsest.index_count);
+	}
+}
+
+void Model::loadOccluder(const std::string& objPath) {
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(objPath, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
+
+	if (!scene || !scene->HasMeshes()) {
+		printf("Failed to load occluder %s\n", objPath.c_str());
+		return;
+	}
+
+	aiMesh* mesh = scene->mMeshes[0];
+	occluderVertices.clear();
+	occluderIndices.clear();
+	for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
+		occluderVertices.push_back(glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z));
+	}
+	for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+		if (mesh->mFaces[i].mNumIndices != 3)
+			continue;
+		occluderIndices.insert(occluderIndices.end(), mesh->mFaces[i].mIndices, mesh->mFaces[i].mIndices + 3);
+	}
 }
 
 
 GLuint Model::loadTexture(const std::string& path) {
-	GLuint textureID;
-	glGenTextures(1, &textureID);
+	// Uncached load, the caller owns the returned texture
+	return loadTextureFile(path).id;
+}
+
+Texture loadTextureFile(const std::string& path) {
+	Texture texture = { 0, "texture_diffuse", path, 0, 0, 0 };
+	glGenTextures(1, &texture.id);
+
+	// A baked sibling already has its mips compressed, upload it as is
+	ktx_texture_t baked;
+	if (app_config_prefer_ktx2 && ktx_read(ktx_sibling_path(path).c_str(), baked)) {
+		glBindTexture(GL_TEXTURE_2D, texture.id);
+		size_t bytes = ktx_upload(baked, GL_TEXTURE_2D, false);
+		if (bytes > 0) {
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)baked.levels.size() - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			texture.width = baked.levels[0].width;
+			texture.height = baked.levels[0].height;
+			texture.bytes = bytes;
+			return texture;
+		}
+	}
 
 	int width, height, nrChannels;
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
+	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, app_config_cpu_mips ? 4 : 0);
 
 	if (data) {
 		GLenum format = (nrChannels == 3) ? GL_RGB : GL_RGBA;
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		GLenum internal_format = (nrChannels == 3) ? GL_RGB8 : GL_RGBA8; // Sized, so it can be copied into a texture page
+		glBindTexture(GL_TEXTURE_2D, texture.id);
+		if (app_config_cpu_mips) {
+			// Filtered on the worker threads in linear light, sharper than glGenerateMipmap's box and without its shimmer
+			texture_image_t image = { (uint32_t)width, (uint32_t)height };
+			image.pixels.assign(data, data + (size_t)width * height * 4);
+			std::vector<texture_image_t> levels;
+			texture_build_mips(image, true, levels);
+			for (size_t i = 0; i < levels.size(); i++) {
+				glTexImage2D(GL_TEXTURE_2D, (GLint)i, internal_format, levels[i].width, levels[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[i].pixels.data());
+			}
+		} else {
+			glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// Drivers pad RGB to 4 bytes per texel, and the mip chain adds roughly a third
+		texture.width = width;
+		texture.height = height;
+		texture.bytes = (size_t)width * height * 4 * 4 / 3;
 	}
 
 	stbi_image_free(data);
-	return textureID;
+	return texture;
 }
 
 glm::mat4 transformToMat4(const Transform& transform) {
@@ -129,70 +312,108 @@ Transform mat4ToTransform(const glm::mat4& mat) {
 	return transform;
 }
 
-void Model::drawModel(const Transform modelTransform) {
-
-	Model model = *this;
-	glUseProgram(app_shader_program);
-
-	// Convert Transform to a matrix
-	glm::mat4 modelMatrix = transformToMat4(modelTransform);
-
-	// Update transformation matrices
-	app_transform_buffer_t modelTransformBuffer;
-	modelTransformBuffer.viewproj = transform_buffer.viewproj;
-	modelTransformBuffer.world = modelMatrix;
-
-	glBindBuffer(GL_UNIFORM_BUFFER, app_uniform_buffer);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(app_transform_buffer_t), &modelTransformBuffer);
-
-	// Bind the model's texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, model.textureID);
-	glUniform1i(glGetUniformLocation(app_shader_program, "texture_diffuse"), 0);
+// Picks from the bounding sphere's projected size, see lod_select()
+const lod_range_t& Model::selectLod(const glm::mat4& world) const {
+	if (lods.size() < 2)
+		return lods[0];
+	glm::vec3 center = glm::vec3(world * glm::vec4(bounds.center, 1.0f));
+	float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+	return lods[lod_select((uint32_t)lods.size(), center, bounds.radius * scale)];
+}
 
-	// Draw the model
-	glBindVertexArray(model.vao);
-	glDrawElements(GL_TRIANGLES, model.indexCount, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+draw_mesh_t Model::drawMesh(const lod_range_t& lod, bool instanced) const {
+	GLuint program = instanced ?
+		(quantized ? app_shader_program_instanced_quantized : app_shader_program_instanced) :
+		(quantized ? app_shader_program_quantized : app_shader_program);
+	draw_mesh_t mesh = { program, textureID, vao, (GLsizei)lod.index_count, lod.first_index, indexType, quantized, bounds.min, bounds.max - bounds.min };
+	if (!instanced)
+		mesh.instanced_program = quantized ? app_shader_program_instanced_quantized : app_shader_program_instanced;
+	if (pooled) {
+		// Any instancing goes through the draw records too, so both cases use the same program
+		mesh.program = quantized ? app_shader_program_indirect_quantized : app_shader_program_indirect;
+		mesh.first_index += pool.indices.first;
+		mesh.base_vertex = (GLint)pool.vertices.first;
+		mesh.pooled = true;
+	}
+	uint32_t page, layer;
+	if (texture && texture->paged) {
+		mesh.texture = texture_pages_array(*texture);
+		mesh.paged = true;
+		mesh.layer = texture->layer;
+	}
+	else if (texture && stream_texture_page(texture->id, page, layer)) {
+		mesh.texture = app_texture_pages.pages[page].array;
+		mesh.paged = true;
+		mesh.layer = layer;
+		mesh.streamed = texture->id;
+	}
+	return mesh;
+}
 
-	glUseProgram(0);
+void Model::drawModel(const Transform modelTransform) {
+	// Record the draw, app_draw replays the frame's list into each view's queue once the game is done rendering
+	if (!uploaded())
+		return;
+	glm::mat4 world = transformToMat4(modelTransform);
+	draw_list_push(app_frame_draws, drawMesh(selectLod(world), false), world, bounds);
 }
 
 void Model::drawModel() {
+	drawModel(defaultTransform);
+}
 
-	const Transform modelTransform = defaultTransform;
-	Model model = *this;
-
-	glUseProgram(app_shader_program);
+void Model::drawInstanced(const Transform* transforms, size_t count) {
+	if (count == 0 || !uploaded())
+		return;
 
-	// Convert Transform to a matrix
-	glm::mat4 modelMatrix = transformToMat4(modelTransform);
+	// World matrices get packed into an instance buffer, and all copies go out in one glDrawElementsInstanced
+	if (lods.size() < 2) {
+		draw_list_push_instanced(app_frame_draws, drawMesh(lods[0], true), transforms, count, bounds);
+		return;
+	}
 
-	// Update transformation matrices
-	app_transform_buffer_t modelTransformBuffer;
-	modelTransformBuffer.viewproj = transform_buffer.viewproj;
-	modelTransformBuffer.world = modelMatrix;
+	// Instances at different levels can't share a draw, so split into one batch per level
+	std::vector<Transform> batches[lod_max_levels];
+	for (size_t i = 0; i < count; i++) {
+		const lod_range_t& lod = selectLod(transformToMat4(transforms[i]));
+		batches[&lod - lods.data()].push_back(transforms[i]);
+	}
+	for (size_t level = 0; level < lods.size(); level++) {
+		if (batches[level].empty())
+			continue;
+		draw_list_push_instanced(app_frame_draws, drawMesh(lods[level], true), batches[level].data(), batches[level].size(), bounds);
+	}
+}
 
-	glBindBuffer(GL_UNIFORM_BUFFER, app_uniform_buffer);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(app_transform_buffer_t), &modelTransformBuffer);
+void Model::drawInstanced(const std::vector<Transform>& transforms) {
+	drawInstanced(transforms.data(), transforms.size());
+}
 
-	// Bind the model's texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, model.textureID);
-	glUniform1i(glGetUniformLocation(app_shader_program, "texture_diffuse"), 0);
 
-	// Draw the model
-	glBindVertexArray(model.vao);
-	glDrawElements(GL_TRIANGLES, model.indexCount, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+void Model::markStatic(const Transform& transform) {
+	static_batch_add(app_static_batch, *this, transform);
+}
 
-	glUseProgram(0);
+void Model::markStatic() {
+	markStatic(defaultTransform);
 }
 
 
 void Model::cleanupModel() {
+	upload_wait(upload); // Copies into these buffers may still be staged
+	upload = nullptr;
 	Model model = *this;
-	glDeleteBuffers(1, &model.vbo);
-	glDeleteBuffers(1, &model.ebo);
-	glDeleteVertexArrays(1, &model.vao);
+	if (pooled) {
+		mesh_pool_free(pool);
+		pooled = false;
+	}
+	else {
+		glDeleteBuffers(1, &model.vbo);
+		glDeleteBuffers(1, &model.ebo);
+		glDeleteVertexArrays(1, &model.vao);
+	}
+	texture = nullptr; // drop our reference, the asset cache decides when the texture itself goes
+	occluderVertices.clear();
+	occluderIndices.clear();
+	lods.clear();
 }
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include <gpuculling.h>
+
+void gpu_cull_init() {
+	std::string cull_source = get_file_contents("Shaders/cull.comp");
+	std::string pyramid_source = get_file_contents("Shaders/hiz.comp");
+	app_gpu_cull.cull_program = gl_create_compute_program(cull_source.c_str());
+	app_gpu_cull.pyramid_program = gl_create_compute_program(pyramid_source.c_str());
+
+	glGenBuffers(1, &app_gpu_cull.commands);
+	glGenBuffers(1, &app_gpu_cull.records);
+	glGenBuffers(1, &app_gpu_cull.results);
+	glGenFramebuffers(1, &app_gpu_cull.depth_fbo);
+}
+
+void gpu_cull_shutdown() {
+	glDeleteProgram(app_gpu_cull.cull_program);
+	glDeleteProgram(app_gpu_cull.pyramid_program);
+	glDeleteBuffers(1, &app_gpu_cull.commands);
+	glDeleteBuffers(1, &app_gpu_cull.records);
+	glDeleteBuffers(1, &app_gpu_cull.results);
+	glDeleteFramebuffers(1, &app_gpu_cull.depth_fbo);
+	glDeleteTextures(1, &app_gpu_cull.depth);
+	glDeleteTextures(1, &app_gpu_cull.pyramid);
+	app_gpu_cull = {};
+}
+
+///////////////////////////////////////////
+
+// Respecified rather than resized, nothing in them outlives a frame
+void gpu_cull_reserve(GLuint buffer, size_t& capacity, size_t bytes) {
+	if (bytes <= capacity)
+		return;
+	capacity = glm::max(bytes, capacity * 2);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_DYNAMIC_COPY);
+}
+
+void gpu_cull_resize(int32_t width, int32_t height) {
+	glDeleteTextures(1, &app_gpu_cull.depth);
+	glDeleteTextures(1, &app_gpu_cull.pyramid);
+	app_gpu_cull.width = width;
+	app_gpu_cull.height = height;
+	app_gpu_cull.valid[0] = app_gpu_cull.valid[1] = false;
+
+	glGenTextures(1, &app_gpu_cull.depth);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, app_gpu_cull.depth);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, width, height, 2);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	uint32_t pyramid_width = glm::max(width / 2, 1), pyramid_height = glm::max(height / 2, 1);
+	app_gpu_cull.levels = 1;
+	while (glm::max(pyramid_width, pyramid_height) >> app_gpu_cull.levels) {
+		app_gpu_cull.levels++;
+	}
+	glGenTextures(1, &app_gpu_cull.pyramid);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, app_gpu_cull.pyramid);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, app_gpu_cull.levels, GL_R32F, pyramid_width, pyramid_height, 2);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Copy the eye's depth out with a blit, since the swapchain's depth is a renderbuffer outside of multiview,
+// then reduce it level by level. Costs a few dispatches per eye, nothing comes back to the CPU.
+void gpu_cull_capture(GLuint read_fbo, uint32_t eye, int32_t width, int32_t height, const glm::mat4& viewproj) {
+	if (!app_config_gpu_culling || !app_config_gpu_cull_occlusion || app_gpu_cull.pyramid_program == 0 || eye > 1 || width <= 0 || height <= 0)
+		return;
+	if (width != app_gpu_cull.width || height != app_gpu_cull.height)
+		gpu_cull_resize(width, height);
+
+	GLint draw_fbo = 0, previous_read_fbo = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_fbo);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_read_fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, app_gpu_cull.depth_fbo);
+	glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, app_gpu_cull.depth, 0, eye);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, read_fbo);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_fbo);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previous_read_fbo);
+
+	GLuint program = app_gpu_cull.pyramid_program;
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "layer"), (GLint)eye);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, app_gpu_cull.depth);
+	glActiveTexture(GL_TEXTURE0);
+
+	int32_t source_width = width, source_height = height;
+	for (uint32_t level = 0; level < app_gpu_cull.levels; level++) {
+		// The first level doesn't read the image, but the unit still needs something bound
+		glBindImageTexture(0, app_gpu_cull.pyramid, level == 0 ? 0 : level - 1, GL_FALSE, eye, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, app_gpu_cull.pyramid, level, GL_FALSE, eye, GL_WRITE_ONLY, GL_R32F);
+		glUniform1i(glGetUniformLocation(program, "source_level"), (GLint)level - 1);
+		glUniform2i(glGetUniformLocation(program, "source_size"), source_width, source_height);
+
+		int32_t dest_width = glm::max(source_width / 2, 1), dest_height = glm::max(source_height / 2, 1);
+		glDispatchCompute((dest_width + 7) / 8, (dest_height + 7) / 8, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+		source_width = dest_width;
+		source_height = dest_height;
+	}
+	glUseProgram(0);
+
+	app_gpu_cull.viewproj[eye] = viewproj;
+	app_gpu_cull.valid[eye] = true;
+}
+
+///////////////////////////////////////////
+
+void gpu_cull_dispatch(const frustum_t* frusta, uint32_t frustum_count, GLuint ring, size_t objects_offset, uint32_t object_count,
+                       size_t records_offset, size_t records_bytes, size_t commands_offset, size_t commands_bytes) {
+	app_gpu_cull.stats = {};
+	if (object_count == 0)
+		return;
+
+	// Every candidate has a slot in the output, so the records are the same size going out as coming in
+	gpu_cull_reserve(app_gpu_cull.commands, app_gpu_cull.commands_bytes, commands_bytes);
+	gpu_cull_reserve(app_gpu_cull.records, app_gpu_cull.records_bytes, records_bytes);
+	gpu_cull_reserve(app_gpu_cull.results, app_gpu_cull.results_bytes, object_count * sizeof(uint32_t));
+
+	// Commands start with no instances, the shader counts them up
+	glBindBuffer(GL_COPY_READ_BUFFER, ring);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, app_gpu_cull.commands);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, commands_offset, 0, commands_bytes);
+
+	GLuint program = app_gpu_cull.cull_program;
+	glUseProgram(program);
+	glm::vec4 planes[12] = {};
+	frustum_count = glm::min(frustum_count, 2u);
+	for (uint32_t v = 0; v < frustum_count; v++) {
+		memcpy(&planes[v * 6], frusta[v].planes, sizeof(frusta[v].planes));
+	}
+	uint32_t hiz_valid = 0;
+	if (app_config_gpu_cull_occlusion && app_gpu_cull.pyramid != 0)
+		hiz_valid = (app_gpu_cull.valid[0] ? 1 : 0) | (app_gpu_cull.valid[1] ? 2 : 0);
+	glUniform1ui(glGetUniformLocation(program, "object_count"), object_count);
+	glUniform1ui(glGetUniformLocation(program, "frustum_count"), frustum_count);
+	glUniform4fv(glGetUniformLocation(program, "planes"), 12, &planes[0].x);
+	glUniform1ui(glGetUniformLocation(program, "hiz_valid"), hiz_valid);
+	glUniformMatrix4fv(glGetUniformLocation(program, "hiz_viewproj"), 2, GL_FALSE, &app_gpu_cull.viewproj[0][0][0]);
+	glUniform2i(glGetUniformLocation(program, "hiz_depth_size"), app_gpu_cull.width, app_gpu_cull.height);
+	glUniform1i(glGetUniformLocation(program, "write_results"), app_config_gpu_cull_validate ? 1 : 0);
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, ring, objects_offset, object_count * sizeof(gpu_cull_object_t));
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, ring, records_offset, records_bytes);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, app_gpu_cull.commands, 0, commands_bytes);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 3, app_gpu_cull.records, 0, records_bytes);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 4, app_gpu_cull.results, 0, object_count * sizeof(uint32_t));
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, app_gpu_cull.pyramid);
+	glActiveTexture(GL_TEXTURE0);
+
+	glDispatchCompute((object_count + 63) / 64, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	glUseProgram(0);
+
+	app_gpu_cull.stats.objects = object_count;
+	app_gpu_cull.stats.dispatches = 1;
+}
+
+void gpu_cull_read_results(uint32_t object_count, std::vector<uint32_t>& out) {
+	out.resize(object_count);
+	if (object_count == 0)
+		return;
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, app_gpu_cull.results);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, object_count * sizeof(uint32_t), out.data());
+}
@@ -0,0 +1,264 @@
+#include <hierarchy.h>
+
+// Position of a live node, UINT32_MAX for a stale handle
+uint32_t hierarchy_position(const transform_hierarchy_t& hierarchy, hierarchy_node_t node) {
+	return hierarchy_valid(hierarchy, node) ? hierarchy.slots[node.index].position : UINT32_MAX;
+}
+
+void hierarchy_mark(transform_hierarchy_t& hierarchy, uint32_t position) {
+	if (!hierarchy.dirty[position]) {
+		hierarchy.dirty[position] = 1;
+		hierarchy.pending++;
+	}
+}
+
+hierarchy_node_t hierarchy_add(transform_hierarchy_t& hierarchy, const Transform& local, hierarchy_node_t parent) {
+	uint32_t parent_position = UINT32_MAX;
+	if (parent.index != UINT32_MAX) {
+		parent_position = hierarchy_position(hierarchy, parent);
+		if (parent_position == UINT32_MAX)
+			printf("Hierarchy: parent was removed, adding as a root\n");
+	}
+
+	uint32_t slot;
+	if (!hierarchy.free_slots.empty()) {
+		slot = hierarchy.free_slots.back();
+		hierarchy.free_slots.pop_back();
+	}
+	else {
+		slot = (uint32_t)hierarchy.slots.size();
+		hierarchy.slots.push_back({});
+	}
+
+	// Appending keeps every parent ahead of its children, only the grouping by depth may need restoring
+	uint32_t position = (uint32_t)hierarchy.parents.size();
+	uint32_t depth = parent_position == UINT32_MAX ? 0 : hierarchy.depths[parent_position] + 1;
+	if (position > 0 && depth < hierarchy.depths.back())
+		hierarchy.unsorted = true;
+	hierarchy.parents.push_back(parent_position);
+	hierarchy.depths.push_back(depth);
+	hierarchy.locals.push_back(local);
+	hierarchy.worlds.push_back(glm::mat4(1.0f));
+	hierarchy.versions.push_back(0);
+	hierarchy.dirty.push_back(0);
+	hierarchy.owners.push_back(slot);
+	hierarchy_mark(hierarchy, position);
+
+	hierarchy.slots[slot].position = position;
+	hierarchy.slots[slot].alive = true;
+	hierarchy.stats.nodes++;
+	return { slot, hierarchy.slots[slot].generation };
+}
+
+// Recompute every depth by walking up to the root, then stable sort by it. Only runs after a reparent,
+// from the next update or a remove that needs parents ahead of their children.
+void hierarchy_sort(transform_hierarchy_t& hierarchy) {
+	uint32_t count = (uint32_t)hierarchy.parents.size();
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t depth = 0;
+		for (uint32_t p = hierarchy.parents[i]; p != UINT32_MAX; p = hierarchy.parents[p]) {
+			depth++;
+		}
+		hierarchy.depths[i] = depth;
+	}
+
+	std::vector<uint32_t> order(count);
+	for (uint32_t i = 0; i < count; i++) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&hierarchy](uint32_t a, uint32_t b) { return hierarchy.depths[a] < hierarchy.depths[b]; });
+	std::vector<uint32_t> remap(count);
+	for (uint32_t i = 0; i < count; i++) {
+		remap[order[i]] = i;
+	}
+
+	transform_hierarchy_t sorted;
+	sorted.parents.resize(count);
+	sorted.depths.resize(count);
+	sorted.locals.resize(count);
+	sorted.worlds.resize(count);
+	sorted.versions.resize(count);
+	sorted.dirty.resize(count);
+	sorted.owners.resize(count);
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t from = order[i];
+		uint32_t parent = hierarchy.parents[from];
+		sorted.parents[i]  = parent == UINT32_MAX ? UINT32_MAX : remap[parent];
+		sorted.depths[i]   = hierarchy.depths[from];
+		sorted.locals[i]   = hierarchy.locals[from];
+		sorted.worlds[i]   = hierarchy.worlds[from];
+		sorted.versions[i] = hierarchy.versions[from];
+		sorted.dirty[i]    = hierarchy.dirty[from];
+		sorted.owners[i]   = hierarchy.owners[from];
+		hierarchy.slots[sorted.owners[i]].position = i;
+	}
+	hierarchy.parents  = std::move(sorted.parents);
+	hierarchy.depths   = std::move(sorted.depths);
+	hierarchy.locals   = std::move(sorted.locals);
+	hierarchy.worlds   = std::move(sorted.worlds);
+	hierarchy.versions = std::move(sorted.versions);
+	hierarchy.dirty    = std::move(sorted.dirty);
+	hierarchy.owners   = std::move(sorted.owners);
+	hierarchy.unsorted = false;
+}
+
+// Keep the positions for which keep[] is set, in order, and point parents and slots at where they moved.
+// The remap is built first, so it doesn't matter whether parents come before their children.
+void hierarchy_compact(transform_hierarchy_t& hierarchy, const std::vector<uint8_t>& keep) {
+	std::vector<uint32_t> remap(hierarchy.parents.size(), UINT32_MAX);
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < hierarchy.parents.size(); i++) {
+		if (keep[i])
+			remap[i] = count++;
+	}
+	count = 0;
+	for (uint32_t i = 0; i < hierarchy.parents.size(); i++) {
+		if (!keep[i])
+			continue;
+		uint32_t parent = hierarchy.parents[i];
+		hierarchy.parents[count]  = parent == UINT32_MAX ? UINT32_MAX : remap[parent];
+		hierarchy.depths[count]   = hierarchy.depths[i];
+		hierarchy.locals[count]   = hierarchy.locals[i];
+		hierarchy.worlds[count]   = hierarchy.worlds[i];
+		hierarchy.versions[count] = hierarchy.versions[i];
+		hierarchy.dirty[count]    = hierarchy.dirty[i];
+		hierarchy.owners[count]   = hierarchy.owners[i];
+		hierarchy.slots[hierarchy.owners[count]].position = count;
+		count++;
+	}
+	hierarchy.parents.resize(count);
+	hierarchy.depths.resize(count);
+	hierarchy.locals.resize(count);
+	hierarchy.worlds.resize(count);
+	hierarchy.versions.resize(count);
+	hierarchy.dirty.resize(count);
+	hierarchy.owners.resize(count);
+}
+
+void hierarchy_remove(transform_hierarchy_t& hierarchy, hierarchy_node_t node) {
+	if (!hierarchy_valid(hierarchy, node))
+		return;
+	if (hierarchy.unsorted)
+		hierarchy_sort(hierarchy);
+	uint32_t position = hierarchy.slots[node.index].position;
+
+	// Parents come first, so one pass from the node finds its whole subtree
+	std::vector<uint8_t> keep(hierarchy.parents.size(), 1);
+	keep[position] = 0;
+	for (uint32_t i = position + 1; i < hierarchy.parents.size(); i++) {
+		uint32_t parent = hierarchy.parents[i];
+		if (parent != UINT32_MAX && !keep[parent])
+			keep[i] = 0;
+	}
+	for (uint32_t i = 0; i < hierarchy.parents.size(); i++) {
+		if (keep[i])
+			continue;
+		hierarchy_slot_t& slot = hierarchy.slots[hierarchy.owners[i]];
+		slot.alive = false;
+		slot.generation++;
+		hierarchy.free_slots.push_back(hierarchy.owners[i]);
+		if (hierarchy.dirty[i])
+			hierarchy.pending--;
+		hierarchy.stats.nodes--;
+	}
+	hierarchy_compact(hierarchy, keep);
+}
+
+bool hierarchy_valid(const transform_hierarchy_t& hierarchy, hierarchy_node_t node) {
+	return node.index < hierarchy.slots.size() && hierarchy.slots[node.index].alive && hierarchy.slots[node.index].generation == node.generation;
+}
+
+void hierarchy_set_local(transform_hierarchy_t& hierarchy, hierarchy_node_t node, const Transform& local) {
+	uint32_t position = hierarchy_position(hierarchy, node);
+	if (position == UINT32_MAX) {
+		printf("Hierarchy: set_local on a node that was removed\n");
+		return;
+	}
+	hierarchy.locals[position] = local;
+	hierarchy_mark(hierarchy, position);
+}
+
+Transform hierarchy_get_local(const transform_hierarchy_t& hierarchy, hierarchy_node_t node) {
+	uint32_t position = hierarchy_position(hierarchy, node);
+	if (position == UINT32_MAX)
+		return { glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f) };
+	return hierarchy.locals[position];
+}
+
+void hierarchy_set_parent(transform_hierarchy_t& hierarchy, hierarchy_node_t node, hierarchy_node_t parent) {
+	uint32_t position = hierarchy_position(hierarchy, node);
+	uint32_t parent_position = hierarchy_position(hierarchy, parent);
+	if (position == UINT32_MAX || (parent.index != UINT32_MAX && parent_position == UINT32_MAX)) {
+		printf("Hierarchy: set_parent on a node that was removed\n");
+		return;
+	}
+	for (uint32_t p = parent_position; p != UINT32_MAX; p = hierarchy.parents[p]) {
+		if (p == position) {
+			printf("Hierarchy: a node can't be parented below itself\n");
+			return;
+		}
+	}
+	hierarchy.parents[position] = parent_position;
+	hierarchy_mark(hierarchy, position);
+	hierarchy.unsorted = true; // The parent may come after it now, and the depths below it are stale
+}
+
+const glm::mat4& hierarchy_world(const transform_hierarchy_t& hierarchy, hierarchy_node_t node) {
+	static const glm::mat4 identity(1.0f);
+	uint32_t position = hierarchy_position(hierarchy, node);
+	return position == UINT32_MAX ? identity : hierarchy.worlds[position];
+}
+
+uint32_t hierarchy_version(const transform_hierarchy_t& hierarchy, hierarchy_node_t node) {
+	uint32_t position = hierarchy_position(hierarchy, node);
+	return position == UINT32_MAX ? 0 : hierarchy.versions[position];
+}
+
+///////////////////////////////////////////
+
+void hierarchy_update(transform_hierarchy_t& hierarchy) {
+	hierarchy.stats.updated = 0;
+	if (hierarchy.unsorted)
+		hierarchy_sort(hierarchy);
+	if (hierarchy.pending == 0)
+		return;
+
+	// A parent rebuilt in this pass carries the new version, which is all its children need to know
+	hierarchy.version++;
+	for (uint32_t i = 0; i < hierarchy.parents.size(); i++) {
+		uint32_t parent = hierarchy.parents[i];
+		bool parent_moved = parent != UINT32_MAX && hierarchy.versions[parent] == hierarchy.version;
+		if (!hierarchy.dirty[i] && !parent_moved)
+			continue;
+		glm::mat4 local = transformToMat4(hierarchy.locals[i]);
+		hierarchy.worlds[i] = parent == UINT32_MAX ? local : hierarchy.worlds[parent] * local;
+		hierarchy.versions[i] = hierarchy.version;
+		hierarchy.dirty[i] = 0;
+		hierarchy.stats.updated++;
+	}
+	hierarchy.pending = 0;
+}
+
+// Slots are kept and their generations bumped, so handles from before the clear stay invalid
+// instead of matching the nodes added after it
+void hierarchy_clear(transform_hierarchy_t& hierarchy) {
+	hierarchy.parents .clear();
+	hierarchy.depths  .clear();
+	hierarchy.locals  .clear();
+	hierarchy.worlds  .clear();
+	hierarchy.versions.clear();
+	hierarchy.dirty   .clear();
+	hierarchy.owners  .clear();
+	hierarchy.free_slots.clear();
+	for (uint32_t i = (uint32_t)hierarchy.slots.size(); i-- > 0;) {
+		hierarchy_slot_t& slot = hierarchy.slots[i];
+		if (slot.alive) {
+			slot.alive = false;
+			slot.generation++;
+		}
+		hierarchy.free_slots.push_back(i);
+	}
+	hierarchy.pending  = 0;
+	hierarchy.unsorted = false;
+	hierarchy.stats    = {};
+}
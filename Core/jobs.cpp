@@ -0,0 +1,126 @@
+#include <jobs.h>
+
+void jobs_worker() {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(app_jobs.mutex);
+			app_jobs.wake.wait(lock, [] { return app_jobs.quit || !app_jobs.queue.empty(); });
+			if (app_jobs.quit && app_jobs.queue.empty())
+				return;
+			job = std::move(app_jobs.queue.front());
+			app_jobs.queue.pop_front();
+			app_jobs.running++;
+		}
+		job();
+		app_jobs.running--;
+	}
+}
+
+// Pop and run one queued job on the calling thread, returns false if there was nothing to do
+bool jobs_run_one() {
+	std::function<void()> job;
+	{
+		std::lock_guard<std::mutex> lock(app_jobs.mutex);
+		if (app_jobs.queue.empty())
+			return false;
+		job = std::move(app_jobs.queue.front());
+		app_jobs.queue.pop_front();
+		app_jobs.running++;
+	}
+	job();
+	app_jobs.running--;
+	return true;
+}
+
+///////////////////////////////////////////
+
+void jobs_init(uint32_t thread_count) {
+	if (!app_jobs.workers.empty())
+		return;
+
+	if (thread_count == 0) {
+		uint32_t cores = std::thread::hardware_concurrency();
+		thread_count = cores > 1 ? cores - 1 : 1;
+	}
+
+	app_jobs.quit = false;
+	for (uint32_t i = 0; i < thread_count; i++) {
+		app_jobs.workers.emplace_back(jobs_worker);
+	}
+}
+
+// Finishes whatever is still queued, then joins the workers
+void jobs_shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(app_jobs.mutex);
+		app_jobs.quit = true;
+	}
+	app_jobs.wake.notify_all();
+	for (std::thread& worker : app_jobs.workers) {
+		worker.join();
+	}
+	app_jobs.workers.clear();
+}
+
+job_handle_t jobs_submit(std::function<void()> job, job_handle_t handle) {
+	if (!handle) {
+		handle = std::make_shared<job_counter_t>();
+		handle->pending = 0;
+	}
+	handle->pending++;
+
+	// Without workers (jobs_init not called, or after shutdown) just run it here
+	if (app_jobs.workers.empty()) {
+		job();
+		handle->pending--;
+		return handle;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(app_jobs.mutex);
+		app_jobs.queue.emplace_back([job, handle]() {
+			job();
+			handle->pending--;
+		});
+	}
+	app_jobs.wake.notify_one();
+	return handle;
+}
+
+bool jobs_done(const job_handle_t& handle) {
+	return !handle || handle->pending == 0;
+}
+
+void jobs_wait(const job_handle_t& handle) {
+	while (!jobs_done(handle)) {
+		// Help out rather than block, the job we're waiting on may still be in the queue
+		if (!jobs_run_one())
+			std::this_thread::yield();
+	}
+}
+
+// Split [0, count) into batches and run them across the pool, the calling thread included. Returns once
+// every batch has finished.
+void jobs_parallel_for(uint32_t count, uint32_t batch, const std::function<void(uint32_t first, uint32_t last)>& job) {
+	if (count == 0)
+		return;
+	batch = batch > 0 ? batch : 1;
+
+	job_handle_t handle = nullptr;
+	for (uint32_t first = batch; first < count; first += batch) {
+		uint32_t last = std::min(first + batch, count);
+		handle = jobs_submit([&job, first, last]() { job(first, last); }, handle);
+	}
+	job(0, std::min(batch, count));
+	jobs_wait(handle);
+}
+
+uint32_t jobs_thread_count() {
+	return (uint32_t)app_jobs.workers.size() + 1;
+}
+
+bool jobs_idle() {
+	std::lock_guard<std::mutex> lock(app_jobs.mutex);
+	return app_jobs.queue.empty() && app_jobs.running == 0;
+}
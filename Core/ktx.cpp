@@ -0,0 +1,230 @@
+#include <ktx.h>
+
+std::string ktx_sibling_path(const std::string& path) {
+	size_t slash = path.find_last_of("/\\");
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return path + ".ktx2";
+	return path.substr(0, dot) + ".ktx2";
+}
+
+///////////////////////////////////////////
+
+uint32_t ktx_vk_format(texture_format_t format, bool srgb) {
+	switch (format) {
+	case TEXTURE_FORMAT_BC1: return srgb ? KTX_VK_FORMAT_BC1_RGB_SRGB : KTX_VK_FORMAT_BC1_RGB_UNORM;
+	case TEXTURE_FORMAT_BC3: return srgb ? KTX_VK_FORMAT_BC3_SRGB     : KTX_VK_FORMAT_BC3_UNORM;
+	case TEXTURE_FORMAT_BC7: return srgb ? KTX_VK_FORMAT_BC7_SRGB     : KTX_VK_FORMAT_BC7_UNORM;
+	default:                 return 0;
+	}
+}
+
+bool ktx_from_vk_format(uint32_t vk_format, texture_format_t& out_format, bool& out_srgb) {
+	switch (vk_format) {
+	case KTX_VK_FORMAT_BC1_RGB_UNORM: out_format = TEXTURE_FORMAT_BC1; out_srgb = false; return true;
+	case KTX_VK_FORMAT_BC1_RGB_SRGB:  out_format = TEXTURE_FORMAT_BC1; out_srgb = true;  return true;
+	case KTX_VK_FORMAT_BC3_UNORM:     out_format = TEXTURE_FORMAT_BC3; out_srgb = false; return true;
+	case KTX_VK_FORMAT_BC3_SRGB:      out_format = TEXTURE_FORMAT_BC3; out_srgb = true;  return true;
+	case KTX_VK_FORMAT_BC7_UNORM:     out_format = TEXTURE_FORMAT_BC7; out_srgb = false; return true;
+	case KTX_VK_FORMAT_BC7_SRGB:      out_format = TEXTURE_FORMAT_BC7; out_srgb = true;  return true;
+	default:                          return false;
+	}
+}
+
+void ktx_put_u32(std::vector<uint8_t>& out, uint32_t value) {
+	out.insert(out.end(), (uint8_t*)&value, (uint8_t*)&value + 4);
+}
+
+void ktx_put_u64(std::vector<uint8_t>& out, uint64_t value) {
+	out.insert(out.end(), (uint8_t*)&value, (uint8_t*)&value + 8);
+}
+
+// Data format descriptor, a single basic block. Readers mostly go by vkFormat, but the spec requires one.
+void ktx_write_dfd(std::vector<uint8_t>& out, texture_format_t format, bool srgb) {
+	const uint32_t color_models[] = { 128, 130, 134 }; // KHR_DF_MODEL_BC1A, BC3, BC7
+	uint32_t sample_count = format == TEXTURE_FORMAT_BC3 ? 2 : 1;
+	uint32_t block_size = 24 + 16 * sample_count;
+
+	ktx_put_u32(out, 4 + block_size);                    // dfdTotalSize
+	ktx_put_u32(out, 0);                                 // vendorId, descriptorType
+	ktx_put_u32(out, 2 | (block_size << 16));            // versionNumber, descriptorBlockSize
+	ktx_put_u32(out, color_models[format] | (1 << 8) | ((srgb ? 2 : 1) << 16)); // BT.709 primaries, sRGB or linear transfer, straight alpha
+	ktx_put_u32(out, 3 | (3 << 8));                      // 4x4x1x1 texel blocks, stored minus one
+	ktx_put_u32(out, texture_block_bytes(format));       // bytesPlane0
+	ktx_put_u32(out, 0);
+
+	// BC3 stores its alpha in the first 8 bytes, then the color
+	if (format == TEXTURE_FORMAT_BC3) {
+		ktx_put_u32(out, 0 | (63 << 16) | (15 << 24)); // bitOffset 0, 64 bits, KHR_DF_CHANNEL_BC3_ALPHA
+		ktx_put_u32(out, 0);
+		ktx_put_u32(out, 0);
+		ktx_put_u32(out, UINT32_MAX);
+		ktx_put_u32(out, 64 | (63 << 16));             // bitOffset 64, 64 bits, KHR_DF_CHANNEL_BC3_COLOR
+	} else {
+		ktx_put_u32(out, 0 | ((texture_block_bytes(format) * 8 - 1) << 16));
+	}
+	ktx_put_u32(out, 0);
+	ktx_put_u32(out, 0);
+	ktx_put_u32(out, UINT32_MAX);
+}
+
+// Level data is stored smallest first, each level aligned to the block size, and the index in front of it
+// lists them largest first.
+bool ktx_write(const char* path, const ktx_texture_t& texture) {
+	if (texture.levels.empty())
+		return false;
+	uint32_t level_count = (uint32_t)texture.levels.size();
+	uint32_t block_bytes = texture_block_bytes(texture.format);
+
+	std::vector<uint8_t> dfd;
+	ktx_write_dfd(dfd, texture.format, texture.srgb);
+
+	uint32_t index_end = 12 + 9 * 4 + 4 * 4 + 2 * 8 + level_count * 3 * 8;
+	uint32_t dfd_offset = index_end;
+
+	std::vector<uint64_t> offsets(level_count);
+	uint64_t offset = dfd_offset + dfd.size();
+	for (uint32_t i = level_count; i-- > 0;) {
+		offset = (offset + block_bytes - 1) / block_bytes * block_bytes;
+		offsets[i] = offset;
+		offset += texture.levels[i].blocks.size();
+	}
+
+	std::vector<uint8_t> file;
+	file.reserve((size_t)offset);
+	file.insert(file.end(), ktx_identifier, ktx_identifier + sizeof(ktx_identifier));
+	ktx_put_u32(file, ktx_vk_format(texture.format, texture.srgb));
+	ktx_put_u32(file, 1); // typeSize, 1 for block compressed formats
+	ktx_put_u32(file, texture.levels[0].width);
+	ktx_put_u32(file, texture.levels[0].height);
+	ktx_put_u32(file, 0); // pixelDepth
+	ktx_put_u32(file, 0); // layerCount
+	ktx_put_u32(file, 1); // faceCount
+	ktx_put_u32(file, level_count);
+	ktx_put_u32(file, 0); // supercompressionScheme
+	ktx_put_u32(file, dfd_offset);
+	ktx_put_u32(file, (uint32_t)dfd.size());
+	ktx_put_u32(file, 0); // No key/value data
+	ktx_put_u32(file, 0);
+	ktx_put_u64(file, 0); // No supercompression global data
+	ktx_put_u64(file, 0);
+	for (uint32_t i = 0; i < level_count; i++) {
+		ktx_put_u64(file, offsets[i]);
+		ktx_put_u64(file, texture.levels[i].blocks.size());
+		ktx_put_u64(file, texture.levels[i].blocks.size());
+	}
+	file.insert(file.end(), dfd.begin(), dfd.end());
+	for (uint32_t i = level_count; i-- > 0;) {
+		file.resize((size_t)offsets[i], 0);
+		file.insert(file.end(), texture.levels[i].blocks.begin(), texture.levels[i].blocks.end());
+	}
+
+	FILE* fp = fopen(path, "wb");
+	if (!fp) {
+		printf("KTX2: can't write %s\n", path);
+		return false;
+	}
+	bool written = fwrite(file.data(), 1, file.size(), fp) == file.size();
+	fclose(fp);
+	return written;
+}
+
+bool ktx_read(const char* path, ktx_texture_t& out_texture) {
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	std::vector<uint8_t> file(size > 0 ? (size_t)size : 0);
+	bool read = size > 0 && fread(file.data(), 1, file.size(), fp) == file.size();
+	fclose(fp);
+
+	const size_t header_bytes = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+	if (!read || file.size() < header_bytes || memcmp(file.data(), ktx_identifier, sizeof(ktx_identifier)) != 0) {
+		printf("KTX2: %s isn't a KTX2 file\n", path);
+		return false;
+	}
+	uint32_t header[9];
+	memcpy(header, &file[12], sizeof(header));
+	uint32_t vk_format = header[0], width = header[2], height = header[3];
+	uint32_t depth = header[4], layers = header[5], faces = header[6], level_count = header[7], supercompression = header[8];
+
+	if (!ktx_from_vk_format(vk_format, out_texture.format, out_texture.srgb) || depth > 1 || layers > 1 || faces != 1 || supercompression != 0) {
+		printf("KTX2: %s uses a layout or format we don't load (vkFormat %u)\n", path, vk_format);
+		return false;
+	}
+	level_count = glm::max(level_count, 1u);
+	if (file.size() < header_bytes + (size_t)level_count * 3 * 8) {
+		printf("KTX2: %s is truncated\n", path);
+		return false;
+	}
+
+	uint32_t block_bytes = texture_block_bytes(out_texture.format);
+	out_texture.levels.resize(level_count);
+	for (uint32_t i = 0; i < level_count; i++) {
+		uint64_t entry[3];
+		memcpy(entry, &file[header_bytes + i * sizeof(entry)], sizeof(entry));
+
+		texture_level_t& level = out_texture.levels[i];
+		level.width = glm::max(width >> i, 1u);
+		level.height = glm::max(height >> i, 1u);
+		uint64_t expected = (uint64_t)((level.width + 3) / 4) * ((level.height + 3) / 4) * block_bytes;
+		if (entry[1] != expected || entry[0] + entry[1] > file.size()) {
+			printf("KTX2: %s level %u is the wrong size\n", path, i);
+			return false;
+		}
+		level.blocks.assign(file.begin() + (size_t)entry[0], file.begin() + (size_t)(entry[0] + entry[1]));
+	}
+	return true;
+}
+
+size_t ktx_upload(const ktx_texture_t& texture, GLenum target, bool srgb) {
+	if (texture.format != TEXTURE_FORMAT_BC7 && !gl_texture_s3tc)
+		return 0;
+
+	GLenum internal_format = texture_gl_format(texture.format, srgb || texture.srgb);
+	size_t bytes = 0;
+	for (uint32_t i = 0; i < texture.levels.size(); i++) {
+		const texture_level_t& level = texture.levels[i];
+		glCompressedTexImage2D(target, i, internal_format, level.width, level.height, 0, (GLsizei)level.blocks.size(), level.blocks.data());
+		bytes += level.blocks.size();
+	}
+	return bytes;
+}
+
+///////////////////////////////////////////
+
+bool ktx_bake_file(const char* source_path, texture_format_t format) {
+	int width, height, channels;
+	unsigned char* data = stbi_load(source_path, &width, &height, &channels, 4);
+	if (!data) {
+		printf("Bake: can't load %s\n", source_path);
+		return false;
+	}
+	texture_image_t image = { (uint32_t)width, (uint32_t)height };
+	image.pixels.assign(data, data + (size_t)width * height * 4);
+	stbi_image_free(data);
+
+	if (format == TEXTURE_FORMAT_AUTO)
+		format = texture_has_alpha(image) ? TEXTURE_FORMAT_BC7 : TEXTURE_FORMAT_BC1;
+
+	auto start = std::chrono::high_resolution_clock::now(); // Baking runs before glfwInit
+	std::vector<texture_image_t> mips;
+	texture_build_mips(image, true, mips);
+
+	ktx_texture_t texture = { format, false };
+	texture.levels.resize(mips.size());
+	size_t bytes = 0;
+	for (size_t i = 0; i < mips.size(); i++) {
+		texture_compress(mips[i], format, texture.levels[i]);
+		bytes += texture.levels[i].blocks.size();
+	}
+
+	std::string out_path = ktx_sibling_path(source_path);
+	if (!ktx_write(out_path.c_str(), texture))
+		return false;
+	printf("Bake: %s -> %s, %dx%d %s, %u levels, %zu KB, %.0f ms\n", source_path, out_path.c_str(), width, height,
+		texture_format_name(format), (uint32_t)texture.levels.size(), bytes / 1024, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	return true;
+}
@@ -0,0 +1,337 @@
+#include <lod.h>
+
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix's upper triangle
+struct lod_quadric_t {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+	double weight; // Total area of the planes, errors are averaged over it
+};
+
+// Half edge collapse, moves vertex from onto vertex to. Versions go stale when either end changes.
+struct lod_collapse_t {
+	float    cost;
+	uint32_t from, to;
+	uint32_t from_version, to_version;
+	bool operator<(const lod_collapse_t& other) const { return cost > other.cost; } // Cheapest on top
+};
+
+void lod_quadric_add(lod_quadric_t& q, const lod_quadric_t& other) {
+	q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+	q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+	q.c2 += other.c2; q.cd += other.cd; q.d2 += other.d2;
+	q.weight += other.weight;
+}
+
+lod_quadric_t lod_quadric_plane(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+	glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+	float length = glm::length(cross);
+	if (length < 1e-12f)
+		return {};
+	glm::dvec3 n = glm::dvec3(cross / length);
+	double d = -glm::dot(n, glm::dvec3(p0));
+	double w = length * 0.5; // Triangle area
+	return { n.x * n.x * w, n.x * n.y * w, n.x * n.z * w, n.x * d * w, n.y * n.y * w, n.y * n.z * w, n.y * d * w, n.z * n.z * w, n.z * d * w, d * d * w, w };
+}
+
+// Average distance from p to the planes, in model units
+float lod_quadric_error(const lod_quadric_t& q, const glm::vec3& p) {
+	if (q.weight <= 0.0)
+		return 0.0f;
+	double x = p.x, y = p.y, z = p.z;
+	double e = q.a2 * x * x + 2 * q.ab * x * y + 2 * q.ac * x * z + 2 * q.ad * x
+		+ q.b2 * y * y + 2 * q.bc * y * z + 2 * q.bd * y
+		+ q.c2 * z * z + 2 * q.cd * z + q.d2;
+	return (float)sqrt(glm::max(e, 0.0) / q.weight);
+}
+
+///////////////////////////////////////////
+
+// Simplification state. Topology works on welded positions, so vertices that only differ by normal or UV
+// still count as connected, while the triangles keep referencing the original vertices.
+struct lod_mesh_t {
+	std::vector<glm::vec3>     positions;  // Per welded vertex
+	std::vector<uint32_t>      weld;       // Original vertex to welded vertex
+	std::vector<uint32_t>      wedge;      // Welded vertex to an original vertex that uses it
+	std::vector<uint8_t>       locked;     // On an open border, a non-manifold edge, or a UV/normal seam
+	std::vector<uint8_t>       removed;
+	std::vector<uint32_t>      version;
+	std::vector<lod_quadric_t> quadrics;
+	std::vector<std::vector<uint32_t>> faces; // Triangles around each welded vertex, may include dead ones
+	std::vector<uint32_t>      corners;    // Original vertex indices, 3 per triangle
+	std::vector<uint8_t>       alive;
+	uint32_t                   triangle_count;
+	std::priority_queue<lod_collapse_t> queue;
+};
+
+void lod_mesh_init(lod_mesh_t& mesh, const float* positions, size_t stride, uint32_t vertex_count, const std::vector<uint32_t>& indices) {
+	// Weld by sorting on position then the rest of the vertex, identical positions end up next to each
+	// other and so do exact copies among them
+	std::vector<uint32_t> order(vertex_count);
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		order[i] = i;
+	}
+	auto position = [&](uint32_t v) { return glm::vec3(positions[v * stride], positions[v * stride + 1], positions[v * stride + 2]); };
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return std::lexicographical_compare(positions + a * stride, positions + (a + 1) * stride, positions + b * stride, positions + (b + 1) * stride);
+	});
+
+	// Copies that match in every attribute, like the per face corners an unwelded OBJ import has, collapse
+	// into one wedge. Only a position with wedges that really differ in normal or UV is a seam.
+	std::vector<uint32_t> wedge_counts;
+	std::vector<uint32_t> canonical(vertex_count);
+	mesh.weld.resize(vertex_count);
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		uint32_t v = order[i];
+		if (i == 0 || position(v) != mesh.positions.back()) {
+			mesh.positions.push_back(position(v));
+			mesh.wedge.push_back(v);
+			wedge_counts.push_back(0);
+		}
+		mesh.weld[v] = (uint32_t)mesh.positions.size() - 1;
+		uint32_t previous = i > 0 ? order[i - 1] : v;
+		if (i > 0 && mesh.weld[previous] == mesh.weld[v] && std::equal(positions + v * stride, positions + (v + 1) * stride, positions + previous * stride)) {
+			canonical[v] = canonical[previous];
+			continue;
+		}
+		canonical[v] = v;
+		wedge_counts.back()++;
+	}
+
+	size_t welded_count = mesh.positions.size();
+	mesh.locked.assign(welded_count, 0);
+	mesh.removed.assign(welded_count, 0);
+	mesh.version.assign(welded_count, 0);
+	mesh.quadrics.assign(welded_count, {});
+	mesh.faces.assign(welded_count, {});
+	for (size_t w = 0; w < welded_count; w++) {
+		mesh.locked[w] = wedge_counts[w] > 1;
+	}
+
+	// Triangles, skipping any that are already degenerate once welded
+	std::vector<uint64_t> edges;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		uint32_t w[3] = { mesh.weld[indices[i]], mesh.weld[indices[i + 1]], mesh.weld[indices[i + 2]] };
+		if (w[0] == w[1] || w[1] == w[2] || w[2] == w[0])
+			continue;
+
+		uint32_t triangle = (uint32_t)mesh.alive.size();
+		mesh.corners.insert(mesh.corners.end(), { canonical[indices[i]], canonical[indices[i + 1]], canonical[indices[i + 2]] });
+		mesh.alive.push_back(1);
+
+		lod_quadric_t plane = lod_quadric_plane(mesh.positions[w[0]], mesh.positions[w[1]], mesh.positions[w[2]]);
+		for (int c = 0; c < 3; c++) {
+			lod_quadric_add(mesh.quadrics[w[c]], plane);
+			mesh.faces[w[c]].push_back(triangle);
+			uint32_t a = w[c], b = w[(c + 1) % 3];
+			edges.push_back(((uint64_t)glm::min(a, b) << 32) | glm::max(a, b));
+		}
+	}
+	mesh.triangle_count = (uint32_t)mesh.alive.size();
+
+	// Edges that don't have exactly two triangles are borders (or worse), their vertices stay put so
+	// silhouettes and holes keep their shape
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size();) {
+		size_t run = 1;
+		while (i + run < edges.size() && edges[i + run] == edges[i]) run++;
+		if (run != 2) {
+			mesh.locked[edges[i] >> 32] = 1;
+			mesh.locked[edges[i] & 0xFFFFFFFF] = 1;
+		}
+		i += run;
+	}
+}
+
+void lod_mesh_push(lod_mesh_t& mesh, uint32_t from, uint32_t to) {
+	if (mesh.locked[from])
+		return;
+	lod_quadric_t q = mesh.quadrics[from];
+	lod_quadric_add(q, mesh.quadrics[to]);
+	mesh.queue.push({ lod_quadric_error(q, mesh.positions[to]), from, to, mesh.version[from], mesh.version[to] });
+}
+
+// Welded vertices sharing a live triangle with v
+void lod_mesh_neighbours(const lod_mesh_t& mesh, uint32_t v, std::vector<uint32_t>& out) {
+	out.clear();
+	for (uint32_t t : mesh.faces[v]) {
+		if (!mesh.alive[t])
+			continue;
+		for (int c = 0; c < 3; c++) {
+			uint32_t w = mesh.weld[mesh.corners[t * 3 + c]];
+			if (w != v && std::find(out.begin(), out.end(), w) == out.end())
+				out.push_back(w);
+		}
+	}
+}
+
+// Checks the collapse keeps the surface manifold and doesn't flip any triangle, then does it
+bool lod_mesh_collapse(lod_mesh_t& mesh, uint32_t from, uint32_t to, std::vector<uint32_t>& scratch_a, std::vector<uint32_t>& scratch_b) {
+	// Which original vertex the moved corners get. If "to" sits on a seam, every triangle on the edge
+	// has to agree, otherwise we can't tell which side of the seam they belong to.
+	uint32_t target = 0xFFFFFFFF;
+	uint32_t shared = 0;
+	for (uint32_t t : mesh.faces[from]) {
+		if (!mesh.alive[t])
+			continue;
+		for (int c = 0; c < 3; c++) {
+			uint32_t corner = mesh.corners[t * 3 + c];
+			if (mesh.weld[corner] != to)
+				continue;
+			if (target != 0xFFFFFFFF && target != corner)
+				return false;
+			target = corner;
+			shared++;
+		}
+	}
+	if (shared == 0)
+		return false; // No longer an edge
+
+	// Link condition: the only vertices both ends share are the ones opposite the collapsed edge
+	lod_mesh_neighbours(mesh, from, scratch_a);
+	lod_mesh_neighbours(mesh, to, scratch_b);
+	uint32_t common = 0;
+	for (uint32_t w : scratch_a) {
+		if (std::find(scratch_b.begin(), scratch_b.end(), w) != scratch_b.end())
+			common++;
+	}
+	if (common != shared)
+		return false;
+
+	// Triangles that stay must keep facing the same way
+	for (uint32_t t : mesh.faces[from]) {
+		if (!mesh.alive[t])
+			continue;
+		uint32_t w[3] = { mesh.weld[mesh.corners[t * 3]], mesh.weld[mesh.corners[t * 3 + 1]], mesh.weld[mesh.corners[t * 3 + 2]] };
+		if (w[0] == to || w[1] == to || w[2] == to)
+			continue;
+		glm::vec3 before = glm::cross(mesh.positions[w[1]] - mesh.positions[w[0]], mesh.positions[w[2]] - mesh.positions[w[0]]);
+		for (int c = 0; c < 3; c++) {
+			if (w[c] == from) w[c] = to;
+		}
+		glm::vec3 after = glm::cross(mesh.positions[w[1]] - mesh.positions[w[0]], mesh.positions[w[2]] - mesh.positions[w[0]]);
+		if (glm::dot(before, after) <= 0.0f)
+			return false;
+	}
+
+	for (uint32_t t : mesh.faces[from]) {
+		if (!mesh.alive[t])
+			continue;
+		bool degenerate = false;
+		for (int c = 0; c < 3; c++) {
+			uint32_t& corner = mesh.corners[t * 3 + c];
+			if (mesh.weld[corner] == to)
+				degenerate = true;
+			else if (mesh.weld[corner] == from)
+				corner = target;
+		}
+		if (degenerate) {
+			mesh.alive[t] = 0;
+			mesh.triangle_count--;
+		}
+		else {
+			mesh.faces[to].push_back(t);
+		}
+	}
+	mesh.faces[from].clear();
+	mesh.removed[from] = 1;
+	lod_quadric_add(mesh.quadrics[to], mesh.quadrics[from]);
+	mesh.version[to]++;
+
+	// Drop dead triangles from the survivor's list so it doesn't grow without bound
+	std::vector<uint32_t>& faces = mesh.faces[to];
+	faces.erase(std::remove_if(faces.begin(), faces.end(), [&](uint32_t t) { return !mesh.alive[t]; }), faces.end());
+
+	// Every edge touching "to" has a new cost
+	lod_mesh_neighbours(mesh, to, scratch_a);
+	for (uint32_t w : scratch_a) {
+		lod_mesh_push(mesh, to, w);
+		lod_mesh_push(mesh, w, to);
+	}
+	return true;
+}
+
+///////////////////////////////////////////
+
+// Simplify the mesh in one continuous run, snapshotting the index list each time it gets down to the next
+// level's triangle budget. Level 0 is the input unchanged. Levels stop early if the error limit is hit,
+// so a model that can't be simplified well ends up with fewer of them.
+void lod_build(const float* positions, size_t stride, uint32_t vertex_count, const std::vector<uint32_t>& indices, float radius, std::vector<uint32_t>& out_indices, std::vector<lod_range_t>& out_levels) {
+	out_indices = indices;
+	out_levels.clear();
+	out_levels.push_back({ 0, (uint32_t)indices.size(), 0.0f });
+
+	uint32_t level_count = glm::min(app_config_lod_levels, lod_max_levels);
+	if (level_count < 2 || indices.size() / 3 < app_config_lod_min_triangles)
+		return;
+
+	lod_mesh_t mesh;
+	lod_mesh_init(mesh, positions, stride, vertex_count, indices);
+	for (uint32_t t = 0; t < mesh.alive.size(); t++) {
+		for (int c = 0; c < 3; c++) {
+			uint32_t a = mesh.weld[mesh.corners[t * 3 + c]];
+			uint32_t b = mesh.weld[mesh.corners[t * 3 + (c + 1) % 3]];
+			lod_mesh_push(mesh, a, b);
+			lod_mesh_push(mesh, b, a);
+		}
+	}
+
+	float max_error = app_config_lod_max_error * radius;
+	float level_error = 0.0f;
+	std::vector<uint32_t> scratch_a, scratch_b;
+	uint32_t source_triangles = (uint32_t)(indices.size() / 3);
+	bool exhausted = false;
+
+	for (uint32_t level = 1; level < level_count && !exhausted; level++) {
+		uint32_t target = (uint32_t)(source_triangles * app_config_lod_ratios[level]);
+		while (mesh.triangle_count > target) {
+			if (mesh.queue.empty()) {
+				exhausted = true;
+				break;
+			}
+			lod_collapse_t candidate = mesh.queue.top();
+			if (candidate.cost > max_error) {
+				exhausted = true;
+				break;
+			}
+			mesh.queue.pop();
+			if (mesh.removed[candidate.from] || mesh.removed[candidate.to] ||
+				candidate.from_version != mesh.version[candidate.from] || candidate.to_version != mesh.version[candidate.to])
+				continue; // Stale, a fresh entry was pushed when the ends changed
+
+			if (lod_mesh_collapse(mesh, candidate.from, candidate.to, scratch_a, scratch_b))
+				level_error = glm::max(level_error, candidate.cost);
+		}
+
+		// Not worth a level if it barely saved anything over the last one
+		uint32_t previous = out_levels.back().index_count / 3;
+		if (mesh.triangle_count > previous * 0.85f)
+			break;
+
+		lod_range_t range = { (uint32_t)out_indices.size(), mesh.triangle_count * 3, level_error };
+		for (uint32_t t = 0; t < mesh.alive.size(); t++) {
+			if (mesh.alive[t])
+				out_indices.insert(out_indices.end(), &mesh.corners[t * 3], &mesh.corners[t * 3 + 3]);
+		}
+		out_levels.push_back(range);
+	}
+}
+
+///////////////////////////////////////////
+
+// Level for an object with this world space bounding sphere. Measured from app_view.lod_position, between
+// the eyes, so both eyes (and both passes without multiview) always pick the same level.
+uint32_t lod_select(uint32_t level_count, const glm::vec3& center, float radius) {
+	if (level_count < 2 || app_view.lod_scale <= 0.0f)
+		return 0;
+
+	float distance = glm::distance(center, app_view.lod_position);
+	if (distance <= radius)
+		return 0;
+
+	// Fraction of the screen height the sphere covers
+	float size = 2.0f * radius / distance * app_view.lod_scale * app_config_lod_bias;
+	for (uint32_t level = 0; level < level_count - 1; level++) {
+		if (size >= app_config_lod_screen_sizes[level])
+			return level;
+	}
+	return level_count - 1;
+}
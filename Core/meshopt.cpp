@@ -0,0 +1,311 @@
+#include <meshopt.h>
+
+// Assimp gives every face corner of an OBJ its own vertex, welding brings them back to one per unique
+// position/normal/UV. Merged vertices keep the index of their first occurrence, so order is preserved.
+uint32_t mesh_weld(std::vector<float>& vertices, size_t stride, std::vector<uint32_t>& indices) {
+	uint32_t vertex_count = (uint32_t)(vertices.size() / stride);
+	size_t bytes = stride * sizeof(float);
+	const float* data = vertices.data();
+
+	std::vector<uint32_t> order(vertex_count);
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		int compare = memcmp(data + a * stride, data + b * stride, bytes);
+		return compare != 0 ? compare < 0 : a < b;
+	});
+
+	// Every vertex points at the first of its duplicates
+	std::vector<uint32_t> remap(vertex_count);
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		bool same = i > 0 && memcmp(data + order[i] * stride, data + order[i - 1] * stride, bytes) == 0;
+		remap[order[i]] = same ? remap[order[i - 1]] : order[i];
+	}
+
+	// Compact the survivors
+	std::vector<uint32_t> compacted(vertex_count);
+	uint32_t welded_count = 0;
+	for (uint32_t v = 0; v < vertex_count; v++) {
+		if (remap[v] != v)
+			continue;
+		compacted[v] = welded_count;
+		memmove(&vertices[welded_count * stride], &vertices[v * stride], bytes);
+		welded_count++;
+	}
+	vertices.resize(welded_count * stride);
+	for (uint32_t& index : indices) {
+		index = compacted[remap[index]];
+	}
+	return welded_count;
+}
+
+///////////////////////////////////////////
+
+// Forsyth's scoring: vertices recently used score high (the last triangle's three a bit less, to avoid
+// strips), and vertices with few triangles left get a boost so they're finished off rather than stranded
+float mesh_forsyth_score(int32_t cache_position, uint32_t live_triangles) {
+	if (live_triangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cache_position >= 0) {
+		score = cache_position < 3 ? 0.75f :
+			powf(1.0f - (float)(cache_position - 3) / (mesh_forsyth_cache_size - 3), 1.5f);
+	}
+	return score + 2.0f / sqrtf((float)live_triangles);
+}
+
+void mesh_optimize_vertex_cache(uint32_t* indices, size_t index_count, uint32_t vertex_count) {
+	uint32_t triangle_count = (uint32_t)(index_count / 3);
+	if (triangle_count == 0)
+		return;
+
+	// Triangles around each vertex, the live ones are kept at the front of each list
+	std::vector<uint32_t> live(vertex_count, 0);
+	for (size_t i = 0; i < index_count; i++) {
+		live[indices[i]]++;
+	}
+	std::vector<uint32_t> offsets(vertex_count + 1, 0);
+	for (uint32_t v = 0; v < vertex_count; v++) {
+		offsets[v + 1] = offsets[v] + live[v];
+	}
+	std::vector<uint32_t> adjacency(index_count);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < index_count; i++) {
+		adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int32_t> cache_position(vertex_count, -1);
+	std::vector<float>   vertex_score(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; v++) {
+		vertex_score[v] = mesh_forsyth_score(-1, live[v]);
+	}
+	std::vector<float>   triangle_score(triangle_count);
+	std::vector<uint8_t> emitted(triangle_count, 0);
+	uint32_t best = 0;
+	for (uint32_t t = 0; t < triangle_count; t++) {
+		triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+		if (triangle_score[t] > triangle_score[best])
+			best = t;
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(index_count);
+	uint32_t cache[mesh_forsyth_cache_size + 3];
+	uint32_t cache_count = 0;
+	uint32_t cursor = 0;
+
+	while (output.size() < index_count) {
+		// Nothing in the cache has triangles left, restart from the next unemitted one in input order
+		if (best == 0xFFFFFFFF) {
+			while (emitted[cursor]) cursor++;
+			best = cursor;
+		}
+
+		const uint32_t* triangle = &indices[best * 3];
+		output.insert(output.end(), triangle, triangle + 3);
+		emitted[best] = 1;
+
+		for (int c = 0; c < 3; c++) {
+			uint32_t v = triangle[c];
+			uint32_t* list = &adjacency[offsets[v]];
+			for (uint32_t n = 0; n < live[v]; n++) {
+				if (list[n] == best) {
+					std::swap(list[n], list[live[v] - 1]);
+					break;
+				}
+			}
+			live[v]--;
+		}
+
+		// The triangle's vertices move to the front of the LRU cache
+		uint32_t next[mesh_forsyth_cache_size + 3] = { triangle[0], triangle[1], triangle[2] };
+		uint32_t next_count = 3;
+		for (uint32_t i = 0; i < cache_count; i++) {
+			uint32_t v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				next[next_count++] = v;
+		}
+		for (uint32_t i = 0; i < next_count; i++) {
+			uint32_t v = next[i];
+			cache_position[v] = i < mesh_forsyth_cache_size ? (int32_t)i : -1;
+			vertex_score[v] = mesh_forsyth_score(cache_position[v], live[v]);
+		}
+
+		// Only triangles touching the cache changed score, the next one is picked from those
+		best = 0xFFFFFFFF;
+		float best_score = -FLT_MAX;
+		for (uint32_t i = 0; i < next_count; i++) {
+			uint32_t v = next[i];
+			for (uint32_t n = 0; n < live[v]; n++) {
+				uint32_t t = adjacency[offsets[v] + n];
+				const uint32_t* tv = &indices[t * 3];
+				triangle_score[t] = vertex_score[tv[0]] + vertex_score[tv[1]] + vertex_score[tv[2]];
+				if (triangle_score[t] > best_score) {
+					best_score = triangle_score[t];
+					best = t;
+				}
+			}
+		}
+
+		cache_count = glm::min(next_count, mesh_forsyth_cache_size);
+		memcpy(cache, next, cache_count * sizeof(uint32_t));
+	}
+	memcpy(indices, output.data(), index_count * sizeof(uint32_t));
+}
+
+///////////////////////////////////////////
+
+// Cuts the cache optimized order into clusters, then sorts the clusters so the ones facing away from the
+// mesh center draw first: from most viewpoints they're in front, and what's drawn after them fails the
+// depth test before shading. A cluster may end wherever its ACMR, counting the cold cache it started with,
+// is within mesh_overdraw_threshold of the whole mesh's, so reordering them costs little cache efficiency.
+const float mesh_overdraw_threshold = 1.05f;
+
+uint32_t mesh_optimize_overdraw(uint32_t* indices, size_t index_count, const float* vertices, size_t stride) {
+	uint32_t triangle_count = (uint32_t)(index_count / 3);
+	if (triangle_count == 0)
+		return 0;
+
+	auto position = [&](uint32_t v) { return glm::vec3(vertices[v * stride], vertices[v * stride + 1], vertices[v * stride + 2]); };
+
+	uint32_t max_vertex = 0;
+	for (size_t i = 0; i < index_count; i++) {
+		max_vertex = glm::max(max_vertex, indices[i]);
+	}
+	mesh_cache_stats_t stats = mesh_cache_stats(indices, index_count, max_vertex + 1);
+	float max_acmr = stats.acmr * mesh_overdraw_threshold;
+
+	// Same FIFO as mesh_cache_stats(), bumping the clock past the cache size empties it
+	std::vector<uint32_t> cache_time(max_vertex + 1, 0);
+	uint32_t time = mesh_cache_size + 1;
+
+	std::vector<uint32_t> cluster_starts;
+	uint32_t cluster_start = 0, cluster_misses = 0;
+	for (uint32_t t = 0; t < triangle_count; t++) {
+		if (t == cluster_start) {
+			cluster_starts.push_back(t);
+			time += mesh_cache_size + 1;
+			cluster_misses = 0;
+		}
+		for (int c = 0; c < 3; c++) {
+			uint32_t v = indices[t * 3 + c];
+			if (time - cache_time[v] > mesh_cache_size) {
+				cache_time[v] = time++;
+				cluster_misses++;
+			}
+		}
+		if ((float)cluster_misses / (t - cluster_start + 1) <= max_acmr)
+			cluster_start = t + 1;
+	}
+	uint32_t cluster_count = (uint32_t)cluster_starts.size();
+	cluster_starts.push_back(triangle_count);
+	if (cluster_count < 2)
+		return cluster_count;
+
+	// Area weighted centroid and normal per cluster, and for the whole mesh
+	std::vector<glm::vec3> cluster_centroid(cluster_count, glm::vec3(0.0f));
+	std::vector<glm::vec3> cluster_normal(cluster_count, glm::vec3(0.0f));
+	glm::vec3 mesh_centroid(0.0f);
+	float mesh_area = 0.0f;
+	for (uint32_t c = 0; c < cluster_count; c++) {
+		float cluster_area = 0.0f;
+		for (uint32_t t = cluster_starts[c]; t < cluster_starts[c + 1]; t++) {
+			glm::vec3 p0 = position(indices[t * 3]), p1 = position(indices[t * 3 + 1]), p2 = position(indices[t * 3 + 2]);
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(cross) * 0.5f;
+			glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+			cluster_centroid[c] += centroid * area;
+			cluster_normal[c] += cross;
+			cluster_area += area;
+		}
+		mesh_centroid += cluster_centroid[c];
+		mesh_area += cluster_area;
+		if (cluster_area > 0.0f)
+			cluster_centroid[c] /= cluster_area;
+	}
+	if (mesh_area > 0.0f)
+		mesh_centroid /= mesh_area;
+
+	std::vector<std::pair<float, uint32_t>> order(cluster_count);
+	for (uint32_t c = 0; c < cluster_count; c++) {
+		float length = glm::length(cluster_normal[c]);
+		float facing = length > 0.0f ? glm::dot(cluster_centroid[c] - mesh_centroid, cluster_normal[c] / length) : 0.0f;
+		order[c] = { -facing, c };
+	}
+	std::stable_sort(order.begin(), order.end());
+
+	std::vector<uint32_t> output;
+	output.reserve(index_count);
+	for (const auto& entry : order) {
+		uint32_t c = entry.second;
+		output.insert(output.end(), indices + cluster_starts[c] * 3, indices + cluster_starts[c + 1] * 3);
+	}
+	memcpy(indices, output.data(), index_count * sizeof(uint32_t));
+	return cluster_count;
+}
+
+///////////////////////////////////////////
+
+// Vertices in the order the index buffer first reaches them, so fetches walk forward through memory.
+// Anything no triangle uses ends up at the back.
+void mesh_optimize_vertex_fetch(std::vector<float>& vertices, size_t stride, std::vector<uint32_t>& indices) {
+	uint32_t vertex_count = (uint32_t)(vertices.size() / stride);
+	std::vector<uint32_t> remap(vertex_count, 0xFFFFFFFF);
+	uint32_t next = 0;
+	for (uint32_t index : indices) {
+		if (remap[index] == 0xFFFFFFFF)
+			remap[index] = next++;
+	}
+	for (uint32_t v = 0; v < vertex_count; v++) {
+		if (remap[v] == 0xFFFFFFFF)
+			remap[v] = next++;
+	}
+
+	std::vector<float> reordered(vertices.size());
+	for (uint32_t v = 0; v < vertex_count; v++) {
+		memcpy(&reordered[remap[v] * stride], &vertices[v * stride], stride * sizeof(float));
+	}
+	vertices.swap(reordered);
+	for (uint32_t& index : indices) {
+		index = remap[index];
+	}
+}
+
+///////////////////////////////////////////
+
+// Simulates a FIFO post-transform cache of mesh_cache_size entries
+mesh_cache_stats_t mesh_cache_stats(const uint32_t* indices, size_t index_count, uint32_t vertex_count) {
+	std::vector<uint32_t> cache_time(vertex_count, 0);
+	std::vector<uint8_t>  used(vertex_count, 0);
+	uint32_t time = mesh_cache_size + 1;
+	uint32_t misses = 0, unique = 0;
+	for (size_t i = 0; i < index_count; i++) {
+		uint32_t v = indices[i];
+		if (time - cache_time[v] > mesh_cache_size) {
+			cache_time[v] = time++;
+			misses++;
+		}
+		if (!used[v]) {
+			used[v] = 1;
+			unique++;
+		}
+	}
+	mesh_cache_stats_t stats = {};
+	if (index_count > 0) {
+		stats.acmr = (float)misses / (index_count / 3);
+		stats.atvr = (float)misses / unique;
+	}
+	return stats;
+}
+
+void mesh_optimize_report(const mesh_optimize_stats_t& stats) {
+	if (stats.meshes == 0 || stats.triangles == 0)
+		return;
+	printf("Optimized %u meshes: %llu -> %llu vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %llu overdraw clusters\n",
+		stats.meshes, (unsigned long long)stats.vertices_before, (unsigned long long)stats.vertices_after,
+		(double)stats.transformed_before / stats.triangles, (double)stats.transformed_after / stats.triangles,
+		(double)stats.transformed_before / glm::max(stats.vertices_before, (uint64_t)1), (double)stats.transformed_after / glm::max(stats.vertices_after, (uint64_t)1),
+		(unsigned long long)stats.clusters);
+}
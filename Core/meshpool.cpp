@@ -0,0 +1,122 @@
+#include <meshpool.h>
+
+// First fit, what's left of the range stays in the list
+bool mesh_pool_take(std::vector<mesh_pool_range_t>& free_ranges, uint32_t count, mesh_pool_range_t& out) {
+	for (size_t i = 0; i < free_ranges.size(); i++) {
+		mesh_pool_range_t& range = free_ranges[i];
+		if (range.count < count)
+			continue;
+		out = { range.first, count };
+		range.first += count;
+		range.count -= count;
+		if (range.count == 0)
+			free_ranges.erase(free_ranges.begin() + i);
+		return true;
+	}
+	return false;
+}
+
+void mesh_pool_give(std::vector<mesh_pool_range_t>& free_ranges, mesh_pool_range_t range) {
+	if (range.count == 0)
+		return;
+	auto it = std::lower_bound(free_ranges.begin(), free_ranges.end(), range, [](const mesh_pool_range_t& a, const mesh_pool_range_t& b) { return a.first < b.first; });
+	it = free_ranges.insert(it, range);
+
+	// Merge with the next range, then the previous one
+	auto next = it + 1;
+	if (next != free_ranges.end() && it->first + it->count == next->first) {
+		it->count += next->count;
+		free_ranges.erase(next);
+	}
+	if (it != free_ranges.begin()) {
+		auto prev = it - 1;
+		if (prev->first + prev->count == it->first) {
+			prev->count += it->count;
+			free_ranges.erase(it);
+		}
+	}
+}
+
+///////////////////////////////////////////
+
+void mesh_pool_bind_draw_ids() {
+	glBindBuffer(GL_ARRAY_BUFFER, app_mesh_pools.draw_ids);
+	glEnableVertexAttribArray(3);
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+	glVertexAttribDivisor(3, 1);
+}
+
+void mesh_pool_create(mesh_pool_t& pool, mesh_pool_format_t format) {
+	pool.vertex_stride = (uint32_t)(format == MESH_POOL_QUANTIZED ? sizeof(vertex_quantized_t) : vertex_float_stride * sizeof(float));
+	pool.vertex_capacity = (uint32_t)(app_config_mesh_pool_vertex_bytes / pool.vertex_stride);
+	pool.index_capacity = (uint32_t)(app_config_mesh_pool_index_bytes / sizeof(uint32_t));
+	pool.free_vertices = { { 0, pool.vertex_capacity } };
+	pool.free_indices = { { 0, pool.index_capacity } };
+	mesh_pool_draw_ids(1);
+
+	glGenVertexArrays(1, &pool.vao);
+	glGenBuffers(1, &pool.vbo);
+	glGenBuffers(1, &pool.ebo);
+	glBindVertexArray(pool.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, pool.vbo);
+	glBufferData(GL_ARRAY_BUFFER, (size_t)pool.vertex_capacity * pool.vertex_stride, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)pool.index_capacity * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+	if (format == MESH_POOL_QUANTIZED)
+		vertex_attributes_quantized();
+	else
+		vertex_attributes_float();
+	mesh_pool_bind_draw_ids();
+	glBindVertexArray(0);
+}
+
+bool mesh_pool_alloc(mesh_pool_format_t format, uint32_t vertex_count, uint32_t index_count, mesh_pool_alloc_t& out) {
+	mesh_pool_t& pool = app_mesh_pools.pools[format];
+	if (pool.vao == 0)
+		mesh_pool_create(pool, format);
+
+	out.format = format;
+	if (!mesh_pool_take(pool.free_vertices, vertex_count, out.vertices))
+		return false;
+	if (!mesh_pool_take(pool.free_indices, index_count, out.indices)) {
+		mesh_pool_give(pool.free_vertices, out.vertices);
+		return false;
+	}
+	return true;
+}
+
+void mesh_pool_free(const mesh_pool_alloc_t& alloc) {
+	mesh_pool_t& pool = app_mesh_pools.pools[alloc.format];
+	mesh_pool_give(pool.free_vertices, alloc.vertices);
+	mesh_pool_give(pool.free_indices, alloc.indices);
+}
+
+// The ids only ever count up, so growing is a refill. The buffer keeps its name, the VAOs see the new store.
+void mesh_pool_draw_ids(uint32_t count) {
+	if (count <= app_mesh_pools.draw_id_capacity)
+		return;
+	uint32_t capacity = glm::max(app_mesh_pools.draw_id_capacity * 2, glm::max(count, 4096u));
+	std::vector<uint32_t> ids(capacity);
+	for (uint32_t i = 0; i < capacity; i++) {
+		ids[i] = i;
+	}
+	if (app_mesh_pools.draw_ids == 0)
+		glGenBuffers(1, &app_mesh_pools.draw_ids);
+	glBindBuffer(GL_ARRAY_BUFFER, app_mesh_pools.draw_ids);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(uint32_t), ids.data(), GL_STATIC_DRAW);
+	app_mesh_pools.draw_id_capacity = capacity;
+}
+
+void mesh_pool_shutdown() {
+	for (mesh_pool_t& pool : app_mesh_pools.pools) {
+		if (pool.vao == 0)
+			continue;
+		glDeleteVertexArrays(1, &pool.vao);
+		glDeleteBuffers(1, &pool.vbo);
+		glDeleteBuffers(1, &pool.ebo);
+		pool = {};
+	}
+	glDeleteBuffers(1, &app_mesh_pools.draw_ids);
+	app_mesh_pools.draw_ids = 0;
+	app_mesh_pools.draw_id_capacity = 0;
+}
@@ -0,0 +1,256 @@
+#include <occlusion.h>
+
+const float occlusion_near = 0.05f; // Triangles and boxes that reach closer than this aren't used/tested
+
+void occlusion_begin(occlusion_buffer_t& buffer, const glm::mat4& viewproj, float eye_offset) {
+	occlusion_tile_t empty = { FLT_MAX, 0.0f, {} };
+	buffer.tiles.assign(occlusion_tiles_x * occlusion_tiles_y, empty);
+	buffer.triangles.clear();
+	buffer.viewproj = viewproj;
+
+	// The w row is the unit view direction, what's left of the x and y rows once its part is taken out is
+	// the projection's scale, whatever the rotation and off center shift
+	glm::vec3 w(viewproj[0][3], viewproj[1][3], viewproj[2][3]);
+	glm::vec3 x(viewproj[0][0], viewproj[1][0], viewproj[2][0]);
+	glm::vec3 y(viewproj[0][1], viewproj[1][1], viewproj[2][1]);
+	buffer.ndc_scale = glm::vec2(glm::length(x - glm::dot(x, w) * w), glm::length(y - glm::dot(y, w) * w));
+	buffer.eye_offset = eye_offset;
+	buffer.occluder_near = FLT_MAX;
+	buffer.ready = false;
+	buffer.stats = {};
+}
+
+// Project an occluder mesh and set up its triangles. Anything crossing the near plane is dropped instead
+// of clipped, an occluder that's missing a triangle only occludes less.
+void occlusion_add_occluder(occlusion_buffer_t& buffer, const glm::vec3* positions, const uint32_t* indices, size_t index_count, const glm::mat4& world) {
+	glm::mat4 mvp = buffer.viewproj * world;
+	buffer.stats.occluders++;
+
+	for (size_t i = 0; i + 2 < index_count; i += 3) {
+		glm::vec4 clip[3];
+		bool behind = false;
+		for (int c = 0; c < 3; c++) {
+			clip[c] = mvp * glm::vec4(positions[indices[i + c]], 1.0f);
+			behind |= clip[c].w < occlusion_near;
+		}
+		if (behind)
+			continue;
+
+		occlusion_triangle_t triangle;
+		triangle.z_max = 0.0f;
+		float z_min = FLT_MAX;
+		for (int c = 0; c < 3; c++) {
+			glm::vec2 ndc = glm::vec2(clip[c]) / clip[c].w;
+			triangle.v[c] = (ndc * 0.5f + 0.5f) * glm::vec2((float)occlusion_width, (float)occlusion_height);
+			triangle.z_max = glm::max(triangle.z_max, clip[c].w);
+			z_min = glm::min(z_min, clip[c].w);
+		}
+
+		// Back faces sit behind the front ones of a closed mesh, skip them
+		glm::vec2 e0 = triangle.v[1] - triangle.v[0];
+		glm::vec2 e1 = triangle.v[2] - triangle.v[0];
+		if (e0.x * e1.y - e0.y * e1.x <= 0.0f)
+			continue;
+
+		float y_min = glm::min(triangle.v[0].y, glm::min(triangle.v[1].y, triangle.v[2].y));
+		float y_max = glm::max(triangle.v[0].y, glm::max(triangle.v[1].y, triangle.v[2].y));
+		float x_min = glm::min(triangle.v[0].x, glm::min(triangle.v[1].x, triangle.v[2].x));
+		float x_max = glm::max(triangle.v[0].x, glm::max(triangle.v[1].x, triangle.v[2].x));
+		if (y_max < 0.0f || y_min >= occlusion_height || x_max < 0.0f || x_min >= occlusion_width)
+			continue;
+
+		triangle.tile_y0 = (uint32_t)glm::max(y_min, 0.0f) / occlusion_tile_height;
+		triangle.tile_y1 = glm::min((uint32_t)y_max / occlusion_tile_height, occlusion_tiles_y - 1);
+		buffer.triangles.push_back(triangle);
+		buffer.occluder_near = glm::min(buffer.occluder_near, z_min);
+	}
+}
+
+///////////////////////////////////////////
+
+// Merge one triangle's coverage of a tile. Coverage goes into the working layer, and once the working
+// layer covers the whole tile it becomes the reference. A triangle much closer to the reference than to
+// the working layer starts a new working layer instead, so one far triangle can't drag a near layer back.
+void occlusion_merge_tile(occlusion_tile_t& tile, const uint32_t mask[occlusion_tile_height], float z) {
+	if (z >= tile.z0)
+		return;
+
+	uint32_t any = 0;
+	for (uint32_t r = 0; r < occlusion_tile_height; r++) {
+		any |= tile.mask[r];
+	}
+	if (any != 0 && z - tile.z1 > tile.z0 - z) {
+		memset(tile.mask, 0, sizeof(tile.mask));
+		tile.z1 = 0.0f;
+	}
+
+	uint32_t full = 0xFFFFFFFF;
+	for (uint32_t r = 0; r < occlusion_tile_height; r++) {
+		tile.mask[r] |= mask[r];
+		full &= tile.mask[r];
+	}
+	tile.z1 = glm::max(tile.z1, z);
+
+	if (full == 0xFFFFFFFF) {
+		tile.z0 = glm::min(tile.z0, tile.z1);
+		tile.z1 = 0.0f;
+		memset(tile.mask, 0, sizeof(tile.mask));
+	}
+}
+
+// Covered pixel span of each of the 8 rows in tile row ty, four rows at a time. Each edge bounds the
+// span from one side; first/last come out inclusive, with first > last for rows the triangle misses.
+void occlusion_triangle_spans(const occlusion_triangle_t& triangle, uint32_t ty, int32_t first[occlusion_tile_height], int32_t last[occlusion_tile_height]) {
+	__m128 y_min = _mm_set1_ps(glm::min(triangle.v[0].y, glm::min(triangle.v[1].y, triangle.v[2].y)));
+	__m128 y_max = _mm_set1_ps(glm::max(triangle.v[0].y, glm::max(triangle.v[1].y, triangle.v[2].y)));
+
+	for (uint32_t r = 0; r < occlusion_tile_height; r += 4) {
+		float row = (float)(ty * occlusion_tile_height + r) + 0.5f; // Pixel centers
+		__m128 y = _mm_add_ps(_mm_set1_ps(row), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+		__m128 left = _mm_set1_ps(0.0f);
+		__m128 right = _mm_set1_ps((float)occlusion_width);
+
+		for (int e = 0; e < 3; e++) {
+			const glm::vec2& a = triangle.v[e];
+			const glm::vec2& b = triangle.v[(e + 1) % 3];
+			float dy = b.y - a.y;
+			if (dy == 0.0f)
+				continue; // Horizontal edges are handled by the y range below
+			__m128 x = _mm_add_ps(_mm_set1_ps(a.x), _mm_mul_ps(_mm_set1_ps((b.x - a.x) / dy), _mm_sub_ps(y, _mm_set1_ps(a.y))));
+			if (dy > 0.0f)
+				right = _mm_min_ps(right, x);
+			else
+				left = _mm_max_ps(left, x);
+		}
+
+		// Rows outside the triangle get an empty span
+		__m128 outside = _mm_or_ps(_mm_cmplt_ps(y, y_min), _mm_cmpgt_ps(y, y_max));
+		left = _mm_or_ps(_mm_andnot_ps(outside, left), _mm_and_ps(outside, _mm_set1_ps((float)occlusion_width)));
+		right = _mm_andnot_ps(outside, right);
+
+		// Round to nearest: the first pixel whose center is right of left, the last whose center is left of right
+		__m128i first4 = _mm_cvtps_epi32(left);
+		__m128i last4 = _mm_sub_epi32(_mm_cvtps_epi32(right), _mm_set1_epi32(1));
+		_mm_storeu_si128((__m128i*)&first[r], first4);
+		_mm_storeu_si128((__m128i*)&last[r], last4);
+	}
+}
+
+// Rasterize every triangle touching tile rows [ty0, ty1). Bands don't share tiles, so they can run at once.
+void occlusion_rasterize_band(occlusion_buffer_t& buffer, uint32_t ty0, uint32_t ty1) {
+	int32_t first[occlusion_tile_height], last[occlusion_tile_height];
+	uint32_t mask[occlusion_tile_height];
+
+	for (const occlusion_triangle_t& triangle : buffer.triangles) {
+		uint32_t row_begin = glm::max(triangle.tile_y0, ty0);
+		uint32_t row_end = glm::min(triangle.tile_y1 + 1, ty1);
+
+		for (uint32_t ty = row_begin; ty < row_end; ty++) {
+			occlusion_triangle_spans(triangle, ty, first, last);
+
+			int32_t span_min = occlusion_width, span_max = -1;
+			for (uint32_t r = 0; r < occlusion_tile_height; r++) {
+				if (first[r] > last[r])
+					continue;
+				span_min = std::min(span_min, first[r]);
+				span_max = std::max(span_max, last[r]);
+			}
+			if (span_max < span_min)
+				continue;
+
+			for (int32_t tx = span_min / (int32_t)occlusion_tile_width; tx <= span_max / (int32_t)occlusion_tile_width; tx++) {
+				int32_t tile_x = tx * occlusion_tile_width;
+				uint32_t any = 0;
+				for (uint32_t r = 0; r < occlusion_tile_height; r++) {
+					int32_t lo = std::max(first[r] - tile_x, 0);
+					int32_t hi = std::min(last[r] - tile_x, (int32_t)occlusion_tile_width - 1);
+					mask[r] = lo > hi ? 0 : (0xFFFFFFFFu >> (31 - (hi - lo))) << lo;
+					any |= mask[r];
+				}
+				if (any)
+					occlusion_merge_tile(buffer.tiles[ty * occlusion_tiles_x + tx], mask, triangle.z_max);
+			}
+		}
+	}
+}
+
+void occlusion_rasterize(occlusion_buffer_t& buffer) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Each band is a few tile rows, enough bands for every thread to get a couple so uneven ones even out
+	uint32_t bands = std::min(jobs_thread_count() * 2, occlusion_tiles_y);
+	uint32_t rows_per_band = (occlusion_tiles_y + bands - 1) / bands;
+	jobs_parallel_for(occlusion_tiles_y, rows_per_band, [&buffer](uint32_t first, uint32_t last) {
+		occlusion_rasterize_band(buffer, first, last);
+	});
+
+	buffer.stats.triangles = (uint32_t)buffer.triangles.size();
+	buffer.stats.raster_us = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	buffer.ready = true;
+}
+
+///////////////////////////////////////////
+
+// A box is hidden when its nearest point is farther than the reference depth of every tile its screen
+// rectangle touches, or where it isn't, than a working layer that covers every pixel of the rectangle
+// in that tile. Boxes reaching behind the near plane are always visible.
+//
+// The buffer is drawn from between the eyes. An eye e away sees a point at depth D shifted by e / D in
+// view tangent units, so against an occluder at depth D_o a point at D moves by up to e * (1 / D_o - 1 / D),
+// which grows without bound the farther the box is behind the occluder. The rectangle grows by that much,
+// taken against the nearest occluder, so whatever either eye can see around an occluder stays visible.
+bool occlusion_test_box(occlusion_buffer_t& buffer, const aabb_t& box) {
+	if (buffer.triangles.empty())
+		return true;
+	buffer.stats.tested++;
+
+	glm::vec2 screen_min(FLT_MAX), screen_max(-FLT_MAX);
+	float nearest = FLT_MAX, farthest = 0.0f;
+	for (int c = 0; c < 8; c++) {
+		glm::vec3 corner((c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y, (c & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = buffer.viewproj * glm::vec4(corner, 1.0f);
+		if (clip.w < occlusion_near)
+			return true;
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		screen_min = glm::min(screen_min, ndc);
+		screen_max = glm::max(screen_max, ndc);
+		nearest = glm::min(nearest, clip.w);
+		farthest = glm::max(farthest, clip.w);
+	}
+	float parallax = buffer.eye_offset * glm::max(1.0f / buffer.occluder_near - 1.0f / farthest, 0.0f);
+	screen_min -= parallax * buffer.ndc_scale;
+	screen_max += parallax * buffer.ndc_scale;
+
+	// Off screen parts are outside the frustum anyway, only the on screen part can be seen. Occluders cover
+	// the pixels whose centers they cover, so the rectangle takes in one more pixel on each side to only
+	// count as hidden between covered centers.
+	glm::vec2 size((float)occlusion_width, (float)occlusion_height);
+	screen_min = glm::clamp((screen_min * 0.5f + 0.5f) * size - 1.0f, glm::vec2(0.0f), size - 1.0f);
+	screen_max = glm::clamp((screen_max * 0.5f + 0.5f) * size + 1.0f, glm::vec2(0.0f), size - 1.0f);
+	int32_t x0 = (int32_t)screen_min.x, x1 = (int32_t)screen_max.x;
+	int32_t y0 = (int32_t)screen_min.y, y1 = (int32_t)screen_max.y;
+
+	for (int32_t ty = y0 / (int32_t)occlusion_tile_height; ty <= y1 / (int32_t)occlusion_tile_height; ty++) {
+		for (int32_t tx = x0 / (int32_t)occlusion_tile_width; tx <= x1 / (int32_t)occlusion_tile_width; tx++) {
+			const occlusion_tile_t& tile = buffer.tiles[ty * occlusion_tiles_x + tx];
+			if (tile.z0 < nearest)
+				continue;
+
+			// Not hidden by the reference layer, but the working layer may still cover the part of the
+			// tile this box overlaps, if it's closer than the box
+			if (tile.z1 == 0.0f || tile.z1 >= nearest)
+				return true;
+			int32_t lo = std::max(x0 - tx * (int32_t)occlusion_tile_width, 0);
+			int32_t hi = std::min(x1 - tx * (int32_t)occlusion_tile_width, (int32_t)occlusion_tile_width - 1);
+			uint32_t columns = (0xFFFFFFFFu >> (31 - (hi - lo))) << lo;
+			int32_t row_lo = std::max(y0 - ty * (int32_t)occlusion_tile_height, 0);
+			int32_t row_hi = std::min(y1 - ty * (int32_t)occlusion_tile_height, (int32_t)occlusion_tile_height - 1);
+			for (int32_t r = row_lo; r <= row_hi; r++) {
+				if ((tile.mask[r] & columns) != columns)
+					return true;
+			}
+		}
+	}
+	buffer.stats.occluded++;
+	return false;
+}
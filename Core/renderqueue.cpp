@@ -0,0 +1,706 @@
+#include <renderqueue.h>
+
+// Sort key layout, most significant first:
+//   program (12 bits) | texture (16 bits) | vao (16 bits) | depth (20 bits)
+// State changes cost the most, so draws sharing a program end up together, then those sharing a texture,
+// and so on. Depth is last so that within a state bucket we draw front to back and let early-z reject more.
+// GL names are small integers, truncating them only costs a missed grouping, never a wrong draw.
+const float render_queue_max_depth = 100.0f; // Matches the far clip plane in app_draw
+
+uint64_t render_queue_key(GLuint program, GLuint texture, GLuint vao, float depth) {
+	float depth01 = glm::clamp(depth / render_queue_max_depth, 0.0f, 1.0f);
+	uint64_t depth_bits = (uint64_t)(depth01 * 0xFFFFF);
+
+	return ((uint64_t)(program & 0xFFF) << 52) |
+		((uint64_t)(texture & 0xFFFF) << 36) |
+		((uint64_t)(vao & 0xFFFF) << 20) |
+		depth_bits;
+}
+
+///////////////////////////////////////////
+
+void render_queue_begin(render_queue_t& queue, const glm::vec3& eye_position, const glm::vec3& eye_forward) {
+	// clear() keeps the capacity, so after the first few frames queuing doesn't allocate
+	queue.packets.clear();
+	queue.keys.clear();
+	queue.instance_worlds.clear();
+	cull_list_clear(queue.bounds);
+	cull_list_clear(queue.gpu_bounds);
+	queue.gpu_cull = app_config_gpu_culling && app_gpu_cull.cull_program != 0;
+	queue.cull = false;
+	queue.eye_position = eye_position;
+	queue.eye_forward = eye_forward;
+	queue.stats = {};
+}
+
+// Cull against this frustum at flush time, without one everything queued is drawn
+void render_queue_set_frustum(render_queue_t& queue, const frustum_t& frustum) {
+	queue.frustum = frustum;
+	queue.cull = true;
+}
+
+// Pooled draws keep their bounds apart when the GPU culls them, the CPU cull never sees those
+cull_list_t& render_queue_cull_list(render_queue_t& queue, const draw_mesh_t& mesh) {
+	return queue.gpu_cull && mesh.pooled ? queue.gpu_bounds : queue.bounds;
+}
+
+void render_queue_push(render_queue_t& queue, const draw_mesh_t& mesh, const glm::mat4& world, const Bounds& bounds) {
+	// Depth along the view direction, measured at the object's origin
+	float depth = glm::dot(glm::vec3(world[3]) - queue.eye_position, queue.eye_forward);
+	uint32_t bounds_index = cull_list_add(render_queue_cull_list(queue, mesh), bounds, world);
+
+	queue.packets.push_back({ mesh, world, 0, 0, bounds_index });
+	queue.keys.push_back(render_queue_key(mesh.program, mesh.texture, mesh.vao, depth));
+	queue.stats.packets++;
+}
+
+// For draws the caller has culled already, like the static scene BVH. The queue won't test these again.
+void render_queue_push_visible(render_queue_t& queue, const draw_mesh_t& mesh, const glm::mat4& world) {
+	float depth = glm::dot(glm::vec3(world[3]) - queue.eye_position, queue.eye_forward);
+
+	queue.packets.push_back({ mesh, world, 0, 0, render_queue_no_bounds });
+	queue.keys.push_back(render_queue_key(mesh.program, mesh.texture, mesh.vao, depth));
+	queue.stats.packets++;
+}
+
+void render_queue_push_instanced(render_queue_t& queue, const draw_mesh_t& mesh, const glm::mat4* worlds, size_t count, const Bounds& bounds) {
+	uint32_t first = (uint32_t)queue.instance_worlds.size();
+	cull_list_t& list = render_queue_cull_list(queue, mesh);
+	uint32_t bounds_index = list.count;
+	for (size_t i = 0; i < count; i++) {
+		queue.instance_worlds.push_back(worlds[i]);
+		cull_list_add(list, bounds, worlds[i]);
+	}
+
+	// The whole batch sorts as one packet, using the first instance for depth
+	const glm::mat4& world = queue.instance_worlds[first];
+	float depth = glm::dot(glm::vec3(world[3]) - queue.eye_position, queue.eye_forward);
+
+	queue.packets.push_back({ mesh, world, first, (uint32_t)count, bounds_index });
+	queue.keys.push_back(render_queue_key(mesh.program, mesh.texture, mesh.vao, depth));
+	queue.stats.packets++;
+}
+
+///////////////////////////////////////////
+
+void draw_list_clear(draw_list_t& list) {
+	list.entries.clear();
+	list.instance_worlds.clear();
+	list.recorded = false;
+}
+
+void draw_list_push(draw_list_t& list, const draw_mesh_t& mesh, const glm::mat4& world, const Bounds& bounds) {
+	list.entries.push_back({ mesh, world, 0, 0, bounds });
+}
+
+// World matrices are built here, so replaying doesn't redo them for every view
+void draw_list_push_instanced(draw_list_t& list, const draw_mesh_t& mesh, const Transform* transforms, size_t count, const Bounds& bounds) {
+	uint32_t first = (uint32_t)list.instance_worlds.size();
+	for (size_t i = 0; i < count; i++) {
+		list.instance_worlds.push_back(transformToMat4(transforms[i]));
+	}
+	list.entries.push_back({ mesh, list.instance_worlds[first], first, (uint32_t)count, bounds });
+}
+
+// Queue everything recorded, depth and culling come from the queue's own view
+void draw_list_replay(const draw_list_t& list, render_queue_t& queue) {
+	for (const draw_list_entry_t& entry : list.entries) {
+		if (entry.instance_count > 0)
+			render_queue_push_instanced(queue, entry.mesh, &list.instance_worlds[entry.instance_first], entry.instance_count, entry.bounds);
+		else
+			render_queue_push(queue, entry.mesh, entry.world, entry.bounds);
+	}
+}
+
+///////////////////////////////////////////
+
+// Test every queued object against the frustum and the occlusion buffer and drop what's hidden, before
+// any sorting or uniform writes are spent on it. Instances are culled one by one, survivors are packed
+// down within their packet.
+void render_queue_cull(render_queue_t& queue) {
+	if (!queue.cull || !app_config_culling)
+		return;
+
+	cull_stats_t result = cull_frustum_test(queue.frustum, queue.bounds);
+	uint8_t* visible = queue.bounds.visible.data();
+
+	// What survived the frustum gets tested against the occluders, when they've been drawn this frame
+	if (app_config_occlusion && app_occlusion.ready) {
+		auto start = std::chrono::high_resolution_clock::now();
+		const cull_list_t& list = queue.bounds;
+		for (uint32_t i = 0; i < list.count; i++) {
+			if (!visible[i])
+				continue;
+			glm::vec3 center(list.center_x[i], list.center_y[i], list.center_z[i]);
+			glm::vec3 extent(list.extent_x[i], list.extent_y[i], list.extent_z[i]);
+			if (!occlusion_test_box(app_occlusion, { center - extent, center + extent })) {
+				visible[i] = 0;
+				result.visible--;
+				queue.stats.occluded++;
+			}
+		}
+		app_occlusion.stats.test_us += std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	queue.stats.tested += result.tested;
+	queue.stats.visible += result.visible;
+	if (result.visible == result.tested)
+		return;
+
+	size_t kept = 0;
+	for (size_t i = 0; i < queue.packets.size(); i++) {
+		draw_packet_t& packet = queue.packets[i];
+
+		if (queue.gpu_cull && packet.mesh.pooled) {
+			// Left for the compute shader
+		}
+		else if (packet.instance_count > 0) {
+			uint32_t survivors = 0;
+			for (uint32_t n = 0; n < packet.instance_count; n++) {
+				if (visible[packet.bounds_index + n])
+					queue.instance_worlds[packet.instance_first + survivors++] = queue.instance_worlds[packet.instance_first + n];
+			}
+			packet.instance_count = survivors;
+			if (survivors == 0)
+				continue;
+		}
+		else if (packet.bounds_index != render_queue_no_bounds && !visible[packet.bounds_index]) {
+			continue;
+		}
+
+		queue.packets[kept] = packet;
+		queue.keys[kept] = queue.keys[i];
+		kept++;
+	}
+	queue.packets.resize(kept);
+	queue.keys.resize(kept);
+}
+
+// Game code tends to call drawModel() on the same model many times a frame. Survivors of the cull that
+// draw the same index range with the same texture and program are folded into one instanced packet,
+// which takes the place of the first of them. Their world matrices go out as instances, so they lose
+// their front to back order among themselves, the merged packet sorts at its first copy's depth.
+void render_queue_instance(render_queue_t& queue) {
+	if (!app_config_auto_instancing)
+		return;
+
+	// Group every mergeable packet. A key collision just leaves the packet out, it's checked against the leader.
+	queue.instance_lookup.clear();
+	queue.instance_groups.clear();
+	queue.packet_groups.assign(queue.packets.size(), UINT32_MAX);
+	for (size_t i = 0; i < queue.packets.size(); i++) {
+		const draw_packet_t& packet = queue.packets[i];
+		const draw_mesh_t& mesh = packet.mesh;
+		if (mesh.pooled || mesh.instanced_program == 0 || packet.instance_count > 0)
+			continue;
+
+		uint64_t key = ((uint64_t)mesh.vao << 44) ^ ((uint64_t)mesh.texture << 28) ^ ((uint64_t)mesh.layer << 20) ^
+			((uint64_t)mesh.index_count << 32) ^ mesh.first_index ^ ((uint64_t)mesh.program << 56);
+		auto found = queue.instance_lookup.find(key);
+		if (found == queue.instance_lookup.end()) {
+			queue.instance_lookup[key] = (uint32_t)queue.instance_groups.size();
+			queue.packet_groups[i] = (uint32_t)queue.instance_groups.size();
+			queue.instance_groups.push_back({ (uint32_t)i, 1, 0, 0 });
+			continue;
+		}
+
+		draw_instance_group_t& group = queue.instance_groups[found->second];
+		const draw_mesh_t& leader = queue.packets[group.leader].mesh;
+		if (leader.vao != mesh.vao || leader.first_index != mesh.first_index || leader.index_count != mesh.index_count || leader.index_type != mesh.index_type ||
+			leader.program != mesh.program || leader.texture != mesh.texture || leader.paged != mesh.paged || leader.layer != mesh.layer)
+			continue;
+		group.count++;
+		queue.packet_groups[i] = found->second;
+	}
+
+	uint32_t min_count = glm::max(app_config_auto_instancing_min, 2u);
+	bool merging = false;
+	for (draw_instance_group_t& group : queue.instance_groups) {
+		if (group.count < min_count)
+			continue;
+		group.first = (uint32_t)queue.instance_worlds.size();
+		queue.instance_worlds.resize(queue.instance_worlds.size() + group.count);
+		merging = true;
+	}
+	if (!merging)
+		return;
+
+	// Keeps packet order, so anything not merged sorts exactly as it would have
+	size_t kept = 0;
+	for (size_t i = 0; i < queue.packets.size(); i++) {
+		draw_packet_t packet = queue.packets[i];
+		uint64_t key = queue.keys[i];
+		uint32_t g = queue.packet_groups[i];
+		if (g != UINT32_MAX && queue.instance_groups[g].count >= min_count) {
+			draw_instance_group_t& group = queue.instance_groups[g];
+			queue.instance_worlds[group.first + group.filled++] = packet.world;
+			if (group.leader != i)
+				continue;
+
+			packet.mesh.program = packet.mesh.instanced_program;
+			packet.instance_first = group.first;
+			packet.instance_count = group.count;
+			packet.bounds_index = render_queue_no_bounds; // Culled already
+			float depth = glm::dot(glm::vec3(packet.world[3]) - queue.eye_position, queue.eye_forward);
+			key = render_queue_key(packet.mesh.program, packet.mesh.texture, packet.mesh.vao, depth);
+			queue.stats.merged += group.count;
+		}
+		queue.packets[kept] = packet;
+		queue.keys[kept] = key;
+		kept++;
+	}
+	queue.packets.resize(kept);
+	queue.keys.resize(kept);
+}
+
+// Report each surviving draw's on screen size to texture streaming. The mesh's object space box is in the
+// decode offset and scale, whether or not its positions are quantized.
+void render_queue_touch_textures(const render_queue_t& queue) {
+	if (app_stream.textures.empty() || app_view.lod_scale <= 0.0f || app_view.pixel_height == 0)
+		return;
+
+	for (const draw_packet_t& packet : queue.packets) {
+		const draw_mesh_t& mesh = packet.mesh;
+		GLuint id = mesh.paged ? mesh.streamed : mesh.texture;
+		if (id == 0)
+			continue;
+		glm::vec3 center = mesh.decode_offset + mesh.decode_scale * 0.5f;
+		float radius = glm::length(mesh.decode_scale) * 0.5f;
+		auto pixels = [&](const glm::mat4& world) {
+			float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+			float distance = glm::max(glm::distance(glm::vec3(world * glm::vec4(center, 1.0f)), app_view.lod_position), radius * scale);
+			return 2.0f * radius * scale / distance * app_view.lod_scale * app_view.pixel_height;
+		};
+
+		float largest = 0.0f;
+		if (packet.instance_count > 0) {
+			for (uint32_t n = 0; n < packet.instance_count; n++) {
+				largest = glm::max(largest, pixels(queue.instance_worlds[packet.instance_first + n]));
+			}
+		}
+		else {
+			largest = pixels(packet.world);
+		}
+		stream_touch(id, largest);
+	}
+}
+
+///////////////////////////////////////////
+
+// LSD radix sort over the keys, 8 bits per pass. Stable, so equal keys keep submission order.
+void render_queue_sort(render_queue_t& queue) {
+	size_t count = queue.keys.size();
+	queue.order.resize(count);
+	queue.order_temp.resize(count);
+	queue.keys_temp.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		queue.order[i] = (uint32_t)i;
+	}
+	if (count < 2)
+		return;
+
+	uint64_t* keys_src = queue.keys.data();
+	uint64_t* keys_dst = queue.keys_temp.data();
+	uint32_t* order_src = queue.order.data();
+	uint32_t* order_dst = queue.order_temp.data();
+
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		size_t histogram[256] = {};
+		for (size_t i = 0; i < count; i++) {
+			histogram[(keys_src[i] >> shift) & 0xFF]++;
+		}
+
+		// Every key has the same digit here, this pass wouldn't move anything. Common for the
+		// program bits, since most scenes only have a couple of shaders.
+		if (histogram[(keys_src[0] >> shift) & 0xFF] == count)
+			continue;
+
+		size_t offset = 0;
+		for (size_t b = 0; b < 256; b++) {
+			size_t bucket_count = histogram[b];
+			histogram[b] = offset;
+			offset += bucket_count;
+		}
+		for (size_t i = 0; i < count; i++) {
+			size_t dst = histogram[(keys_src[i] >> shift) & 0xFF]++;
+			keys_dst[dst] = keys_src[i];
+			order_dst[dst] = order_src[i];
+		}
+		std::swap(keys_src, keys_dst);
+		std::swap(order_src, order_dst);
+	}
+
+	// Passes may have left the result in the temp buffers
+	if (order_src != queue.order.data()) {
+		queue.order.swap(queue.order_temp);
+		queue.keys.swap(queue.keys_temp);
+	}
+}
+
+///////////////////////////////////////////
+
+// Quantized positions are unorm16 within the model's box, scaling and offsetting them is just one more
+// transform, so it's folded into the world matrix here instead of costing the vertex shader anything
+glm::mat4 render_queue_decode(const draw_mesh_t& mesh, const glm::mat4& world) {
+	if (!mesh.quantized)
+		return world;
+	glm::mat4 result = world;
+	result[0] *= mesh.decode_scale.x;
+	result[1] *= mesh.decode_scale.y;
+	result[2] *= mesh.decode_scale.z;
+	result[3] = world * glm::vec4(mesh.decode_offset, 1.0f);
+	return result;
+}
+
+// Everything a flush writes into the uniform ring, reserved in one go before any of it is handed out.
+// Growing the ring swaps its buffer, so a second reservation after the uniforms were written could leave
+// the view and per draw offsets pointing into the old one.
+void render_queue_reserve(render_queue_t& queue) {
+	size_t align = app_uniform_ring.alignment;
+	size_t aligned_stride = (sizeof(app_transform_buffer_t) + align - 1) / align * align;
+	size_t instance_bytes = queue.instance_worlds.size() * sizeof(glm::mat4) + queue.packets.size() * (align + sizeof(glm::uvec4));
+	size_t bytes = aligned_stride * (queue.order.size() + 1) + instance_bytes;
+
+	// With GPU culling there's a command per distinct mesh in each batch rather than per packet, never more
+	queue.indirect_commands = 0;
+	queue.indirect_records = 0;
+	for (uint32_t index : queue.order) {
+		const draw_packet_t& packet = queue.packets[index];
+		if (packet.mesh.pooled) {
+			queue.indirect_commands++;
+			queue.indirect_records += glm::max(packet.instance_count, 1u);
+		}
+	}
+	if (queue.indirect_commands > 0) {
+		bytes += queue.indirect_records * sizeof(draw_record_t) + queue.indirect_commands * sizeof(draw_indirect_command_t) + align * 3;
+		if (queue.gpu_cull)
+			bytes += queue.indirect_records * sizeof(gpu_cull_object_t);
+	}
+	gl_ring_reserve(app_uniform_ring, bytes);
+}
+
+// Write one TransformBuffer per packet into the uniform ring. MVP is built here on the CPU, so the
+// vertex shader does a single matrix multiply per vertex instead of two. Instanced packets get their
+// world matrices packed instead, behind a 16 byte header with the texture layer, and share one ViewBuffer.
+void render_queue_write_uniforms(render_queue_t& queue) {
+	const size_t stride = sizeof(app_transform_buffer_t);
+	queue.uniform_offsets.resize(queue.order.size());
+
+	glm::mat4* view = (glm::mat4*)gl_ring_alloc(app_uniform_ring, sizeof(glm::mat4) * 2, queue.view_offset);
+	memcpy(view, app_view.viewproj, sizeof(glm::mat4) * 2);
+
+	for (size_t i = 0; i < queue.order.size(); i++) {
+		const draw_packet_t& packet = queue.packets[queue.order[i]];
+		if (packet.mesh.pooled)
+			continue;
+
+		uint32_t layer = packet.mesh.paged ? packet.mesh.layer : texture_no_layer;
+		if (packet.instance_count > 0) {
+			size_t bytes = sizeof(glm::uvec4) + packet.instance_count * sizeof(glm::mat4);
+			glm::uvec4* header = (glm::uvec4*)gl_ring_alloc(app_uniform_ring, bytes, queue.uniform_offsets[i]);
+			*header = glm::uvec4(layer, 0, 0, 0);
+			glm::mat4* instances = (glm::mat4*)(header + 1);
+			if (!packet.mesh.quantized) {
+				memcpy(instances, &queue.instance_worlds[packet.instance_first], packet.instance_count * sizeof(glm::mat4));
+				continue;
+			}
+			for (uint32_t n = 0; n < packet.instance_count; n++) {
+				instances[n] = render_queue_decode(packet.mesh, queue.instance_worlds[packet.instance_first + n]);
+			}
+			continue;
+		}
+
+		app_transform_buffer_t* uniforms = (app_transform_buffer_t*)gl_ring_alloc(app_uniform_ring, stride, queue.uniform_offsets[i]);
+		glm::mat4 world = render_queue_decode(packet.mesh, packet.world); // Not read back from the ring, it's write combined memory
+		uniforms->world = world;
+		for (uint32_t v = 0; v < app_view.view_count; v++) {
+			uniforms->mvp[v] = app_view.viewproj[v] * world;
+		}
+		uniforms->material = glm::uvec4(layer, 0, 0, 0);
+	}
+	gl_ring_commit(app_uniform_ring);
+}
+
+// The batch sorted packet i goes in, a new one when it can't share the previous packet's state
+draw_batch_t& render_queue_batch(render_queue_t& queue, size_t i, bool& started) {
+	started = false;
+	if (!queue.batches.empty()) {
+		draw_batch_t& batch = queue.batches.back();
+		const draw_mesh_t& previous = queue.packets[queue.order[i - 1]].mesh;
+		const draw_mesh_t& mesh = queue.packets[queue.order[i]].mesh;
+		if (batch.first + batch.count == i && previous.program == mesh.program && previous.texture == mesh.texture &&
+			previous.paged == mesh.paged && previous.vao == mesh.vao)
+			return batch;
+	}
+	queue.batches.push_back({ (uint32_t)i, 0, 0, 0 });
+	started = true;
+	return queue.batches.back();
+}
+
+// With GPU culling a batch has one command per distinct mesh instead, with a slot for each of its objects,
+// and cull.comp counts in the ones that survive. Each object gets a cull object next to its draw record,
+// pointing at both. Nothing about visibility is decided here.
+void render_queue_write_indirect_gpu(render_queue_t& queue, uint32_t record_count) {
+	std::vector<draw_indirect_command_t>& commands = queue.gpu_command_list;
+	commands.clear();
+	queue.gpu_packet_commands.resize(queue.order.size());
+	for (size_t i = 0; i < queue.order.size(); i++) {
+		const draw_packet_t& packet = queue.packets[queue.order[i]];
+		const draw_mesh_t& mesh = packet.mesh;
+		if (!mesh.pooled)
+			continue;
+
+		bool started;
+		draw_batch_t& batch = render_queue_batch(queue, i, started);
+		if (started) {
+			batch.command_offset = commands.size() * sizeof(draw_indirect_command_t);
+			queue.gpu_commands.clear();
+		}
+		batch.count++;
+
+		// LODs and meshes never share index ranges in a pool, so the first index names the mesh
+		auto found = queue.gpu_commands.find(mesh.first_index);
+		uint32_t command;
+		if (found == queue.gpu_commands.end()) {
+			command = (uint32_t)commands.size();
+			queue.gpu_commands[mesh.first_index] = command;
+			commands.push_back({ (uint32_t)mesh.index_count, 0, mesh.first_index, mesh.base_vertex, 0 });
+			batch.commands++;
+		}
+		else {
+			command = found->second;
+		}
+		commands[command].instance_count += glm::max(packet.instance_count, 1u); // Slots needed, for now
+		queue.gpu_packet_commands[i] = command;
+	}
+
+	// Slots become where each command's survivors start, and the counts go back to zero for the shader
+	uint32_t slot = 0;
+	for (draw_indirect_command_t& command : commands) {
+		command.base_instance = slot;
+		slot += command.instance_count;
+		command.instance_count = 0;
+	}
+
+	queue.records_bytes = record_count * sizeof(draw_record_t);
+	queue.gpu_commands_bytes = commands.size() * sizeof(draw_indirect_command_t);
+	queue.gpu_object_count = record_count;
+	draw_record_t* records = (draw_record_t*)gl_ring_alloc(app_uniform_ring, queue.records_bytes, queue.records_offset);
+	gpu_cull_object_t* objects = (gpu_cull_object_t*)gl_ring_alloc(app_uniform_ring, record_count * sizeof(gpu_cull_object_t), queue.gpu_objects_offset);
+	void* command_data = gl_ring_alloc(app_uniform_ring, queue.gpu_commands_bytes, queue.gpu_commands_offset);
+	memcpy(command_data, commands.data(), queue.gpu_commands_bytes);
+
+	const cull_list_t& list = queue.gpu_bounds;
+	queue.gpu_object_bounds.clear();
+	uint32_t record = 0;
+	for (size_t i = 0; i < queue.order.size(); i++) {
+		const draw_packet_t& packet = queue.packets[queue.order[i]];
+		const draw_mesh_t& mesh = packet.mesh;
+		if (!mesh.pooled)
+			continue;
+
+		glm::uvec4 material(mesh.paged ? mesh.layer : texture_no_layer, 0, 0, 0);
+		uint32_t instances = glm::max(packet.instance_count, 1u);
+		for (uint32_t n = 0; n < instances; n++) {
+			const glm::mat4& world = packet.instance_count > 0 ? queue.instance_worlds[packet.instance_first + n] : packet.world;
+			records[record] = { render_queue_decode(mesh, world), material };
+
+			uint32_t bounds = packet.bounds_index == render_queue_no_bounds ? render_queue_no_bounds : packet.bounds_index + n;
+			gpu_cull_object_t& object = objects[record];
+			if (bounds == render_queue_no_bounds) {
+				object = { glm::vec4(0.0f), glm::vec4(0.0f), glm::uvec4(queue.gpu_packet_commands[i], record, gpu_cull_always_visible, 0) };
+			}
+			else {
+				object = {
+					glm::vec4(list.center_x[bounds], list.center_y[bounds], list.center_z[bounds], 0.0f),
+					glm::vec4(list.extent_x[bounds], list.extent_y[bounds], list.extent_z[bounds], 0.0f),
+					glm::uvec4(queue.gpu_packet_commands[i], record, 0, 0) };
+			}
+			queue.gpu_object_bounds.push_back(bounds);
+			record++;
+		}
+	}
+	gl_ring_commit(app_uniform_ring);
+	queue.stats.gpu_culled += record_count;
+}
+
+// Pooled packets become indirect commands plus one draw record per object, and every run of them that
+// binds the same state becomes a batch. Sorting already put those runs together. What's left on the CPU
+// is writing 100 bytes or so per object, the GL calls no longer grow with the object count.
+void render_queue_write_indirect(render_queue_t& queue) {
+	queue.batches.clear();
+	queue.records_bytes = 0;
+	queue.gpu_object_count = 0;
+	uint32_t command_count = queue.indirect_commands, record_count = queue.indirect_records;
+	if (command_count == 0)
+		return;
+
+	mesh_pool_draw_ids(record_count);
+	if (queue.gpu_cull) {
+		render_queue_write_indirect_gpu(queue, record_count);
+		return;
+	}
+
+	draw_record_t* records = (draw_record_t*)gl_ring_alloc(app_uniform_ring, record_count * sizeof(draw_record_t), queue.records_offset);
+	size_t commands_offset;
+	draw_indirect_command_t* commands = (draw_indirect_command_t*)gl_ring_alloc(app_uniform_ring, command_count * sizeof(draw_indirect_command_t), commands_offset);
+	queue.records_bytes = record_count * sizeof(draw_record_t);
+
+	uint32_t record = 0, command = 0;
+	for (size_t i = 0; i < queue.order.size(); i++) {
+		const draw_packet_t& packet = queue.packets[queue.order[i]];
+		const draw_mesh_t& mesh = packet.mesh;
+		if (!mesh.pooled)
+			continue;
+
+		bool started;
+		draw_batch_t& batch = render_queue_batch(queue, i, started);
+		if (started)
+			batch.command_offset = commands_offset + command * sizeof(draw_indirect_command_t);
+		batch.count++;
+		batch.commands++;
+
+		uint32_t instances = glm::max(packet.instance_count, 1u);
+		commands[command++] = { (uint32_t)mesh.index_count, instances, mesh.first_index, mesh.base_vertex, record };
+
+		glm::uvec4 material(mesh.paged ? mesh.layer : texture_no_layer, 0, 0, 0);
+		if (packet.instance_count > 0) {
+			for (uint32_t n = 0; n < packet.instance_count; n++) {
+				records[record++] = { render_queue_decode(mesh, queue.instance_worlds[packet.instance_first + n]), material };
+			}
+		}
+		else {
+			records[record++] = { render_queue_decode(mesh, packet.world), material };
+		}
+	}
+	gl_ring_commit(app_uniform_ring);
+}
+
+// Hand the pooled objects to cull.comp, testing against the frustum of each view being drawn
+void render_queue_dispatch_culling(render_queue_t& queue) {
+	if (queue.gpu_object_count == 0)
+		return;
+
+	frustum_t frusta[2];
+	uint32_t frustum_count = 0;
+	if (queue.cull && app_config_culling) {
+		for (; frustum_count < glm::min(app_view.view_count, 2u); frustum_count++) {
+			frusta[frustum_count] = cull_frustum_from_matrix(app_view.viewproj[frustum_count]);
+		}
+	}
+	gpu_cull_dispatch(frusta, frustum_count, app_uniform_ring.buffer, queue.gpu_objects_offset, queue.gpu_object_count,
+		queue.records_offset, queue.records_bytes, queue.gpu_commands_offset, queue.gpu_commands_bytes);
+	if (!app_config_gpu_cull_validate)
+		return;
+
+	// Read every result back and hold the frustum part to cull_frustum_test() over the same boxes, an object
+	// is inside when any view has it. Occluded ones must be inside too, Hi-Z has nothing on the CPU to compare with.
+	std::vector<uint32_t> results;
+	gpu_cull_read_results(queue.gpu_object_count, results);
+	std::vector<uint8_t> inside(queue.gpu_bounds.count, frustum_count == 0 ? 1 : 0);
+	for (uint32_t v = 0; v < frustum_count; v++) {
+		cull_frustum_test(frusta[v], queue.gpu_bounds);
+		for (uint32_t b = 0; b < queue.gpu_bounds.count; b++) {
+			inside[b] |= queue.gpu_bounds.visible[b];
+		}
+	}
+
+	gpu_cull_stats_t& stats = app_gpu_cull.stats;
+	for (uint32_t k = 0; k < queue.gpu_object_count; k++) {
+		uint32_t bounds = queue.gpu_object_bounds[k];
+		bool expected = bounds == render_queue_no_bounds || inside[bounds];
+		stats.visible += results[k] == GPU_CULL_VISIBLE;
+		stats.occluded += results[k] == GPU_CULL_OCCLUDED;
+		if (expected != (results[k] != GPU_CULL_OUTSIDE))
+			stats.mismatches++;
+	}
+	if (stats.mismatches > 0)
+		printf("GPU culling: %u of %u objects disagree with the CPU frustum test\n", stats.mismatches, queue.gpu_object_count);
+}
+
+// Sort and submit everything in the queue, only touching GL state when it actually changes
+void render_queue_flush(render_queue_t& queue) {
+	render_queue_cull(queue);
+	render_queue_instance(queue);
+	render_queue_touch_textures(queue);
+	render_queue_sort(queue);
+	render_queue_reserve(queue);
+	render_queue_write_uniforms(queue);
+	render_queue_write_indirect(queue);
+	if (queue.gpu_cull)
+		render_queue_dispatch_culling(queue);
+
+	GLuint bound_program = 0;
+	GLuint bound_texture = 0;
+	GLuint bound_array = 0;
+	GLuint bound_vao = 0;
+	bool   first = true;
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferRange(GL_UNIFORM_BUFFER, 1, app_uniform_ring.buffer, queue.view_offset, sizeof(glm::mat4) * 2);
+	if (!queue.batches.empty())
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, queue.gpu_cull ? app_gpu_cull.commands : app_uniform_ring.buffer);
+	size_t next_batch = 0;
+
+	for (size_t i = 0; i < queue.order.size(); i++) {
+		const draw_packet_t& packet = queue.packets[queue.order[i]];
+
+		if (first || packet.mesh.program != bound_program) {
+			glUseProgram(packet.mesh.program);
+			glUniform1i(glGetUniformLocation(packet.mesh.program, "texture_diffuse"), 0);
+			bound_program = packet.mesh.program;
+			queue.stats.program_binds++;
+		}
+		// Paged textures sit on unit 1, draws in the same page only differ in the layer they were given
+		if (packet.mesh.paged && packet.mesh.texture != bound_array) {
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, packet.mesh.texture);
+			glActiveTexture(GL_TEXTURE0);
+			bound_array = packet.mesh.texture;
+			queue.stats.texture_binds++;
+		}
+		else if (!packet.mesh.paged && (first || packet.mesh.texture != bound_texture)) {
+			glBindTexture(GL_TEXTURE_2D, packet.mesh.texture);
+			bound_texture = packet.mesh.texture;
+			queue.stats.texture_binds++;
+		}
+		if (first || packet.mesh.vao != bound_vao) {
+			glBindVertexArray(packet.mesh.vao);
+			bound_vao = packet.mesh.vao;
+			queue.stats.vao_binds++;
+		}
+		first = false;
+
+		// The whole batch in one call, each command finds its draw record through baseInstance
+		const draw_mesh_t& mesh = packet.mesh;
+		if (mesh.pooled) {
+			const draw_batch_t& batch = queue.batches[next_batch++];
+			if (queue.gpu_cull)
+				glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, app_gpu_cull.records, 0, queue.records_bytes);
+			else
+				glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, app_uniform_ring.buffer, queue.records_offset, queue.records_bytes);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)batch.command_offset, batch.commands, 0);
+			queue.stats.commands += batch.commands;
+			queue.stats.draws++;
+			i += batch.count - 1;
+			continue;
+		}
+
+		// Point the shader at this draw's slice of the ring, no data moves here
+		void* first_index = (void*)(mesh.first_index * (mesh.index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t)));
+		if (packet.instance_count > 0) {
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, app_uniform_ring.buffer, queue.uniform_offsets[i], sizeof(glm::uvec4) + packet.instance_count * sizeof(glm::mat4));
+			glDrawElementsInstanced(GL_TRIANGLES, mesh.index_count, mesh.index_type, first_index, packet.instance_count);
+			queue.stats.instances += packet.instance_count;
+		}
+		else {
+			glBindBufferRange(GL_UNIFORM_BUFFER, 0, app_uniform_ring.buffer, queue.uniform_offsets[i], sizeof(app_transform_buffer_t));
+			glDrawElements(GL_TRIANGLES, mesh.index_count, mesh.index_type, first_index);
+		}
+		queue.stats.draws++;
+	}
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,140 @@
+#include <ringbuffer.h>
+
+size_t gl_ring_alignment() {
+	GLint uniform_alignment = 256;
+	GLint storage_alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment);
+	return (size_t)std::max(uniform_alignment, storage_alignment);
+}
+
+void gl_ring_create(gpu_ring_t& ring, size_t section_size, size_t alignment) {
+	ring = {};
+	ring.alignment = alignment;
+	ring.section_size = (section_size + alignment - 1) / alignment * alignment;
+	size_t total = ring.section_size * gpu_ring_frames;
+
+	glGenBuffers(1, &ring.buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+
+	if (ext_glBufferStorage) {
+		// Map once and keep it mapped, coherent so writes show up without explicit flushes
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		ext_glBufferStorage(GL_COPY_WRITE_BUFFER, total, nullptr, flags);
+		ring.mapped = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags);
+		ring.persistent = ring.mapped != nullptr;
+	}
+	if (!ring.persistent) {
+		// Without persistent mapping, stage on the CPU and upload each batch with a single glBufferSubData
+		glBufferData(GL_COPY_WRITE_BUFFER, total, nullptr, GL_DYNAMIC_DRAW);
+		ring.staging.resize(total);
+		ring.mapped = ring.staging.data();
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void gl_ring_delete_buffer(GLuint buffer, bool persistent) {
+	if (persistent) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void gl_ring_destroy(gpu_ring_t& ring) {
+	for (uint32_t i = 0; i < gpu_ring_frames; i++) {
+		if (ring.fences[i]) glDeleteSync(ring.fences[i]);
+	}
+	for (const gpu_ring_retired_t& old : ring.retired) {
+		glDeleteSync(old.fence);
+		gl_ring_delete_buffer(old.buffer, old.persistent);
+	}
+	gl_ring_delete_buffer(ring.buffer, ring.persistent);
+	ring = {};
+}
+
+///////////////////////////////////////////
+
+void gl_ring_begin_frame(gpu_ring_t& ring) {
+	ring.section = (ring.section + 1) % gpu_ring_frames;
+	ring.offset = 0;
+	ring.committed = 0;
+
+	// Wait for the GPU to finish the frame that last used this section. With three sections
+	// this is normally already signaled, and it only blocks if the GPU falls two frames behind.
+	GLsync& fence = ring.fences[ring.section];
+	if (fence) {
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		while (result == GL_TIMEOUT_EXPIRED) {
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	// Let go of buffers the ring grew out of, once nothing in flight reads from them
+	for (size_t i = 0; i < ring.retired.size();) {
+		if (glClientWaitSync(ring.retired[i].fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			i++;
+			continue;
+		}
+		glDeleteSync(ring.retired[i].fence);
+		gl_ring_delete_buffer(ring.retired[i].buffer, ring.retired[i].persistent);
+		ring.retired.erase(ring.retired.begin() + i);
+	}
+}
+
+void gl_ring_end_frame(gpu_ring_t& ring) {
+	if (ring.fences[ring.section]) glDeleteSync(ring.fences[ring.section]);
+	ring.fences[ring.section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Make sure the current section has room for size more bytes. Reserve once for everything a batch is about
+// to allocate: growing swaps in a new buffer, so only offsets handed out before this call point into the
+// old one, and those were for draws already submitted. The old buffer stays mapped and alive until a fence
+// after those draws signals, then gl_ring_begin_frame lets it go.
+void gl_ring_reserve(gpu_ring_t& ring, size_t size) {
+	if (ring.offset + size + ring.alignment <= ring.section_size)
+		return;
+
+	gl_ring_commit(ring);
+	size_t new_size = std::max(ring.section_size * 2, size + ring.alignment);
+
+	std::vector<gpu_ring_retired_t> retired = std::move(ring.retired);
+	retired.push_back({ ring.buffer, ring.persistent, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+	for (uint32_t i = 0; i < gpu_ring_frames; i++) {
+		if (ring.fences[i]) glDeleteSync(ring.fences[i]); // Only ever guarded the old buffer
+	}
+
+	uint32_t section = ring.section;
+	size_t alignment = ring.alignment;
+	gl_ring_create(ring, new_size, alignment);
+	ring.section = section;
+	ring.retired = std::move(retired);
+}
+
+// Returns where to write size bytes, and the buffer offset to bind them at
+uint8_t* gl_ring_alloc(gpu_ring_t& ring, size_t size, size_t& out_offset) {
+	size_t aligned = (ring.offset + ring.alignment - 1) / ring.alignment * ring.alignment;
+	if (aligned + size > ring.section_size) {
+		printf("GPU ring: allocation of %zu bytes wasn't reserved\n", size); // Growing here would move offsets already handed out
+		gl_ring_reserve(ring, size);
+		aligned = (ring.offset + ring.alignment - 1) / ring.alignment * ring.alignment;
+	}
+	ring.offset = aligned + size;
+	out_offset = ring.section * ring.section_size + aligned;
+	return ring.mapped + out_offset;
+}
+
+// Persistent and coherent mappings need nothing here, staging uploads everything written since the last commit
+void gl_ring_commit(gpu_ring_t& ring) {
+	if (ring.persistent || ring.offset == ring.committed)
+		return;
+
+	size_t start = ring.section * ring.section_size + ring.committed;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, start, ring.offset - ring.committed, ring.mapped + start);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	ring.committed = ring.offset;
+}
@@ -0,0 +1,188 @@
+#include <scene.h>
+
+Entity Scene::add(ModelHandle model, const Transform& transform) {
+	if (world.components.empty()) {
+		position   = ecs_register<glm::vec3>(world, "position");
+		rotation   = ecs_register<glm::quat>(world, "rotation");
+		scale      = ecs_register<glm::vec3>(world, "scale");
+		matrix     = ecs_register<glm::mat4>(world, "world");
+		renderable = ecs_register<scene_renderable_t>(world, "renderable");
+		parent     = ecs_register<hierarchy_node_t>(world, "parent");
+		dirty      = ecs_register<uint8_t>(world, "dirty"); // Transform set since the last update()
+	}
+
+	uint32_t model_index;
+	auto found = model_lookup.find(model.get());
+	if (found != model_lookup.end()) {
+		model_index = found->second;
+	}
+	else if (!free_models.empty()) {
+		model_index = free_models.back();
+		free_models.pop_back();
+		models[model_index] = { model, 0 };
+		model_lookup[model.get()] = model_index;
+	}
+	else {
+		model_index = (uint32_t)models.size();
+		models.push_back({ model, 0 });
+		model_lookup[model.get()] = model_index;
+	}
+	models[model_index].users++;
+
+	Entity entity = ecs_create(world, ecs_mask(position) | ecs_mask(rotation) | ecs_mask(scale) | ecs_mask(matrix) | ecs_mask(renderable) | ecs_mask(dirty));
+	*(glm::vec3*)ecs_write(world, entity, position) = transform.position;
+	*(glm::quat*)ecs_write(world, entity, rotation) = transform.rotation;
+	*(glm::vec3*)ecs_write(world, entity, scale) = transform.scale;
+	*(glm::mat4*)ecs_write(world, entity, matrix) = transformToMat4(transform);
+	*(scene_renderable_t*)ecs_write(world, entity, renderable) = { model_index, true };
+	stats.entities = world.count;
+	return entity;
+}
+
+void Scene::remove(Entity entity) {
+	if (!valid(entity))
+		return;
+	uint32_t model_index = ((const scene_renderable_t*)ecs_get(world, entity, renderable))->model;
+	scene_model_t& model = models[model_index];
+	if (--model.users == 0) {
+		model_lookup.erase(model.model.get());
+		model.model = nullptr; // The model can be released now, if nothing else holds it
+		free_models.push_back(model_index);
+	}
+	ecs_destroy(world, entity);
+	stats.entities = world.count;
+}
+
+bool Scene::valid(Entity entity) const {
+	return ecs_alive(world, entity);
+}
+
+Transform Scene::getTransform(Entity entity) const {
+	if (!valid(entity))
+		return { glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f) };
+	return {
+		*(const glm::vec3*)ecs_get(world, entity, position),
+		*(const glm::quat*)ecs_get(world, entity, rotation),
+		*(const glm::vec3*)ecs_get(world, entity, scale) };
+}
+
+// All three are written together, so update() only has to watch position for changes. The position's
+// chunk version says which chunks to visit, the dirty flag which rows in them.
+void Scene::setTransform(Entity entity, const Transform& transform) {
+	if (!valid(entity)) {
+		printf("Scene: setTransform on an entity that was removed\n");
+		return;
+	}
+	*(glm::vec3*)ecs_write(world, entity, position) = transform.position;
+	*(glm::quat*)ecs_write(world, entity, rotation) = transform.rotation;
+	*(glm::vec3*)ecs_write(world, entity, scale) = transform.scale;
+	*(uint8_t*)ecs_write(world, entity, dirty) = 1;
+}
+
+void Scene::setVisible(Entity entity, bool visible) {
+	if (valid(entity))
+		((scene_renderable_t*)ecs_write(world, entity, renderable))->visible = visible;
+}
+
+// Moves the entity to the archetype with a parent component, or back out of it
+void Scene::setParent(Entity entity, hierarchy_node_t node) {
+	if (!valid(entity)) {
+		printf("Scene: setParent on an entity that was removed\n");
+		return;
+	}
+	if (node.index == UINT32_MAX) {
+		ecs_remove(world, entity, parent);
+	}
+	else {
+		ecs_add(world, entity, parent);
+		*(hierarchy_node_t*)ecs_write(world, entity, parent) = node;
+	}
+	ecs_write(world, entity, position); // Rebuild it either way
+	*(uint8_t*)ecs_write(world, entity, dirty) = 1;
+}
+
+///////////////////////////////////////////
+
+void Scene::update() {
+	stats.updated = 0;
+	if (world.components.empty())
+		return;
+
+	ecs_mask_t transform = ecs_mask(position) | ecs_mask(rotation) | ecs_mask(scale) | ecs_mask(matrix);
+	std::atomic<uint32_t> updated(0);
+
+	// Roots, only the dirty rows of chunks where a transform was written
+	ecs_query_t roots = { transform | ecs_mask(dirty), ecs_mask(parent), position, updated_version };
+	ecs_for_each_parallel(world, roots, [this, &updated](ecs_view_t& view) {
+		const glm::vec3* positions = view.read<glm::vec3>(position);
+		const glm::quat* rotations = view.read<glm::quat>(rotation);
+		const glm::vec3* scales    = view.read<glm::vec3>(scale);
+		glm::mat4*       worlds    = view.write<glm::mat4>(matrix);
+		uint8_t*         dirties   = view.write<uint8_t>(dirty);
+		uint32_t rebuilt = 0;
+		for (uint32_t i = 0; i < view.count; i++) {
+			if (!dirties[i])
+				continue;
+			worlds[i] = transformToMat4({ positions[i], rotations[i], scales[i] });
+			dirties[i] = 0;
+			rebuilt++;
+		}
+		updated += rebuilt;
+	});
+
+	// Children, also wherever their node was rebuilt since last time. A removed node leaves them at the origin.
+	ecs_query_t children = { transform | ecs_mask(parent) | ecs_mask(dirty), 0, 0, 0 };
+	ecs_for_each(world, children, [this, &updated](ecs_view_t& view) {
+		const hierarchy_node_t* nodes = view.read<hierarchy_node_t>(parent);
+		const glm::vec3* positions = view.read<glm::vec3>(position);
+		const glm::quat* rotations = view.read<glm::quat>(rotation);
+		const glm::vec3* scales    = view.read<glm::vec3>(scale);
+		glm::mat4*       worlds    = view.write<glm::mat4>(matrix);
+		uint8_t*         dirties   = view.write<uint8_t>(dirty);
+		for (uint32_t i = 0; i < view.count; i++) {
+			if (!dirties[i] && hierarchy_valid(*hierarchy, nodes[i]) && hierarchy_version(*hierarchy, nodes[i]) <= hierarchy_seen)
+				continue;
+			worlds[i] = hierarchy_world(*hierarchy, nodes[i]) * transformToMat4({ positions[i], rotations[i], scales[i] });
+			dirties[i] = 0;
+			updated++;
+		}
+	});
+	stats.updated = updated;
+
+	// Writes from here on land in a newer version than the one just rebuilt
+	updated_version = world.version;
+	hierarchy_seen = hierarchy->version;
+	ecs_tick(world);
+}
+
+// Entities of the same model come out as identical meshes, so the queue can turn them into one instanced draw
+void Scene::draw(draw_list_t& list) {
+	stats.drawn = 0;
+	if (world.components.empty())
+		return;
+
+	ecs_query_t query = { ecs_mask(matrix) | ecs_mask(renderable), 0, 0, 0 };
+	ecs_for_each(world, query, [this, &list](ecs_view_t& view) {
+		const glm::mat4*          worlds      = view.read<glm::mat4>(matrix);
+		const scene_renderable_t* renderables = view.read<scene_renderable_t>(renderable);
+		for (uint32_t i = 0; i < view.count; i++) {
+			if (!renderables[i].visible)
+				continue;
+			const Model& model = *models[renderables[i].model].model;
+			if (!model.uploaded())
+				continue;
+			draw_list_push(list, model.drawMesh(model.selectLod(worlds[i]), false), worlds[i], model.bounds);
+			stats.drawn++;
+		}
+	});
+}
+
+void Scene::clear() {
+	ecs_clear(world);
+	models.clear();
+	free_models.clear();
+	model_lookup.clear();
+	updated_version = 0;
+	hierarchy_seen = 0;
+	stats = {};
+}
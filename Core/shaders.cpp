@@ -21,8 +21,8 @@ std::string get_file_contents(const char* filename)
 Shaders::Shaders(const char* vertexFile, const char* fragmentFile)
 {
 	// Read vertexFile and fragmentFile and store the strings
-	std::string vertexCode = get_file_contents(vertexFile);
-	std::string fragmentCode = get_file_contents(fragmentFile);
+	vertexCode = get_file_contents(vertexFile);
+	fragmentCode = get_file_contents(fragmentFile);
 
 	// Convert the shader source strings into character arrays
 	vertexShader = vertexCode.c_str();
@@ -33,7 +33,7 @@ Shaders::Shaders(const char* vertexFile, const char* fragmentFile)
 void Shaders::loadVertexShader(const char* vertexFile)
 {
 	// Read vertexFile and store the string
-	std::string vertexCode = get_file_contents(vertexFile);
+	vertexCode = get_file_contents(vertexFile);
 	// Convert the shader source string into a character array
 	vertexShader = vertexCode.c_str();
 }
@@ -42,7 +42,7 @@ void Shaders::loadVertexShader(const char* vertexFile)
 void Shaders::loadFragmentShader(const char* fragmentFile)
 {
 	// Read fragmentFile and store the string
-	std::string fragmentCode = get_file_contents(fragmentFile);
+	fragmentCode = get_file_contents(fragmentFile);
 	// Convert the shader source string into a character array
 	fragmentShader = fragmentCode.c_str();
 }
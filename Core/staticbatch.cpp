@@ -0,0 +1,211 @@
+#include <staticbatch.h>
+
+void static_batch_add(static_batch_t& batch, Model& model, const Transform& transform) {
+	batch.sources.push_back({ &model, transform });
+}
+
+///////////////////////////////////////////
+
+// Read the full detail level straight out of the model's buffers, or its slice of a mesh pool
+bool static_batch_read(const Model& model, std::vector<float>& vertices, std::vector<uint32_t>& indices) {
+	if (model.lods.empty())
+		return false;
+	upload_wait(model.upload);
+
+	const lod_range_t& lod = model.lods[0];
+	size_t vertex_stride = model.quantized ? sizeof(vertex_quantized_t) : vertex_float_stride * sizeof(float);
+	size_t index_size = model.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	GLuint vbo = model.vbo, ebo = model.ebo;
+	size_t vertex_offset = 0, index_offset = (size_t)lod.first_index * index_size;
+	uint32_t vertex_count = 0;
+	if (model.pooled) {
+		const mesh_pool_t& pool = app_mesh_pools.pools[model.pool.format];
+		vbo = pool.vbo;
+		ebo = pool.ebo;
+		vertex_offset = (size_t)model.pool.vertices.first * vertex_stride;
+		index_offset = ((size_t)model.pool.indices.first + lod.first_index) * sizeof(uint32_t);
+		vertex_count = model.pool.vertices.count;
+	}
+	else {
+		GLint bytes = 0;
+		glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+		glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &bytes);
+		vertex_count = (uint32_t)(bytes / vertex_stride);
+	}
+
+	std::vector<uint8_t> data((size_t)vertex_count * vertex_stride);
+	glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, vertex_offset, data.size(), data.data());
+	if (model.quantized) {
+		vertex_dequantize((const vertex_quantized_t*)data.data(), vertex_count, model.bounds.min, model.bounds.max, vertices);
+	}
+	else {
+		vertices.resize((size_t)vertex_count * vertex_float_stride);
+		memcpy(vertices.data(), data.data(), data.size());
+	}
+
+	data.resize((size_t)lod.index_count * index_size);
+	glBindBuffer(GL_COPY_READ_BUFFER, ebo);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, index_offset, data.size(), data.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	indices.resize(lod.index_count);
+	for (uint32_t i = 0; i < lod.index_count; i++) {
+		indices[i] = index_size == sizeof(uint16_t) ? ((const uint16_t*)data.data())[i] : ((const uint32_t*)data.data())[i];
+	}
+	return true;
+}
+
+// Transform the placement into world space, then hand each triangle to the chunk of the cell its centroid
+// is in. A vertex is copied once per chunk that uses it.
+void static_batch_merge(const float* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count, const glm::mat4& world,
+                        float cell_size, std::unordered_map<uint64_t, uint32_t>& cells, std::vector<static_batch_chunk_t>& chunks) {
+	glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(world)));
+	std::vector<float> transformed(vertices, vertices + (size_t)vertex_count * vertex_float_stride);
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		float* v = &transformed[(size_t)i * vertex_float_stride];
+		glm::vec3 position = glm::vec3(world * glm::vec4(v[0], v[1], v[2], 1.0f));
+		glm::vec3 normal = normal_matrix * glm::vec3(v[3], v[4], v[5]);
+		if (glm::dot(normal, normal) > 0.0f)
+			normal = glm::normalize(normal);
+		v[0] = position.x; v[1] = position.y; v[2] = position.z;
+		v[3] = normal.x;   v[4] = normal.y;   v[5] = normal.z;
+	}
+
+	// Mirrored placements would turn inside out
+	bool flip = glm::determinant(glm::mat3(world)) < 0.0f;
+
+	std::unordered_map<uint32_t, std::vector<uint32_t>> remaps; // Chunk to its vertex for each source vertex, UINT32_MAX until used
+	for (uint32_t t = 0; t + 2 < index_count; t += 3) {
+		uint32_t corners[3] = { indices[t], indices[t + 1], indices[t + 2] };
+		if (flip)
+			std::swap(corners[1], corners[2]);
+
+		glm::vec3 centroid(0.0f);
+		for (uint32_t corner : corners) {
+			centroid += glm::vec3(transformed[(size_t)corner * vertex_float_stride], transformed[(size_t)corner * vertex_float_stride + 1], transformed[(size_t)corner * vertex_float_stride + 2]);
+		}
+		glm::ivec3 cell = cell_size > 0.0f ? glm::ivec3(glm::floor(centroid / (3.0f * cell_size))) : glm::ivec3(0);
+		uint64_t key = ((uint64_t)(cell.x & 0x1FFFFF) << 42) | ((uint64_t)(cell.y & 0x1FFFFF) << 21) | (uint64_t)(cell.z & 0x1FFFFF);
+
+		auto found = cells.find(key);
+		uint32_t chunk_index;
+		if (found == cells.end()) {
+			chunk_index = (uint32_t)chunks.size();
+			cells[key] = chunk_index;
+			chunks.emplace_back();
+		}
+		else {
+			chunk_index = found->second;
+		}
+		static_batch_chunk_t& chunk = chunks[chunk_index];
+
+		std::vector<uint32_t>& remap = remaps[chunk_index];
+		if (remap.empty()) {
+			remap.assign(vertex_count, UINT32_MAX);
+			chunk.sources++;
+		}
+		for (uint32_t corner : corners) {
+			if (remap[corner] == UINT32_MAX) {
+				remap[corner] = (uint32_t)(chunk.vertices.size() / vertex_float_stride);
+				const float* v = &transformed[(size_t)corner * vertex_float_stride];
+				chunk.vertices.insert(chunk.vertices.end(), v, v + vertex_float_stride);
+			}
+			chunk.indices.push_back(remap[corner]);
+		}
+	}
+}
+
+///////////////////////////////////////////
+
+void static_batch_build(static_batch_t& batch, static_scene_t& scene) {
+	if (batch.sources.empty())
+		return;
+
+	if (!app_config_static_batching) {
+		for (const static_batch_source_t& source : batch.sources) {
+			static_scene_add(scene, *source.model, source.transform);
+		}
+		batch.sources.clear();
+		return;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	batch.stats = {};
+
+	// Sources sharing a texture end up next to each other, and so do placements of the same model
+	std::vector<static_batch_source_t> sources = batch.sources;
+	std::stable_sort(sources.begin(), sources.end(), [](const static_batch_source_t& a, const static_batch_source_t& b) {
+		return std::make_tuple(a.model->texture.get(), a.model->textureID, a.model) < std::make_tuple(b.model->texture.get(), b.model->textureID, b.model);
+	});
+
+	std::vector<static_batch_chunk_t> chunks;
+	std::unordered_map<uint64_t, uint32_t> cells;
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<Model*> models;
+	bool readable = false;
+	for (size_t i = 0; i < sources.size(); i++) {
+		const static_batch_source_t& source = sources[i];
+		const Model& model = *source.model;
+		bool new_model = i == 0 || source.model != sources[i - 1].model;
+		if (i == 0 || model.texture != sources[i - 1].model->texture || model.textureID != sources[i - 1].model->textureID) {
+			cells.clear(); // A new material starts its own chunks
+		}
+		if (new_model) {
+			readable = static_batch_read(model, vertices, indices);
+			if (!readable) {
+				printf("Static batching: skipped a model that isn't loaded\n");
+				continue;
+			}
+			models.push_back(source.model);
+		}
+		if (!readable)
+			continue;
+
+		size_t first_chunk = chunks.size();
+		static_batch_merge(vertices.data(), (uint32_t)(vertices.size() / vertex_float_stride), indices.data(), (uint32_t)indices.size(),
+			transformToMat4(source.transform), app_config_static_batch_cell, cells, chunks);
+		for (size_t c = first_chunk; c < chunks.size(); c++) {
+			chunks[c].texture = model.texture;
+			chunks[c].texture_id = model.textureID;
+		}
+		batch.stats.sources++;
+	}
+
+	// Each chunk becomes a model of its own, drawn and culled by the static scene at its world position
+	Transform identity = { glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f) };
+	for (size_t c = 0; c < chunks.size(); c++) {
+		static_batch_chunk_t& chunk = chunks[c];
+		batch.stats.triangles += (uint32_t)(chunk.indices.size() / 3);
+
+		ModelHandle merged = std::make_shared<Model>();
+		merged->loadMesh("static batch " + std::to_string(batch.chunks.size()), chunk.vertices, chunk.indices, chunk.texture);
+		if (!chunk.texture)
+			merged->textureID = chunk.texture_id;
+		static_scene_add(scene, *merged, identity);
+		batch.chunks.push_back(merged);
+		chunk = {}; // Done with the CPU copy
+	}
+
+	if (app_config_static_batch_free_sources) {
+		for (Model* model : models) {
+			if (!asset_release_model(model))
+				batch.stats.kept++;
+		}
+	}
+
+	batch.stats.models = (uint32_t)models.size();
+	batch.stats.chunks = (uint32_t)chunks.size();
+	batch.stats.build_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("Static batching: %u placements of %u models -> %u chunks, %u triangles in %.1f ms, %u sources kept\n",
+		batch.stats.sources, batch.stats.models, batch.stats.chunks, batch.stats.triangles, batch.stats.build_ms, batch.stats.kept);
+	batch.sources.clear();
+}
+
+// Call after static_scene_clear(), the scene points at the chunks
+void static_batch_clear(static_batch_t& batch) {
+	for (const ModelHandle& chunk : batch.chunks) {
+		chunk->cleanupModel();
+	}
+	batch = {};
+}
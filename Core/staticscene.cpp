@@ -0,0 +1,137 @@
+#include <staticscene.h>
+
+uint32_t static_scene_add(static_scene_t& scene, const Model& model, const Transform& transform) {
+	glm::mat4 world = transformToMat4(transform);
+	scene.objects.push_back({ &model, world });
+	scene.boxes.push_back(cull_world_box(model.bounds, world));
+	return (uint32_t)scene.objects.size() - 1;
+}
+
+// For objects that move rarely: the box is updated now and the tree refit next update, rather than rebuilt
+void static_scene_move(static_scene_t& scene, uint32_t object, const Transform& transform) {
+	static_object_t& entry = scene.objects[object];
+	entry.world = transformToMat4(transform);
+	scene.boxes[object] = cull_world_box(entry.model->bounds, entry.world);
+	scene.moved = true;
+}
+
+// Once per frame: swap in a finished build, start a new one if objects were added, and refit after moves
+void static_scene_update(static_scene_t& scene) {
+	if (scene.build_job && jobs_done(scene.build_job)) {
+		std::swap(scene.bvh, scene.bvh_building);
+		scene.built_count = scene.building_count;
+		scene.build_ms = scene.building_ms;
+		scene.build_job = nullptr;
+		scene.moved = true; // The build saw a snapshot, catch up with anything that moved since
+	}
+
+	if (!scene.build_job && scene.built_count < scene.objects.size()) {
+		// The job gets its own copy of the boxes, so the main thread can keep adding and moving objects
+		static_scene_t* target = &scene;
+		std::vector<aabb_t> boxes = scene.boxes;
+		scene.building_count = (uint32_t)boxes.size();
+		scene.build_job = jobs_submit([target, boxes]() {
+			auto start = std::chrono::high_resolution_clock::now();
+			bvh_build(target->bvh_building, boxes);
+			target->building_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		});
+	}
+
+	if (scene.moved && scene.built_count > 0) {
+		bvh_refit(scene.bvh, scene.boxes);
+		scene.moved = false;
+	}
+}
+
+// Rasterize the nearest visible objects that have occluder meshes into the occlusion buffer
+void static_scene_draw_occluders(static_scene_t& scene, occlusion_buffer_t& buffer, const glm::vec3& eye_position) {
+	scene.occluders.clear();
+	for (uint32_t object : scene.visible) {
+		if (scene.objects[object].model->occluderIndices.empty())
+			continue;
+		glm::vec3 center = (scene.boxes[object].min + scene.boxes[object].max) * 0.5f;
+		scene.occluders.push_back({ glm::distance(center, eye_position), object });
+	}
+
+	size_t count = std::min(scene.occluders.size(), (size_t)app_config_occluders_per_frame);
+	std::partial_sort(scene.occluders.begin(), scene.occluders.begin() + count, scene.occluders.end());
+	for (size_t i = 0; i < count; i++) {
+		const static_object_t& entry = scene.objects[scene.occluders[i].second];
+		const Model& model = *entry.model;
+		occlusion_add_occluder(buffer, model.occluderVertices.data(), model.occluderIndices.data(), model.occluderIndices.size(), entry.world);
+	}
+	occlusion_rasterize(buffer);
+}
+
+// Queue every visible static object. These skip the render queue's own culling, the BVH already did it,
+// and once per frame the nearest of them are drawn as occluders and the rest tested against them.
+void static_scene_draw(static_scene_t& scene, render_queue_t& queue, const frustum_t& frustum) {
+	scene.visible.clear();
+	if (app_config_culling) {
+		bvh_cull(scene.bvh, scene.boxes, frustum, scene.visible, scene.stats);
+	}
+	else {
+		for (uint32_t i = 0; i < scene.built_count; i++) {
+			scene.visible.push_back(i);
+		}
+	}
+
+	// occlusion_begin() was called for this frame but nothing has been drawn into it yet
+	bool occlusion = app_config_occlusion && app_config_culling && !app_occlusion.tiles.empty();
+	if (occlusion && !app_occlusion.ready) {
+		static_scene_draw_occluders(scene, app_occlusion, queue.eye_position);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t object : scene.visible) {
+		if (occlusion && !occlusion_test_box(app_occlusion, scene.boxes[object]))
+			continue;
+
+		const static_object_t& entry = scene.objects[object];
+		const Model& model = *entry.model;
+		if (!model.uploaded())
+			continue;
+		render_queue_push_visible(queue, model.drawMesh(model.selectLod(entry.world), false), entry.world);
+	}
+	if (occlusion) {
+		app_occlusion.stats.test_us += std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Not in the tree yet, the queue culls these one at a time
+	for (size_t i = scene.built_count; i < scene.objects.size(); i++) {
+		const static_object_t& entry = scene.objects[i];
+		const Model& model = *entry.model;
+		if (!model.uploaded())
+			continue;
+		render_queue_push(queue, model.drawMesh(model.selectLod(entry.world), false), entry.world, model.bounds);
+	}
+}
+
+///////////////////////////////////////////
+
+// Nearest object whose box the ray passes through
+static_hit_t static_scene_raycast(const static_scene_t& scene, const glm::vec3& origin, const glm::vec3& direction, float max_distance) {
+	static_hit_t result = { false, 0, max_distance };
+	result.hit = bvh_raycast(scene.bvh, scene.boxes, origin, direction, max_distance, result.object, result.distance);
+
+	glm::vec3 inv_direction = 1.0f / direction;
+	for (size_t i = scene.built_count; i < scene.objects.size(); i++) {
+		float t = bvh_ray_box(origin, inv_direction, scene.boxes[i].min, scene.boxes[i].max, result.distance);
+		if (t < result.distance) {
+			result = { true, (uint32_t)i, t };
+		}
+	}
+	return result;
+}
+
+// Ray down the pose's forward (-z) axis, as used for controller pointing
+static_hit_t static_scene_raycast_pose(const static_scene_t& scene, const XrPosef& pose, float max_distance) {
+	glm::quat orientation(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z);
+	glm::vec3 origin(pose.position.x, pose.position.y, pose.position.z);
+	return static_scene_raycast(scene, origin, orientation * glm::vec3(0.0f, 0.0f, -1.0f), max_distance);
+}
+
+void static_scene_clear(static_scene_t& scene) {
+	jobs_wait(scene.build_job);
+	scene = {};
+}
@@ -0,0 +1,308 @@
+#include <streaming.h>
+
+uint32_t stream_level_width(const stream_texture_t& texture, uint32_t level) {
+	return glm::max(texture.width >> level, 1u);
+}
+
+uint32_t stream_level_height(const stream_texture_t& texture, uint32_t level) {
+	return glm::max(texture.height >> level, 1u);
+}
+
+size_t stream_level_bytes(const stream_texture_t& texture, uint32_t level) {
+	if (texture.compressed)
+		return texture.baked.levels[level].blocks.size();
+	return (size_t)stream_level_width(texture, level) * stream_level_height(texture, level) * 4; // Drivers pad RGB to 4 bytes
+}
+
+// Bytes of levels [first, last)
+size_t stream_chain_bytes(const stream_texture_t& texture, uint32_t first, uint32_t last) {
+	size_t bytes = 0;
+	for (uint32_t level = first; level < last; level++) {
+		bytes += stream_level_bytes(texture, level);
+	}
+	return bytes;
+}
+
+// Goes through the staging ring, the handle drops once the GL thread has issued every piece
+void stream_stage_level(const stream_texture_t& texture, uint32_t level, const job_handle_t& handle) {
+	uint32_t width = stream_level_width(texture, level), height = stream_level_height(texture, level);
+	if (texture.compressed) {
+		const texture_level_t& blocks = texture.baked.levels[level];
+		upload_texture_compressed(texture.id, level, width, height, texture.format, blocks.blocks.data(), blocks.blocks.size(), handle);
+	} else {
+		upload_texture(texture.id, level, width, height, texture.format, texture.levels[level].pixels.data(), handle);
+	}
+}
+
+// Respecifying a level as empty lets the driver free it, it's below the base level so sampling never sees it
+void stream_evict_level(const stream_texture_t& texture, uint32_t level) {
+	if (texture.compressed)
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.format, 0, 0, 0, 0, nullptr);
+	else
+		glTexImage2D(GL_TEXTURE_2D, level, texture.format, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+}
+
+///////////////////////////////////////////
+
+// Runs on a worker: a baked .ktx2 is read as is, anything else is decoded and gets its mips built
+void stream_decode_levels(stream_texture_t& texture) {
+	if (app_config_prefer_ktx2 && ktx_read(ktx_sibling_path(texture.path).c_str(), texture.baked) &&
+		(texture.baked.format == TEXTURE_FORMAT_BC7 || gl_texture_s3tc)) {
+		texture.compressed = true;
+		texture.format = texture_gl_format(texture.baked.format, texture.baked.srgb);
+		texture.width = texture.baked.levels[0].width;
+		texture.height = texture.baked.levels[0].height;
+		texture.level_count = (uint32_t)texture.baked.levels.size();
+		return;
+	}
+	texture.baked.levels.clear();
+
+	int width, height, channels;
+	unsigned char* data = stbi_load(texture.path.c_str(), &width, &height, &channels, 4);
+	if (!data) {
+		printf("Streaming: can't load %s\n", texture.path.c_str());
+		texture.level_count = 0;
+		return;
+	}
+	texture_image_t image = { (uint32_t)width, (uint32_t)height };
+	image.pixels.assign(data, data + (size_t)width * height * 4);
+	stbi_image_free(data);
+
+	texture_build_mips(image, true, texture.levels);
+	texture.compressed = false;
+	texture.format = channels == 3 ? GL_RGB : GL_RGBA;
+	texture.width = image.width;
+	texture.height = image.height;
+	texture.level_count = (uint32_t)texture.levels.size();
+}
+
+// Then the levels up to the resident size are staged from the same worker
+void stream_decode(stream_texture_t& texture) {
+	stream_decode_levels(texture);
+	if (texture.level_count == 0)
+		return;
+
+	texture.floor = texture.level_count - 1;
+	while (texture.floor > 0 && glm::max(stream_level_width(texture, texture.floor - 1), stream_level_height(texture, texture.floor - 1)) <= app_config_stream_resident_size) {
+		texture.floor--;
+	}
+	for (uint32_t level = texture.level_count; level-- > texture.floor;) {
+		stream_stage_level(texture, level, texture.decode);
+	}
+}
+
+// The always resident levels go into a texture page as well, straight from system memory. While nothing
+// finer is wanted the texture is drawn from there, so it batches with the rest of the page.
+void stream_page_levels(stream_texture_t& texture) {
+	uint32_t width = stream_level_width(texture, texture.floor), height = stream_level_height(texture, texture.floor);
+	GLenum format = texture.compressed ? texture.format : texture.format == GL_RGB ? GL_RGB8 : GL_RGBA8; // Pages need sized formats
+	if (!texture_pages_alloc(format, width, height, texture.level_count - texture.floor, texture.page, texture.layer))
+		return;
+	texture.paged = true;
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, app_texture_pages.pages[texture.page].array);
+	for (uint32_t level = texture.floor; level < texture.level_count; level++) {
+		width = stream_level_width(texture, level);
+		height = stream_level_height(texture, level);
+		if (texture.compressed) {
+			const texture_level_t& blocks = texture.baked.levels[level];
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level - texture.floor, 0, 0, texture.layer, width, height, 1, format, (GLsizei)blocks.blocks.size(), blocks.blocks.data());
+		} else {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level - texture.floor, 0, 0, texture.layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, texture.levels[level].pixels.data());
+		}
+	}
+}
+
+// Once the decode and its uploads land the texture is usable
+void stream_make_ready(stream_texture_t& texture) {
+	texture.ready = true;
+	texture.decode = nullptr;
+	texture.uploading = texture.level_count;
+	if (texture.level_count == 0)
+		return;
+
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.level_count - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.floor);
+	texture.resident_base = texture.floor;
+	texture.target_base = texture.floor;
+	stream_page_levels(texture);
+}
+
+// A finer level finished uploading, switch to it
+void stream_land_level(stream_texture_t& texture) {
+	uint32_t level = texture.uploading;
+	texture.uploading = texture.level_count;
+	texture.upload = nullptr;
+	texture.resident_base = level;
+
+	// MIN_LOD is relative to the base level, starting at 1 samples exactly what was there before
+	texture.min_lod = app_config_stream_fade > 0.0f ? glm::min(texture.min_lod + 1.0f, 2.0f) : 0.0f;
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, texture.min_lod);
+}
+
+///////////////////////////////////////////
+
+Texture stream_texture_load(const std::string& path) {
+	// The asset cache counts these at zero, app_stream.stats has what's actually resident
+	Texture texture = { 0, "texture_diffuse", path, 0, 0, 0 };
+	glGenTextures(1, &texture.id);
+
+	// Flat grey until the decode lands, real levels replace it
+	const uint32_t grey = 0xFF808080;
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &grey);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// Map nodes don't move, so the job can hold on to this one
+	stream_texture_t& stream = app_stream.textures[texture.id];
+	stream = {};
+	stream.id = texture.id;
+	stream.path = path;
+	stream_texture_t* decoding = &stream;
+	stream.decode = std::make_shared<job_counter_t>();
+	stream.decode->pending = 0;
+	jobs_submit([decoding]() { stream_decode(*decoding); }, stream.decode); // The job's uploads count under the same handle
+	return texture;
+}
+
+void stream_texture_release(GLuint id) {
+	auto it = app_stream.textures.find(id);
+	if (it == app_stream.textures.end())
+		return;
+	upload_wait(it->second.decode);
+	upload_wait(it->second.upload);
+	if (it->second.paged)
+		texture_pages_free(it->second.page, it->second.layer);
+	app_stream.textures.erase(it);
+}
+
+void stream_touch(GLuint id, float pixels) {
+	auto it = app_stream.textures.find(id);
+	if (it == app_stream.textures.end())
+		return;
+	it->second.pixels = glm::max(it->second.pixels, pixels);
+	it->second.last_seen = app_stream.frame;
+}
+
+bool stream_texture_page(GLuint id, uint32_t& out_page, uint32_t& out_layer) {
+	auto it = app_stream.textures.find(id);
+	if (it == app_stream.textures.end() || !it->second.paged || it->second.resident_base < it->second.floor)
+		return false;
+	out_page = it->second.page;
+	out_layer = it->second.layer;
+	return true;
+}
+
+// Each texture wants the level whose size matches how many pixels it covered, the budget then hands out
+// bytes biggest on screen first. Evictions go first so the budget holds, then uploads, finest level last
+// and one level at a time per texture so detail sharpens in steps within the per frame upload limit.
+void stream_update() {
+	stream_stats_t& stats = app_stream.stats;
+	stats = {};
+	stats.textures = (uint32_t)app_stream.textures.size();
+
+	std::vector<stream_texture_t*> order;
+	size_t resident_minimum = 0;
+	for (auto& it : app_stream.textures) {
+		stream_texture_t& texture = it.second;
+		if (!texture.ready) {
+			if (!jobs_done(texture.decode)) {
+				stats.decoding++;
+				continue;
+			}
+			stream_make_ready(texture);
+		}
+		if (texture.level_count == 0)
+			continue;
+		if (texture.uploading < texture.level_count && jobs_done(texture.upload)) {
+			stream_land_level(texture);
+			stats.uploaded_levels++;
+		}
+
+		texture.target_base = texture.floor;
+		if (texture.pixels > 0.0f && app_stream.frame - texture.last_seen <= app_config_stream_idle_frames) {
+			float texels = (float)glm::max(texture.width, texture.height);
+			float level = log2f(texels / glm::max(texture.pixels * app_config_stream_bias, 1.0f));
+			texture.target_base = (uint32_t)glm::clamp((int32_t)floorf(level), 0, (int32_t)texture.floor);
+		}
+		resident_minimum += stream_chain_bytes(texture, texture.floor, texture.level_count);
+		order.push_back(&texture);
+	}
+	// Ties go to what's already resident, so textures of equal priority don't trade levels back and forth
+	std::sort(order.begin(), order.end(), [](const stream_texture_t* a, const stream_texture_t* b) {
+		if (a->pixels != b->pixels)
+			return a->pixels > b->pixels;
+		if (a->resident_base != b->resident_base)
+			return a->resident_base < b->resident_base;
+		return a->id < b->id;
+	});
+
+	size_t remaining = app_config_texture_budget > resident_minimum ? app_config_texture_budget - resident_minimum : 0;
+	for (stream_texture_t* texture : order) {
+		size_t extra = stream_chain_bytes(*texture, texture->target_base, texture->floor);
+		while (texture->target_base < texture->floor && extra > remaining) {
+			extra -= stream_level_bytes(*texture, texture->target_base);
+			texture->target_base++;
+		}
+		remaining -= extra;
+	}
+
+	for (stream_texture_t* texture : order) {
+		if (texture->resident_base >= texture->target_base || texture->uploading < texture->level_count)
+			continue;
+		glBindTexture(GL_TEXTURE_2D, texture->id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture->target_base);
+		for (uint32_t level = texture->resident_base; level < texture->target_base; level++) {
+			stream_evict_level(*texture, level);
+			stats.evicted_levels++;
+		}
+		texture->resident_base = texture->target_base;
+		texture->min_lod = 0.0f;
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, 0.0f);
+	}
+
+	// Next level down for each texture that wants more, staged by a worker and issued by upload_update
+	size_t queued = 0;
+	for (stream_texture_t* texture : order) {
+		if (texture->resident_base <= texture->target_base || texture->uploading < texture->level_count)
+			continue;
+		if (queued > 0 && queued >= app_config_stream_upload_bytes)
+			break;
+		uint32_t level = texture->resident_base - 1;
+		texture->uploading = level;
+		texture->upload = std::make_shared<job_counter_t>();
+		texture->upload->pending = 0;
+		jobs_submit([texture, level]() { stream_stage_level(*texture, level, texture->upload); }, texture->upload);
+		queued += stream_level_bytes(*texture, level);
+		stats.uploaded_bytes += stream_level_bytes(*texture, level);
+	}
+
+	for (stream_texture_t* texture : order) {
+		if (texture->min_lod > 0.0f) {
+			texture->min_lod = glm::max(texture->min_lod - app_config_stream_fade, 0.0f);
+			glBindTexture(GL_TEXTURE_2D, texture->id);
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, texture->min_lod);
+		}
+		stats.resident_bytes += stream_chain_bytes(*texture, texture->resident_base, texture->level_count);
+		stats.uploading += texture->uploading < texture->level_count ? 1 : 0;
+		texture->pixels = 0.0f;
+	}
+	app_stream.frame++;
+}
+
+void stream_shutdown() {
+	for (auto& it : app_stream.textures) {
+		upload_wait(it.second.decode);
+		upload_wait(it.second.upload);
+		if (it.second.paged)
+			texture_pages_free(it.second.page, it.second.layer);
+	}
+	app_stream.textures.clear();
+}
@@ -0,0 +1,593 @@
+#include <texcompress.h>
+
+uint32_t texture_block_bytes(texture_format_t format) {
+	return format == TEXTURE_FORMAT_BC1 ? 8 : 16;
+}
+
+GLenum texture_gl_format(texture_format_t format, bool srgb) {
+	switch (format) {
+	case TEXTURE_FORMAT_BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TEXTURE_FORMAT_BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case TEXTURE_FORMAT_BC7: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	default:                 return 0;
+	}
+}
+
+const char* texture_format_name(texture_format_t format) {
+	switch (format) {
+	case TEXTURE_FORMAT_BC1:  return "BC1";
+	case TEXTURE_FORMAT_BC3:  return "BC3";
+	case TEXTURE_FORMAT_BC7:  return "BC7";
+	case TEXTURE_FORMAT_AUTO: return "auto";
+	default:                  return "unknown";
+	}
+}
+
+bool texture_has_alpha(const texture_image_t& image) {
+	for (size_t i = 3; i < image.pixels.size(); i += 4) {
+		if (image.pixels[i] != 255)
+			return true;
+	}
+	return false;
+}
+
+///////////////////////////////////////////
+
+// Filter taps along one axis: every output texel reads `count` source texels starting at first[i]. Taps that
+// fall off the edge are folded onto the edge texel, as a clamped sampler would.
+struct texture_taps_t {
+	std::vector<uint32_t> first;
+	std::vector<float>    weights; // count per output texel
+	uint32_t              count;
+};
+
+float texture_sinc(float x) {
+	if (fabsf(x) < 1e-5f)
+		return 1.0f;
+	x *= glm::pi<float>();
+	return sinf(x) / x;
+}
+
+// Modified Bessel function of the first kind, order zero, for the Kaiser window
+float texture_bessel_i0(float x) {
+	float sum = 1.0f, term = 1.0f;
+	for (int k = 1; k < 20; k++) {
+		term *= (x * 0.5f / k) * (x * 0.5f / k);
+		sum += term;
+	}
+	return sum;
+}
+
+// Support is in destination texels
+float texture_filter_radius(texture_mip_filter_t filter) {
+	return filter == TEXTURE_MIP_BOX ? 0.5f : 3.0f;
+}
+
+float texture_filter_weight(texture_mip_filter_t filter, float x) {
+	const float radius = texture_filter_radius(filter);
+	if (fabsf(x) >= radius)
+		return 0.0f;
+	switch (filter) {
+	case TEXTURE_MIP_LANCZOS:
+		return texture_sinc(x) * texture_sinc(x / radius);
+	case TEXTURE_MIP_KAISER: {
+		const float beta = 4.0f;
+		float window = x / radius;
+		return texture_sinc(x) * texture_bessel_i0(beta * sqrtf(1.0f - window * window)) / texture_bessel_i0(beta);
+	}
+	default:
+		return 1.0f;
+	}
+}
+
+void texture_build_taps(uint32_t source_size, uint32_t dest_size, texture_mip_filter_t filter, texture_taps_t& out_taps) {
+	float scale = (float)source_size / dest_size;
+	float support = texture_filter_radius(filter) * scale;
+	out_taps.count = glm::min(source_size, (uint32_t)ceilf(support * 2.0f) + 2);
+	out_taps.first.resize(dest_size);
+	out_taps.weights.assign((size_t)dest_size * out_taps.count, 0.0f);
+
+	for (uint32_t i = 0; i < dest_size; i++) {
+		float center = (i + 0.5f) * scale;
+		int32_t low = (int32_t)floorf(center - support - 0.5f);
+		int32_t high = (int32_t)ceilf(center + support - 0.5f);
+		uint32_t first = (uint32_t)glm::clamp(low, 0, (int32_t)(source_size - out_taps.count));
+		out_taps.first[i] = first;
+
+		float* weights = &out_taps.weights[(size_t)i * out_taps.count];
+		float total = 0.0f;
+		for (int32_t j = low; j <= high; j++) {
+			float weight = texture_filter_weight(filter, (j + 0.5f - center) / scale);
+			weights[glm::clamp(j, 0, (int32_t)source_size - 1) - first] += weight;
+			total += weight;
+		}
+		for (uint32_t k = 0; k < out_taps.count; k++) {
+			weights[k] /= total;
+		}
+	}
+}
+
+// 8 bit values to the space we filter in, and back. Color channels of sRGB images are averaged as light,
+// averaging the encoded values is what makes box filtered mips darker than the texture they came from.
+struct texture_transfer_t {
+	float   to_linear[256];
+	uint8_t to_encoded[16384];
+
+	texture_transfer_t(bool srgb) {
+		for (int i = 0; i < 256; i++) {
+			float v = i / 255.0f;
+			to_linear[i] = !srgb ? v : v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < 16384; i++) {
+			float v = i / 16383.0f;
+			float encoded = !srgb ? v : v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+			to_encoded[i] = (uint8_t)(encoded * 255.0f + 0.5f);
+		}
+	}
+};
+
+// Separable: each output row sums the filtered source rows, then filters that row horizontally. Rows are
+// spread across the job system; each job keeps the source rows it has converted to linear in a small ring,
+// since neighbouring output rows read mostly the same source rows.
+void texture_downsample(const texture_image_t& source, bool srgb, texture_mip_filter_t filter, texture_image_t& out_image) {
+	static const texture_transfer_t transfer_linear(false), transfer_srgb(true);
+	const texture_transfer_t& transfer = srgb ? transfer_srgb : transfer_linear;
+
+	out_image.width = glm::max(source.width / 2, 1u);
+	out_image.height = glm::max(source.height / 2, 1u);
+	out_image.pixels.resize((size_t)out_image.width * out_image.height * 4);
+
+	texture_taps_t taps_x, taps_y;
+	texture_build_taps(source.width, out_image.width, filter, taps_x);
+	texture_build_taps(source.height, out_image.height, filter, taps_y);
+
+	const uint32_t ring_size = taps_y.count + 2;
+	jobs_parallel_for(out_image.height, 16, [&](uint32_t first_row, uint32_t last_row) {
+		std::vector<float>   ring((size_t)ring_size * source.width * 4);
+		std::vector<int32_t> ring_rows(ring_size, -1);
+		std::vector<float>   column((size_t)source.width * 4);
+
+		for (uint32_t y = first_row; y < last_row; y++) {
+			std::fill(column.begin(), column.end(), 0.0f);
+			const float* weights_y = &taps_y.weights[(size_t)y * taps_y.count];
+			for (uint32_t k = 0; k < taps_y.count; k++) {
+				uint32_t row = taps_y.first[y] + k;
+				uint32_t slot = row % ring_size;
+				float* linear = &ring[(size_t)slot * source.width * 4];
+				if (ring_rows[slot] != (int32_t)row) {
+					const uint8_t* encoded = &source.pixels[(size_t)row * source.width * 4];
+					for (uint32_t x = 0; x < source.width * 4; x += 4) {
+						linear[x + 0] = transfer.to_linear[encoded[x + 0]];
+						linear[x + 1] = transfer.to_linear[encoded[x + 1]];
+						linear[x + 2] = transfer.to_linear[encoded[x + 2]];
+						linear[x + 3] = encoded[x + 3] / 255.0f;
+					}
+					ring_rows[slot] = (int32_t)row;
+				}
+				if (weights_y[k] == 0.0f)
+					continue;
+				__m128 weight = _mm_set1_ps(weights_y[k]);
+				for (uint32_t x = 0; x < source.width * 4; x += 4) {
+					_mm_storeu_ps(&column[x], _mm_add_ps(_mm_loadu_ps(&column[x]), _mm_mul_ps(weight, _mm_loadu_ps(&linear[x]))));
+				}
+			}
+
+			uint8_t* out = &out_image.pixels[(size_t)y * out_image.width * 4];
+			for (uint32_t x = 0; x < out_image.width; x++) {
+				const float* weights_x = &taps_x.weights[(size_t)x * taps_x.count];
+				const float* texels = &column[(size_t)taps_x.first[x] * 4];
+				__m128 sum = _mm_setzero_ps();
+				for (uint32_t k = 0; k < taps_x.count; k++) {
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights_x[k]), _mm_loadu_ps(&texels[k * 4])));
+				}
+				// Sinc lobes can overshoot, clamp before encoding
+				sum = _mm_min_ps(_mm_max_ps(sum, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+				float value[4];
+				_mm_storeu_ps(value, sum);
+				out[x * 4 + 0] = transfer.to_encoded[(int32_t)(value[0] * 16383.0f + 0.5f)];
+				out[x * 4 + 1] = transfer.to_encoded[(int32_t)(value[1] * 16383.0f + 0.5f)];
+				out[x * 4 + 2] = transfer.to_encoded[(int32_t)(value[2] * 16383.0f + 0.5f)];
+				out[x * 4 + 3] = (uint8_t)(value[3] * 255.0f + 0.5f);
+			}
+		}
+	});
+}
+
+// Each level comes from the one above it, down to 1x1
+void texture_build_mips(const texture_image_t& source, bool srgb, std::vector<texture_image_t>& out_levels) {
+	out_levels.clear();
+	out_levels.push_back(source);
+	while (out_levels.back().width > 1 || out_levels.back().height > 1) {
+		texture_image_t level;
+		texture_downsample(out_levels.back(), srgb, app_config_mip_filter, level);
+		out_levels.push_back(std::move(level));
+	}
+}
+
+///////////////////////////////////////////
+
+// 16 texels as floats, one array per channel so the fitting can take 4 texels per SSE register
+struct texture_block_t {
+	float channel[4][16]; // r, g, b, a
+};
+
+// BC7 interpolation weights for 4 bit indices, out of 64
+const int32_t texture_bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+void texture_load_block(const uint8_t* rgba, texture_block_t& block) {
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 4; c++) {
+			block.channel[c][i] = rgba[i * 4 + c];
+		}
+	}
+}
+
+// Endpoints at the extremes of the block projected onto its principal axis, found by power iteration
+void texture_pca_endpoints(const texture_block_t& block, int channels, float e0[4], float e1[4]) {
+	float mean[4] = {}, low[4], high[4];
+	for (int c = 0; c < channels; c++) {
+		low[c] = 255.0f;
+		high[c] = 0.0f;
+		for (int i = 0; i < 16; i++) {
+			mean[c] += block.channel[c][i];
+			low[c] = glm::min(low[c], block.channel[c][i]);
+			high[c] = glm::max(high[c], block.channel[c][i]);
+		}
+		mean[c] /= 16.0f;
+	}
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++) {
+		for (int a = 0; a < channels; a++) {
+			for (int b = 0; b < channels; b++) {
+				covariance[a][b] += (block.channel[a][i] - mean[a]) * (block.channel[b][i] - mean[b]);
+			}
+		}
+	}
+
+	// Starting from the box diagonal converges in a few steps for nearly every block
+	float axis[4] = {};
+	for (int c = 0; c < channels; c++) {
+		axis[c] = high[c] - low[c];
+	}
+	for (int iteration = 0; iteration < 6; iteration++) {
+		float next[4] = {}, length = 0.0f;
+		for (int a = 0; a < channels; a++) {
+			for (int b = 0; b < channels; b++) {
+				next[a] += covariance[a][b] * axis[b];
+			}
+			length = glm::max(length, fabsf(next[a]));
+		}
+		if (length < 1e-6f)
+			break;
+		for (int c = 0; c < channels; c++) {
+			axis[c] = next[c] / length;
+		}
+	}
+	float length_squared = 0.0f;
+	for (int c = 0; c < channels; c++) {
+		length_squared += axis[c] * axis[c];
+	}
+	if (length_squared < 1e-12f) {
+		for (int c = 0; c < channels; c++) {
+			e0[c] = e1[c] = mean[c];
+		}
+		return;
+	}
+
+	float t_min = FLT_MAX, t_max = -FLT_MAX;
+	for (int i = 0; i < 16; i++) {
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++) {
+			t += (block.channel[c][i] - mean[c]) * axis[c];
+		}
+		t_min = glm::min(t_min, t);
+		t_max = glm::max(t_max, t);
+	}
+	for (int c = 0; c < channels; c++) {
+		e0[c] = glm::clamp(mean[c] + axis[c] * t_min / length_squared, 0.0f, 255.0f);
+		e1[c] = glm::clamp(mean[c] + axis[c] * t_max / length_squared, 0.0f, 255.0f);
+	}
+}
+
+// For every texel, the nearest of steps + 1 evenly spaced points from e0 to e1, by projecting onto the segment
+void texture_fit_steps(const texture_block_t& block, int channels, const float e0[4], const float e1[4], int32_t steps, int32_t out_steps[16]) {
+	float direction[4] = {}, length_squared = 0.0f;
+	for (int c = 0; c < channels; c++) {
+		direction[c] = e1[c] - e0[c];
+		length_squared += direction[c] * direction[c];
+	}
+	if (length_squared <= 0.0f) {
+		memset(out_steps, 0, sizeof(int32_t) * 16);
+		return;
+	}
+
+	__m128 scale = _mm_set1_ps(steps / length_squared);
+	__m128 max_step = _mm_set1_ps((float)steps);
+	for (int i = 0; i < 16; i += 4) {
+		__m128 t = _mm_setzero_ps();
+		for (int c = 0; c < channels; c++) {
+			__m128 offset = _mm_sub_ps(_mm_loadu_ps(&block.channel[c][i]), _mm_set1_ps(e0[c]));
+			t = _mm_add_ps(t, _mm_mul_ps(offset, _mm_set1_ps(direction[c])));
+		}
+		t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(t, scale), _mm_setzero_ps()), max_step);
+		_mm_storeu_si128((__m128i*)&out_steps[i], _mm_cvtps_epi32(t));
+	}
+}
+
+// Squared error of the block against endpoints interpolated with a weight (0 at e0, 1 at e1) per texel
+float texture_block_error(const texture_block_t& block, int channels, const float e0[4], const float e1[4], const float weights[16]) {
+	__m128 error = _mm_setzero_ps();
+	for (int i = 0; i < 16; i += 4) {
+		__m128 w = _mm_loadu_ps(&weights[i]);
+		for (int c = 0; c < channels; c++) {
+			__m128 value = _mm_add_ps(_mm_set1_ps(e0[c]), _mm_mul_ps(w, _mm_set1_ps(e1[c] - e0[c])));
+			__m128 difference = _mm_sub_ps(value, _mm_loadu_ps(&block.channel[c][i]));
+			error = _mm_add_ps(error, _mm_mul_ps(difference, difference));
+		}
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, error);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+// Least squares endpoints for the weights the texels ended up with, usually better than the PCA extremes
+void texture_refine_endpoints(const texture_block_t& block, int channels, const float weights[16], float e0[4], float e1[4]) {
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[4] = {}, bx[4] = {};
+	for (int i = 0; i < 16; i++) {
+		float b = weights[i], a = 1.0f - b;
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		for (int c = 0; c < channels; c++) {
+			ax[c] += a * block.channel[c][i];
+			bx[c] += b * block.channel[c][i];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return;
+	for (int c = 0; c < channels; c++) {
+		e0[c] = glm::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+		e1[c] = glm::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+	}
+}
+
+///////////////////////////////////////////
+
+uint16_t texture_pack_565(const float color[4]) {
+	uint32_t r = (uint32_t)(color[0] * 31.0f / 255.0f + 0.5f);
+	uint32_t g = (uint32_t)(color[1] * 63.0f / 255.0f + 0.5f);
+	uint32_t b = (uint32_t)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+void texture_unpack_565(uint16_t packed, float out[4]) {
+	uint32_t r = packed >> 11, g = (packed >> 5) & 0x3F, b = packed & 0x1F;
+	out[0] = (float)((r << 3) | (r >> 2));
+	out[1] = (float)((g << 2) | (g >> 4));
+	out[2] = (float)((b << 3) | (b >> 2));
+	out[3] = 255.0f;
+}
+
+// BC1 in four color mode: two 565 endpoints and 2 bit indices, the middle two colors at thirds
+void texture_compress_bc1(const texture_block_t& block, uint8_t* out) {
+	float e0[4], e1[4];
+	texture_pca_endpoints(block, 3, e0, e1);
+
+	uint16_t best_c0 = 0, best_c1 = 0;
+	int32_t  best_steps[16] = {};
+	float    best_error = FLT_MAX;
+	for (int pass = 0; pass < 2; pass++) {
+		uint16_t c0 = texture_pack_565(e0), c1 = texture_pack_565(e1);
+		float q0[4], q1[4], weights[16];
+		int32_t steps[16];
+		texture_unpack_565(c0, q0);
+		texture_unpack_565(c1, q1);
+		texture_fit_steps(block, 3, q0, q1, 3, steps);
+		for (int i = 0; i < 16; i++) {
+			weights[i] = steps[i] / 3.0f;
+		}
+		float error = texture_block_error(block, 3, q0, q1, weights);
+		if (error < best_error) {
+			best_error = error;
+			best_c0 = c0;
+			best_c1 = c1;
+			memcpy(best_steps, steps, sizeof(steps));
+		}
+		texture_refine_endpoints(block, 3, weights, e0, e1);
+	}
+
+	// c0 > c1 selects four color mode, equal endpoints can only mean a flat block
+	if (best_c0 < best_c1) {
+		std::swap(best_c0, best_c1);
+		for (int i = 0; i < 16; i++) {
+			best_steps[i] = 3 - best_steps[i];
+		}
+	}
+	const uint32_t codes[4] = { 0, 2, 3, 1 }; // Step from c0 to c1, to the index that decodes to it
+	uint32_t indices = 0;
+	for (int i = 0; i < 16; i++) {
+		indices |= (best_c0 == best_c1 ? 0 : codes[best_steps[i]]) << (i * 2);
+	}
+	memcpy(out, &best_c0, 2);
+	memcpy(out + 2, &best_c1, 2);
+	memcpy(out + 4, &indices, 4);
+}
+
+// BC4 style alpha in eight value mode: a0 > a1, six values interpolated between them
+void texture_compress_alpha(const texture_block_t& block, uint8_t* out) {
+	float low = 255.0f, high = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		low = glm::min(low, block.channel[3][i]);
+		high = glm::max(high, block.channel[3][i]);
+	}
+	uint8_t a0 = (uint8_t)(high + 0.5f), a1 = (uint8_t)(low + 0.5f);
+	uint64_t bits = (uint64_t)a0 | ((uint64_t)a1 << 8);
+	if (a0 != a1) {
+		// Fit on the alpha channel alone, by treating it as the block's only channel
+		texture_block_t alpha;
+		memcpy(alpha.channel[0], block.channel[3], sizeof(alpha.channel[0]));
+		float e0[4] = { (float)a0 }, e1[4] = { (float)a1 };
+		int32_t steps[16];
+		texture_fit_steps(alpha, 1, e0, e1, 7, steps);
+		for (int i = 0; i < 16; i++) {
+			uint64_t code = steps[i] == 0 ? 0 : steps[i] == 7 ? 1 : (uint64_t)steps[i] + 1;
+			bits |= code << (16 + i * 3);
+		}
+	}
+	memcpy(out, &bits, 8);
+}
+
+///////////////////////////////////////////
+
+// Little endian bit stream for BC7's 128 bit blocks
+struct texture_bit_writer_t {
+	uint8_t* out;
+	uint32_t position;
+};
+
+void texture_write_bits(texture_bit_writer_t& writer, uint32_t value, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		if (value & (1u << i))
+			writer.out[writer.position >> 3] |= (uint8_t)(1u << (writer.position & 7));
+		writer.position++;
+	}
+}
+
+// 7 bits per channel plus one shared low bit (the p-bit), whichever p-bit lands closer
+void texture_quantize_bc7_endpoint(const float endpoint[4], uint32_t out_channels[4], uint32_t& out_pbit, float out_value[4]) {
+	float best_error = FLT_MAX;
+	for (uint32_t p = 0; p < 2; p++) {
+		uint32_t channels[4];
+		float error = 0.0f;
+		for (int c = 0; c < 4; c++) {
+			channels[c] = (uint32_t)glm::clamp((endpoint[c] - p) * 0.5f + 0.5f, 0.0f, 127.0f);
+			float value = (float)((channels[c] << 1) | p);
+			error += (value - endpoint[c]) * (value - endpoint[c]);
+		}
+		if (error < best_error) {
+			best_error = error;
+			out_pbit = p;
+			for (int c = 0; c < 4; c++) {
+				out_channels[c] = channels[c];
+				out_value[c] = (float)((channels[c] << 1) | p);
+			}
+		}
+	}
+}
+
+// BC7 mode 6: one subset, RGBA endpoints with p-bits and 4 bit indices. The simplest mode, and the one
+// that does best on smooth content; other modes mostly help blocks with sharp color edges.
+void texture_compress_bc7(const texture_block_t& block, uint8_t* out) {
+	// Nearest of the 16 index weights for a position 0-64 along the segment
+	static const struct lookup_t {
+		uint8_t index[65];
+		lookup_t() {
+			for (int32_t t = 0; t <= 64; t++) {
+				int32_t best = 0;
+				for (int32_t i = 1; i < 16; i++) {
+					if (abs(texture_bc7_weights[i] - t) < abs(texture_bc7_weights[best] - t))
+						best = i;
+				}
+				index[t] = (uint8_t)best;
+			}
+		}
+	} lookup;
+
+	float e0[4], e1[4];
+	texture_pca_endpoints(block, 4, e0, e1);
+
+	uint32_t best_channels[2][4] = {}, best_pbits[2] = {};
+	int32_t  best_indices[16] = {};
+	float    best_error = FLT_MAX;
+	for (int pass = 0; pass < 2; pass++) {
+		uint32_t channels[2][4], pbits[2];
+		float q0[4], q1[4], weights[16];
+		int32_t steps[16];
+		texture_quantize_bc7_endpoint(e0, channels[0], pbits[0], q0);
+		texture_quantize_bc7_endpoint(e1, channels[1], pbits[1], q1);
+		texture_fit_steps(block, 4, q0, q1, 64, steps);
+		for (int i = 0; i < 16; i++) {
+			steps[i] = lookup.index[steps[i]];
+			weights[i] = texture_bc7_weights[steps[i]] / 64.0f;
+		}
+		float error = texture_block_error(block, 4, q0, q1, weights);
+		if (error < best_error) {
+			best_error = error;
+			memcpy(best_channels, channels, sizeof(channels));
+			memcpy(best_pbits, pbits, sizeof(pbits));
+			memcpy(best_indices, steps, sizeof(steps));
+		}
+		texture_refine_endpoints(block, 4, weights, e0, e1);
+	}
+
+	// The first texel's index is stored with its top bit implied zero, swap the endpoints if it isn't
+	if (best_indices[0] >= 8) {
+		std::swap(best_channels[0], best_channels[1]);
+		std::swap(best_pbits[0], best_pbits[1]);
+		for (int i = 0; i < 16; i++) {
+			best_indices[i] = 15 - best_indices[i];
+		}
+	}
+
+	memset(out, 0, 16);
+	texture_bit_writer_t writer = { out, 0 };
+	texture_write_bits(writer, 1 << 6, 7); // Mode 6
+	for (int c = 0; c < 4; c++) {
+		texture_write_bits(writer, best_channels[0][c], 7);
+		texture_write_bits(writer, best_channels[1][c], 7);
+	}
+	texture_write_bits(writer, best_pbits[0], 1);
+	texture_write_bits(writer, best_pbits[1], 1);
+	texture_write_bits(writer, best_indices[0], 3);
+	for (int i = 1; i < 16; i++) {
+		texture_write_bits(writer, best_indices[i], 4);
+	}
+}
+
+///////////////////////////////////////////
+
+void texture_compress_block(const uint8_t* rgba, texture_format_t format, uint8_t* out_block) {
+	texture_block_t block;
+	texture_load_block(rgba, block);
+	switch (format) {
+	case TEXTURE_FORMAT_BC1:
+		texture_compress_bc1(block, out_block);
+		break;
+	case TEXTURE_FORMAT_BC3:
+		texture_compress_alpha(block, out_block);
+		texture_compress_bc1(block, out_block + 8);
+		break;
+	case TEXTURE_FORMAT_BC7:
+		texture_compress_bc7(block, out_block);
+		break;
+	default:
+		break;
+	}
+}
+
+// Rows of blocks are spread across the job system. Partial blocks at the right and bottom edges repeat
+// the last texel, which is what a sampler clamped to the level would see anyway.
+void texture_compress(const texture_image_t& image, texture_format_t format, texture_level_t& out_level) {
+	uint32_t blocks_x = (image.width + 3) / 4;
+	uint32_t blocks_y = (image.height + 3) / 4;
+	uint32_t block_bytes = texture_block_bytes(format);
+	out_level.width = image.width;
+	out_level.height = image.height;
+	out_level.blocks.assign((size_t)blocks_x * blocks_y * block_bytes, 0);
+
+	jobs_parallel_for(blocks_y, 4, [&](uint32_t first, uint32_t last) {
+		uint8_t texels[16 * 4];
+		for (uint32_t by = first; by < last; by++) {
+			for (uint32_t bx = 0; bx < blocks_x; bx++) {
+				for (uint32_t i = 0; i < 16; i++) {
+					uint32_t x = glm::min(bx * 4 + (i & 3), image.width - 1);
+					uint32_t y = glm::min(by * 4 + (i >> 2), image.height - 1);
+					memcpy(&texels[i * 4], &image.pixels[((size_t)y * image.width + x) * 4], 4);
+				}
+				texture_compress_block(texels, format, &out_level.blocks[((size_t)by * blocks_x + bx) * block_bytes]);
+			}
+		}
+	});
+}
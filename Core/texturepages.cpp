@@ -0,0 +1,178 @@
+#include <texturepages.h>
+
+bool texture_page_compressed(GLenum format) {
+	switch (format) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+size_t texture_page_layer_bytes(const texture_page_t& page) {
+	size_t bytes = 0;
+	for (uint32_t level = 0; level < page.levels; level++) {
+		uint32_t width = glm::max(page.width >> level, 1u), height = glm::max(page.height >> level, 1u);
+		if (texture_page_compressed(page.format))
+			bytes += (size_t)((width + 3) / 4) * ((height + 3) / 4) * (page.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || page.format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ? 8 : 16);
+		else
+			bytes += (size_t)width * height * 4; // Drivers pad RGB to 4 bytes
+	}
+	return bytes;
+}
+
+// Every level of layers [0, layers) from one array into another, or of one 2D texture into a layer
+void texture_page_copy(GLuint source, GLenum source_target, uint32_t source_layer, const texture_page_t& page, GLuint dest, uint32_t dest_layer, uint32_t layers) {
+	for (uint32_t level = 0; level < page.levels; level++) {
+		uint32_t width = glm::max(page.width >> level, 1u), height = glm::max(page.height >> level, 1u);
+		glCopyImageSubData(source, source_target, level, 0, 0, source_layer, dest, GL_TEXTURE_2D_ARRAY, level, 0, 0, dest_layer, width, height, layers);
+	}
+}
+
+// Reallocate with twice the layers and copy the used ones over. Textures refer to the page by index, so
+// the new array name is picked up at their next draw.
+bool texture_page_grow(texture_page_t& page) {
+	uint32_t capacity = page.capacity == 0 ? app_config_texture_page_first_layers : page.capacity * 2;
+	capacity = glm::min(capacity, app_texture_pages.max_layers);
+	if (capacity <= page.capacity)
+		return false;
+
+	GLuint array;
+	glGenTextures(1, &array);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, page.levels, page.format, page.width, page.height, capacity);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	if (page.array != 0) {
+		if (page.high_water > 0)
+			texture_page_copy(page.array, GL_TEXTURE_2D_ARRAY, 0, page, array, 0, page.high_water);
+		glDeleteTextures(1, &page.array);
+	}
+	app_texture_pages.bytes += texture_page_layer_bytes(page) * (capacity - page.capacity);
+	page.array = array;
+	page.capacity = capacity;
+	return true;
+}
+
+///////////////////////////////////////////
+
+bool texture_pages_alloc(GLenum format, uint32_t width, uint32_t height, uint32_t levels, uint32_t& out_page, uint32_t& out_layer) {
+	if (!app_config_texture_arrays)
+		return false;
+	if (app_texture_pages.max_layers == 0) {
+		GLint max_layers = 0;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+		app_texture_pages.max_layers = (uint32_t)glm::max(max_layers, 1);
+	}
+
+	// A page of the same shape with room, or one that can still grow, else a new page
+	uint32_t index = 0;
+	for (; index < app_texture_pages.pages.size(); index++) {
+		const texture_page_t& page = app_texture_pages.pages[index];
+		if (page.format == format && page.width == width && page.height == height && page.levels == levels &&
+			(!page.free_layers.empty() || page.high_water < page.capacity || page.capacity < app_texture_pages.max_layers))
+			break;
+	}
+	if (index == app_texture_pages.pages.size()) {
+		texture_page_t page = {};
+		page.format = format;
+		page.width = width;
+		page.height = height;
+		page.levels = levels;
+		app_texture_pages.pages.push_back(page);
+	}
+	texture_page_t& page = app_texture_pages.pages[index];
+
+	uint32_t layer;
+	if (!page.free_layers.empty()) {
+		layer = page.free_layers.back();
+		page.free_layers.pop_back();
+	}
+	else {
+		if (page.high_water == page.capacity && !texture_page_grow(page))
+			return false;
+		layer = page.high_water++;
+	}
+	page.used++;
+	out_page = index;
+	out_layer = layer;
+	return true;
+}
+
+void texture_pages_free(uint32_t page_index, uint32_t layer) {
+	if (page_index >= app_texture_pages.pages.size())
+		return;
+	texture_page_t& page = app_texture_pages.pages[page_index];
+	page.free_layers.push_back(layer);
+	page.used--;
+
+	// Empty pages give their memory back but keep their slot, so page indices stay valid
+	if (page.used == 0) {
+		app_texture_pages.bytes -= texture_page_layer_bytes(page) * page.capacity;
+		glDeleteTextures(1, &page.array);
+		page.array = 0;
+		page.capacity = 0;
+		page.high_water = 0;
+		page.free_layers.clear();
+	}
+}
+
+bool texture_pages_add(Texture& texture) {
+	if (!app_config_texture_arrays || texture.id == 0 || texture.paged)
+		return false;
+
+	GLint format = 0, width = 0, height = 0, max_level = 0;
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &max_level);
+	// glTexStorage3D only takes sized formats, and glCopyImageSubData won't match an unsized one against them
+	if (width <= 0 || height <= 0 || format == GL_RGB || format == GL_RGBA)
+		return false;
+
+	// Loaded textures carry a full chain, unless a .ktx2 was baked with fewer levels
+	uint32_t levels = 1;
+	while (glm::max((uint32_t)width >> levels, (uint32_t)height >> levels) > 0) {
+		levels++;
+	}
+	levels = glm::min(levels, (uint32_t)max_level + 1);
+
+	uint32_t index, layer;
+	if (!texture_pages_alloc((GLenum)format, (uint32_t)width, (uint32_t)height, levels, index, layer))
+		return false;
+	texture_page_t& page = app_texture_pages.pages[index];
+	texture_page_copy(texture.id, GL_TEXTURE_2D, 0, page, page.array, layer, 1);
+	glDeleteTextures(1, &texture.id);
+	texture.id = 0;
+	texture.paged = true;
+	texture.page = index;
+	texture.layer = layer;
+	return true;
+}
+
+void texture_pages_remove(const Texture& texture) {
+	if (texture.paged)
+		texture_pages_free(texture.page, texture.layer);
+}
+
+GLuint texture_pages_array(const Texture& texture) {
+	return app_texture_pages.pages[texture.page].array;
+}
+
+void texture_pages_shutdown() {
+	for (texture_page_t& page : app_texture_pages.pages) {
+		if (page.array != 0)
+			glDeleteTextures(1, &page.array);
+	}
+	app_texture_pages.pages.clear();
+	app_texture_pages.bytes = 0;
+}
@@ -0,0 +1,322 @@
+#include <upload.h>
+
+void upload_init() {
+	upload_system_t& upload = app_upload;
+	upload.gl_thread = std::this_thread::get_id();
+	upload.capacity = app_config_upload_ring_bytes;
+	upload.head = 0;
+	upload.next_id = 1;
+
+	glGenBuffers(1, &upload.buffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, upload.buffer);
+	if (ext_glBufferStorage) {
+		// Written from any thread through the mapping, coherent so nothing needs flushing before the copy
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		ext_glBufferStorage(GL_COPY_READ_BUFFER, upload.capacity, nullptr, flags);
+		upload.mapped = (uint8_t*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, upload.capacity, flags);
+		upload.persistent = upload.mapped != nullptr;
+	}
+	if (!upload.persistent) {
+		// Staged on the CPU, each op's slice goes up with glBufferSubData right before its copy
+		glBufferData(GL_COPY_READ_BUFFER, upload.capacity, nullptr, GL_STREAM_DRAW);
+		upload.staging.resize(upload.capacity);
+		upload.mapped = upload.staging.data();
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+///////////////////////////////////////////
+
+uint32_t upload_block_bytes(GLenum format) {
+	return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ? 8 : 16;
+}
+
+// Room for size bytes after the newest op, wrapping to the start when the end is too short. The oldest
+// op that hasn't retired marks where the free space stops. Called with the mutex held.
+bool upload_try_alloc(size_t size, size_t& out_offset) {
+	upload_system_t& upload = app_upload;
+	if (size > upload.capacity)
+		return false;
+	if (upload.ops.empty()) {
+		out_offset = 0;
+		upload.head = size;
+		return true;
+	}
+
+	size_t tail = upload.ops.front().staging_offset;
+	if (upload.head > tail) {
+		if (upload.head + size <= upload.capacity)
+			out_offset = upload.head;
+		else if (size <= tail)
+			out_offset = 0;
+		else
+			return false;
+	}
+	else {
+		if (upload.head + size > tail)
+			return false;
+		out_offset = upload.head;
+	}
+	upload.head = out_offset + size;
+	return true;
+}
+
+void upload_retire(bool wait);
+void upload_issue(size_t byte_budget, float ms_budget);
+
+// Reserve ring space for one op, copy its bytes in, and hand it to the GL thread
+void upload_stage(upload_op_t op, const uint8_t* data) {
+	upload_system_t& upload = app_upload;
+	size_t reserved = (op.size + 15) & ~(size_t)15; // Keeps every slice 16 byte aligned for the copies
+	upload_op_t* slot = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(upload.mutex);
+		size_t offset;
+		while (!upload_try_alloc(reserved, offset)) {
+			if (std::this_thread::get_id() == upload.gl_thread) {
+				// Nobody else frees space, so push out what's staged and wait on the GPU right here
+				lock.unlock();
+				upload_issue(SIZE_MAX, FLT_MAX);
+				upload_retire(true);
+				std::this_thread::yield();
+				lock.lock();
+			}
+			else {
+				upload.space.wait_for(lock, std::chrono::milliseconds(1));
+			}
+		}
+		op.staging_offset = offset;
+		op.id = upload.next_id++;
+		op.ready = false;
+		op.issued = false;
+		if (op.handle)
+			op.handle->pending++;
+		upload.ops.push_back(op);
+		slot = &upload.ops.back(); // Deque elements stay put while others are added, and this one can't retire before it's issued
+	}
+
+	memcpy(upload.mapped + slot->staging_offset, data, slot->size);
+
+	std::lock_guard<std::mutex> lock(upload.mutex);
+	slot->ready = true;
+}
+
+void upload_buffer(GLuint buffer, size_t offset, const void* data, size_t size, const job_handle_t& handle) {
+	for (size_t done = 0; done < size; done += upload_chunk_bytes) {
+		upload_op_t op = {};
+		op.kind = UPLOAD_BUFFER;
+		op.object = buffer;
+		op.dest_offset = offset + done;
+		op.size = std::min(upload_chunk_bytes, size - done);
+		op.handle = handle;
+		upload_stage(op, (const uint8_t*)data + done);
+	}
+}
+
+// RGBA8 rows, several rows per op. The op with the first rows also (re)allocates the level.
+void upload_texture(GLuint texture, uint32_t level, uint32_t width, uint32_t height, GLenum internal_format, const uint8_t* rgba, const job_handle_t& handle) {
+	size_t row_bytes = (size_t)width * 4;
+	uint32_t rows_per_op = (uint32_t)std::max<size_t>(upload_chunk_bytes / row_bytes, 1);
+	for (uint32_t y = 0; y < height; y += rows_per_op) {
+		upload_op_t op = {};
+		op.kind = UPLOAD_TEXTURE;
+		op.object = texture;
+		op.level = level;
+		op.level_width = width;
+		op.level_height = height;
+		op.format = internal_format;
+		op.y = y;
+		op.rows = std::min(rows_per_op, height - y);
+		op.first = y == 0;
+		op.size = row_bytes * op.rows;
+		op.handle = handle;
+		upload_stage(op, rgba + row_bytes * y);
+	}
+}
+
+// Same in rows of 4x4 blocks, every op but the last covers a multiple of 4 texel rows as the format requires
+void upload_texture_compressed(GLuint texture, uint32_t level, uint32_t width, uint32_t height, GLenum internal_format, const uint8_t* blocks, size_t block_bytes, const job_handle_t& handle) {
+	size_t row_bytes = (size_t)((width + 3) / 4) * upload_block_bytes(internal_format);
+	uint32_t block_rows = (height + 3) / 4;
+	uint32_t block_rows_per_op = (uint32_t)std::max<size_t>(upload_chunk_bytes / row_bytes, 1);
+	for (uint32_t row = 0; row < block_rows; row += block_rows_per_op) {
+		upload_op_t op = {};
+		op.kind = UPLOAD_TEXTURE_COMPRESSED;
+		op.object = texture;
+		op.level = level;
+		op.level_width = width;
+		op.level_height = height;
+		op.format = internal_format;
+		op.y = row * 4;
+		op.rows = std::min(block_rows_per_op * 4, height - op.y);
+		op.first = row == 0;
+		op.size = row_bytes * std::min(block_rows_per_op, block_rows - row);
+		op.handle = handle;
+		upload_stage(op, blocks + row_bytes * row);
+	}
+}
+
+///////////////////////////////////////////
+
+void upload_issue_op(const upload_op_t& op) {
+	upload_system_t& upload = app_upload;
+	if (!upload.persistent) {
+		glBindBuffer(GL_COPY_READ_BUFFER, upload.buffer);
+		glBufferSubData(GL_COPY_READ_BUFFER, op.staging_offset, op.size, upload.mapped + op.staging_offset);
+	}
+
+	void* source = (void*)op.staging_offset; // Offset into the bound unpack buffer
+	switch (op.kind) {
+	case UPLOAD_BUFFER:
+		glBindBuffer(GL_COPY_READ_BUFFER, upload.buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, op.object);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, op.staging_offset, op.dest_offset, op.size);
+		break;
+	case UPLOAD_TEXTURE:
+		glBindTexture(GL_TEXTURE_2D, op.object);
+		if (op.first) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glTexImage2D(GL_TEXTURE_2D, op.level, op.format, op.level_width, op.level_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+		glTexSubImage2D(GL_TEXTURE_2D, op.level, 0, op.y, op.level_width, op.rows, GL_RGBA, GL_UNSIGNED_BYTE, source);
+		break;
+	case UPLOAD_TEXTURE_COMPRESSED:
+		glBindTexture(GL_TEXTURE_2D, op.object);
+		if (op.first) {
+			size_t level_bytes = (size_t)((op.level_width + 3) / 4) * ((op.level_height + 3) / 4) * upload_block_bytes(op.format);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glCompressedTexImage2D(GL_TEXTURE_2D, op.level, op.format, op.level_width, op.level_height, 0, (GLsizei)level_bytes, nullptr);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, op.level, 0, op.y, op.level_width, op.rows, op.format, (GLsizei)op.size, source);
+		break;
+	}
+}
+
+// Issue ready ops oldest first until the budget runs out, always at least one. An op whose producer is
+// still copying holds back everything after it, so the ring keeps retiring in order.
+void upload_issue(size_t byte_budget, float ms_budget) {
+	upload_system_t& upload = app_upload;
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<job_handle_t> finished;
+	uint64_t last_id = 0;
+	{
+		std::lock_guard<std::mutex> lock(upload.mutex);
+		size_t bytes = 0;
+		for (upload_op_t& op : upload.ops) {
+			if (op.issued)
+				continue;
+			if (!op.ready)
+				break;
+			if (last_id != 0 && (bytes + op.size > byte_budget ||
+				std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() > ms_budget))
+				break;
+			upload_issue_op(op);
+			op.issued = true;
+			bytes += op.size;
+			last_id = op.id;
+			upload.stats.ops++;
+			upload.stats.bytes += op.size;
+			if (op.handle)
+				finished.push_back(op.handle);
+		}
+	}
+	if (last_id == 0)
+		return;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	upload.batches.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), last_id });
+
+	// Commands are in the GL stream now, anything drawn after this sees the data
+	for (const job_handle_t& handle : finished) {
+		handle->pending--;
+	}
+	upload.stats.ms += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Free the ring space of batches the GPU has finished reading
+void upload_retire(bool wait) {
+	upload_system_t& upload = app_upload;
+	bool retired = false;
+	while (!upload.batches.empty()) {
+		upload_batch_t& batch = upload.batches.front();
+		GLenum result = glClientWaitSync(batch.fence, 0, 0);
+		while (wait && result == GL_TIMEOUT_EXPIRED) {
+			result = glClientWaitSync(batch.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+		}
+		if (result == GL_TIMEOUT_EXPIRED)
+			break;
+		glDeleteSync(batch.fence);
+		{
+			std::lock_guard<std::mutex> lock(upload.mutex);
+			while (!upload.ops.empty() && upload.ops.front().issued && upload.ops.front().id <= batch.last_id) {
+				upload.ops.pop_front();
+			}
+		}
+		upload.batches.pop_front();
+		retired = true;
+	}
+	if (retired)
+		upload.space.notify_all();
+}
+
+void upload_update() {
+	upload_system_t& upload = app_upload;
+	upload.stats = {};
+	upload_retire(false);
+	upload_issue(app_config_upload_frame_bytes, app_config_upload_frame_ms);
+
+	std::lock_guard<std::mutex> lock(upload.mutex);
+	for (const upload_op_t& op : upload.ops) {
+		if (!op.issued)
+			upload.stats.pending_bytes += op.size;
+	}
+}
+
+void upload_flush() {
+	upload_issue(SIZE_MAX, FLT_MAX);
+}
+
+void upload_wait(const job_handle_t& handle) {
+	// jobs_wait alone would spin forever, the handle only drops once this thread has issued the ops
+	while (!jobs_done(handle)) {
+		upload_flush();
+		if (!jobs_run_one())
+			std::this_thread::yield();
+	}
+}
+
+// Workers staging uploads may be waiting on ring space that only this thread frees, so keep issuing
+// until every job has finished. Before jobs_shutdown, which would otherwise join them forever.
+void upload_drain() {
+	while (!jobs_idle()) {
+		upload_flush();
+		upload_retire(false);
+		if (!jobs_run_one())
+			std::this_thread::yield();
+	}
+	upload_flush();
+}
+
+void upload_shutdown() {
+	upload_system_t& upload = app_upload;
+	if (upload.buffer == 0)
+		return;
+	upload_flush();
+	upload_retire(true);
+
+	if (upload.persistent) {
+		glBindBuffer(GL_COPY_READ_BUFFER, upload.buffer);
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &upload.buffer);
+	upload.buffer = 0;
+	upload.mapped = nullptr;
+	upload.persistent = false;
+	upload.ops.clear();
+	upload.staging.clear();
+}
@@ -0,0 +1,102 @@
+#include <vertexformat.h>
+
+// Half floats keep 11 bits of precision, fine for UVs near the 0-1 range but not for heavily tiled ones
+bool vertex_can_quantize(const float* vertices, uint32_t vertex_count) {
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		const float* uv = vertices + i * vertex_float_stride + 6;
+		if (fabsf(uv[0]) > vertex_half_uv_max || fabsf(uv[1]) > vertex_half_uv_max)
+			return false;
+	}
+	return true;
+}
+
+// Unit vector to a point on the octahedron, unfolded into the [-1, 1] square (Cigolle et al., "A Survey
+// of Efficient Representations for Independent Unit Vectors"). Zero normals come out as +z.
+glm::vec2 vertex_octahedral_encode(const glm::vec3& normal) {
+	float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (length <= 0.0f)
+		return glm::vec2(0.0f);
+	glm::vec2 p = glm::vec2(normal) / length;
+	if (normal.z < 0.0f) {
+		glm::vec2 sign(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+		p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+	}
+	return p;
+}
+
+// The inverse of vertex_octahedral_encode
+glm::vec3 vertex_octahedral_decode(const glm::vec2& p) {
+	glm::vec3 normal(p.x, p.y, 1.0f - fabsf(p.x) - fabsf(p.y));
+	float t = glm::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -t : t;
+	normal.y += normal.y >= 0.0f ? -t : t;
+	return glm::normalize(normal);
+}
+
+// Positions map the box onto 0-65535 per axis, the render queue folds the box back into the world matrix.
+// Normals and UVs decode in the vertex fetch (normalized shorts, half floats) and default.vert.
+void vertex_quantize(const float* vertices, uint32_t vertex_count, const glm::vec3& box_min, const glm::vec3& box_max, std::vector<vertex_quantized_t>& out) {
+	glm::vec3 extent = box_max - box_min;
+	glm::vec3 scale(extent.x > 0.0f ? 65535.0f / extent.x : 0.0f, extent.y > 0.0f ? 65535.0f / extent.y : 0.0f, extent.z > 0.0f ? 65535.0f / extent.z : 0.0f);
+
+	out.resize(vertex_count);
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		const float* v = vertices + i * vertex_float_stride;
+		vertex_quantized_t& q = out[i];
+
+		glm::vec3 position = glm::clamp((glm::vec3(v[0], v[1], v[2]) - box_min) * scale + 0.5f, 0.0f, 65535.0f);
+		q.position[0] = (uint16_t)position.x;
+		q.position[1] = (uint16_t)position.y;
+		q.position[2] = (uint16_t)position.z;
+		q.position[3] = 0;
+
+		glm::vec2 normal = glm::round(glm::clamp(vertex_octahedral_encode(glm::vec3(v[3], v[4], v[5])), -1.0f, 1.0f) * 32767.0f);
+		q.normal[0] = (int16_t)normal.x;
+		q.normal[1] = (int16_t)normal.y;
+
+		q.uv[0] = (uint16_t)glm::packHalf1x16(v[6]);
+		q.uv[1] = (uint16_t)glm::packHalf1x16(v[7]);
+	}
+}
+
+// For code that needs the mesh on the CPU again after it went up quantized
+void vertex_dequantize(const vertex_quantized_t* packed, uint32_t vertex_count, const glm::vec3& box_min, const glm::vec3& box_max, std::vector<float>& out) {
+	glm::vec3 scale = (box_max - box_min) / 65535.0f;
+
+	out.resize((size_t)vertex_count * vertex_float_stride);
+	for (uint32_t i = 0; i < vertex_count; i++) {
+		const vertex_quantized_t& q = packed[i];
+		float* v = &out[(size_t)i * vertex_float_stride];
+
+		glm::vec3 position = box_min + glm::vec3(q.position[0], q.position[1], q.position[2]) * scale;
+		glm::vec3 normal = vertex_octahedral_decode(glm::max(glm::vec2(q.normal[0], q.normal[1]) / 32767.0f, -1.0f));
+		v[0] = position.x; v[1] = position.y; v[2] = position.z;
+		v[3] = normal.x;   v[4] = normal.y;   v[5] = normal.z;
+		v[6] = glm::unpackHalf1x16(q.uv[0]);
+		v[7] = glm::unpackHalf1x16(q.uv[1]);
+	}
+}
+
+///////////////////////////////////////////
+
+void vertex_attributes_float() {
+	glEnableVertexAttribArray(0); // Position attribute
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertex_float_stride * sizeof(float), (void*)0);
+
+	glEnableVertexAttribArray(1); // Normal attribute
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertex_float_stride * sizeof(float), (void*)(3 * sizeof(float)));
+
+	glEnableVertexAttribArray(2); // Texture coordinate attribute
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, vertex_float_stride * sizeof(float), (void*)(6 * sizeof(float)));
+}
+
+void vertex_attributes_quantized() {
+	glEnableVertexAttribArray(0); // Position, 0-1 within the box
+	glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(vertex_quantized_t), (void*)offsetof(vertex_quantized_t, position));
+
+	glEnableVertexAttribArray(1); // Octahedral normal, -1 to 1
+	glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(vertex_quantized_t), (void*)offsetof(vertex_quantized_t, normal));
+
+	glEnableVertexAttribArray(2); // Texture coordinates
+	glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(vertex_quantized_t), (void*)offsetof(vertex_quantized_t, uv));
+}
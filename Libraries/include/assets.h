@@ -0,0 +1,24 @@
+#pragma once
+
+#include <gameobject.h> // Model and Texture types handed out by the cache
+#include <streaming.h>  // Cached textures stream their mip levels in
+#include <texturepages.h> // or are packed into array pages when loaded whole
+
+// Counters for the resident asset cache
+struct asset_cache_stats_t {
+	uint64_t hits;              // Loads answered from the cache
+	uint64_t misses;            // Loads that had to import from disk
+	size_t   resident_bytes;    // GPU memory held by cached models and textures
+	size_t   resident_models;
+	size_t   resident_textures;
+};
+
+// Path-keyed, refcounted cache. Each asset is imported once and every caller shares the same handle.
+ModelHandle   asset_load_model(const std::string& objPath, const std::string& texturePath = "");
+TextureHandle asset_load_texture(const std::string& path);
+
+size_t asset_collect(); // Release cached assets that nobody else holds a handle to, returns how many were freed
+bool   asset_release_model(Model* model); // cleanupModel() unless other handles to it are still out, returns whether it was freed
+void   asset_shutdown(); // Drop every cached asset, call while the GL context is still current
+
+asset_cache_stats_t asset_cache_stats();
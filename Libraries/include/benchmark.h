@@ -0,0 +1,47 @@
+#pragma once
+
+#include <renderqueue.h> // The draw submission path being measured
+#include <shaders.h> // Test shaders come from the same files the engine uses
+#include <staticbatch.h> // Level geometry drawn per object and merged
+#include <scene.h>       // Retained entities against immediate drawModel() calls, ECS against plain structs
+
+// Offscreen target and a small test mesh, so benchmarks run without a headset or any assets
+struct benchmark_scene_t {
+	GLuint  fbo;
+	GLuint  color;
+	GLuint  depth;
+	GLuint  vao;
+	GLuint  vbo;
+	GLuint  ebo;
+	GLsizei index_count;
+	GLuint  texture;
+	GLuint  program;
+	Bounds  bounds;
+};
+
+// A test mesh both in its own buffers and in a mesh pool, for comparing the two draw paths
+struct benchmark_pooled_mesh_t {
+	GLuint            vao;
+	GLuint            vbo;
+	GLuint            ebo;
+	GLsizei           index_count;
+	mesh_pool_alloc_t pool;
+};
+
+// A column of numbers in a benchmark's results, printed with precision digits after the point
+struct benchmark_column_t {
+	const char* name;
+	int         width;
+	int         precision;
+};
+
+// Every benchmark prints its results the same way, a row per way of doing the thing being measured
+struct benchmark_table_t {
+	const char*                     label;
+	int                             label_width;
+	std::vector<benchmark_column_t> columns;
+};
+
+// Run with --benchmark on the command line, needs a GL context but no OpenXR runtime
+void benchmark_run();
+int  benchmark_test(); // --test: the checks with a right answer, returns how many failed
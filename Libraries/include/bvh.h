@@ -0,0 +1,29 @@
+#pragma once
+
+#include <culling.h> // frustum_t and aabb_t
+
+// 32 bytes, two nodes per cache line. Siblings are stored next to each other and always after their
+// parent, so an inner node only needs the index of its left child, and refitting is one reverse pass.
+struct bvh_node_t {
+	glm::vec3 min;
+	uint32_t  first; // Leaf: first entry in bvh_t::indices. Inner: left child, the right one is first + 1
+	glm::vec3 max;
+	uint32_t  count; // Objects in a leaf, 0 for inner nodes
+};
+
+struct bvh_t {
+	std::vector<bvh_node_t> nodes;   // nodes[0] is the root
+	std::vector<uint32_t>   indices; // Object indices, grouped by leaf
+};
+
+// Counters from the last traversal
+struct bvh_stats_t {
+	uint32_t nodes_visited;
+	uint32_t objects_tested;  // Leaf objects that still needed their own box test
+	uint32_t objects_visible;
+};
+
+void bvh_build  (bvh_t& bvh, const std::vector<aabb_t>& boxes);
+void bvh_refit  (bvh_t& bvh, const std::vector<aabb_t>& boxes);
+void bvh_cull   (const bvh_t& bvh, const std::vector<aabb_t>& boxes, const frustum_t& frustum, std::vector<uint32_t>& out_visible, bvh_stats_t& stats);
+bool bvh_raycast(const bvh_t& bvh, const std::vector<aabb_t>& boxes, const glm::vec3& origin, const glm::vec3& direction, float max_distance, uint32_t& out_index, float& out_distance);
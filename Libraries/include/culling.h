@@ -0,0 +1,41 @@
+#pragma once
+
+#include <gameobject.h> // Bounds from Model::loadModel
+
+#include <xmmintrin.h> // SSE, every x64 CPU has it
+
+// World space box
+struct aabb_t {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// Plane as normal and distance, a point p is on the inside when dot(normal, p) + distance >= 0
+struct frustum_t {
+	glm::vec4 planes[6]; // left, right, bottom, top, near, far
+};
+
+// World space boxes in SoA layout, so the plane test can run on four at once
+struct cull_list_t {
+	std::vector<float>   center_x, center_y, center_z;
+	std::vector<float>   extent_x, extent_y, extent_z;
+	std::vector<uint8_t> visible; // Result of the last cull_frustum_test(), one per entry
+	uint32_t             count;
+};
+
+// Counters from the last cull
+struct cull_stats_t {
+	uint32_t tested;
+	uint32_t visible;
+};
+
+bool app_config_culling = true; // Frustum cull queued draws before they are submitted, results land in render_stats_t
+
+frustum_t    cull_frustum_from_fov   (const XrPosef& pose, const XrFovf& fov, float near_z, float far_z);
+frustum_t    cull_frustum_stereo     (const XrView* views, uint32_t view_count, float near_z, float far_z);
+frustum_t    cull_frustum_from_matrix(const glm::mat4& viewproj);
+glm::mat4    cull_stereo_viewproj    (const XrView* views, uint32_t view_count, float near_z, float far_z);
+aabb_t       cull_world_box          (const Bounds& bounds, const glm::mat4& world);
+void         cull_list_clear         (cull_list_t& list);
+uint32_t     cull_list_add           (cull_list_t& list, const Bounds& bounds, const glm::mat4& world);
+cull_stats_t cull_frustum_test       (const frustum_t& frustum, cull_list_t& list);
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <jobs.h> // Queries can run over chunks on the worker threads
+
+// Archetype ECS. Every distinct set of components is an archetype, and its entities live in fixed size
+// chunks where each component is its own contiguous array (positions together, rotations together...).
+// A query walks the chunks of every archetype that has what it asks for, so iteration touches only the
+// arrays it uses, in order, and a chunk is a natural unit of work for the job system.
+//
+// Components are plain data, copied around with memcpy when entities move between archetypes or get
+// swapped into a removed entity's row. Anything that needs a destructor (a shared_ptr) belongs in a side
+// table, indexed from a component.
+//
+// Each chunk keeps a version per component: writing through ecs_write() stamps it with the world's current
+// version, and a query can skip chunks that haven't changed since a version it saw before.
+
+// Handle to an entity. A slot's generation changes when it's reused, so a handle to a destroyed entity
+// stays invalid instead of pointing at whatever took its place.
+struct Entity {
+	uint32_t index;
+	uint32_t generation;
+};
+
+const Entity entity_none = { UINT32_MAX, 0 };
+
+typedef uint32_t ecs_component_t; // Index of a registered component
+typedef uint64_t ecs_mask_t;      // Bit per component
+
+const uint32_t ecs_max_components = 64;
+const size_t   ecs_chunk_bytes    = 16 * 1024; // Fits L1 on most cores, whatever the archetype's row size
+const size_t   ecs_array_align    = 16;
+
+struct ecs_component_info_t {
+	const char* name;
+	size_t      size;
+};
+
+struct ecs_chunk_t {
+	std::vector<uint8_t> data;     // Entity ids, then each component's array, capacity rows long
+	uint32_t             count;
+	uint32_t             versions[ecs_max_components]; // World version of the last write to each component
+};
+
+struct ecs_archetype_t {
+	ecs_mask_t               mask;
+	uint32_t                 capacity;                     // Rows per chunk
+	size_t                   offsets[ecs_max_components];  // Of each component's array in a chunk
+	std::vector<ecs_chunk_t> chunks;                       // Only the last one has free rows
+};
+
+// Where an entity lives
+struct ecs_record_t {
+	uint32_t archetype;
+	uint32_t chunk;
+	uint32_t row;
+	uint32_t generation;
+	bool     alive;
+};
+
+struct ecs_world_t {
+	std::vector<ecs_component_info_t>      components;
+	std::vector<ecs_archetype_t>           archetypes;
+	std::unordered_map<ecs_mask_t, uint32_t> archetype_lookup;
+	std::vector<ecs_record_t>              records;
+	std::vector<uint32_t>                  free_records;
+	uint32_t                               version = 1; // Bumped by ecs_tick(), starts at 1 so 0 means never written
+	uint32_t                               count   = 0; // Alive entities
+};
+
+// Which entities a query visits, and optionally only chunks where a component changed
+struct ecs_query_t {
+	ecs_mask_t      all;          // Has every one of these
+	ecs_mask_t      none;         // and none of these
+	ecs_component_t changed;      // With changed_since > 0, skip chunks where this wasn't written after it
+	uint32_t        changed_since;
+};
+
+// One chunk as a query hands it out
+struct ecs_view_t {
+	ecs_world_t*     world;
+	ecs_archetype_t* archetype;
+	ecs_chunk_t*     chunk;
+	uint32_t         count;
+
+	const Entity* entities() const { return (const Entity*)chunk->data.data(); }
+	template <typename T> const T* read(ecs_component_t component) const { return (const T*)(chunk->data.data() + archetype->offsets[component]); }
+	template <typename T> T*       write(ecs_component_t component) const; // Stamps the chunk's version for the component
+	bool has(ecs_component_t component) const { return (archetype->mask & ((ecs_mask_t)1 << component)) != 0; }
+};
+
+ecs_world_t app_ecs;
+
+ecs_component_t ecs_register(ecs_world_t& world, const char* name, size_t size);
+template <typename T> ecs_component_t ecs_register(ecs_world_t& world, const char* name) { return ecs_register(world, name, sizeof(T)); }
+inline ecs_mask_t ecs_mask(ecs_component_t component) { return (ecs_mask_t)1 << component; }
+
+Entity ecs_create (ecs_world_t& world, ecs_mask_t components); // Components start zeroed
+void   ecs_destroy(ecs_world_t& world, Entity entity);
+bool   ecs_alive  (const ecs_world_t& world, Entity entity);
+void   ecs_add    (ecs_world_t& world, Entity entity, ecs_component_t component); // Moves it to another archetype
+void   ecs_remove (ecs_world_t& world, Entity entity, ecs_component_t component);
+bool   ecs_has    (const ecs_world_t& world, Entity entity, ecs_component_t component);
+const void* ecs_get(const ecs_world_t& world, Entity entity, ecs_component_t component); // Read only, nullptr if missing
+void*  ecs_write  (ecs_world_t& world, Entity entity, ecs_component_t component); // Same, and stamps the chunk
+void   ecs_tick   (ecs_world_t& world); // New version, call once per frame
+void   ecs_clear  (ecs_world_t& world); // Every entity and archetype, components stay registered
+
+void   ecs_for_each         (ecs_world_t& world, const ecs_query_t& query, const std::function<void(ecs_view_t& view)>& fn);
+void   ecs_for_each_parallel(ecs_world_t& world, const ecs_query_t& query, const std::function<void(ecs_view_t& view)>& fn); // A job per chunk, fn must only touch its own chunk
+uint32_t ecs_query_count    (ecs_world_t& world, const ecs_query_t& query); // Entities it would visit
+
+template <typename T> T* ecs_view_t::write(ecs_component_t component) const {
+	chunk->versions[component] = world->version;
+	return (T*)(chunk->data.data() + archetype->offsets[component]);
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 // Tell OpenXR what platform code we'll be using
 #define XR_USE_PLATFORM_WIN32
 #define XR_USE_GRAPHICS_API_OPENGL
@@ -37,23 +39,29 @@
 
 #include <cstdio> // parse - debug
 #include <cmath> // sin, cos
+#include <cfloat> // FLT_MAX, empty bounds start from it
 
 #include <iostream> // std namespace
 #include <sstream> // string conversions
 #include <map> // key-value pairs
+#include <unordered_map> // mesh to indirect command lookups
 #include <string> // string manipulation
+#include <memory> // shared_ptr for cached asset handles
 
 ///////////////////////////////////////////
 
 struct swapchain_surfdata_t {
 	GLuint fbo;
 	GLuint depthbuffer;
+	GLuint depthtexture; // Layered depth for multiview, renderbuffers can't be layered
+	GLuint layerfbo[2];  // One per layer of a multiview image, for blitting to the desktop window
 };
 
 struct swapchain_t {
 	XrSwapchain handle;
 	int32_t width;
 	int32_t height;
+	uint32_t array_size; // 1 per eye, or one layer per view with multiview
 	std::vector<XrSwapchainImageOpenGLKHR> surface_images;
 	std::vector<swapchain_surfdata_t>      surface_data;
 };
@@ -76,22 +84,59 @@ PFN_xrGetOpenGLGraphicsRequirementsKHR ext_xrGetOpenGLGraphicsRequirementsKHR =
 PFN_xrCreateDebugUtilsMessengerEXT    ext_xrCreateDebugUtilsMessengerEXT = nullptr;
 PFN_xrDestroyDebugUtilsMessengerEXT   ext_xrDestroyDebugUtilsMessengerEXT = nullptr;
 
+// Function pointers for OpenGL extensions, glad only loads the 4.3 core profile
+typedef void (APIENTRYP PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC)(GLenum target, GLenum attachment, GLuint texture, GLint level, GLint baseViewIndex, GLsizei numViews);
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC ext_glFramebufferTextureMultiviewOVR = nullptr;
+PFNGLBUFFERSTORAGEPROC                  ext_glBufferStorage = nullptr; // ARB_buffer_storage, core in 4.4
+
+#define GL_MAP_PERSISTENT_BIT  0x0040
+#define GL_MAP_COHERENT_BIT    0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+
 ///////////////////////////////////////////
 
+// Per draw uniforms, matches TransformBuffer in default.vert
 struct app_transform_buffer_t {
 	glm::mat4 world;
-	glm::mat4 viewproj;
+	glm::mat4 mvp[2]; // viewproj * world, one per eye, multiview indexes it with gl_ViewID_OVR
+	glm::uvec4 material; // x: layer in the bound texture page, texture_no_layer for a plain 2D texture
 };
 
-app_transform_buffer_t transform_buffer;
+// The view(s) app_draw is currently drawing, MVPs get built from these on the CPU
+struct app_view_t {
+	glm::mat4 viewproj[2];
+	uint32_t  view_count;
+	glm::vec3 lod_position; // Between the eyes, every LOD decision is made from here so both eyes agree
+	float     lod_scale;    // 1 / (tan up - tan down), turns size over distance into a fraction of the screen height
+	uint32_t  pixel_height; // Of the render target, texture streaming turns screen fractions into pixels with it
+};
+
+app_view_t app_view;
 
 XrFormFactor            app_config_form = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
 XrViewConfigurationType app_config_view = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+bool                    app_config_multiview = true; // Render both eyes in a single pass when GL_OVR_multiview is available
+bool                    gl_multiview = false;        // Set by gl_load_extensions() when multiview is actually in use
+bool                    gl_texture_s3tc = false;     // EXT_texture_compression_s3tc, needed for BC1 and BC3 uploads (BC7 is core)
+
+// What the desktop window shows, it copies the headset images rather than drawing the scene again
+enum mirror_mode_t {
+	MIRROR_NONE,      // Leave the desktop window alone
+	MIRROR_LEFT_EYE,  // One eye, scaled to fit the window
+	MIRROR_BOTH_EYES, // Both eyes side by side
+};
+mirror_mode_t app_config_mirror = MIRROR_LEFT_EYE;
+uint32_t      app_config_mirror_divisor = 1; // Refresh the desktop window every Nth XR frame
 
 ///////////////////////////////////////////
 
 GLuint app_shader_program = 0;
-GLuint app_uniform_buffer = 0;
+GLuint app_shader_program_instanced = 0; // default.vert built with INSTANCED, for Model::drawInstanced
+GLuint app_shader_program_quantized = 0; // QUANTIZED variants, for models loaded with the 16 byte vertex layout
+GLuint app_shader_program_instanced_quantized = 0;
+GLuint app_shader_program_indirect = 0; // INDIRECT variants, for pooled models drawn with multi draw indirect
+GLuint app_shader_program_indirect_quantized = 0;
 
 GLuint app_vao; // VAO (Vertex Array Object) for input layout
 
@@ -120,6 +165,9 @@ int desktopHeight = 1100;
 
 uint32_t leftEyeImageIndex; // Set during xrAcquireSwapchainImage calls for left eye
 int left_eye_index = 0; // left eye at index 0
+uint64_t mirror_frame_counter = 0; // XR frames seen, for app_config_mirror_divisor
+bool     mirror_this_frame = false; // Whether this XR frame refreshes the desktop window
+bool     mirror_pending = false;    // Something was copied to the window and still needs a swap
 extern std::vector<swapchain_t> xr_swapchains;
 extern GLFWwindow* window;
 extern int desktopWidth, desktopHeight;
@@ -127,7 +175,7 @@ extern int desktopWidth, desktopHeight;
 ///////////////////////////////////////////
 
 void app_init();
-void app_draw(XrCompositionLayerProjectionView& layerView);
+void app_draw(XrCompositionLayerProjectionView* views, uint32_t view_count);
 void app_update();
 void app_update_predicted();
 void opengl_shutdown();
@@ -158,9 +206,15 @@ void openxr_poll_actions();
 void openxr_poll_predicted(XrTime predicted_time);
 void openxr_render_frame();
 bool openxr_render_layer(XrTime predictedTime, std::vector<XrCompositionLayerProjectionView>& projectionViews, XrCompositionLayerProjection& layer);
+void gl_load_extensions();
+GLuint gl_create_program(const char* vs_src, const char* fs_src, const char* defines = "");
+GLuint gl_create_compute_program(const char* cs_src, const char* defines = "");
 void gl_swapchain_destroy(swapchain_t& swapchain);
-void gl_render_layer(XrCompositionLayerProjectionView& view, swapchain_surfdata_t& surface, GLFWwindow* window);
+void gl_render_layer(XrCompositionLayerProjectionView* views, uint32_t view_count, swapchain_surfdata_t& surface);
+void gl_mirror_view(GLuint read_fbo, uint32_t eye, int32_t width, int32_t height);
+void gl_mirror_present();
 swapchain_surfdata_t gl_make_surface_data(XrBaseInStructure& swapchain_img, int32_t width, int32_t height);
+swapchain_surfdata_t gl_make_surface_data_multiview(XrBaseInStructure& swapchain_img, int32_t width, int32_t height, uint32_t layers);
 
 ///////////////////////////////////////////
 
@@ -176,7 +230,7 @@ class Game {
 public:
 	void start();
 	void update();
-	void render();
+	void render(); // Once per frame, what it draws is recorded and replayed for every view
 };
 
 Game game;
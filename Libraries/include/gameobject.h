@@ -1,6 +1,14 @@
 #pragma once
 
 #include <engine.h> // Engine for OpenGL and OpenXR bindings and model loading
+#include <lod.h>    // Simplified levels generated at load
+#include <vertexformat.h> // Optional 16 byte vertex layout
+#include <meshopt.h>  // Import time cache and overdraw optimization
+#include <ktx.h>      // Baked block compressed textures
+#include <upload.h>   // Buffer data goes up through the staging ring
+#include <meshpool.h> // Shared vertex and index buffers for multi draw indirect
+
+struct draw_mesh_t; // renderqueue.h
 
 struct Transform {
 	glm::vec3 position;
@@ -12,6 +20,22 @@ struct Texture {
 	GLuint id;
 	std::string type;
 	std::string path;
+	int width;
+	int height;
+	size_t bytes; // Approximate VRAM footprint, including mips
+	bool paged;      // Moved into a texture array page, id is 0 then, see texturepages.h
+	uint32_t page;
+	uint32_t layer;
+};
+
+typedef std::shared_ptr<Texture> TextureHandle; // Shared handle to a cached texture
+
+// Object space bounds, computed from the vertices when a model is loaded
+struct Bounds {
+	glm::vec3 min;    // Axis aligned box
+	glm::vec3 max;
+	glm::vec3 center; // Bounding sphere
+	float     radius;
 };
 
 class Model {
@@ -19,15 +43,39 @@ public:
 	GLuint vao;       // Vertex Array Object
 	GLuint vbo;       // Vertex Buffer Object
 	GLuint ebo;       // Element Buffer Object
-	size_t indexCount; // Number of indices
+	size_t indexCount; // Number of indices, full resolution level
 	GLuint textureID; // Add a texture ID
+	TextureHandle texture; // Keeps the cached texture resident while this model uses it
+	size_t bufferBytes; // VBO + EBO size in bytes
+	Bounds bounds;      // For culling, and the box quantized positions are relative to
+	bool quantized;     // VBO uses vertex_quantized_t instead of 8 floats
+	GLenum indexType;   // GL_UNSIGNED_SHORT when every vertex can be reached with one
+	std::vector<glm::vec3> occluderVertices; // Low poly CPU copy for occlusion culling, empty if this model doesn't occlude
+	std::vector<uint32_t>  occluderIndices;
+	std::vector<lod_range_t> lods; // Index ranges in the EBO, finest first, always at least one
+	job_handle_t upload; // VBO and EBO data on its way through the staging ring
+	bool pooled;            // Lives in app_mesh_pools instead of its own buffers, vao is the pool's then and vbo/ebo are 0
+	mesh_pool_alloc_t pool;
 	void loadModel(const std::string& objPath, const std::string& texturePath);
+	void loadMesh(const std::string& name, std::vector<float>& vertices, std::vector<uint32_t>& indices, TextureHandle texture); // From vertex_float_stride vertices in memory, both vectors get reordered
+	void loadOccluder(const std::string& objPath); // Use a separate low poly mesh to occlude with
 	void drawModel(const Transform modelTransform);
 	void drawModel(); // Overloaded drawModel function
+	void drawInstanced(const Transform* transforms, size_t count); // Many copies in a single draw call
+	void drawInstanced(const std::vector<Transform>& transforms);
+	void markStatic(const Transform& transform); // Placed in the level for good, merged into a static batch at the next static_batch_build()
+	void markStatic();
+	bool uploaded() const { return !lods.empty() && jobs_done(upload); } // Draws are skipped until then, and once cleaned up
+	const lod_range_t& selectLod(const glm::mat4& world) const; // Level to draw at this world transform
+	draw_mesh_t drawMesh(const lod_range_t& lod, bool instanced) const; // What the render queue needs to draw it
 	void cleanupModel();
 	GLuint loadTexture(const std::string& path);
 };
 
-Transform defaultTransform;
+typedef std::shared_ptr<Model> ModelHandle; // Shared handle to a cached model
+
+Transform defaultTransform = { glm::vec3(0.0f, 0.0f, -5.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f) };
+ModelHandle app_controller_model; // Controller Model - Default are Vive Controllers
 glm::mat4 transformToMat4(const Transform& transform);
-Transform mat4ToTransform(const glm::mat4& mat);
\ No newline at end of file
+Transform mat4ToTransform(const glm::mat4& mat);
+Texture loadTextureFile(const std::string& path);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <culling.h> // frustum_t, the planes are tested the same way as cull_frustum_test()
+#include <shaders.h> // get_file_contents for the compute shaders
+
+// GPU driven culling for pooled meshes. The render queue writes one cull object per pooled object (each
+// instance counts) next to its draw record, plus one indirect command per distinct mesh with room for all
+// of its candidates. cull.comp tests every object against each view's frustum and a Hi-Z pyramid built from
+// the previous frame's depth, then appends the survivors' records to their command, bumping its instance
+// count. The CPU never sees the result, it only issues the multi draw.
+//
+// The pyramid is max depth, so an object is hidden when its nearest point is behind the farthest depth in
+// the texels it covers. Each eye gets its own pyramid layer, tested with the matrix that eye was drawn
+// with; an object is only dropped when every captured eye agrees it's hidden. Occluders that moved away
+// since last frame can keep something hidden for one frame.
+
+// Matches cull_object_t in cull.comp
+struct gpu_cull_object_t {
+	glm::vec4  center; // World space box, same as the CPU cull list
+	glm::vec4  extent;
+	glm::uvec4 info;   // x: command, y: draw record, z: gpu_cull_always_visible or 0, w: unused
+};
+
+const uint32_t gpu_cull_always_visible = 1; // Pushed with render_queue_push_visible(), the caller culled it already
+
+// Per object result, written when validating
+enum gpu_cull_result_t {
+	GPU_CULL_OUTSIDE  = 0,
+	GPU_CULL_VISIBLE  = 1,
+	GPU_CULL_OCCLUDED = 2,
+};
+
+struct gpu_cull_stats_t {
+	uint32_t objects;    // Sent to the compute shader
+	uint32_t dispatches;
+	uint32_t visible;    // These three are only known when validating
+	uint32_t occluded;
+	uint32_t mismatches; // Frustum results that differ from cull_frustum_test()
+};
+
+struct gpu_cull_t {
+	GLuint   cull_program;    // cull.comp
+	GLuint   pyramid_program; // hiz.comp
+	GLuint   commands;        // Indirect commands after culling, GPU only
+	GLuint   records;         // Surviving draw records, grouped per command
+	GLuint   results;         // gpu_cull_result_t per object, for validation
+	size_t   commands_bytes;
+	size_t   records_bytes;
+	size_t   results_bytes;
+
+	GLuint    depth;         // GL_DEPTH_COMPONENT24 array, a layer per eye, the depth buffer gets blitted here
+	GLuint    depth_fbo;
+	GLuint    pyramid;       // R32F array with mips, level 0 is half the depth size
+	int32_t   width;         // Of depth
+	int32_t   height;
+	uint32_t  levels;
+	glm::mat4 viewproj[2];   // What each layer was drawn with
+	bool      valid[2];      // Layer holds a captured depth
+	gpu_cull_stats_t stats;
+};
+
+bool       app_config_gpu_culling = true;          // Cull pooled meshes in a compute shader instead of on the CPU
+bool       app_config_gpu_cull_occlusion = true;   // Also test against last frame's depth
+bool       app_config_gpu_cull_validate = false;   // Read every result back and check the frustum part against cull_frustum_test(), stalls
+gpu_cull_t app_gpu_cull;
+
+void gpu_cull_init    ();
+void gpu_cull_shutdown();
+void gpu_cull_capture (GLuint read_fbo, uint32_t eye, int32_t width, int32_t height, const glm::mat4& viewproj); // After an eye is drawn, builds its pyramid layer
+void gpu_cull_dispatch(const frustum_t* frusta, uint32_t frustum_count, GLuint ring, size_t objects_offset, uint32_t object_count,
+                       size_t records_offset, size_t records_bytes, size_t commands_offset, size_t commands_bytes); // Culled commands and records end up in commands and records above
+void gpu_cull_read_results(uint32_t object_count, std::vector<uint32_t>& out); // Stalls until the dispatch is done
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <gameobject.h> // Transform, and transformToMat4 for the local matrices
+
+// Handle to a node. A slot's generation changes when it's reused, so a handle to a removed node stays
+// invalid instead of pointing at whatever took its place.
+struct hierarchy_node_t {
+	uint32_t index;
+	uint32_t generation;
+};
+
+const hierarchy_node_t hierarchy_none = { UINT32_MAX, 0 };
+
+// Where a handle's node currently sits in the arrays, which move when they're re-sorted
+struct hierarchy_slot_t {
+	uint32_t position;
+	uint32_t generation;
+	bool     alive;
+};
+
+struct hierarchy_stats_t {
+	uint32_t nodes;
+	uint32_t updated; // World matrices rebuilt by the last update
+};
+
+// Parent/child transforms, kept as parallel arrays sorted by depth so every parent comes before its
+// children. hierarchy_update() is one pass in that order: a node is rebuilt if its local transform was set
+// or its parent was rebuilt in the same pass, so only dirty subtrees are recomputed and the rest keep
+// their cached world matrix.
+struct transform_hierarchy_t {
+	std::vector<uint32_t>         parents;    // Position of the parent, UINT32_MAX for roots
+	std::vector<uint32_t>         depths;
+	std::vector<Transform>        locals;
+	std::vector<glm::mat4>        worlds;     // Cached, as of the last update
+	std::vector<uint32_t>         versions;   // Update that last rebuilt each world matrix
+	std::vector<uint8_t>          dirty;      // Local transform set since the last update
+	std::vector<uint32_t>         owners;     // Slot of the node at each position
+	std::vector<hierarchy_slot_t> slots;
+	std::vector<uint32_t>         free_slots;
+	uint32_t                      version  = 0; // Bumped by every update that rebuilt something
+	uint32_t                      pending  = 0; // Nodes marked dirty since the last update
+	bool                          unsorted = false; // A parent changed, the depth order needs restoring
+	hierarchy_stats_t             stats    = {};
+};
+
+transform_hierarchy_t app_hierarchy;
+hierarchy_node_t      app_hand_nodes[2] = { hierarchy_none, hierarchy_none }; // Follow xr_input.handPose, attach held objects to these
+
+hierarchy_node_t hierarchy_add       (transform_hierarchy_t& hierarchy, const Transform& local, hierarchy_node_t parent = hierarchy_none);
+void             hierarchy_remove    (transform_hierarchy_t& hierarchy, hierarchy_node_t node); // And everything below it
+bool             hierarchy_valid     (const transform_hierarchy_t& hierarchy, hierarchy_node_t node);
+void             hierarchy_set_local (transform_hierarchy_t& hierarchy, hierarchy_node_t node, const Transform& local);
+Transform        hierarchy_get_local (const transform_hierarchy_t& hierarchy, hierarchy_node_t node);
+void             hierarchy_set_parent(transform_hierarchy_t& hierarchy, hierarchy_node_t node, hierarchy_node_t parent); // Keeps the local transform
+const glm::mat4& hierarchy_world     (const transform_hierarchy_t& hierarchy, hierarchy_node_t node); // As of the last update
+uint32_t         hierarchy_version   (const transform_hierarchy_t& hierarchy, hierarchy_node_t node); // Update that last changed its world matrix
+void             hierarchy_update    (transform_hierarchy_t& hierarchy); // Once per frame, before anything reads world matrices
+void             hierarchy_clear     (transform_hierarchy_t& hierarchy);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <engine.h>
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+
+// Counts the jobs still running under one handle, a handle is done when it reaches zero
+struct job_counter_t {
+	std::atomic<int32_t> pending;
+};
+
+typedef std::shared_ptr<job_counter_t> job_handle_t;
+
+// Fixed pool of worker threads pulling from one queue. Jobs are for CPU work only, the GL context
+// belongs to the main thread.
+struct job_system_t {
+	std::vector<std::thread>          workers;
+	std::deque<std::function<void()>> queue;
+	std::mutex                        mutex;
+	std::condition_variable           wake;
+	bool                              quit;
+	std::atomic<uint32_t>             running; // Popped from the queue and not finished yet
+};
+
+job_system_t app_jobs;
+
+void         jobs_init    (uint32_t thread_count = 0); // 0 picks one per core, minus the main thread
+void         jobs_shutdown();
+job_handle_t jobs_submit  (std::function<void()> job, job_handle_t handle = nullptr); // Pass a handle to group jobs under it
+bool         jobs_done    (const job_handle_t& handle);
+void         jobs_wait    (const job_handle_t& handle); // Runs queued jobs on this thread while it waits
+void         jobs_parallel_for(uint32_t count, uint32_t batch, const std::function<void(uint32_t first, uint32_t last)>& job);
+uint32_t     jobs_thread_count(); // Workers plus the calling thread
+bool         jobs_idle    (); // Nothing queued and nothing running
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <texcompress.h> // Block compressed levels, and the encoders the baker runs
+
+// KTX2 container for block compressed textures. The baker (game --bake) writes one next to each source
+// image with its full mip chain already compressed, so loading is a read and a glCompressedTexImage2D per
+// level with nothing decoded on the CPU or the driver.
+//
+// Only what we write is read back: one 2D image, no array layers or faces, no supercompression.
+
+const uint8_t ktx_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// VkFormat values for the formats in texture_format_t
+enum ktx_vk_format_t {
+	KTX_VK_FORMAT_BC1_RGB_UNORM  = 131,
+	KTX_VK_FORMAT_BC1_RGB_SRGB   = 132,
+	KTX_VK_FORMAT_BC3_UNORM      = 137,
+	KTX_VK_FORMAT_BC3_SRGB       = 138,
+	KTX_VK_FORMAT_BC7_UNORM      = 145,
+	KTX_VK_FORMAT_BC7_SRGB       = 146,
+};
+
+struct ktx_texture_t {
+	texture_format_t             format;
+	bool                         srgb;   // Stored as sRGB, callers that ask for sRGB get it either way
+	std::vector<texture_level_t> levels; // Largest first
+};
+
+bool app_config_prefer_ktx2 = true; // Texture loads use a baked .ktx2 next to the source image when there is one
+
+std::string ktx_sibling_path(const std::string& path); // "Resources/a.jpeg" -> "Resources/a.ktx2"
+bool        ktx_write       (const char* path, const ktx_texture_t& texture);
+bool        ktx_read        (const char* path, ktx_texture_t& out_texture);
+size_t      ktx_upload      (const ktx_texture_t& texture, GLenum target, bool srgb); // Into the texture bound to target, returns bytes uploaded
+bool        ktx_bake_file   (const char* source_path, texture_format_t format);    // Writes ktx_sibling_path(source_path)
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <engine.h> // glm
+
+#include <queue> // Collapse candidates are kept in a priority queue
+
+// Levels of detail are built at import by quadric error simplification (Garland and Heckbert, "Surface
+// Simplification Using Quadric Error Metrics"). Collapses only ever move a vertex onto one of its
+// neighbours, so every level reuses the full resolution vertex buffer and only the indices differ. All
+// levels are stored back to back in the model's one EBO.
+const uint32_t lod_max_levels = 4;
+
+// One level's slice of the index buffer
+struct lod_range_t {
+	uint32_t first_index;
+	uint32_t index_count;
+	float    error; // Largest geometric error of the collapses that made this level, in model units
+};
+
+uint32_t app_config_lod_levels = 4; // Including the full resolution mesh, at most lod_max_levels
+float    app_config_lod_ratios[lod_max_levels]       = { 1.0f, 0.5f, 0.25f, 0.125f }; // Fraction of the triangles each level keeps
+float    app_config_lod_screen_sizes[lod_max_levels] = { 0.25f, 0.12f, 0.05f, 0.0f }; // A level is used while the object covers at least this fraction of the screen height
+float    app_config_lod_max_error = 0.02f; // Stop simplifying once a collapse moves the surface by this fraction of the model's radius
+float    app_config_lod_bias      = 1.0f;  // Scales projected size before picking a level, below 1 switches to coarser levels sooner
+uint32_t app_config_lod_min_triangles = 256; // Models smaller than this only get the one level
+
+void     lod_build   (const float* positions, size_t stride, uint32_t vertex_count, const std::vector<uint32_t>& indices, float radius, std::vector<uint32_t>& out_indices, std::vector<lod_range_t>& out_levels);
+uint32_t lod_select  (uint32_t level_count, const glm::vec3& center, float radius);
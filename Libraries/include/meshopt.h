@@ -0,0 +1,41 @@
+#pragma once
+
+#include <engine.h> // glm
+
+// Import time mesh optimization, run by Model::loadModel on every mesh:
+//   weld         merge vertices that are identical in every attribute
+//   vertex cache reorder triangles for the post-transform cache (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+//   overdraw     reorder the cache friendly clusters so outward facing ones come first (Sander et al.,
+//                "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+//   vertex fetch renumber vertices in the order the index buffer first uses them
+// Cache efficiency is reported as ACMR (transformed vertices per triangle, 0.5 is the ideal for big
+// regular meshes, 3 the worst) and ATVR (transformed vertices per unique vertex, 1 is ideal).
+const uint32_t mesh_cache_size        = 16; // FIFO cache the stats simulate, close to what mobile GPUs have
+const uint32_t mesh_forsyth_cache_size = 32; // LRU cache the Forsyth scoring models
+
+struct mesh_cache_stats_t {
+	float acmr;
+	float atvr;
+};
+
+// Totals over every mesh Model::loadMesh has optimized. ACMR is transformed / triangles and ATVR is
+// transformed / vertices, before and after, so the averages weigh each mesh by its size.
+struct mesh_optimize_stats_t {
+	uint32_t meshes;
+	uint64_t triangles;
+	uint64_t vertices_before;    // As imported, before welding
+	uint64_t vertices_after;
+	uint64_t transformed_before; // Vertices the simulated cache transforms
+	uint64_t transformed_after;
+	uint64_t clusters;           // Overdraw clusters
+};
+
+bool                  app_config_optimize_meshes = true;
+mesh_optimize_stats_t app_mesh_optimize_stats    = {};
+
+uint32_t           mesh_weld                 (std::vector<float>& vertices, size_t stride, std::vector<uint32_t>& indices); // Returns the new vertex count
+void               mesh_optimize_vertex_cache(uint32_t* indices, size_t index_count, uint32_t vertex_count);
+uint32_t           mesh_optimize_overdraw    (uint32_t* indices, size_t index_count, const float* vertices, size_t stride); // Returns the cluster count
+void               mesh_optimize_vertex_fetch(std::vector<float>& vertices, size_t stride, std::vector<uint32_t>& indices);
+mesh_cache_stats_t mesh_cache_stats          (const uint32_t* indices, size_t index_count, uint32_t vertex_count);
+void               mesh_optimize_report      (const mesh_optimize_stats_t& stats); // One line of totals, once loading is done
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vertexformat.h> // One pool per vertex layout
+#include <upload.h>       // Mesh data goes in through the staging ring
+
+// Every model with the same vertex layout sub-allocates from one big vertex buffer and one big index
+// buffer, and they all draw through one VAO. That's what lets the render queue put meshes sharing a program
+// and texture into a single glMultiDrawElementsIndirect. Indices are always 32 bit and relative to the
+// mesh, each command's baseVertex points them at its vertices.
+enum mesh_pool_format_t {
+	MESH_POOL_FLOAT,     // 32 byte vertices
+	MESH_POOL_QUANTIZED, // vertex_quantized_t
+	MESH_POOL_FORMAT_COUNT,
+};
+
+struct mesh_pool_range_t {
+	uint32_t first;
+	uint32_t count;
+};
+
+// Where one model lives in a pool
+struct mesh_pool_alloc_t {
+	mesh_pool_format_t format;
+	mesh_pool_range_t  vertices;
+	mesh_pool_range_t  indices;
+};
+
+struct mesh_pool_t {
+	GLuint                         vao; // Attribute 3 reads the draw id buffer below, once per instance
+	GLuint                         vbo;
+	GLuint                         ebo;
+	uint32_t                       vertex_stride;
+	uint32_t                       vertex_capacity;
+	uint32_t                       index_capacity;
+	std::vector<mesh_pool_range_t> free_vertices; // Sorted by first, neighbours merged
+	std::vector<mesh_pool_range_t> free_indices;
+};
+
+struct mesh_pools_t {
+	mesh_pool_t pools[MESH_POOL_FORMAT_COUNT];
+	GLuint      draw_ids; // 0, 1, 2... as an instanced attribute, so a command's baseInstance is the index of its first draw record
+	uint32_t    draw_id_capacity;
+};
+
+mesh_pools_t app_mesh_pools;
+
+bool   app_config_mesh_pool = true;                    // loadModel sub-allocates from the pools, and the render queue draws them with multi draw indirect
+size_t app_config_mesh_pool_vertex_bytes = 128u << 20; // Per layout. Pools never grow, staged uploads hold on to the buffer name
+size_t app_config_mesh_pool_index_bytes = 64u << 20;
+
+bool mesh_pool_alloc   (mesh_pool_format_t format, uint32_t vertex_count, uint32_t index_count, mesh_pool_alloc_t& out); // false when the pool is full
+void mesh_pool_free    (const mesh_pool_alloc_t& alloc);
+void mesh_pool_draw_ids(uint32_t count); // Draw records up to count can be addressed this frame
+void mesh_pool_shutdown();
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <culling.h> // aabb_t
+#include <jobs.h>    // Rasterization is split into bands across the worker threads
+
+#include <emmintrin.h> // SSE2 float to int conversion for the span setup
+
+// Coarse depth buffer for the combined stereo view, in 32x8 pixel tiles. Each tile stores a masked
+// two layer depth (Hasselgren et al., "Masked Software Occlusion Culling"): a reference depth z0 that
+// the whole tile is known to be occluded beyond, and a working layer that collects partial coverage
+// until it fills the tile and becomes the new reference. Depth is view distance, larger is farther.
+const uint32_t occlusion_width       = 320;
+const uint32_t occlusion_height      = 192;
+const uint32_t occlusion_tile_width  = 32; // One bit per pixel in a uint32_t row
+const uint32_t occlusion_tile_height = 8;
+const uint32_t occlusion_tiles_x     = occlusion_width / occlusion_tile_width;
+const uint32_t occlusion_tiles_y     = occlusion_height / occlusion_tile_height;
+
+struct occlusion_tile_t {
+	float    z0;      // Reference layer, FLT_MAX when nothing covers the whole tile yet
+	float    z1;      // Working layer, farthest depth of what's been merged into it
+	uint32_t mask[occlusion_tile_height]; // Working layer coverage
+};
+
+// Occluder triangle after projection, counter clockwise in pixels
+struct occlusion_triangle_t {
+	glm::vec2 v[3];
+	float     z_max;   // Farthest vertex, the whole triangle is treated as being this far away
+	uint32_t  tile_y0; // Tile rows it touches, inclusive
+	uint32_t  tile_y1;
+};
+
+struct occlusion_stats_t {
+	uint32_t occluders;
+	uint32_t triangles; // Front facing occluder triangles that were rasterized
+	uint32_t tested;
+	uint32_t occluded;
+	float    raster_us;
+	float    test_us;
+};
+
+struct occlusion_buffer_t {
+	std::vector<occlusion_tile_t>     tiles;
+	std::vector<occlusion_triangle_t> triangles;
+	glm::mat4         viewproj;
+	glm::vec2         ndc_scale;     // NDC units per unit of view space tangent, from the projection
+	float             eye_offset;    // Farthest any eye sits from the center view the buffer is drawn from
+	float             occluder_near; // Closest occluder vertex rasterized, bounds how far an eye can see around one
+	bool              ready;   // Rasterized for the current frame, cleared at the start of every XR frame
+	occlusion_stats_t stats;
+};
+
+bool               app_config_occlusion           = true; // Test objects against the static scene's occluders
+uint32_t           app_config_occluder_triangles  = 1024; // Models at or under this many triangles keep a CPU copy to occlude with
+uint32_t           app_config_occluders_per_frame = 64;   // Nearest visible occluders that get rasterized
+occlusion_buffer_t app_occlusion;
+
+void occlusion_begin       (occlusion_buffer_t& buffer, const glm::mat4& viewproj, float eye_offset);
+void occlusion_add_occluder(occlusion_buffer_t& buffer, const glm::vec3* positions, const uint32_t* indices, size_t index_count, const glm::mat4& world);
+void occlusion_rasterize   (occlusion_buffer_t& buffer);
+bool occlusion_test_box    (occlusion_buffer_t& buffer, const aabb_t& box); // False when the box is certainly hidden
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <gameobject.h> // Model and Transform, plus the GL state we sort on
+#include <ringbuffer.h> // Per draw uniforms are written into a persistently mapped ring
+#include <culling.h> // Queued draws are frustum culled before sorting
+#include <occlusion.h> // and then tested against the occlusion buffer
+#include <streaming.h> // Visible draws tell texture streaming how big they are on screen
+#include <texturepages.h> // Textures in array pages are picked per draw by layer
+#include <gpuculling.h> // Pooled draws can be culled by a compute shader instead
+
+// What a draw uses: GL state, the range of the index buffer, and how its vertex positions are encoded
+struct draw_mesh_t {
+	GLuint    program;
+	GLuint    texture;
+	GLuint    vao;
+	GLsizei   index_count;
+	uint32_t  first_index;   // Where the model's LOD starts in its EBO
+	GLenum    index_type;    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	bool      quantized;     // Positions are unorm16 within the box below, decoded by folding it into the world matrix
+	glm::vec3 decode_offset;
+	glm::vec3 decode_scale;
+	bool      paged;         // texture is a GL_TEXTURE_2D_ARRAY page, sampled at layer
+	uint32_t  layer;
+	bool      pooled;        // Lives in a mesh pool, drawn by multi draw indirect with base_vertex
+	GLint     base_vertex;
+	GLuint    instanced_program; // Same shader with INSTANCED, so repeated plain draws can be merged. 0 keeps them apart
+	GLuint    streamed;      // Streamed texture drawn from its page, still told how big it is on screen
+};
+
+// glMultiDrawElementsIndirect's command layout
+struct draw_indirect_command_t {
+	uint32_t count;
+	uint32_t instance_count;
+	uint32_t first_index;
+	int32_t  base_vertex;
+	uint32_t base_instance; // First draw record, see default.vert
+};
+
+// One per pooled object (per instance for instanced packets), matches draw_record_t in default.vert
+struct draw_record_t {
+	glm::mat4  world;
+	glm::uvec4 material; // Same as app_transform_buffer_t::material
+};
+
+// Sorted pooled packets in a row that share program, texture and VAO, drawn with one call
+struct draw_batch_t {
+	uint32_t first;          // Into render_queue_t::order
+	uint32_t count;
+	uint32_t commands;       // One per packet, or per distinct mesh when GPU culled
+	size_t   command_offset; // Their commands, in the ring or in app_gpu_cull.commands
+};
+
+// One queued draw, holds everything the flush needs so it never has to look at the Model again
+struct draw_packet_t {
+	draw_mesh_t mesh;
+	glm::mat4 world;
+	uint32_t  instance_first; // Into render_queue_t::instance_worlds, when instance_count > 0
+	uint32_t  instance_count; // 0 for a plain draw using world
+	uint32_t  bounds_index;   // Into render_queue_t::bounds, instanced packets have one entry per instance from here
+};
+
+const uint32_t render_queue_no_bounds = 0xFFFFFFFF; // bounds_index of a packet the caller already culled
+
+// Plain draws of one mesh with one material, folded into an instanced packet by render_queue_instance()
+struct draw_instance_group_t {
+	uint32_t leader;    // Packet that becomes the instanced draw
+	uint32_t count;
+	uint32_t first;     // Into render_queue_t::instance_worlds
+	uint32_t filled;
+};
+
+// Counters from the last flush of a queue
+struct render_stats_t {
+	uint32_t packets;       // Draws submitted to the queue
+	uint32_t tested;        // Objects frustum tested, each instance counts
+	uint32_t visible;       // Objects that passed, the rest never reach GL
+	uint32_t occluded;      // Inside the frustum but hidden behind occluders
+	uint32_t draws;         // Draw calls issued
+	uint32_t commands;      // Indirect commands inside multi draw calls
+	uint32_t gpu_culled;    // Pooled objects left to the compute shader, not counted in tested/visible
+	uint32_t instances;     // Objects drawn through instanced draws
+	uint32_t merged;        // Plain draws that went out as part of an automatic instanced draw instead of their own
+	uint32_t program_binds; // State changes that actually reached GL, the rest were skipped as redundant
+	uint32_t texture_binds;
+	uint32_t vao_binds;
+};
+
+// Draws for one view (or both eyes with multiview), sorted by GL state and then front to back before submission
+struct render_queue_t {
+	std::vector<draw_packet_t> packets;
+	std::vector<uint64_t>      keys;        // 64 bit sort key per packet, see render_queue_key()
+	std::vector<uint32_t>      order;       // Packet indices, sorted by key
+	std::vector<uint64_t>      keys_temp;   // Radix sort ping-pong buffers
+	std::vector<uint32_t>      order_temp;
+	std::vector<size_t>        uniform_offsets; // Where each sorted packet's TransformBuffer (or instance data) lives in the ring
+	std::vector<glm::mat4>     instance_worlds; // World matrices for instanced packets
+	std::vector<draw_batch_t>  batches;         // Multi draw indirect calls, in sorted order
+	std::unordered_map<uint64_t, uint32_t> instance_lookup; // Mesh and material to group, see render_queue_instance()
+	std::vector<draw_instance_group_t>     instance_groups;
+	std::vector<uint32_t>      packet_groups;   // Group of each packet, UINT32_MAX when it stays as it is
+	uint32_t                   indirect_commands; // Pooled packets, counted by render_queue_reserve()
+	uint32_t                   indirect_records;  // and the objects in them
+	size_t                     records_offset;  // Draw records of every pooled packet, in the ring
+	size_t                     records_bytes;
+	cull_list_t                bounds;          // World space bounds of everything queued
+	cull_list_t                gpu_bounds;      // Same, for pooled packets when gpu_cull is set
+	std::vector<uint32_t>      gpu_object_bounds; // Into gpu_bounds per cull object, for validation
+	std::unordered_map<uint32_t, uint32_t> gpu_commands; // first_index to command, within the current batch
+	std::vector<draw_indirect_command_t>   gpu_command_list;    // Built here, then copied into the ring
+	std::vector<uint32_t>      gpu_packet_commands; // Command of each sorted pooled packet
+	size_t                     gpu_objects_offset;  // gpu_cull_object_t per pooled object, in the ring
+	uint32_t                   gpu_object_count;
+	size_t                     gpu_commands_offset;
+	size_t                     gpu_commands_bytes;
+	bool                       gpu_cull;        // app_config_gpu_culling at render_queue_begin()
+	frustum_t                  frustum;
+	bool                       cull;            // Set by render_queue_set_frustum() for this frame
+	size_t                     view_offset;     // ViewBuffer for the instanced shader, in the ring
+	glm::vec3                  eye_position;
+	glm::vec3                  eye_forward;
+	render_stats_t             stats;
+};
+
+// A draw recorded for replay, see draw_list_t
+struct draw_list_entry_t {
+	draw_mesh_t mesh;
+	glm::mat4   world;
+	uint32_t    instance_first; // Into draw_list_t::instance_worlds, when instance_count > 0
+	uint32_t    instance_count; // 0 for a plain draw using world
+	Bounds      bounds;
+};
+
+// What the game drew this frame. Game::render runs once into this list, then it's replayed into the render
+// queue of each view, which culls, sorts and writes uniforms with that view's matrices. Transforms, LOD
+// picks and whatever else the game computes only happen once however many views there are.
+struct draw_list_t {
+	std::vector<draw_list_entry_t> entries;
+	std::vector<glm::mat4>         instance_worlds;
+	bool                           recorded; // This frame's list is complete, set by whoever recorded it
+};
+
+render_queue_t app_render_queue;
+draw_list_t    app_frame_draws; // Model::drawModel and drawInstanced record here
+
+bool     app_config_auto_instancing = true;  // Merge plain draws of the same mesh and material into instanced draws at flush
+uint32_t app_config_auto_instancing_min = 2; // Fewer copies than this stay separate draws, keeping their front to back order
+
+void     render_queue_begin(render_queue_t& queue, const glm::vec3& eye_position, const glm::vec3& eye_forward);
+void     render_queue_set_frustum(render_queue_t& queue, const frustum_t& frustum);
+void     render_queue_push (render_queue_t& queue, const draw_mesh_t& mesh, const glm::mat4& world, const Bounds& bounds);
+void     render_queue_push_visible(render_queue_t& queue, const draw_mesh_t& mesh, const glm::mat4& world);
+void     render_queue_push_instanced(render_queue_t& queue, const draw_mesh_t& mesh, const glm::mat4* worlds, size_t count, const Bounds& bounds);
+void     render_queue_cull (render_queue_t& queue);
+void     render_queue_instance(render_queue_t& queue);
+void     render_queue_sort (render_queue_t& queue);
+void     render_queue_touch_textures(const render_queue_t& queue);
+void     render_queue_flush(render_queue_t& queue);
+uint64_t render_queue_key  (GLuint program, GLuint texture, GLuint vao, float depth);
+
+void     draw_list_clear (draw_list_t& list);
+void     draw_list_push  (draw_list_t& list, const draw_mesh_t& mesh, const glm::mat4& world, const Bounds& bounds);
+void     draw_list_push_instanced(draw_list_t& list, const draw_mesh_t& mesh, const Transform* transforms, size_t count, const Bounds& bounds);
+void     draw_list_replay(const draw_list_t& list, render_queue_t& queue);
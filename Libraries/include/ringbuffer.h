@@ -0,0 +1,40 @@
+#pragma once
+
+#include <engine.h> // OpenGL and the extension pointers
+
+const uint32_t gpu_ring_frames = 3; // Frames the GPU may still be reading from while we write the next one
+
+// A buffer the ring grew out of, kept mapped until the GPU is done with the draws that already used it
+struct gpu_ring_retired_t {
+	GLuint buffer;
+	bool   persistent;
+	GLsync fence;
+};
+
+// A buffer split into one section per frame in flight. The CPU writes per-draw data straight into a
+// persistent, coherent mapping and binds it by offset, so uploads never make the driver sync or rename
+// the buffer. A fence per section tells us when the GPU is done with it and it can be written again.
+struct gpu_ring_t {
+	GLuint   buffer;
+	uint8_t* mapped;          // Persistent mapping, or the staging copy when ARB_buffer_storage is missing
+	bool     persistent;
+	size_t   section_size;    // Bytes per frame in flight
+	size_t   alignment;       // Offset alignment for binding ranges of this buffer
+	uint32_t section;         // Section the current frame writes to
+	size_t   offset;          // Write position in the current section
+	size_t   committed;       // Staging mode: how much of the section has been uploaded already
+	GLsync   fences[gpu_ring_frames];
+	std::vector<uint8_t> staging;
+	std::vector<gpu_ring_retired_t> retired;
+};
+
+gpu_ring_t app_uniform_ring; // Per draw TransformBuffer data
+
+void     gl_ring_create     (gpu_ring_t& ring, size_t section_size, size_t alignment);
+void     gl_ring_destroy    (gpu_ring_t& ring);
+void     gl_ring_begin_frame(gpu_ring_t& ring);
+void     gl_ring_end_frame  (gpu_ring_t& ring);
+void     gl_ring_reserve    (gpu_ring_t& ring, size_t size); // Once per batch, before any of its allocations
+uint8_t* gl_ring_alloc      (gpu_ring_t& ring, size_t size, size_t& out_offset); // From what was reserved
+void     gl_ring_commit     (gpu_ring_t& ring);
+size_t   gl_ring_alignment  (); // Satisfies both uniform and shader storage binding offsets
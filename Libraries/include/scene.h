@@ -0,0 +1,57 @@
+#pragma once
+
+#include <renderqueue.h> // Entities are recorded into the frame draw list like any drawModel() call
+#include <ecs.h>         // Entities, and their transforms in per-component arrays
+#include <hierarchy.h>   // Entities can hang off a node and follow it
+
+// Which model an entity draws, as an index into Scene::models so the component stays plain data
+struct scene_renderable_t {
+	uint32_t model;
+	bool     visible;
+};
+
+// A model the scene holds on to for as long as any entity draws it
+struct scene_model_t {
+	ModelHandle model;
+	uint32_t    users;
+};
+
+// Counters from the last update and draw
+struct scene_stats_t {
+	uint32_t entities; // Alive
+	uint32_t updated;  // World matrices rebuilt
+	uint32_t drawn;    // Recorded into the draw list
+};
+
+// Retained set of drawables. The game adds a model with a transform once and the engine records it every
+// frame after Game::render, so the render queue sees every entity at once and can cull, sort and merge
+// them into instanced draws. Entities live in an archetype ECS: position, rotation and scale are separate
+// arrays, and update() only visits chunks whose transform was written since the last update, spread over
+// the worker threads. Inside those it rebuilds just the rows marked dirty, so a few scattered moves don't
+// rebuild every chunk they land in. An entity given a parent node keeps its transform relative
+// to it, and is rebuilt whenever that node's world matrix changes.
+class Scene {
+public:
+	ecs_world_t                          world;
+	ecs_component_t                      position, rotation, scale, matrix, renderable, parent, dirty; // Registered on the first add()
+	transform_hierarchy_t*               hierarchy = &app_hierarchy; // Where parent nodes live
+	std::vector<scene_model_t>           models;
+	std::vector<uint32_t>                free_models;
+	std::unordered_map<Model*, uint32_t> model_lookup;
+	uint32_t                             updated_version = 0; // World version the matrices were last rebuilt at
+	uint32_t                             hierarchy_seen = 0; // Hierarchy version they were last rebuilt against
+	scene_stats_t                        stats = {};
+
+	Entity    add(ModelHandle model, const Transform& transform);
+	void      remove(Entity entity);
+	bool      valid(Entity entity) const;
+	Transform getTransform(Entity entity) const;
+	void      setTransform(Entity entity, const Transform& transform); // Its matrix gets rebuilt by the next update()
+	void      setVisible(Entity entity, bool visible);
+	void      setParent(Entity entity, hierarchy_node_t node); // hierarchy_none to detach, the transform becomes relative to the node
+	void      update(); // Rebuild the world matrices of entities that changed
+	void      draw(draw_list_t& list); // Record every visible entity whose model has landed
+	void      clear();
+};
+
+Scene app_scene; // Drawn by app_draw every frame
@@ -15,6 +15,10 @@ public:
 	const char* vertexShader;
 	const char* fragmentShader;
 
+	// Backing storage for the pointers above
+	std::string vertexCode;
+	std::string fragmentCode;
+
 	// Constructor that build the Shader Program from 2 different shaders
 	Shaders(const char* vertexFile, const char* fragmentFile);
 	void loadVertexShader(const char* vertexFile);
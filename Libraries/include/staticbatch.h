@@ -0,0 +1,53 @@
+#pragma once
+
+#include <staticscene.h> // Merged chunks are drawn and culled as static objects
+#include <assets.h>      // Sources may be shared through the asset cache
+
+// Models marked static are merged at level load: every placement sharing a texture goes into pre-transformed
+// vertex and index buffers, one per grid cell, so a level of props turns into a few big draws that the
+// static scene can still cull. Triangles go to the cell their centroid is in, so a large mesh gets split up
+// too. Every model draws with the default program, so the texture is all that tells materials apart.
+//
+// Sources are read back from the GPU (full detail level only, decoded if quantized) and each chunk goes
+// through Model::loadMesh(), so it gets its own LODs, optimization, quantization and mesh pool slot.
+// Per object LOD selection is traded for per chunk selection, and static scene ray queries hit chunks.
+struct static_batch_source_t {
+	Model*    model; // Not owned, has to outlive the build
+	Transform transform;
+};
+
+// One cell of merged geometry while building
+struct static_batch_chunk_t {
+	TextureHandle         texture;
+	GLuint                texture_id; // For models whose texture didn't come from the asset cache
+	std::vector<float>    vertices;   // World space, vertex_float_stride
+	std::vector<uint32_t> indices;
+	uint32_t              sources;    // Placements with triangles in this chunk
+};
+
+struct static_batch_stats_t {
+	uint32_t sources;   // Placements merged
+	uint32_t models;    // Distinct models they used
+	uint32_t chunks;    // Models they became
+	uint32_t triangles;
+	uint32_t kept;      // Sources not freed because other handles to them are still out
+	double   build_ms;
+};
+
+struct static_batch_t {
+	std::vector<static_batch_source_t> sources; // Marked since the last build
+	std::vector<ModelHandle>           chunks;  // Registered with the static scene, so they live as long as the batch
+	static_batch_stats_t               stats;
+};
+
+bool  app_config_static_batching = true;         // Otherwise marked models are added to the static scene one by one
+float app_config_static_batch_cell = 16.0f;      // Chunk size in world units, smaller culls better but draws more
+bool  app_config_static_batch_free_sources = true; // Free the originals once merged, unless something else still holds a handle to them
+static_batch_t app_static_batch;
+
+void static_batch_add  (static_batch_t& batch, Model& model, const Transform& transform); // Model::markStatic()
+void static_batch_merge(const float* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count, const glm::mat4& world,
+                        float cell_size, std::unordered_map<uint64_t, uint32_t>& cells, std::vector<static_batch_chunk_t>& chunks); // Appends one placement, cells maps a cell key to its chunk
+bool static_batch_read (const Model& model, std::vector<float>& vertices, std::vector<uint32_t>& indices); // Full detail level back from the GPU, waits for the upload
+void static_batch_build(static_batch_t& batch, static_scene_t& scene); // Merge everything marked so far, after the level is loaded
+void static_batch_clear(static_batch_t& batch);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <bvh.h>         // Culling and ray queries over the registered objects
+#include <jobs.h>        // The BVH is built off the main thread
+#include <renderqueue.h> // Visible objects are queued like any other draw
+
+// A model placed in the level that (almost) never moves
+struct static_object_t {
+	const Model* model; // Not owned, has to outlive the scene
+	glm::mat4    world;
+};
+
+// Level geometry registered once at load, drawn every frame through a BVH instead of a flat list.
+// Objects added since the last build are still drawn, just culled one by one until the next build lands.
+struct static_scene_t {
+	std::vector<static_object_t> objects;
+	std::vector<aabb_t>          boxes;          // World space bounds, parallel to objects
+	bvh_t                        bvh;            // Covers objects [0, built_count)
+	uint32_t                     built_count;
+	bvh_t                        bvh_building;   // Written by the build job, swapped in once it's done
+	uint32_t                     building_count;
+	double                       build_ms;       // Of the BVH swapped in last, on its worker
+	double                       building_ms;    // Written by the build job
+	job_handle_t                 build_job;
+	bool                         moved;          // Objects moved since the last refit
+	std::vector<uint32_t>        visible;
+	std::vector<std::pair<float, uint32_t>> occluders; // Distance and object, candidates for the occlusion buffer
+	bvh_stats_t                  stats;          // From the last draw
+};
+
+// What a ray query hit
+struct static_hit_t {
+	bool     hit;
+	uint32_t object;   // Index returned by static_scene_add
+	float    distance;
+};
+
+static_scene_t app_static_scene;
+static_hit_t   app_hand_hits[2]; // What each controller points at, updated every frame
+
+uint32_t     static_scene_add    (static_scene_t& scene, const Model& model, const Transform& transform);
+void         static_scene_move   (static_scene_t& scene, uint32_t object, const Transform& transform);
+void         static_scene_update (static_scene_t& scene);
+void         static_scene_draw   (static_scene_t& scene, render_queue_t& queue, const frustum_t& frustum);
+static_hit_t static_scene_raycast(const static_scene_t& scene, const glm::vec3& origin, const glm::vec3& direction, float max_distance);
+static_hit_t static_scene_raycast_pose(const static_scene_t& scene, const XrPosef& pose, float max_distance);
+void         static_scene_clear  (static_scene_t& scene);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <ktx.h>  // Baked textures stream their compressed levels as stored
+#include <jobs.h> // Source images are decoded and filtered off the main thread
+#include <upload.h> // And their levels staged from there too
+#include <texturepages.h> // The always resident levels are paged as well
+
+// A texture whose mip levels become resident over several frames. It's usable as soon as its small levels
+// are up, finer ones are uploaded when something on screen is big enough to need them and the budget
+// allows, and dropped again when nothing does. Every level stays in system memory, so evicting one
+// only costs an upload to bring it back.
+struct stream_texture_t {
+	GLuint                       id;
+	std::string                  path;
+	uint32_t                     width;  // Level 0
+	uint32_t                     height;
+	uint32_t                     level_count;
+	GLenum                       format; // Internal format, GL_RGB/GL_RGBA or a block compressed one
+	bool                         compressed;
+	ktx_texture_t                baked;  // Levels of a .ktx2, when there was one
+	std::vector<texture_image_t> levels; // Otherwise decoded and filtered by the job below
+	job_handle_t                 decode;        // The decode job and the uploads of its resident levels
+	job_handle_t                 upload;        // A finer level on its way up
+	uint32_t                     uploading;     // Which one, level_count while none is
+	bool                         ready;         // Levels are in memory and the small ones are uploaded
+	uint32_t                     floor;         // Coarsest level that's always resident, once ready
+	uint32_t                     resident_base; // Finest level on the GPU, level_count while none are
+	uint32_t                     target_base;   // Where the budget says resident_base should go
+	float                        pixels;        // Largest on screen size this frame, in pixels across
+	uint64_t                     last_seen;     // app_stream.frame it was last drawn in
+	float                        min_lod;       // Fades a newly arrived level in instead of popping
+	bool                         paged;         // The levels from floor down also sit in a texture page, at layer
+	uint32_t                     page;
+	uint32_t                     layer;
+};
+
+// Counters from the last stream_update()
+struct stream_stats_t {
+	size_t   resident_bytes;  // Levels on the GPU across every streamed texture
+	uint32_t textures;
+	uint32_t decoding;        // Still waiting on their image to decode
+	uint32_t uploading;       // Textures with a finer level on its way up
+	uint32_t uploaded_levels; // Landed this update
+	size_t   uploaded_bytes;  // Queued this update
+	uint32_t evicted_levels;
+};
+
+struct stream_system_t {
+	std::map<GLuint, stream_texture_t> textures; // By GL name, that's what draw packets carry
+	uint64_t                           frame;
+	stream_stats_t                     stats;
+};
+
+stream_system_t app_stream;
+
+bool     app_config_texture_streaming = true;       // asset_load_texture streams, instead of loading every level up front
+size_t   app_config_texture_budget = 512ull << 20;  // GPU bytes streamed textures may hold, the always resident levels included
+size_t   app_config_stream_upload_bytes = 8u << 20; // Queue at most this much per frame, at least one level always goes
+uint32_t app_config_stream_resident_size = 64;      // Levels this size and smaller are uploaded as soon as the texture loads
+uint32_t app_config_stream_idle_frames = 90;        // Textures not drawn for this long fall back to their resident levels
+float    app_config_stream_bias = 1.0f;             // Scales the size textures are wanted at, below 1 streams in less detail
+float    app_config_stream_fade = 0.1f;             // Mip levels per frame a newly arrived level fades in at, 0 pops
+
+Texture stream_texture_load   (const std::string& path); // Returns right away, the texture starts out as a placeholder
+void    stream_texture_release(GLuint id);               // Before the GL texture is deleted
+void    stream_touch          (GLuint id, float pixels); // Drawn this frame at about this many pixels across
+bool    stream_texture_page   (GLuint id, uint32_t& out_page, uint32_t& out_layer); // True while only the paged levels are resident, draw from the page then
+void    stream_update         ();                        // Once per frame: finish decodes, apply the budget, queue uploads and evict
+void    stream_shutdown       ();
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <jobs.h> // Images are compressed in parallel, a band of block rows per job
+
+#include <emmintrin.h> // SSE2 index fitting 4 texels at a time, and mip filtering one RGBA texel per register
+
+// S3TC isn't in our glad profile, these come from EXT_texture_compression_s3tc and EXT_texture_sRGB
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT        0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT       0x83F3
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT       0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// Block compressed formats the texture baker writes. Every one works on 4x4 texel blocks.
+//   BC1  8 bytes per block, RGB, 8x smaller than RGBA8
+//   BC3 16 bytes per block, BC1 color plus a separately coded alpha channel
+//   BC7 16 bytes per block, RGBA at much better quality than BC3 (only mode 6 is written)
+enum texture_format_t {
+	TEXTURE_FORMAT_BC1,
+	TEXTURE_FORMAT_BC3,
+	TEXTURE_FORMAT_BC7,
+	TEXTURE_FORMAT_AUTO, // BC1 for opaque images, BC7 when there's alpha
+};
+
+// How each mip level is filtered down from the one above it
+enum texture_mip_filter_t {
+	TEXTURE_MIP_BOX,     // 2x2 average, what glGenerateMipmap does, fine detail aliases into shimmer
+	TEXTURE_MIP_LANCZOS, // Lanczos-3 windowed sinc, sharpest, a little ringing at hard edges
+	TEXTURE_MIP_KAISER,  // Kaiser windowed sinc, nearly as sharp with less ringing
+};
+
+texture_mip_filter_t app_config_mip_filter = TEXTURE_MIP_KAISER;
+bool                 app_config_cpu_mips = true; // Textures build their mips on the worker threads instead of glGenerateMipmap
+
+// One mip level of an RGBA8 image
+struct texture_image_t {
+	uint32_t             width;
+	uint32_t             height;
+	std::vector<uint8_t> pixels; // RGBA8, rows top to bottom
+};
+
+// One compressed mip level
+struct texture_level_t {
+	uint32_t             width;
+	uint32_t             height;
+	std::vector<uint8_t> blocks;
+};
+
+uint32_t    texture_block_bytes   (texture_format_t format);
+GLenum      texture_gl_format     (texture_format_t format, bool srgb);
+const char* texture_format_name   (texture_format_t format);
+bool        texture_has_alpha     (const texture_image_t& image);
+void        texture_build_mips    (const texture_image_t& source, bool srgb, std::vector<texture_image_t>& out_levels); // Level 0 is a copy of source
+void        texture_downsample    (const texture_image_t& source, bool srgb, texture_mip_filter_t filter, texture_image_t& out_image); // To half size, rounded down
+void        texture_compress      (const texture_image_t& image, texture_format_t format, texture_level_t& out_level);
+void        texture_compress_block(const uint8_t* rgba, texture_format_t format, uint8_t* out_block); // 16 texels, row by row
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <gameobject.h> // Texture, which records the page and layer it was packed into
+
+// A GL_TEXTURE_2D_ARRAY holding textures of one size, format and mip count, one per layer. Draws sampling
+// any of them bind the same texture and only differ in the layer the shader is given, so the render queue
+// groups them by mesh instead and texture binds drop to one per page. Pages grow by doubling.
+struct texture_page_t {
+	GLuint                array;      // 0 while the page holds nothing
+	GLenum                format;     // Sized internal format, block compressed ones included
+	uint32_t              width;
+	uint32_t              height;
+	uint32_t              levels;
+	uint32_t              capacity;   // Layers allocated
+	uint32_t              high_water; // Layers ever handed out, the ones below it that were released are in free_layers
+	uint32_t              used;
+	std::vector<uint32_t> free_layers;
+};
+
+struct texture_pages_t {
+	std::vector<texture_page_t> pages; // Never reordered, Texture::page indexes it
+	size_t                      bytes; // Allocated across every page, free layers included
+	uint32_t                    max_layers;
+};
+
+texture_pages_t app_texture_pages;
+
+bool     app_config_texture_arrays = true;        // Pack textures loaded whole into pages. Streamed ones keep their own texture for the mips they stream, their always resident ones are paged too
+uint32_t app_config_texture_page_first_layers = 4; // A new page starts this big
+const uint32_t texture_no_layer = 0xFFFFFFFF;     // What the shader gets for a draw with a plain GL_TEXTURE_2D
+
+bool   texture_pages_add     (Texture& texture);       // Moves a loaded texture into a page, false leaves it as it was
+void   texture_pages_remove  (const Texture& texture);
+bool   texture_pages_alloc   (GLenum format, uint32_t width, uint32_t height, uint32_t levels, uint32_t& out_page, uint32_t& out_layer); // A layer for the caller to fill
+void   texture_pages_free    (uint32_t page, uint32_t layer);
+GLuint texture_pages_array   (const Texture& texture); // The page's current array, it changes when the page grows
+void   texture_pages_shutdown();
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <engine.h> // OpenGL and the extension pointers
+#include <jobs.h>   // Handles to wait on, producers are usually worker threads
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// What one staged upload turns into on the GL thread
+enum upload_kind_t {
+	UPLOAD_BUFFER,             // glCopyBufferSubData into a buffer
+	UPLOAD_TEXTURE,            // glTexSubImage2D of RGBA8 rows
+	UPLOAD_TEXTURE_COMPRESSED, // glCompressedTexSubImage2D of block rows
+};
+
+// A slice of the staging ring and where it goes. Big uploads are split into several of these so they
+// spread over frames.
+struct upload_op_t {
+	upload_kind_t kind;
+	GLuint        object;       // Buffer or texture name
+	size_t        dest_offset;  // Buffers: byte offset to write at
+	uint32_t      level;        // Textures: mip level, allocated with the op that has first set
+	uint32_t      level_width;
+	uint32_t      level_height;
+	GLenum        format;       // Internal format
+	uint32_t      y;            // First texel row this op covers, and how many
+	uint32_t      rows;
+	bool          first;
+	size_t        staging_offset;
+	size_t        size;
+	job_handle_t  handle;       // Counts down once the op has been issued to GL
+	uint64_t      id;
+	bool          ready;        // The producer finished writing the staging bytes
+	bool          issued;
+};
+
+// A set of ops issued together, the fence tells when the GPU has read their staging bytes
+struct upload_batch_t {
+	GLsync   fence;
+	uint64_t last_id;
+};
+
+// Counters from the last upload_update()
+struct upload_stats_t {
+	uint32_t ops;
+	size_t   bytes;
+	size_t   pending_bytes; // Staged and waiting for a later frame's budget
+	float    ms;            // CPU time spent issuing
+};
+
+// A persistently mapped staging buffer used as a FIFO. Any thread can stage data into it, copying straight
+// into the mapping; the GL thread then issues the copies out of it (PBO sourced for textures) a few MB per
+// frame, and a fence per batch says when that space can be written again. If the ring is full a worker
+// waits for space, the GL thread instead issues and waits itself so it never deadlocks.
+struct upload_system_t {
+	GLuint                     buffer;
+	uint8_t*                   mapped;  // Persistent mapping, or a CPU copy when ARB_buffer_storage is missing
+	bool                       persistent;
+	size_t                     capacity;
+	size_t                     head;    // Next write position
+	std::deque<upload_op_t>    ops;     // Oldest first, each holds its range of the ring until its batch retires
+	std::deque<upload_batch_t> batches;
+	uint64_t                   next_id;
+	std::vector<uint8_t>       staging;
+	std::mutex                 mutex;
+	std::condition_variable    space;
+	std::thread::id            gl_thread;
+	upload_stats_t             stats;
+};
+
+upload_system_t app_upload;
+
+size_t app_config_upload_ring_bytes  = 64u << 20; // Staging ring size
+size_t app_config_upload_frame_bytes = 8u << 20;  // Issued per frame at most, at least one op always goes
+float  app_config_upload_frame_ms    = 1.0f;      // Also stop issuing once this much of the frame went into it
+const size_t upload_chunk_bytes = 1u << 20;       // Uploads are split into ops of about this size
+
+void upload_init    ();  // On the GL thread, once there's a context
+void upload_shutdown();  // Issues what's left and waits for it
+void upload_drain   ();  // GL thread: issue uploads until no job is left running, before jobs_shutdown
+void upload_buffer  (GLuint buffer, size_t offset, const void* data, size_t size, const job_handle_t& handle);
+void upload_texture (GLuint texture, uint32_t level, uint32_t width, uint32_t height, GLenum internal_format, const uint8_t* rgba, const job_handle_t& handle);
+void upload_texture_compressed(GLuint texture, uint32_t level, uint32_t width, uint32_t height, GLenum internal_format, const uint8_t* blocks, size_t block_bytes, const job_handle_t& handle);
+void upload_update  ();  // GL thread, once per frame: retire finished batches and issue within the budget
+void upload_flush   ();  // GL thread: issue everything staged, ignoring the budget
+void upload_wait    (const job_handle_t& handle); // GL thread: wait on jobs that stage uploads, issuing them as they come
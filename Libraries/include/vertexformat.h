@@ -0,0 +1,28 @@
+#pragma once
+
+#include <engine.h> // GL and glm
+
+#include <glm/gtc/packing.hpp> // Half float UVs
+
+// Vertex layouts a Model's VBO can use. Both feed default.vert at the same attribute locations, the
+// quantized one is drawn with the QUANTIZED variant, which unpacks its normals.
+//   float:     position 3x fp32, normal 3x fp32, uv 2x fp32                   32 bytes
+//   quantized: position 4x unorm16, normal 2x snorm16 octahedral, uv 2x fp16   16 bytes
+struct vertex_quantized_t {
+	uint16_t position[4]; // Relative to the mesh's box, w is padding that keeps the normal 4 byte aligned
+	int16_t  normal[2];
+	uint16_t uv[2];       // Half floats
+};
+
+const uint32_t vertex_float_stride = 8;    // Floats per vertex in the layout loadModel builds
+const float    vertex_half_uv_max  = 4.0f; // Past this half floats lose more than a texel on big textures, such meshes stay fp32
+
+bool app_config_quantize_vertices = true; // Models load with the 16 byte layout when their UVs allow it
+
+bool      vertex_can_quantize       (const float* vertices, uint32_t vertex_count);
+void      vertex_quantize           (const float* vertices, uint32_t vertex_count, const glm::vec3& box_min, const glm::vec3& box_max, std::vector<vertex_quantized_t>& out);
+void      vertex_dequantize         (const vertex_quantized_t* packed, uint32_t vertex_count, const glm::vec3& box_min, const glm::vec3& box_max, std::vector<float>& out); // Back to the float layout, what the QUANTIZED shader decodes
+glm::vec2 vertex_octahedral_encode  (const glm::vec3& normal);
+glm::vec3 vertex_octahedral_decode  (const glm::vec2& p);
+void      vertex_attributes_float   (); // Attribute pointers for the bound VAO and VBO
+void      vertex_attributes_quantized();
@@ -1,13 +1,20 @@
 #version 450 core
+#ifdef MULTIVIEW
+#extension GL_OVR_multiview : require
+layout(num_views = 2) in; // Both eyes in one pass
+#define VIEW_ID gl_ViewID_OVR
+#else
+#define VIEW_ID 0
+#endif
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 uProjection;
-uniform mat4 uView;
+uniform mat4 uProjection[2];
+uniform mat4 uView[2];
 
 out vec3 TexCoords;
 
 void main() {
     TexCoords = aPos;
-    vec4 pos = uProjection * uView * vec4(aPos, 1.0);
+    vec4 pos = uProjection[VIEW_ID] * uView[VIEW_ID] * vec4(aPos, 1.0);
     gl_Position = pos.xyww; // trick to ensure depth = 1.0 and we don't discard skybox
-}
\ No newline at end of file
+}
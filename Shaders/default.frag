@@ -1,9 +1,15 @@
 #version 450 core
 in vec2 TexCoords; 
+flat in uint TextureLayer;
 out vec4 fragColor;
 
 uniform sampler2D texture_diffuse; 
+layout(binding = 1) uniform sampler2DArray texture_pages; // Textures packed by size and format, see texturepages.h
 
 void main() {
-	fragColor = texture(texture_diffuse, TexCoords);
+	// Same for the whole draw, so the branch costs nothing
+	if (TextureLayer == 0xFFFFFFFFu)
+		fragColor = texture(texture_diffuse, TexCoords);
+	else
+		fragColor = texture(texture_pages, vec3(TexCoords, float(TextureLayer)));
 }
\ No newline at end of file
@@ -1,16 +1,67 @@
 #version 450 core
+#ifdef MULTIVIEW
+#extension GL_OVR_multiview : require
+layout(num_views = 2) in; // Both eyes in one pass
+#define VIEW_ID gl_ViewID_OVR
+#else
+#define VIEW_ID 0
+#endif
 layout (location = 0) in vec3 in_pos;
+#ifdef QUANTIZED
+// 16 byte vertices: in_pos is 0-1 within the mesh's box, which the CPU folds into the world matrix,
+// in_texCoords are half floats, and normals are octahedral snorm16 pairs. Nothing is lit yet, so the
+// normal isn't decoded here, vertex_octahedral_decode is the CPU side inverse.
+layout (location = 1) in vec2 in_norm;
+#else
 layout (location = 1) in vec3 in_norm;
+#endif
 layout (location = 2) in vec2 in_texCoords; // Input texture coordinates
 
 out vec2 TexCoords; // Pass texture coordinates to fragment shader
+flat out uint TextureLayer; // Layer in texture_pages, or ~0 to sample texture_diffuse
 
+#ifdef INDIRECT
+// Pooled meshes, many per glMultiDrawElementsIndirect. in_draw counts up per instance from the command's
+// baseInstance, which is where its draw records start. An attribute rather than gl_DrawIDARB, so it works
+// without ARB_shader_draw_parameters and covers instanced commands too.
+layout (location = 3) in uint in_draw;
+layout(std140) uniform ViewBuffer {
+    mat4 viewproj[2];
+};
+struct draw_record_t {
+    mat4 world;
+    uvec4 material;
+};
+layout(std430, binding = 0) readonly buffer DrawBuffer {
+    draw_record_t draws[];
+};
+#elif defined(INSTANCED)
+// Many copies of one mesh in a single draw, each instance reads its own world matrix
+layout(std140) uniform ViewBuffer {
+    mat4 viewproj[2];
+};
+layout(std430, binding = 0) readonly buffer InstanceBuffer {
+    uvec4 instance_material; // Same layout as material below, shared by every instance
+    mat4 instance_world[];
+};
+#else
 layout(std140) uniform TransformBuffer {
     mat4 world;
-    mat4 viewproj;
+    mat4 mvp[2]; // viewproj * world from the CPU, one per eye, only [0] is used without multiview
+    uvec4 material;
 };
+#endif
 
 void main() {
     TexCoords = in_texCoords;
-    gl_Position = viewproj * world * vec4(in_pos, 1.0);
+#ifdef INDIRECT
+    TextureLayer = draws[in_draw].material.x;
+    gl_Position = viewproj[VIEW_ID] * (draws[in_draw].world * vec4(in_pos, 1.0));
+#elif defined(INSTANCED)
+    TextureLayer = instance_material.x;
+    gl_Position = viewproj[VIEW_ID] * (instance_world[gl_InstanceID] * vec4(in_pos, 1.0));
+#else
+    TextureLayer = material.x;
+    gl_Position = mvp[VIEW_ID] * vec4(in_pos, 1.0);
+#endif
 }
@@ -1,13 +1,17 @@
 #include "core/engine.cpp"
 
-Model rockModel, sceneModel; // Models
+ModelHandle rockModel; // Models
+Model sceneModel;
 Texture rockTexture, sceneTexture; // Their respective textures
+Entity rock; // Placed in app_scene, the engine draws it every frame
 Audio testSound;
 
 // Logic that runs once at the start of the game and used for initialization/declarations
 void Game::start() {
-	rockModel.loadModel("Resources/rock.obj", "Resources/rock_texture.jpeg");
+	rockModel = asset_load_model("Resources/rock.obj", "Resources/rock_texture.jpeg");
 	sceneModel.loadModel("Resources/zen_garden.obj", "Resources/zen_garden_texture.jpeg");
+	rock = app_scene.add(rockModel, defaultTransform); // move it later with app_scene.setTransform(), or hold it with app_scene.setParent(rock, app_hand_nodes[0])
+	sceneModel.markStatic(); // Level geometry, merged and culled in chunks
 	testSound.playAudio("Resources/test_sound.wav"); // assign audio file and play it (can use setVolume() to adjust volume)
 }
 
@@ -18,9 +22,7 @@ void Game::update() {
 		testSound.stopAudio(); // can also stop the same audio, for example, on input
 }
 
-// TODO: make transform within model and have drawing be automatic
-// Logic that runs once per frame - used for rendering
+// Logic that runs once per frame - used for rendering. Anything added to app_scene is drawn without
+// being listed here, this is for one-off drawModel() calls.
 void Game::render() {
-	rockModel.drawModel();
-	sceneModel.drawModel();
 }